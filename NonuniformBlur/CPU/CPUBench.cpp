@@ -0,0 +1,411 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "CPUFilterBatch.h"
+#include "CPUKernel.h"
+
+using namespace std;
+using namespace CPU;
+
+namespace
+{
+	void BuildMipChain(Texture2D &image, bool highQuality)
+	{
+		for (auto i = 1u; i < image.GetNumMips(); ++i)
+		{
+			const auto dst = image.GetSurface(i);
+			const auto src = image.GetSurface(i - 1);
+			for (auto y = 0u; y < dst.Height; ++y)
+				Kernel::Resample(dst, src, y, 0, dst.Width, highQuality);
+		}
+	}
+
+	bool IsEqual(const Texture2D &a, const Texture2D &b)
+	{
+		for (auto i = 0u; i < a.GetNumMips(); ++i)
+		{
+			const auto sa = a.GetSurface(i);
+			const auto sb = b.GetSurface(i);
+			for (auto y = 0u; y < sa.Height; ++y)
+				C_RETURN(memcmp(sa.GetRow(y), sb.GetRow(y), sa.Width * PixelSize) != 0, false);
+		}
+
+		return true;
+	}
+
+	uint32_t MaxDifference(const Texture2D &a, const Texture2D &b)
+	{
+		const auto sa = a.GetSurface();
+		const auto sb = b.GetSurface();
+		auto diff = 0u;
+		for (auto y = 0u; y < sa.Height; ++y)
+		{
+			const auto pa = sa.GetRow(y), pb = sb.GetRow(y);
+			for (auto i = 0u; i < sa.Width * PixelSize; ++i)
+				diff = (max)(diff, static_cast<uint32_t>(abs(pa[i] - pb[i])));
+		}
+
+		return diff;
+	}
+
+	double MeanDifference(const Texture2D &a, const Texture2D &b)
+	{
+		const auto sa = a.GetSurface();
+		const auto sb = b.GetSurface();
+		auto sum = 0.0;
+		for (auto y = 0u; y < sa.Height; ++y)
+		{
+			const auto pa = sa.GetRow(y), pb = sb.GetRow(y);
+			for (auto i = 0u; i < sa.Width * PixelSize; ++i) sum += abs(pa[i] - pb[i]);
+		}
+
+		return sum / (static_cast<double>(sa.Width) * sa.Height * PixelSize);
+	}
+
+	// Bytes of the levels between the source and the result, both chains
+	size_t GetIntermediateSize(uint32_t width, uint32_t height, uint32_t numMips, Format format)
+	{
+		size_t size = 0;
+		for (auto i = 1u; i < numMips; ++i)
+			size += static_cast<size_t>((max)(width >> i, 1u)) * (max)(height >> i, 1u);
+
+		return 2 * size * GetTexelSize(format);
+	}
+
+	// Names the outcome of a comparison that must be exact, counting the mismatches
+	const char *Exactness(bool isExact, uint32_t &numMismatches)
+	{
+		if (!isExact) ++numMismatches;
+
+		return isExact ? "exact" : "MISMATCH";
+	}
+
+	template<typename Func>
+	double Time(uint32_t numIterations, Func func)
+	{
+		auto best = 1e30;
+		for (auto n = 0u; n < numIterations; ++n)
+		{
+			const auto start = chrono::high_resolution_clock::now();
+			func();
+			const chrono::duration<double, milli> elapsed = chrono::high_resolution_clock::now() - start;
+			best = (min)(best, elapsed.count());
+		}
+
+		return best;
+	}
+}
+
+// Times building the full down-sampled mip chain, and the complete filter, of a
+// synthetic image with each instruction set supported by the running processor,
+// on the calling thread. Returns 1 if any of the results that must be exact is not.
+int main(int argc, char *argv[])
+{
+	const auto width = argc > 2 ? static_cast<uint32_t>(atoi(argv[1])) : 3840u;
+	const auto height = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 2160u;
+	const auto numIterations = 20u;
+	auto numMismatches = 0u;
+
+	const auto numMips = static_cast<uint32_t>(log2f(static_cast<float>((max)(width, height))) + 1.0f);
+	vector<uint8_t> source(size_t(width) * height * PixelSize);
+	auto seed = 1u;
+	for (auto &v : source)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		v = static_cast<uint8_t>(seed >> 24);
+	}
+
+	Texture2D reference, image;
+	N_RETURN(reference.Create(width, height, numMips), 1);
+	N_RETURN(image.Create(width, height, numMips), 1);
+	N_RETURN(reference.Upload(source.data()), 1);
+	N_RETURN(image.Upload(source.data()), 1);
+
+	printf("Mip chain of %ux%u (%u levels), best of %u runs\n", width, height, numMips, numIterations);
+	for (auto highQuality : { false, true })
+	{
+		Kernel::SetInstructionSet(Kernel::SCALAR);
+		BuildMipChain(reference, highQuality);
+
+		for (auto i = 0u; i <= Kernel::GetSupportedInstructionSet(); ++i)
+		{
+			const auto instructionSet = static_cast<Kernel::InstructionSet>(i);
+			Kernel::SetInstructionSet(instructionSet);
+
+			const auto best = Time(numIterations, [&]() { BuildMipChain(image, highQuality); });
+
+			printf("%-8s %-8s %8.3f ms  %s\n", highQuality ? "5-tap" : "2x2", Kernel::GetInstructionSetName(instructionSet),
+				best, Exactness(IsEqual(image, reference), numMismatches));
+		}
+	}
+
+	// The up-sample weights of the vectorized paths use a fast exp(), and those of
+	// the weight table are interpolated, so the results may differ from the scalar
+	// path by rounding
+	Filter filterRef, filter;
+	N_RETURN(filterRef.SetWeightTable(0), 1);
+	N_RETURN(filter.SetWeightTable(0), 1);
+	N_RETURN(filterRef.Init(width, height, source.data()), 1);
+	N_RETURN(filter.Init(width, height, source.data()), 1);
+	Kernel::SetInstructionSet(Kernel::SCALAR);
+	filterRef.Process(Float2{ 0.0f, 0.0f }, 24.0f);
+
+	printf("Filter::Process() of %ux%u\n", width, height);
+	for (auto i = 0u; i <= Kernel::GetSupportedInstructionSet(); ++i)
+	{
+		const auto instructionSet = static_cast<Kernel::InstructionSet>(i);
+		Kernel::SetInstructionSet(instructionSet);
+
+		const auto best = Time(numIterations / 4, [&]() { filter.InvalidateSource(); filter.Process(Float2{ 0.0f, 0.0f }, 24.0f); });
+		printf("%-8s %8.3f ms  max diff %u\n", Kernel::GetInstructionSetName(instructionSet),
+			best, MaxDifference(filter.GetResult(), filterRef.GetResult()));
+	}
+
+	N_RETURN(filter.SetWeightTable(256), 1);
+	const auto best = Time(numIterations / 4, [&]() { filter.InvalidateSource(); filter.Process(Float2{ 0.0f, 0.0f }, 24.0f); });
+	printf("%-8s %8.3f ms  max diff %u\n", "Table", best, MaxDifference(filter.GetResult(), filterRef.GetResult()));
+
+	// Tiles on every hardware thread
+	auto threadPool = make_shared<ThreadPool>();
+	N_RETURN(threadPool->Create(), 1);
+	filter.SetThreadPool(threadPool);
+	const auto bestMT = Time(numIterations / 4, [&]() { filter.InvalidateSource(); filter.Process(Float2{ 0.0f, 0.0f }, 24.0f); });
+	printf("%-8s %8.3f ms  max diff %u (%u threads)\n", "Table", bestMT,
+		MaxDifference(filter.GetResult(), filterRef.GetResult()), threadPool->GetNumThreads());
+
+	// Down-sampled levels kept from the previous call, as while only the focus
+	// and sigma animate
+	{
+		const auto bestUpSample = Time(numIterations / 4, [&]() { filter.Process(Float2{ 0.0f, 0.0f }, 24.0f); });
+		vector<uint8_t> upSampled(size_t(width) * height * PixelSize), full(upSampled.size());
+		N_RETURN(filter.GetResult().Readback(upSampled.data()), 1);
+		filter.InvalidateSource();
+		filter.Process(Float2{ 0.0f, 0.0f }, 24.0f);
+		N_RETURN(filter.GetResult().Readback(full.data()), 1);
+		printf("%-8s %8.3f ms  %s (%u threads)\n", "Up only", bestUpSample,
+			Exactness(upSampled == full, numMismatches), threadPool->GetNumThreads());
+	}
+
+	// A rectangle of the source changed every call, as an overlay on a static
+	// image: only the tiles it reaches run again
+	{
+		const auto rectWidth = (min)(64u, width), rectHeight = (min)(64u, height);
+		const Rect rect = { (width - rectWidth) / 2, (height - rectHeight) / 2,
+			(width + rectWidth) / 2, (height + rectHeight) / 2 };
+		vector<uint8_t> overlay(size_t(rectWidth) * rectHeight * PixelSize);
+		auto frame = 0u;
+		const auto bestDirty = Time(numIterations / 4, [&]()
+		{
+			fill(overlay.begin(), overlay.end(), static_cast<uint8_t>(++frame));
+			filter.UpdateSource(rect, overlay.data());
+			filter.Process(Float2{ 0.0f, 0.0f }, 24.0f);
+		});
+
+		vector<uint8_t> updated(size_t(width) * height * PixelSize), full(updated.size());
+		N_RETURN(filter.GetResult().Readback(updated.data()), 1);
+		filter.InvalidateSource();
+		filter.Process(Float2{ 0.0f, 0.0f }, 24.0f);
+		N_RETURN(filter.GetResult().Readback(full.data()), 1);
+		printf("%-8s %8.3f ms  %s, %ux%u (%u threads)\n", "Dirty", bestDirty,
+			Exactness(updated == full, numMismatches), rectWidth, rectHeight, threadPool->GetNumThreads());
+
+		N_RETURN(filter.UpdateSource(source.data()), 1);
+		filter.Process(Float2{ 0.0f, 0.0f }, 24.0f);
+	}
+
+	// A crop of the result, of the levels kept from the previous call
+	{
+		const auto roiWidth = (min)(256u, width), roiHeight = (min)(256u, height);
+		const Rect roi = { (width - roiWidth) / 2, (height - roiHeight) / 2,
+			(width + roiWidth) / 2, (height + roiHeight) / 2 };
+		const auto bestRoi = Time(numIterations / 4, [&]() { filter.Process(Float2{ 0.0f, 0.0f }, 24.0f, roi); });
+
+		vector<uint8_t> cropped(size_t(width) * height * PixelSize), full(cropped.size());
+		N_RETURN(filter.GetResult().Readback(cropped.data()), 1);
+		filter.Process(Float2{ 0.0f, 0.0f }, 24.0f);
+		N_RETURN(filter.GetResult().Readback(full.data()), 1);
+		auto isEqual = true;
+		for (auto y = roi.Top; y < roi.Bottom; ++y)
+		{
+			const auto offset = (size_t(width) * y + roi.Left) * PixelSize;
+			isEqual = isEqual && memcmp(&cropped[offset], &full[offset], roiWidth * PixelSize) == 0;
+		}
+		printf("%-8s %8.3f ms  %s, %ux%u (%u threads)\n", "ROI", bestRoi,
+			Exactness(isEqual, numMismatches), roiWidth, roiHeight, threadPool->GetNumThreads());
+	}
+
+	// A mostly sharp frame, blurred within a quarter of it by the sigma map: the
+	// sharp tiles take the source as it is, and the coarser tiles that only they
+	// would blend are skipped
+	{
+		vector<float> sigmaScales(size_t(width) * height, 0.0f);
+		for (auto y = height / 4; y < height / 2; ++y)
+			fill_n(&sigmaScales[size_t(width) * y + width / 4], width / 4, 1.0f);
+		N_RETURN(filter.SetSigmaMap(width, height, sigmaScales.data()), 1);
+
+		filter.SetWeightTolerance(-1.0f);
+		const auto bestWhole = Time(numIterations / 4, [&]() { filter.Process(Float2{ 0.0f, 0.0f }, 24.0f); });
+		vector<uint8_t> whole(size_t(width) * height * PixelSize), adaptive(whole.size());
+		N_RETURN(filter.GetResult().Readback(whole.data()), 1);
+
+		filter.SetWeightTolerance(0.0f);
+		const auto bestAdaptive = Time(numIterations / 4, [&]() { filter.Process(Float2{ 0.0f, 0.0f }, 24.0f); });
+		N_RETURN(filter.GetResult().Readback(adaptive.data()), 1);
+		printf("%-8s %8.3f ms  %s, every tile %8.3f ms (%u threads)\n", "Sharp", bestAdaptive,
+			Exactness(adaptive == whole, numMismatches), bestWhole, threadPool->GetNumThreads());
+
+		N_RETURN(filter.SetSigmaMap(0, 0, nullptr), 1);
+		filter.Process(Float2{ 0.0f, 0.0f }, 24.0f);
+	}
+
+	// The fused traversal runs the same kernels, so it matches the tiled result exactly
+	Texture2D tiledResult;
+	vector<uint8_t> result(size_t(width) * height * PixelSize);
+	N_RETURN(filter.GetResult().Readback(result.data()), 1);
+	N_RETURN(tiledResult.Create(width, height), 1);
+	N_RETURN(tiledResult.Upload(result.data()), 1);
+
+	filter.SetExecutionMode(Filter::EXECUTION_FUSED);
+	const auto bestFused = Time(numIterations / 4, [&]() { filter.Process(Float2{ 0.0f, 0.0f }, 24.0f); });
+	printf("%-8s %8.3f ms  %s (%u threads)\n", "Fused", bestFused,
+		Exactness(MaxDifference(filter.GetResult(), tiledResult) == 0, numMismatches), threadPool->GetNumThreads());
+
+	// The coarse levels in one task run the same kernels as their tiles
+	filter.SetExecutionMode(Filter::EXECUTION_TILED);
+	filter.SetCoarseUpSampleSize(32);
+	const auto bestCoarse = Time(numIterations / 4, [&]() { filter.InvalidateSource(); filter.Process(Float2{ 0.0f, 0.0f }, 24.0f); });
+	printf("%-8s %8.3f ms  %s (%u threads)\n", "Coarse", bestCoarse,
+		Exactness(MaxDifference(filter.GetResult(), tiledResult) == 0, numMismatches), threadPool->GetNumThreads());
+	filter.SetCoarseUpSampleSize(0);
+
+	// The single pass reduces with the 2x2 box, so it matches the tiled mode of a
+	// filter without the 5-tap filter exactly
+	Filter boxFilter;
+	N_RETURN(boxFilter.SetWeightTable(256), 1);
+	N_RETURN(boxFilter.Init(width, height, source.data(), 0, false), 1);
+	boxFilter.SetThreadPool(threadPool);
+	const auto bestBox = Time(numIterations / 4, [&]() { boxFilter.InvalidateSource(); boxFilter.Process(Float2{ 0.0f, 0.0f }, 24.0f); });
+	Texture2D boxResult;
+	N_RETURN(boxFilter.GetResult().Readback(result.data()), 1);
+	N_RETURN(boxResult.Create(width, height), 1);
+	N_RETURN(boxResult.Upload(result.data()), 1);
+
+	boxFilter.SetExecutionMode(Filter::EXECUTION_SINGLE_PASS);
+	const auto bestSinglePass = Time(numIterations / 4, [&]() { boxFilter.InvalidateSource(); boxFilter.Process(Float2{ 0.0f, 0.0f }, 24.0f); });
+	printf("%-8s %8.3f ms  %s, 2x2 tiled %8.3f ms (%u threads)\n", "1-pass", bestSinglePass,
+		Exactness(MaxDifference(boxFilter.GetResult(), boxResult) == 0, numMismatches), bestBox,
+		threadPool->GetNumThreads());
+
+	// Wider intermediate levels against 8-bit quantization, measured from the
+	// result of 32-bit float levels, of an opaque copy of the source: its alpha
+	// survives every format exactly, so the differences are of the colors alone,
+	// rather than of the 2-bit alpha of R10G10B10A2
+	{
+		static const char *formatNames[] = { "B8G8R8A8", "R10G10B10A2", "R16G16B16A16F", "R32G32B32A32F" };
+
+		auto opaqueSource = source;
+		for (auto i = size_t(3); i < opaqueSource.size(); i += PixelSize) opaqueSource[i] = 0xff;
+
+		Filter formatFilters[NUM_FORMAT];
+		for (auto i = static_cast<uint32_t>(NUM_FORMAT); i-- > 0;)
+		{
+			auto &formatFilter = formatFilters[i];
+			N_RETURN(formatFilter.SetWeightTable(256), 1);
+			formatFilter.SetIntermediateFormat(static_cast<Format>(i));
+			N_RETURN(formatFilter.Init(width, height, opaqueSource.data()), 1);
+			formatFilter.SetThreadPool(threadPool);
+
+			const auto bestFormat = Time(numIterations / 4, [&]() { formatFilter.InvalidateSource(); formatFilter.Process(Float2{ 0.0f, 0.0f }, 24.0f); });
+			const auto &reference = formatFilters[FORMAT_R32G32B32A32_FLOAT].GetResult();
+			printf("%-14s %8.3f ms  %2u bytes/texel %7.2f MB  max diff %u, mean diff %.4f (%u threads)\n",
+				formatNames[i], bestFormat, GetTexelSize(static_cast<Format>(i)),
+				GetIntermediateSize(width, height, numMips, static_cast<Format>(i)) / (1024.0 * 1024.0),
+				MaxDifference(formatFilter.GetResult(), reference), MeanDifference(formatFilter.GetResult(), reference),
+				threadPool->GetNumThreads());
+		}
+
+		// F16C converts as the scalar path does
+		auto &halfFilter = formatFilters[FORMAT_R16G16B16A16_FLOAT];
+		N_RETURN(halfFilter.GetResult().Readback(result.data()), 1);
+		Texture2D halfResult;
+		N_RETURN(halfResult.Create(width, height), 1);
+		N_RETURN(halfResult.Upload(result.data()), 1);
+		Kernel::SetInstructionSet(Kernel::SCALAR);
+		halfFilter.InvalidateSource();
+		halfFilter.Process(Float2{ 0.0f, 0.0f }, 24.0f);
+		Kernel::SetInstructionSet(Kernel::GetSupportedInstructionSet());
+		const auto instructionSet = Kernel::GetSupportedInstructionSet();
+		printf("%-14s %s vs %s: %s\n", formatNames[FORMAT_R16G16B16A16_FLOAT],
+			instructionSet >= Kernel::AVX2 ? "F16C" : Kernel::GetInstructionSetName(instructionSet),
+			Kernel::GetInstructionSetName(Kernel::SCALAR),
+			Exactness(MaxDifference(halfFilter.GetResult(), halfResult) == 0, numMismatches));
+	}
+
+	// Streaming reads the source rows twice and never holds the full image
+	Filter streamFilter;
+	N_RETURN(streamFilter.SetWeightTable(256), 1);
+	N_RETURN(streamFilter.InitStream(width, height), 1);
+	streamFilter.SetThreadPool(threadPool);
+	const auto rowSize = width * PixelSize;
+	const auto bestStream = Time(numIterations / 4, [&]()
+	{
+		streamFilter.ProcessStream([&](uint32_t y, uint8_t *pRow)
+		{
+			memcpy(pRow, &source[size_t(rowSize) * y], rowSize);
+			return true;
+		}, [&](uint32_t y, const uint8_t *pRow)
+		{
+			memcpy(&result[size_t(rowSize) * y], pRow, rowSize);
+			return true;
+		}, Float2{ 0.0f, 0.0f }, 24.0f);
+	});
+	Texture2D streamResult;
+	N_RETURN(streamResult.Create(width, height), 1);
+	N_RETURN(streamResult.Upload(result.data()), 1);
+	printf("%-8s %8.3f ms  %s (%u threads)\n", "Stream", bestStream,
+		Exactness(MaxDifference(streamResult, tiledResult) == 0, numMismatches), threadPool->GetNumThreads());
+
+	// Thumbnails of mixed sizes, one Filter each or all in a batch
+	const auto numThumbnails = 256u;
+	vector<FilterBatch::Image> thumbnails(numThumbnails);
+	vector<unique_ptr<Filter>> thumbnailFilters(numThumbnails);
+	for (auto i = 0u; i < numThumbnails; ++i)
+	{
+		auto &thumbnail = thumbnails[i];
+		thumbnail.Width = 64u << (i % 3);
+		thumbnail.Height = 48u + 16u * (i % 5);
+		thumbnail.pSource = source.data();
+		thumbnail.RowPitch = width * PixelSize;
+
+		thumbnailFilters[i] = make_unique<Filter>();
+		thumbnailFilters[i]->SetThreadPool(threadPool);
+		N_RETURN(thumbnailFilters[i]->Init(thumbnail.Width, thumbnail.Height, source.data(), thumbnail.RowPitch), 1);
+	}
+
+	FilterBatch batch;
+	batch.SetThreadPool(threadPool);
+	N_RETURN(batch.Init(thumbnails.data(), numThumbnails), 1);
+
+	const auto bestSingle = Time(numIterations, [&]()
+	{
+		for (auto &thumbnailFilter : thumbnailFilters)
+		{
+			thumbnailFilter->InvalidateSource();
+			thumbnailFilter->Process(Float2{ 0.0f, 0.0f }, 24.0f);
+		}
+	});
+	const auto bestBatch = Time(numIterations, [&]() { batch.Process(Float2{ 0.0f, 0.0f }, 24.0f); });
+
+	auto maxDiff = 0u;
+	for (auto i = 0u; i < numThumbnails; ++i)
+		maxDiff = (max)(maxDiff, MaxDifference(batch.GetResult(i), thumbnailFilters[i]->GetResult()));
+
+	printf("%u thumbnails: %8.3f ms single, %8.3f ms batch  max diff %u\n",
+		numThumbnails, bestSingle, bestBatch, maxDiff);
+
+	return numMismatches > 0 ? 1 : 0;
+}
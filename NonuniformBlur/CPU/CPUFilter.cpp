@@ -0,0 +1,1300 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include <cassert>
+#include "CPUFilter.h"
+#include "CPUKernel.h"
+
+using namespace std;
+using namespace CPU;
+
+Filter::Filter() :
+	m_threadPool(nullptr),
+	m_pReader(nullptr),
+	m_pWriter(nullptr),
+	m_upSampleDesc(),
+	m_sigmaG(24.0f),
+	m_weightTolerance(0.0f),
+	m_weightTableResolution(256),
+	m_weightTableMaxSigma(64.0f),
+	m_coarseUpSampleSize(0),
+	m_width(0),
+	m_height(0),
+	m_numMips(11),
+	m_levelBase(0),
+	m_residentLevel(0),
+	m_highQuality(true),
+	m_hasSigmaMap(false),
+	m_isStreaming(false),
+	m_isStreamOk(true),
+	m_executionMode(EXECUTION_TILED),
+	m_pyramid(PYRAMID_INVALID),
+	m_isSourceChanged(false),
+	m_isUpSampleCurrent(false),
+	m_isUpSampleStale(true),
+	m_isUpSampleAdaptive(false),
+	m_format(FORMAT_B8G8R8A8_UNORM)
+{
+}
+
+Filter::~Filter()
+{
+}
+
+bool Filter::Init(uint32_t width, uint32_t height, const void *pSource,
+	uint32_t rowPitch, bool highQuality)
+{
+	M_RETURN(!pSource, cerr, "The source image is NULL.", false);
+	M_RETURN(width == 0 || height == 0, cerr, "Invalid image dimensions.", false);
+
+	// Create resources
+	const auto viewportSize = static_cast<float>((max)(width, height));
+	m_numMips = static_cast<uint8_t>(log2f(viewportSize) + 1.0f);
+	m_width = width;
+	m_height = height;
+	m_levelBase = 0;
+	m_isStreaming = false;
+	m_highQuality = highQuality;
+	N_RETURN(createResources(), false);
+
+	// Copy source
+	return m_filtered[TABLE_DOWN_SAMPLE].Upload(pSource, rowPitch);
+}
+
+bool Filter::UpdateSource(const void *pSource, uint32_t rowPitch)
+{
+	M_RETURN(!pSource, cerr, "The source image is NULL.", false);
+	M_RETURN(m_isStreaming, cerr, "The filter is initialized for streaming.", false);
+
+	InvalidateSource();
+
+	return m_filtered[TABLE_DOWN_SAMPLE].Upload(pSource, rowPitch);
+}
+
+bool Filter::UpdateSource(const Rect &rect, const void *pSource, uint32_t rowPitch)
+{
+	M_RETURN(!pSource, cerr, "The source image is NULL.", false);
+	M_RETURN(m_isStreaming, cerr, "The filter is initialized for streaming.", false);
+	M_RETURN(rect.Right > m_width || rect.Bottom > m_height, cerr, "The rectangle exceeds the source.", false);
+	C_RETURN(rect.Left >= rect.Right || rect.Top >= rect.Bottom, true);
+
+	N_RETURN(m_filtered[TABLE_DOWN_SAMPLE].Upload(rect, pSource, rowPitch), false);
+	setChanged(TABLE_DOWN_SAMPLE, 0, rect, true);
+	m_isSourceChanged = true;
+
+	return true;
+}
+
+void Filter::InvalidateSource()
+{
+	m_pyramid = PYRAMID_INVALID;
+}
+
+bool Filter::InitStream(uint32_t width, uint32_t height, bool highQuality)
+{
+	M_RETURN(width == 0 || height == 0, cerr, "Invalid image dimensions.", false);
+
+	const auto viewportSize = static_cast<float>((max)(width, height));
+	m_numMips = static_cast<uint8_t>(log2f(viewportSize) + 1.0f);
+	m_width = width;
+	m_height = height;
+	m_isStreaming = true;
+	m_highQuality = highQuality;
+
+	// Only the levels from the resident one up are stored; images with too few
+	// levels to stream are processed whole
+	m_levelBase = m_numMips > 2 ? selectResidentLevel() : 0;
+
+	return createResources();
+}
+
+bool Filter::createResources()
+{
+	// The source and the result stay B8G8R8A8
+	const auto baseFormat = m_levelBase > 0 ? m_format : FORMAT_B8G8R8A8_UNORM;
+	for (auto &image : m_filtered)
+		N_RETURN(image.Create(getWidth(m_levelBase), getHeight(m_levelBase),
+			m_numMips - m_levelBase, baseFormat, m_format), false);
+
+	// The task graphs refer to the levels, so they are built again on first use
+	for (auto &graph : m_graphs) graph.Clear();
+	m_fusedSlabs.clear();
+	m_pyramid = PYRAMID_INVALID;
+	m_isUpSampleCurrent = false;
+	m_isUpSampleAdaptive = false;
+
+	// No tile has changed yet
+	m_isSourceChanged = false;
+	for (auto &changedTiles : m_changedTiles)
+	{
+		changedTiles.resize(m_levelBase > 0 ? 0 : m_numMips);
+		for (auto i = 0u; i < changedTiles.size(); ++i)
+			changedTiles[i].assign(static_cast<size_t>((getWidth(i) + TileSize - 1) / TileSize) *
+				((getHeight(i) + TileSize - 1) / TileSize), 0);
+	}
+
+	// Tiles of the up-sampled levels, all but the coarsest one
+	m_upSampleTiles.resize(m_levelBase > 0 || m_numMips <= 1 ? 0 : m_numMips - 1);
+	for (auto i = 0u; i < m_upSampleTiles.size(); ++i)
+		m_upSampleTiles[i].assign(static_cast<size_t>((getWidth(i) + TileSize - 1) / TileSize) *
+			((getHeight(i) + TileSize - 1) / TileSize), TILE_UP_SAMPLED);
+
+	if (m_weightTableResolution > 0)
+		N_RETURN(m_weightTable.Create(m_numMips, m_weightTableMaxSigma, m_weightTableResolution), false);
+
+	if (m_hasSigmaMap) N_RETURN(reduceSigmaMap(), false);
+
+	return true;
+}
+
+bool Filter::SetWeightTable(uint32_t resolution, float maxSigma)
+{
+	m_weightTableResolution = resolution;
+	m_weightTableMaxSigma = maxSigma;
+	m_isUpSampleCurrent = false;
+
+	const auto isInitialized = m_filtered[TABLE_DOWN_SAMPLE].GetNumMips() > 0;
+	C_RETURN(!isInitialized || resolution == 0, true);
+
+	return m_weightTable.Create(m_numMips, maxSigma, resolution);
+}
+
+bool Filter::SetSigmaMap(uint32_t width, uint32_t height, const float *pSigmas, uint32_t rowPitch)
+{
+	m_hasSigmaMap = pSigmas != nullptr;
+	m_isUpSampleCurrent = false;
+	C_RETURN(!m_hasSigmaMap, true);
+
+	// A float is as large as a texel, so the map reuses the texture layout
+	N_RETURN(m_sigmaMapSource.Create(width, height), false);
+	N_RETURN(m_sigmaMapSource.Upload(pSigmas, rowPitch), false);
+
+	const auto isInitialized = m_filtered[TABLE_DOWN_SAMPLE].GetNumMips() > 0;
+	C_RETURN(!isInitialized, true);
+
+	return reduceSigmaMap();
+}
+
+void Filter::SetThreadPool(const shared_ptr<ThreadPool> &threadPool)
+{
+	m_threadPool = threadPool;
+}
+
+void Filter::SetCoarseUpSampleSize(uint32_t size)
+{
+	// The graphs are built again on first use
+	if (size != m_coarseUpSampleSize) for (auto &graph : m_graphs) graph.Clear();
+	m_coarseUpSampleSize = size;
+}
+
+void Filter::SetWeightTolerance(float tolerance)
+{
+	m_weightTolerance = tolerance;
+	m_isUpSampleCurrent = false;
+}
+
+void Filter::SetIntermediateFormat(Format format)
+{
+	m_format = format < NUM_FORMAT ? format : FORMAT_B8G8R8A8_UNORM;
+}
+
+Format Filter::GetIntermediateFormat() const
+{
+	return m_format;
+}
+
+void Filter::SetExecutionMode(ExecutionMode mode)
+{
+	m_executionMode = mode;
+}
+
+void Filter::Process(Float2 focus, float sigma)
+{
+	M_RETURN(m_levelBase > 0, cerr, "The filter is initialized for streaming.", );
+
+	// A single texel is its own result
+	if (m_numMips <= 1)
+	{
+		copyTexel();
+		return;
+	}
+
+	const auto isUpSampled = isUpSampleCurrent(focus, sigma);
+	setUpSampleDesc(focus, sigma);
+
+	const auto isSinglePass = m_executionMode == EXECUTION_SINGLE_PASS && getNumTileLevels() > 0;
+	const auto pyramid = getPyramidState();
+	const auto isFused = m_executionMode == EXECUTION_FUSED && m_numMips > 2;
+	const auto isUpdate = !isFused && m_pyramid == pyramid && m_isSourceChanged;
+
+	// The streamed levels of the fused mode and the tiles of the update graph
+	// are all up sampled
+	const auto isUpSampleWhole = setUpSampleTiles(!isFused && !isUpdate);
+
+	// Fusing needs a streamed level below the resident ones. It reduces the
+	// source again, as it keeps no finer levels, and leaves the others as they were.
+	if (isFused)
+	{
+		if (m_isSourceChanged) InvalidateSource();
+		if (m_graphs[GRAPH_PROCESS_FUSED].GetNumTasks() == 0) createFusedGraph(GRAPH_PROCESS_FUSED, FusedSlabHeight);
+		m_graphs[GRAPH_PROCESS_FUSED].Execute(m_threadPool.get());
+	}
+	else if (isUpdate)
+	{
+		// Only the tiles that the changed ones of the source reach, unless the
+		// focus or sigma has changed too
+		m_isUpSampleStale = !isUpSampled;
+		if (m_graphs[GRAPH_PROCESS_UPDATE].GetNumTasks() == 0) createProcessGraph(GRAPH_PROCESS_UPDATE, TILES_CHANGED);
+		m_graphs[GRAPH_PROCESS_UPDATE].Execute(m_threadPool.get());
+	}
+	else if (m_pyramid == pyramid)
+	{
+		if (m_graphs[GRAPH_PROCESS_UP_SAMPLE].GetNumTasks() == 0) createUpSampleGraph(GRAPH_PROCESS_UP_SAMPLE, TILES_ALL);
+		m_graphs[GRAPH_PROCESS_UP_SAMPLE].Execute(m_threadPool.get());
+	}
+	else if (isSinglePass)
+	{
+		if (m_graphs[GRAPH_PROCESS_SINGLE_PASS].GetNumTasks() == 0) createSinglePassGraph();
+		m_graphs[GRAPH_PROCESS_SINGLE_PASS].Execute(m_threadPool.get());
+		m_pyramid = pyramid;
+	}
+	else
+	{
+		if (m_graphs[GRAPH_PROCESS].GetNumTasks() == 0) createProcessGraph();
+		m_graphs[GRAPH_PROCESS].Execute(m_threadPool.get());
+		m_pyramid = pyramid;
+	}
+
+	// The fused mode keeps only the result of the up sampling, and the skipped
+	// tiles are left as they were
+	m_isUpSampleCurrent = !isFused && isUpSampleWhole;
+
+	// The levels hold the changes of the source now
+	if (m_isSourceChanged)
+	{
+		auto &changedTiles = m_changedTiles[TABLE_DOWN_SAMPLE][0];
+		fill(changedTiles.begin(), changedTiles.end(), 0);
+		m_isSourceChanged = false;
+	}
+}
+
+void Filter::Process(Float2 focus, float sigma, const Rect &roi)
+{
+	M_RETURN(m_levelBase > 0, cerr, "The filter is initialized for streaming.", );
+	M_RETURN(roi.Right > m_width || roi.Bottom > m_height, cerr, "The region of interest exceeds the image.", );
+	C_RETURN(roi.Left >= roi.Right || roi.Top >= roi.Bottom, );
+
+	// The whole image, or a single texel
+	if (m_numMips <= 1 || (roi.Left == 0 && roi.Top == 0 && roi.Right == m_width && roi.Bottom == m_height))
+	{
+		Process(focus, sigma);
+		return;
+	}
+
+	setUpSampleDesc(focus, sigma);
+	setRegionOfInterest(roi);
+
+	if (m_pyramid == getPyramidState() && !m_isSourceChanged)
+	{
+		if (m_graphs[GRAPH_PROCESS_UP_SAMPLE_ROI].GetNumTasks() == 0)
+			createUpSampleGraph(GRAPH_PROCESS_UP_SAMPLE_ROI, TILES_ROI);
+		m_graphs[GRAPH_PROCESS_UP_SAMPLE_ROI].Execute(m_threadPool.get());
+	}
+	else
+	{
+		// The levels are reduced with the filter of the execution mode, but only
+		// partly, as are the changes of the source
+		if (m_graphs[GRAPH_PROCESS_ROI].GetNumTasks() == 0) createProcessGraph(GRAPH_PROCESS_ROI, TILES_ROI);
+		m_graphs[GRAPH_PROCESS_ROI].Execute(m_threadPool.get());
+		InvalidateSource();
+
+		auto &changedTiles = m_changedTiles[TABLE_DOWN_SAMPLE][0];
+		fill(changedTiles.begin(), changedTiles.end(), 0);
+		m_isSourceChanged = false;
+	}
+
+	m_isUpSampleCurrent = false;
+}
+
+bool Filter::ProcessStream(const RowReader &reader, const RowWriter &writer, Float2 focus, float sigma)
+{
+	M_RETURN(!m_isStreaming, cerr, "The filter is not initialized for streaming.", false);
+
+	// Too small to stream
+	if (m_levelBase == 0)
+	{
+		const auto &src = m_filtered[TABLE_DOWN_SAMPLE].GetSurface();
+		const auto &dst = m_filtered[TABLE_UP_SAMPLE].GetSurface();
+		InvalidateSource();
+		for (auto y = 0u; y < m_height; ++y) N_RETURN(reader(y, src.GetRow(y)), false);
+		Process(focus, sigma);
+		for (auto y = 0u; y < m_height; ++y) N_RETURN(writer(y, dst.GetRow(y)), false);
+
+		return true;
+	}
+
+	setUpSampleDesc(focus, sigma);
+	m_pReader = &reader;
+	m_pWriter = &writer;
+	m_isStreamOk = true;
+
+	// Rows are read and written in order, so each sweep is a single slab
+	if (m_graphs[GRAPH_PROCESS_STREAM].GetNumTasks() == 0) createFusedGraph(GRAPH_PROCESS_STREAM, m_height);
+	m_graphs[GRAPH_PROCESS_STREAM].Execute(m_threadPool.get());
+
+	m_pReader = nullptr;
+	m_pWriter = nullptr;
+
+	return m_isStreamOk;
+}
+
+void Filter::ProcessG(float sigma)
+{
+	M_RETURN(m_levelBase > 0, cerr, "The filter is initialized for streaming.", );
+
+	m_sigmaG = sigma;
+
+	// The down-sampled levels are rewritten with the filter of the tiled mode,
+	// and the coarsest one goes to the down chain, leaving that of Process(),
+	// so a changed source leaves it stale; the result is no up sampling.
+	if (m_isSourceChanged || m_pyramid != (m_highQuality ? PYRAMID_HIGH_QUALITY : PYRAMID_BOX))
+		InvalidateSource();
+	m_isUpSampleCurrent = false;
+
+	if (m_graphs[GRAPH_PROCESS_G].GetNumTasks() == 0) createProcessGGraph();
+	m_graphs[GRAPH_PROCESS_G].Execute(m_threadPool.get());
+}
+
+bool Filter::isUpSampleCurrent(Float2 focus, float sigma) const
+{
+	return m_isUpSampleCurrent && m_upSampleDesc.Focus.x == focus.x &&
+		m_upSampleDesc.Focus.y == focus.y && m_upSampleDesc.Sigma == sigma;
+}
+
+void Filter::setUpSampleDesc(Float2 focus, float sigma)
+{
+	m_upSampleDesc.Focus = focus;
+	m_upSampleDesc.Sigma = sigma;
+	m_upSampleDesc.NumLevels = m_numMips;
+	m_upSampleDesc.pWeightTable = m_weightTableResolution > 0 ? &m_weightTable : nullptr;
+}
+
+void Filter::copyTexel()
+{
+	const auto &src = m_filtered[TABLE_DOWN_SAMPLE].GetSurface();
+	const auto &dst = m_filtered[TABLE_UP_SAMPLE].GetSurface();
+	memcpy(dst.GetRow(0), src.GetRow(0), dst.Width * PixelSize);
+}
+
+bool Filter::reduceSigmaMap()
+{
+	if (m_sigmaMaps.GetNumMips() != m_numMips || m_sigmaMaps.GetWidth() != m_width ||
+		m_sigmaMaps.GetHeight() != m_height)
+		N_RETURN(m_sigmaMaps.Create(m_width, m_height, m_numMips), false);
+
+	// Each level is sampled from the next finer one, as the image pyramid
+	for (auto i = 0u; i < m_numMips; ++i)
+	{
+		const auto &dst = m_sigmaMaps.GetSurface(i);
+		const auto &src = i > 0 ? m_sigmaMaps.GetSurface(i - 1) : m_sigmaMapSource.GetSurface();
+		for (auto y = 0u; y < dst.Height; ++y) Kernel::ResampleSigma(dst, src, y, 0, dst.Width);
+	}
+
+	// Largest scale of each tile, bounding the sigmas of the up-sampled tiles
+	m_maxSigmaScales.resize(m_numMips);
+	for (auto i = 0u; i < m_numMips; ++i)
+	{
+		const auto &map = m_sigmaMaps.GetSurface(i);
+		const auto cols = (map.Width + TileSize - 1) / TileSize;
+		auto &maxScales = m_maxSigmaScales[i];
+		maxScales.assign(static_cast<size_t>(cols) * ((map.Height + TileSize - 1) / TileSize), 0.0f);
+		for (auto y = 0u; y < map.Height; ++y)
+		{
+			const auto pScales = reinterpret_cast<const float*>(map.GetRow(y));
+			const auto pMaxScales = &maxScales[static_cast<size_t>(cols) * (y / TileSize)];
+			for (auto x = 0u; x < map.Width; ++x)
+				pMaxScales[x / TileSize] = (max)(pMaxScales[x / TileSize], pScales[x]);
+		}
+	}
+
+	return true;
+}
+
+const Surface *Filter::getSigmaMap(uint8_t level) const
+{
+	return m_hasSigmaMap ? &m_sigmaMaps.GetSurface(level) : nullptr;
+}
+
+const Texture2D &Filter::GetResult() const
+{
+	return m_filtered[TABLE_UP_SAMPLE];
+}
+
+void Filter::createProcessGraph(GraphIndex graphIndex, TileFilter tileFilter)
+{
+	addProcessTasks(m_graphs[graphIndex], tileFilter);
+}
+
+void Filter::createUpSampleGraph(GraphIndex graphIndex, TileFilter tileFilter)
+{
+	// The levels without tasks are all current
+	vector<TileGrid> downTiles(m_numMips), upTiles(m_numMips);
+	addUpSampleTiles(m_graphs[graphIndex], downTiles, upTiles, 0, tileFilter);
+}
+
+void Filter::addProcessTasks(TaskGraph &graph, TileFilter tileFilter)
+{
+	if (m_numMips <= 1)
+	{
+		graph.AddTask([this]() { copyTexel(); });
+		return;
+	}
+
+	const auto &down = m_filtered[TABLE_DOWN_SAMPLE];
+
+	// Level 0 of the down-sampling chain is the source, which has no tasks
+	vector<TileGrid> downTiles(m_numMips), upTiles(m_numMips);
+	downTiles[0] = { 0, 0, 0, down.GetWidth(), down.GetHeight(), TileSize, TileSize };
+
+	addProcessTiles(graph, downTiles, upTiles, 0, tileFilter);
+}
+
+void Filter::createFusedGraph(GraphIndex graphIndex, uint32_t slabHeight)
+{
+	auto &graph = m_graphs[graphIndex];
+	m_residentLevel = m_levelBase > 0 ? m_levelBase : selectResidentLevel();
+	const auto k = m_residentLevel;
+
+	// Slabs are sized by dry runs before any task refers to them
+	const auto downSlabHeight = (max)(slabHeight >> k, 1u);
+	const auto numDownSlabs = (getHeight(k) + downSlabHeight - 1) / downSlabHeight;
+	const auto numUpSlabs = (m_height + slabHeight - 1) / slabHeight;
+	m_fusedSlabs.resize(numDownSlabs + numUpSlabs);
+	for (auto i = 0u; i < numDownSlabs; ++i)
+		initSlab(m_fusedSlabs[i], i * downSlabHeight,
+			(min)((i + 1) * downSlabHeight, getHeight(k)), false);
+	for (auto i = 0u; i < numUpSlabs; ++i)
+		initSlab(m_fusedSlabs[numDownSlabs + i], i * slabHeight,
+			(min)((i + 1) * slabHeight, m_height), true);
+
+	// Down sweep into the resident level
+	vector<TileGrid> downTiles(m_numMips), upTiles(m_numMips);
+	downTiles[k] = { graph.GetNumTasks(), 1, numDownSlabs, getWidth(k), getHeight(k),
+		getWidth(k), downSlabHeight };
+	for (auto i = 0u; i < numDownSlabs; ++i)
+	{
+		const auto pSlab = &m_fusedSlabs[i];
+		graph.AddTask([this, pSlab]() { runSlab(*pSlab, false); });
+	}
+
+	// Resident levels
+	addProcessTiles(graph, downTiles, upTiles, k);
+
+	// Up sweep, each slab waiting for the resident rows its dry run read
+	const auto &residentTiles = upTiles[k];
+	for (auto i = 0u; i < numUpSlabs; ++i)
+	{
+		auto &slab = m_fusedSlabs[numDownSlabs + i];
+		const auto pSlab = &slab;
+		const auto task = graph.AddTask([this, pSlab]() { runSlab(*pSlab, false); });
+
+		for (auto r = slab.ResidentRow0 / TileSize; r <= slab.ResidentRow1 / TileSize; ++r)
+			for (auto c = 0u; c < residentTiles.Cols; ++c)
+				graph.AddDependency(task, residentTiles.FirstTask + residentTiles.Cols * r + c);
+	}
+}
+
+uint8_t Filter::selectResidentLevel() const
+{
+	// The first level that fits the budget is resident, leaving the coarsest pass
+	// (which reads the level before it) to the tiles
+	const uint8_t numPasses = m_numMips - 1;
+	uint8_t level = 1;
+	while (level + 1 < numPasses && static_cast<size_t>(getWidth(level)) *
+		getHeight(level) * GetTexelSize(m_format) > FusedResidentSize) ++level;
+
+	return level;
+}
+
+uint8_t Filter::getNumTileLevels() const
+{
+	// Levels are reduced within the tiles while they halve exactly, as then no
+	// texel of a tile samples outside it
+	const uint8_t numPasses = m_numMips - 1;
+	const auto maxTileLevels = (min)(static_cast<uint8_t>(MaxTileLevels), numPasses);
+	uint8_t numTileLevels = 0;
+	while (numTileLevels < maxTileLevels && getWidth(numTileLevels) % 2 == 0 &&
+		getHeight(numTileLevels) % 2 == 0) ++numTileLevels;
+
+	return numTileLevels;
+}
+
+Filter::PyramidState Filter::getPyramidState() const
+{
+	// The single pass reduces with the 2x2 box, as does the tiled mode without
+	// the 5-tap filter
+	const auto isSinglePass = m_executionMode == EXECUTION_SINGLE_PASS && getNumTileLevels() > 0;
+
+	return isSinglePass || !m_highQuality ? PYRAMID_BOX : PYRAMID_HIGH_QUALITY;
+}
+
+uint8_t Filter::getCoarseLevel() const
+{
+	// The finest level of which the dimensions fit the size
+	auto level = static_cast<uint8_t>(m_numMips - 1);
+	while (level > 0 && getWidth(level - 1) <= m_coarseUpSampleSize &&
+		getHeight(level - 1) <= m_coarseUpSampleSize) --level;
+
+	return level;
+}
+
+uint32_t Filter::getWidth(uint8_t level) const
+{
+	return (max)(m_width >> level, 1u);
+}
+
+uint32_t Filter::getHeight(uint8_t level) const
+{
+	return (max)(m_height >> level, 1u);
+}
+
+const Surface &Filter::getLevel(MipChainIndex chain, uint8_t level) const
+{
+	return m_filtered[chain].GetSurface(level - m_levelBase);
+}
+
+const Surface &Filter::getDownLevel(uint8_t level) const
+{
+	// The coarsest level is written to the up-sampling chain directly
+	return getLevel(level + 1 < m_numMips ? TABLE_DOWN_SAMPLE : TABLE_UP_SAMPLE, level);
+}
+
+void Filter::addProcessTiles(TaskGraph &graph, vector<TileGrid> &downTiles,
+	vector<TileGrid> &upTiles, uint8_t firstLevel, TileFilter tileFilter)
+{
+	const uint8_t numPasses = m_numMips - 1;
+
+	// Partial reductions keep the filter of the levels of the execution mode
+	const auto isPartial = tileFilter != TILES_ALL;
+	const auto resample = [this, isPartial](const Surface &dst, const Surface &src) -> RowFunc
+	{
+		return [this, isPartial, &dst, &src](uint32_t y, uint32_t x0, uint32_t x1)
+		{
+			Kernel::Resample(dst, src, y, x0, x1, isPartial ? getPyramidState() == PYRAMID_HIGH_QUALITY : m_highQuality);
+		};
+	};
+
+	// Generate Mips
+	for (auto i = firstLevel + 1u; i < numPasses; ++i)
+	{
+		const auto &dst = getLevel(TABLE_DOWN_SAMPLE, i);
+		const auto &src = getLevel(TABLE_DOWN_SAMPLE, i - 1);
+		downTiles[i] = addLevelTiles(graph, TABLE_DOWN_SAMPLE, i, tileFilter,
+			{ { TABLE_DOWN_SAMPLE, static_cast<uint8_t>(i - 1), 2 } }, resample(dst, src));
+		addDependencies(graph, downTiles[i], downTiles[i - 1], 2);
+	}
+
+	// The coarsest level is written to the up-sampling chain directly
+	{
+		const auto &dst = getLevel(TABLE_UP_SAMPLE, numPasses);
+		const auto &src = getLevel(TABLE_DOWN_SAMPLE, numPasses - 1);
+		upTiles[numPasses] = addLevelTiles(graph, TABLE_UP_SAMPLE, numPasses, tileFilter,
+			{ { TABLE_DOWN_SAMPLE, static_cast<uint8_t>(numPasses - 1), 2 } }, resample(dst, src));
+		addDependencies(graph, upTiles[numPasses], downTiles[numPasses - 1], 2);
+	}
+
+	addUpSampleTiles(graph, downTiles, upTiles, firstLevel, tileFilter);
+}
+
+void Filter::addUpSampleTiles(TaskGraph &graph, const vector<TileGrid> &downTiles,
+	vector<TileGrid> &upTiles, uint8_t firstLevel, TileFilter tileFilter)
+{
+	const uint8_t numPasses = m_numMips - 1;
+
+	// The coarse levels in one task, each otherwise a single tile; the first
+	// level keeps its tiles, as the up sweep of the fused mode waits on them
+	auto c = numPasses;
+	const auto coarseLevel = (max)(getCoarseLevel(), static_cast<uint8_t>(firstLevel + 1));
+	if (coarseLevel + 1 < numPasses)
+	{
+		const auto task = graph.AddTask([this, coarseLevel, tileFilter]() { upSampleCoarse(coarseLevel, tileFilter); });
+		for (auto j = coarseLevel; j < numPasses; ++j)
+		{
+			upTiles[j] = { task, 1, 1, getWidth(j), getHeight(j), getWidth(j), getHeight(j) };
+			addDependencies(graph, upTiles[j], downTiles[j], 0);
+		}
+		addDependencies(graph, upTiles[numPasses - 1], upTiles[numPasses], 2);
+		c = coarseLevel;
+	}
+
+	// Up sampling
+	for (; c > firstLevel; --c)
+	{
+		const auto j = c - 1;
+		const auto &dst = getLevel(TABLE_UP_SAMPLE, j);
+		const auto &src = getLevel(TABLE_DOWN_SAMPLE, j);
+		const auto &coarser = getLevel(TABLE_UP_SAMPLE, c);
+		const RowFunc upSample = [this, j, &dst, &src, &coarser](uint32_t y, uint32_t x0, uint32_t x1)
+		{
+			auto desc = m_upSampleDesc;
+			desc.Level = j;
+			desc.pSigmaMap = getSigmaMap(j);
+			Kernel::UpSample(dst, src, coarser, desc, y, x0, x1);
+		};
+		upTiles[j] = addLevelTiles(graph, TABLE_UP_SAMPLE, j, tileFilter,
+			{ { TABLE_DOWN_SAMPLE, static_cast<uint8_t>(j), 0 }, { TABLE_UP_SAMPLE, c, 2 } }, upSample);
+		addDependencies(graph, upTiles[j], downTiles[j], 0);
+		addDependencies(graph, upTiles[j], upTiles[c], 2);
+	}
+}
+
+void Filter::upSampleCoarse(uint8_t coarseLevel, TileFilter tileFilter)
+{
+	// Every level is a few texels, so the whole loop stays in cache, and runs
+	// unless no finer tile reads the first one
+	const uint8_t numPasses = m_numMips - 1;
+	if (m_isUpSampleAdaptive && tileFilter == TILES_ALL)
+	{
+		const auto &tiles = m_upSampleTiles[coarseLevel];
+		C_RETURN(all_of(tiles.cbegin(), tiles.cend(), [](uint8_t tile) { return tile == TILE_SKIPPED; }), );
+	}
+	for (auto c = numPasses; c > coarseLevel; --c)
+	{
+		const uint8_t j = c - 1;
+		const auto &dst = getLevel(TABLE_UP_SAMPLE, j);
+		const auto &src = getLevel(TABLE_DOWN_SAMPLE, j);
+		const auto &coarser = getLevel(TABLE_UP_SAMPLE, c);
+
+		auto desc = m_upSampleDesc;
+		desc.Level = j;
+		desc.pSigmaMap = getSigmaMap(j);
+		const auto upSample = [&](uint32_t y, uint32_t x0, uint32_t x1)
+		{
+			Kernel::UpSample(dst, src, coarser, desc, y, x0, x1);
+		};
+
+		// The levels of a region of interest run whole, as they are a few texels
+		if (tileFilter == TILES_CHANGED)
+		{
+			// Each level updates as a single tile
+			const Rect rect = { 0, 0, dst.Width, dst.Height };
+			const auto isDirty = m_isUpSampleStale ||
+				isChanged({ TABLE_DOWN_SAMPLE, j, 0 }, rect, dst.Width, dst.Height) ||
+				isChanged({ TABLE_UP_SAMPLE, c, 2 }, rect, dst.Width, dst.Height);
+			setChanged(TABLE_UP_SAMPLE, j, rect, isDirty &&
+				updateRows(dst, upSample, rect.Left, rect.Right, rect.Top, rect.Bottom));
+		}
+		else for (auto y = 0u; y < dst.Height; ++y) upSample(y, 0, dst.Width);
+	}
+}
+
+void Filter::createSinglePassGraph()
+{
+	auto &graph = m_graphs[GRAPH_PROCESS_SINGLE_PASS];
+	const uint8_t numPasses = m_numMips - 1;
+	const auto numTileLevels = getNumTileLevels();
+
+	// A task per tile of the source, as the groups of the single dispatch
+	const auto cols = (m_width + TileSize - 1) / TileSize;
+	const auto rows = (m_height + TileSize - 1) / TileSize;
+	const auto firstTask = graph.GetNumTasks();
+	for (auto i = 0u; i < rows; ++i)
+		for (auto j = 0u; j < cols; ++j)
+			graph.AddTask([this, i, j, numTileLevels]() { reduceTile(j, i, numTileLevels); });
+
+	// The tiles of the levels reduced together are the same tasks
+	vector<TileGrid> downTiles(m_numMips), upTiles(m_numMips);
+	for (auto i = 1u; i <= numTileLevels; ++i)
+		(i < numPasses ? downTiles[i] : upTiles[i]) = { firstTask, cols, rows,
+			getWidth(i), getHeight(i), TileSize >> i, TileSize >> i };
+
+	// The tail is released by whichever tile finishes last, as the last group
+	// of the dispatch takes the tail over in the shader
+	if (numTileLevels < numPasses)
+	{
+		const auto tail = graph.AddTask([this, numTileLevels]() { reduceTail(numTileLevels); });
+		for (auto i = 0u; i < rows * cols; ++i) graph.AddDependency(tail, firstTask + i);
+		for (auto i = numTileLevels + 1u; i <= numPasses; ++i)
+			(i < numPasses ? downTiles[i] : upTiles[i]) = { tail, 1, 1,
+				getWidth(i), getHeight(i), getWidth(i), getHeight(i) };
+	}
+
+	addUpSampleTiles(graph, downTiles, upTiles, 0);
+}
+
+void Filter::reduceTile(uint32_t col, uint32_t row, uint8_t numTileLevels)
+{
+	// Each level halves the tile of the level before, which is still in cache
+	for (auto i = 1u; i <= numTileLevels; ++i)
+	{
+		const auto &dst = getDownLevel(i);
+		const auto &src = getDownLevel(i - 1);
+		const auto tileSize = TileSize >> i;
+		const auto x0 = col * tileSize, x1 = (min)(x0 + tileSize, dst.Width);
+		const auto y0 = row * tileSize, y1 = (min)(y0 + tileSize, dst.Height);
+		for (auto y = y0; y < y1; ++y) Kernel::Resample(dst, src, y, x0, x1, false);
+	}
+}
+
+void Filter::reduceTail(uint8_t numTileLevels)
+{
+	for (auto i = numTileLevels + 1u; i < m_numMips; ++i)
+	{
+		const auto &dst = getDownLevel(i);
+		const auto &src = getDownLevel(i - 1);
+		for (auto y = 0u; y < dst.Height; ++y) Kernel::Resample(dst, src, y, 0, dst.Width, false);
+	}
+}
+
+void Filter::createProcessGGraph()
+{
+	const auto &down = m_filtered[TABLE_DOWN_SAMPLE];
+	auto &graph = m_graphs[GRAPH_PROCESS_G];
+
+	vector<TileGrid> downTiles(m_numMips);
+	downTiles[0] = { 0, 0, 0, down.GetWidth(), down.GetHeight(), TileSize, TileSize };
+
+	// Generate Mips
+	for (auto i = 1u; i < m_numMips; ++i)
+	{
+		const auto &dst = down.GetSurface(i);
+		const auto &src = down.GetSurface(i - 1);
+		downTiles[i] = addTiles(graph, dst, [this, &dst, &src](uint32_t y, uint32_t x0, uint32_t x1)
+		{
+			Kernel::Resample(dst, src, y, x0, x1, m_highQuality);
+		});
+		addDependencies(graph, downTiles[i], downTiles[i - 1], 2);
+	}
+
+	// Gaussian
+	auto levels = make_shared<vector<Surface>>(m_numMips);
+	for (auto i = 0u; i < m_numMips; ++i) (*levels)[i] = down.GetSurface(i);
+
+	const auto &dst = m_filtered[TABLE_UP_SAMPLE].GetSurface();
+	const auto numLevels = m_numMips;
+	const auto tiles = addTiles(graph, dst, [this, &dst, levels, numLevels](uint32_t y, uint32_t x0, uint32_t x1)
+	{
+		Kernel::MipGaussian(dst, levels->data(), numLevels, m_sigmaG, y, x0, x1);
+	});
+	for (auto i = 1u; i < m_numMips; ++i) addDependencies(graph, tiles, downTiles[i], 2);
+}
+
+Filter::TileGrid Filter::addTiles(TaskGraph &graph, const Surface &dst, const RowFunc &rowFunc)
+{
+	TileGrid tiles;
+	tiles.Cols = (dst.Width + TileSize - 1) / TileSize;
+	tiles.Rows = (dst.Height + TileSize - 1) / TileSize;
+	tiles.Width = dst.Width;
+	tiles.Height = dst.Height;
+	tiles.TileWidth = TileSize;
+	tiles.TileHeight = TileSize;
+	tiles.FirstTask = graph.GetNumTasks();
+
+	for (auto i = 0u; i < tiles.Rows; ++i)
+	{
+		for (auto j = 0u; j < tiles.Cols; ++j)
+		{
+			const auto x0 = j * TileSize, x1 = (min)(x0 + TileSize, dst.Width);
+			const auto y0 = i * TileSize, y1 = (min)(y0 + TileSize, dst.Height);
+			graph.AddTask([rowFunc, x0, x1, y0, y1]()
+			{
+				for (auto y = y0; y < y1; ++y) rowFunc(y, x0, x1);
+			});
+		}
+	}
+
+	return tiles;
+}
+
+void Filter::addDependencies(TaskGraph &graph, const TileGrid &dst, const TileGrid &src, uint32_t margin)
+{
+	// Source levels without tasks are always available
+	if (src.Cols == 0 || src.Rows == 0) return;
+
+	// Source tiles under the footprint of a destination range
+	const auto footprint = [margin](uint32_t i0, uint32_t i1, uint32_t dstSize, uint32_t srcSize,
+		uint32_t srcTileSize, uint32_t &t0, uint32_t &t1)
+	{
+		uint32_t s0, s1;
+		getFootprint(s0, s1, i0, i1, dstSize, srcSize, margin);
+		t0 = s0 / srcTileSize;
+		t1 = (s1 - 1) / srcTileSize;
+	};
+
+	for (auto i = 0u; i < dst.Rows; ++i)
+	{
+		uint32_t r0, r1;
+		footprint(i * dst.TileHeight, (min)((i + 1) * dst.TileHeight, dst.Height),
+			dst.Height, src.Height, src.TileHeight, r0, r1);
+
+		for (auto j = 0u; j < dst.Cols; ++j)
+		{
+			uint32_t c0, c1;
+			footprint(j * dst.TileWidth, (min)((j + 1) * dst.TileWidth, dst.Width),
+				dst.Width, src.Width, src.TileWidth, c0, c1);
+
+			const auto task = dst.FirstTask + dst.Cols * i + j;
+			for (auto r = r0; r <= r1; ++r)
+				for (auto c = c0; c <= c1; ++c)
+					graph.AddDependency(task, src.FirstTask + src.Cols * r + c);
+		}
+	}
+}
+
+void Filter::getFootprint(uint32_t &s0, uint32_t &s1, uint32_t i0, uint32_t i1,
+	uint32_t dstSize, uint32_t srcSize, uint32_t margin)
+{
+	// Sampling footprint [s0, s1) of a destination range in the source, widened by
+	// margin texels to cover the bilinear and offset taps
+	const auto f0 = static_cast<uint64_t>(i0) * srcSize / dstSize;
+	const auto f1 = (static_cast<uint64_t>(i1) * srcSize + dstSize - 1) / dstSize;
+	s0 = static_cast<uint32_t>(f0 > margin ? f0 - margin : 0);
+	s1 = static_cast<uint32_t>((min)(f1 + margin, static_cast<uint64_t>(srcSize)));
+}
+
+Filter::TileGrid Filter::addLevelTiles(TaskGraph &graph, MipChainIndex chain, uint8_t level,
+	TileFilter tileFilter, vector<TileInput> &&inputs, const RowFunc &rowFunc)
+{
+	switch (tileFilter)
+	{
+	case TILES_CHANGED:
+		return addUpdateTiles(graph, chain, level, move(inputs), rowFunc);
+	case TILES_ROI:
+		return addRoiTiles(graph, chain, level, rowFunc);
+	default:
+		// The coarsest level is reduced into the up-sampling chain
+		return chain == TABLE_UP_SAMPLE && level + 1 < m_numMips ?
+			addAdaptiveTiles(graph, level, rowFunc) : addTiles(graph, getLevel(chain, level), rowFunc);
+	}
+}
+
+Filter::TileGrid Filter::addUpdateTiles(TaskGraph &graph, MipChainIndex chain, uint8_t level,
+	vector<TileInput> &&inputs, const RowFunc &rowFunc)
+{
+	// The tiles of addTiles()
+	const auto &dst = getLevel(chain, level);
+	const TileGrid tiles = { graph.GetNumTasks(), (dst.Width + TileSize - 1) / TileSize,
+		(dst.Height + TileSize - 1) / TileSize, dst.Width, dst.Height, TileSize, TileSize };
+
+	// Up-sampled tiles all run again for another focus or sigma
+	const auto isUpSampled = chain == TABLE_UP_SAMPLE && level + 1 < m_numMips;
+	const auto pInputs = make_shared<vector<TileInput>>(move(inputs));
+	for (auto i = 0u; i < tiles.Rows; ++i)
+	{
+		for (auto j = 0u; j < tiles.Cols; ++j)
+		{
+			const Rect rect = { j * TileSize, i * TileSize,
+				(min)((j + 1) * TileSize, dst.Width), (min)((i + 1) * TileSize, dst.Height) };
+			graph.AddTask([this, chain, level, pInputs, rowFunc, rect, isUpSampled, &dst]()
+			{
+				auto isDirty = isUpSampled && m_isUpSampleStale;
+				for (const auto &input : *pInputs)
+					isDirty = isDirty || isChanged(input, rect, dst.Width, dst.Height);
+				setChanged(chain, level, rect, isDirty &&
+					updateRows(dst, rowFunc, rect.Left, rect.Right, rect.Top, rect.Bottom));
+			});
+		}
+	}
+
+	return tiles;
+}
+
+Filter::TileGrid Filter::addAdaptiveTiles(TaskGraph &graph, uint8_t level, const RowFunc &rowFunc)
+{
+	// The tiles of addTiles()
+	const auto &dst = getLevel(TABLE_UP_SAMPLE, level);
+	const auto &src = getLevel(TABLE_DOWN_SAMPLE, level);
+	const TileGrid tiles = { graph.GetNumTasks(), (dst.Width + TileSize - 1) / TileSize,
+		(dst.Height + TileSize - 1) / TileSize, dst.Width, dst.Height, TileSize, TileSize };
+
+	for (auto i = 0u; i < tiles.Rows; ++i)
+	{
+		for (auto j = 0u; j < tiles.Cols; ++j)
+		{
+			const Rect rect = { j * TileSize, i * TileSize,
+				(min)((j + 1) * TileSize, dst.Width), (min)((i + 1) * TileSize, dst.Height) };
+			const auto tile = tiles.Cols * i + j;
+			graph.AddTask([this, level, rowFunc, rect, tile, &dst, &src]()
+			{
+				const auto upSample = m_isUpSampleAdaptive ? m_upSampleTiles[level][tile] : static_cast<uint8_t>(TILE_UP_SAMPLED);
+				if (upSample == TILE_UP_SAMPLED)
+					for (auto y = rect.Top; y < rect.Bottom; ++y) rowFunc(y, rect.Left, rect.Right);
+				else if (upSample == TILE_COPIED)
+				{
+					// A weight of 1 leaves the down-sampled texels, of the same format
+					const auto texelSize = GetTexelSize(dst.TexelFormat);
+					for (auto y = rect.Top; y < rect.Bottom; ++y)
+						memcpy(dst.GetRow(y) + rect.Left * texelSize, src.GetRow(y) + rect.Left * texelSize,
+							(rect.Right - rect.Left) * texelSize);
+				}
+			});
+		}
+	}
+
+	return tiles;
+}
+
+bool Filter::setUpSampleTiles(bool isAdaptive)
+{
+	m_isUpSampleAdaptive = isAdaptive && m_weightTolerance >= 0.0f && !m_upSampleTiles.empty();
+	C_RETURN(!m_isUpSampleAdaptive, true);
+
+	// Every tile of the result is read, and a tile of each coarser level is read
+	// if it is under the footprint of an up-sampled tile of the level before
+	auto isWhole = true;
+	auto desc = m_upSampleDesc;
+	fill(m_upSampleTiles[0].begin(), m_upSampleTiles[0].end(), TILE_UP_SAMPLED);
+	for (auto j = 0u; j < m_upSampleTiles.size(); ++j)
+	{
+		const auto c = j + 1;
+		const auto width = getWidth(j), height = getHeight(j);
+		const auto cols = (width + TileSize - 1) / TileSize;
+		const auto coarserCols = (getWidth(c) + TileSize - 1) / TileSize;
+		const auto pCoarserTiles = c < m_upSampleTiles.size() ? &m_upSampleTiles[c] : nullptr;
+		if (pCoarserTiles) fill(pCoarserTiles->begin(), pCoarserTiles->end(), TILE_SKIPPED);
+
+		desc.Level = j;
+		auto &tiles = m_upSampleTiles[j];
+		for (auto t = 0u; t < tiles.size(); ++t)
+		{
+			if (tiles[t] == TILE_SKIPPED)
+			{
+				isWhole = false;
+				continue;
+			}
+
+			// The weight of the level falls as sigma grows
+			const auto col = t % cols, row = t / cols;
+			const Rect rect = { col * TileSize, row * TileSize,
+				(min)((col + 1) * TileSize, width), (min)((row + 1) * TileSize, height) };
+			const auto weight = Kernel::GetUpSampleWeight(desc, getMaxSigma(j, rect));
+			tiles[t] = 1.0f - weight > m_weightTolerance ? TILE_UP_SAMPLED : TILE_COPIED;
+			if (tiles[t] == TILE_COPIED || !pCoarserTiles) continue;
+
+			// The coarser tiles that addDependencies() waits for
+			uint32_t x0, x1, y0, y1;
+			getFootprint(x0, x1, rect.Left, rect.Right, width, getWidth(c), 2);
+			getFootprint(y0, y1, rect.Top, rect.Bottom, height, getHeight(c), 2);
+			for (auto r = y0 / TileSize; r <= (y1 - 1) / TileSize; ++r)
+				for (auto s = x0 / TileSize; s <= (x1 - 1) / TileSize; ++s)
+					(*pCoarserTiles)[coarserCols * r + s] = TILE_UP_SAMPLED;
+		}
+	}
+
+	return isWhole;
+}
+
+float Filter::getMaxSigma(uint8_t level, const Rect &rect) const
+{
+	const auto &desc = m_upSampleDesc;
+	if (m_hasSigmaMap)
+	{
+		const auto cols = (getWidth(level) + TileSize - 1) / TileSize;
+		const auto maxScale = m_maxSigmaScales[level][cols * (rect.Top / TileSize) + rect.Left / TileSize];
+
+		return desc.Sigma * (max)(maxScale, 0.0f);
+	}
+
+	// The radial falloff of Kernel::UpSample() is the largest at the texel
+	// centers of either end of a range that are the farthest from the focus
+	const auto maxDistance2 = [](uint32_t i0, uint32_t i1, uint32_t size, float focus)
+	{
+		const auto r0 = static_cast<float>(2 * i0 + 1) / size - 1.0f - focus;
+		const auto r1 = static_cast<float>(2 * i1 - 1) / size - 1.0f - focus;
+
+		return (max)(r0 * r0, r1 * r1);
+	};
+
+	const auto rx2 = maxDistance2(rect.Left, rect.Right, getWidth(level), desc.Focus.x);
+	const auto ry2 = maxDistance2(rect.Top, rect.Bottom, getHeight(level), desc.Focus.y);
+
+	return desc.Sigma * (min)((max)(rx2 + ry2 + 0.25f, 0.0f), 1.0f);
+}
+
+Filter::TileGrid Filter::addRoiTiles(TaskGraph &graph, MipChainIndex chain, uint8_t level, const RowFunc &rowFunc)
+{
+	// The tiles of addTiles()
+	const auto &dst = getLevel(chain, level);
+	const TileGrid tiles = { graph.GetNumTasks(), (dst.Width + TileSize - 1) / TileSize,
+		(dst.Height + TileSize - 1) / TileSize, dst.Width, dst.Height, TileSize, TileSize };
+
+	for (auto i = 0u; i < tiles.Rows; ++i)
+	{
+		for (auto j = 0u; j < tiles.Cols; ++j)
+		{
+			const Rect rect = { j * TileSize, i * TileSize,
+				(min)((j + 1) * TileSize, dst.Width), (min)((i + 1) * TileSize, dst.Height) };
+			graph.AddTask([this, chain, level, rowFunc, rect]()
+			{
+				const auto &roi = m_roiRects[chain][level];
+				const auto x0 = (max)(rect.Left, roi.Left), x1 = (min)(rect.Right, roi.Right);
+				const auto y0 = (max)(rect.Top, roi.Top), y1 = (min)(rect.Bottom, roi.Bottom);
+				if (x0 < x1) for (auto y = y0; y < y1; ++y) rowFunc(y, x0, x1);
+			});
+		}
+	}
+
+	return tiles;
+}
+
+void Filter::setRegionOfInterest(const Rect &roi)
+{
+	// Footprint of a rectangle of a level in another, as addDependencies() waits for
+	const auto footprint = [this](const Rect &rect, uint8_t level, uint8_t srcLevel, uint32_t margin)
+	{
+		Rect srcRect;
+		getFootprint(srcRect.Left, srcRect.Right, rect.Left, rect.Right, getWidth(level), getWidth(srcLevel), margin);
+		getFootprint(srcRect.Top, srcRect.Bottom, rect.Top, rect.Bottom, getHeight(level), getHeight(srcLevel), margin);
+
+		return srcRect;
+	};
+
+	const uint8_t numPasses = m_numMips - 1;
+	auto &downRects = m_roiRects[TABLE_DOWN_SAMPLE];
+	auto &upRects = m_roiRects[TABLE_UP_SAMPLE];
+	downRects.resize(m_numMips);
+	upRects.resize(m_numMips);
+
+	// Each up-sampled level needs the coarser one under its bilinear taps
+	upRects[0] = roi;
+	for (auto c = 1u; c <= numPasses; ++c) upRects[c] = footprint(upRects[c - 1], c - 1, c, 2);
+
+	// and the same texels of the down-sampled level, of which the next coarser
+	// level needs those under its taps too; the coarsest level is up sampled
+	downRects[0] = { 0, 0, m_width, m_height };
+	downRects[numPasses] = {};
+	auto coarser = upRects[numPasses];
+	for (auto i = numPasses - 1u; i > 0; --i)
+	{
+		const auto &upRect = upRects[i];
+		const auto srcRect = footprint(coarser, i + 1, i, 2);
+		downRects[i] = { (min)(upRect.Left, srcRect.Left), (min)(upRect.Top, srcRect.Top),
+			(max)(upRect.Right, srcRect.Right), (max)(upRect.Bottom, srcRect.Bottom) };
+		coarser = downRects[i];
+	}
+}
+
+bool Filter::isChanged(const TileInput &input, const Rect &rect, uint32_t width, uint32_t height) const
+{
+	// The tiles of the input under the footprint of rect, as addDependencies() waits for
+	const auto srcWidth = getWidth(input.Level);
+	const auto srcHeight = getHeight(input.Level);
+	uint32_t x0, x1, y0, y1;
+	getFootprint(x0, x1, rect.Left, rect.Right, width, srcWidth, input.Margin);
+	getFootprint(y0, y1, rect.Top, rect.Bottom, height, srcHeight, input.Margin);
+
+	const auto &changedTiles = m_changedTiles[input.Chain][input.Level];
+	const auto cols = (srcWidth + TileSize - 1) / TileSize;
+	for (auto r = y0 / TileSize; r <= (y1 - 1) / TileSize; ++r)
+		for (auto c = x0 / TileSize; c <= (x1 - 1) / TileSize; ++c)
+			C_RETURN(changedTiles[cols * r + c], true);
+
+	return false;
+}
+
+void Filter::setChanged(MipChainIndex chain, uint8_t level, const Rect &rect, bool isChanged)
+{
+	// Tasks set the flags of their own tiles only
+	auto &changedTiles = m_changedTiles[chain][level];
+	const auto cols = (getWidth(level) + TileSize - 1) / TileSize;
+	for (auto r = rect.Top / TileSize; r <= (rect.Bottom - 1) / TileSize; ++r)
+		for (auto c = rect.Left / TileSize; c <= (rect.Right - 1) / TileSize; ++c)
+			changedTiles[cols * r + c] = isChanged;
+}
+
+bool Filter::updateRows(const Surface &dst, const RowFunc &rowFunc,
+	uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1)
+{
+	// Each row is compared to its previous texels, which are still in cache
+	const auto texelSize = GetTexelSize(dst.TexelFormat);
+	const auto offset = x0 * texelSize;
+	const auto size = (x1 - x0) * texelSize;
+	thread_local vector<uint8_t> previous;
+	previous.resize(size);
+
+	auto isChanged = false;
+	for (auto y = y0; y < y1; ++y)
+	{
+		const auto pRow = dst.GetRow(y) + offset;
+		memcpy(previous.data(), pRow, size);
+		rowFunc(y, x0, x1);
+		isChanged = isChanged || memcmp(previous.data(), pRow, size) != 0;
+	}
+
+	return isChanged;
+}
+
+void Filter::initSlab(FusedSlab &slab, uint32_t y0, uint32_t y1, bool isUpSweep)
+{
+	const auto numStreamed = m_residentLevel - 1u;
+
+	slab.Y0 = y0;
+	slab.Y1 = y1;
+	slab.IsUpSweep = isUpSweep;
+	slab.Down.resize(numStreamed + (m_levelBase > 0 ? 1 : 0));
+	slab.Up.resize(isUpSweep ? numStreamed : 0);
+	slab.Result = {};
+
+	// Streamed sources come first in the down chain
+	const auto firstStreamed = m_levelBase > 0 ? 0u : 1u;
+	for (auto streams : { &slab.Down, &slab.Up })
+	{
+		for (auto i = 0u; i < streams->size(); ++i)
+		{
+			const auto level = static_cast<uint8_t>(i + (streams == &slab.Down ? firstStreamed : 1));
+			auto &stream = (*streams)[i];
+			stream.Rows = {};
+			stream.Rows.Width = getWidth(level);
+			stream.Rows.Height = getHeight(level);
+			stream.Rows.TexelFormat = level > 0 ? m_format : FORMAT_B8G8R8A8_UNORM;
+			stream.Rows.RowPitch = stream.Rows.Width * GetTexelSize(stream.Rows.TexelFormat);
+			stream.MaxSpan = 0;
+		}
+	}
+
+	// The dry run walks the exact row requests to size the rings
+	runSlab(slab, true);
+
+	if (isUpSweep && m_levelBase > 0)
+	{
+		slab.Result.Rows.Width = m_width;
+		slab.Result.Rows.Height = m_height;
+		slab.Result.Rows.RowPitch = m_width * PixelSize;
+		slab.Result.MaxSpan = 1;
+		slab.Result.Data.resize(slab.Result.Rows.RowPitch);
+	}
+
+	for (auto streams : { &slab.Down, &slab.Up })
+	{
+		for (auto &stream : *streams)
+		{
+			stream.Rows.NumRows = (max)(stream.MaxSpan, 1u);
+			stream.Data.resize(static_cast<size_t>(stream.Rows.RowPitch) * stream.Rows.NumRows);
+			stream.Rows.pData = stream.Data.data();
+		}
+	}
+	slab.Result.Rows.NumRows = 1;
+	slab.Result.Rows.pData = slab.Result.Data.data();
+}
+
+void Filter::runSlab(FusedSlab &slab, bool dryRun)
+{
+	const auto k = m_residentLevel;
+
+	for (auto &stream : slab.Down) stream.IsStarted = false;
+	for (auto &stream : slab.Up) stream.IsStarted = false;
+	if (dryRun)
+	{
+		slab.ResidentRow0 = UINT32_MAX;
+		slab.ResidentRow1 = 0;
+	}
+
+	for (auto y = slab.Y0; y < slab.Y1; ++y)
+	{
+		uint32_t row0, row1;
+		if (slab.IsUpSweep)
+		{
+			Kernel::GetUpSampleRows(row0, row1, y, m_height, getHeight(1));
+			const auto &coarser = requestUpRows(slab, 1, row0, row1, dryRun);
+			const auto &src = requestDownRows(slab, 0, y, y, dryRun);
+			if (dryRun) continue;
+
+			// Streamed results go out a row at a time
+			const auto &dst = m_levelBase > 0 ? slab.Result.Rows : getLevel(TABLE_UP_SAMPLE, 0);
+			auto desc = m_upSampleDesc;
+			desc.Level = 0;
+			desc.pSigmaMap = getSigmaMap(0);
+			Kernel::UpSample(dst, src, coarser, desc, y, 0, m_width);
+			if (m_levelBase > 0 && m_isStreamOk && !(*m_pWriter)(y, dst.GetRow(y))) m_isStreamOk = false;
+		}
+		else
+		{
+			Kernel::GetResampleRows(row0, row1, y, getHeight(k), getHeight(k - 1), m_highQuality);
+			const auto &src = requestDownRows(slab, k - 1, row0, row1, dryRun);
+			if (dryRun) continue;
+
+			Kernel::Resample(getLevel(TABLE_DOWN_SAMPLE, k), src, y, 0, getWidth(k), m_highQuality);
+		}
+	}
+}
+
+const Surface &Filter::requestDownRows(FusedSlab &slab, uint8_t level,
+	uint32_t row0, uint32_t row1, bool dryRun)
+{
+	if (level >= m_residentLevel || (level == 0 && m_levelBase == 0))
+		return getLevel(TABLE_DOWN_SAMPLE, level);
+
+	auto &stream = slab.Down[m_levelBase > 0 ? level : level - 1];
+	if (!stream.IsStarted)
+	{
+		stream.Next = row0;
+		stream.IsStarted = true;
+	}
+
+	for (; stream.Next <= row1; ++stream.Next)
+	{
+		const auto y = stream.Next;
+		if (level == 0)
+		{
+			// Streamed source
+			if (!dryRun && m_isStreamOk && !(*m_pReader)(y, stream.Rows.GetRow(y))) m_isStreamOk = false;
+			continue;
+		}
+
+		uint32_t src0, src1;
+		Kernel::GetResampleRows(src0, src1, y, stream.Rows.Height, getHeight(level - 1), m_highQuality);
+		const auto &src = requestDownRows(slab, level - 1, src0, src1, dryRun);
+		if (!dryRun) Kernel::Resample(stream.Rows, src, y, 0, stream.Rows.Width, m_highQuality);
+	}
+
+	// Rows [row0, Next) must still be in the ring
+	stream.MaxSpan = (max)(stream.MaxSpan, stream.Next - row0);
+	assert(dryRun || stream.Next - row0 <= stream.Rows.NumRows);
+
+	return stream.Rows;
+}
+
+const Surface &Filter::requestUpRows(FusedSlab &slab, uint8_t level,
+	uint32_t row0, uint32_t row1, bool dryRun)
+{
+	if (level >= m_residentLevel)
+	{
+		if (dryRun)
+		{
+			slab.ResidentRow0 = (min)(slab.ResidentRow0, row0);
+			slab.ResidentRow1 = (max)(slab.ResidentRow1, row1);
+		}
+
+		return getLevel(TABLE_UP_SAMPLE, level);
+	}
+
+	auto &stream = slab.Up[level - 1];
+	if (!stream.IsStarted)
+	{
+		stream.Next = row0;
+		stream.IsStarted = true;
+	}
+
+	for (; stream.Next <= row1; ++stream.Next)
+	{
+		const auto y = stream.Next;
+		uint32_t coarser0, coarser1;
+		Kernel::GetUpSampleRows(coarser0, coarser1, y, stream.Rows.Height, getHeight(level + 1));
+
+		// The coarser rows go first: their down chain runs ahead of this level
+		const auto &coarser = requestUpRows(slab, level + 1, coarser0, coarser1, dryRun);
+		const auto &src = requestDownRows(slab, level, y, y, dryRun);
+		if (dryRun) continue;
+
+		auto desc = m_upSampleDesc;
+		desc.Level = level;
+		desc.pSigmaMap = getSigmaMap(level);
+		Kernel::UpSample(stream.Rows, src, coarser, desc, y, 0, stream.Rows.Width);
+	}
+
+	stream.MaxSpan = (max)(stream.MaxSpan, stream.Next - row0);
+	assert(dryRun || stream.Next - row0 <= stream.Rows.NumRows);
+
+	return stream.Rows;
+}
@@ -0,0 +1,343 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPUKernel.h"
+#include "CPUTaskGraph.h"
+#include "CPUTexture.h"
+#include "CPUWeightTable.h"
+
+namespace CPU
+{
+	// CPU execution engine of the mip-Gaussian filter. It runs the same passes as the
+	// D3D12 Filter (CSResample -> CSUpSample, or CSMipGaussian) on B8G8R8A8 images,
+	// with the levels in between in B8G8R8A8 or any wider Format, and has no
+	// dependency on Windows or Direct3D. Every level is split into tiles
+	// of TileSize x TileSize texels, and a tile only waits for the tiles of its
+	// input levels under its sampling footprint.
+	//
+	// Process() reduces the source once and then only up samples the levels
+	// again until the source changes, as only the focus and sigma animate. After
+	// UpdateSource() of a rectangle, it only runs the tiles of either chain of
+	// which an input tile has changed, and a tile that comes out the same stops
+	// the change there. Process() of a region of interest only runs the texels of
+	// each level under the footprint of that region.
+	//
+	// The tiled and single-pass modes bound the sigma of each up-sampled tile
+	// before they run. A tile of which the coarser levels weigh no more than the
+	// tolerance takes its down-sampled texels instead, so only the tiles of the
+	// coarser levels that another tile still blends are up sampled, and a tile of
+	// no blur passes the source through.
+	//
+	// In the fused mode, Process() stores only the levels from the first one of at
+	// most FusedResidentSize bytes up. The finer levels of both chains stream through
+	// rings of a few rows per level, over slabs of FusedSlabHeight rows: a down-
+	// sweep slab reduces the source to its rows of the resident level, and an up-
+	// sweep slab reduces the source again and resolves each level while its rows
+	// are still in cache, writing only the final result.
+	//
+	// The streaming mode runs the same traversal over an image that never resides in
+	// memory: rows are pulled from a reader and the results pushed to a writer, so
+	// only the resident levels and the rings (a few rows of each level, up to about
+	// 2^level rows of the source) are held, which is proportional to the width.
+	//
+	// The single-pass mode mirrors CSResampleSinglePass.hlsl for validation: a task
+	// per TileSize x TileSize tile of the source reduces it through up to
+	// MaxTileLevels levels while they halve exactly, and one task waiting on all
+	// the tiles resamples the rest. It reduces with the 2x2 box regardless of
+	// highQuality, so it matches the tiled mode of a filter initialized without it.
+	class Filter
+	{
+	public:
+		// Rows are B8G8R8A8 and are read or written in order; false aborts the stream
+		using RowReader = std::function<bool(uint32_t y, uint8_t *pRow)>;
+		using RowWriter = std::function<bool(uint32_t y, const uint8_t *pRow)>;
+
+		enum ExecutionMode : uint8_t
+		{
+			EXECUTION_TILED,
+			EXECUTION_FUSED,
+			EXECUTION_SINGLE_PASS
+		};
+
+		Filter();
+		virtual ~Filter();
+
+		bool Init(uint32_t width, uint32_t height, const void *pSource,
+			uint32_t rowPitch = 0, bool highQuality = true);
+
+		// Replaces the source of Init(), of the same size
+		bool UpdateSource(const void *pSource, uint32_t rowPitch = 0);
+
+		// Replaces the texels of rect of the source with pSource, which holds rect
+		// alone; the next Process() updates the levels from the tiles it touches
+		bool UpdateSource(const Rect &rect, const void *pSource, uint32_t rowPitch = 0);
+
+		// The down-sampled levels depend on the source only, so Process() keeps
+		// them while the source is unchanged and only up samples them for a new
+		// focus or sigma. This forces the next Process() to rebuild them.
+		void InvalidateSource();
+
+		// The source is read twice per ProcessStream(): once to reduce it to the
+		// resident levels and once to resolve the result
+		bool InitStream(uint32_t width, uint32_t height, bool highQuality = true);
+
+		// A resolution of 0 evaluates the up-sample weights per texel instead of
+		// looking them up; the table is rebuilt if the filter is initialized.
+		bool SetWeightTable(uint32_t resolution, float maxSigma = 64.0f);
+
+		// Per-texel sigma scales (one float each, at any resolution) that replace the
+		// radial falloff around the focus of Process(); they are resampled bilinearly
+		// to every level once here. NULL restores the radial falloff.
+		bool SetSigmaMap(uint32_t width, uint32_t height, const float *pSigmas, uint32_t rowPitch = 0);
+
+		// Tiles run on the thread pool if set, otherwise serially on the caller
+		void SetThreadPool(const std::shared_ptr<ThreadPool> &threadPool);
+
+		// Process() only; ProcessG() samples every level at once and stays tiled
+		void SetExecutionMode(ExecutionMode mode);
+
+		// Format of the levels between the source and the result, from the next
+		// Init() or InitStream(); B8G8R8A8 quantizes each of them to 8 bits
+		void SetIntermediateFormat(Format format);
+		Format GetIntermediateFormat() const;
+
+		// Up samples all the levels of at most size x size texels in one task, as
+		// CSUpSampleCoarse.hlsl does in one group; 0 gives each level its tiles
+		void SetCoarseUpSampleSize(uint32_t size);
+
+		// Largest weight of the coarser levels in the up sampling of a tile that
+		// takes its down-sampled texels instead; 0 only takes those of no weight at
+		// all, which is exact, and a negative tolerance up samples every tile
+		void SetWeightTolerance(float tolerance);
+
+		void Process(Float2 focus, float sigma);
+
+		// Evaluates the result within roi only, leaving the rest of it as it was. It
+		// up samples the levels kept by Process(), and reduces the source otherwise,
+		// but then only within roi, so the next Process() reduces it again.
+		void Process(Float2 focus, float sigma, const Rect &roi);
+		void ProcessG(float sigma = 24.0f);
+		bool ProcessStream(const RowReader &reader, const RowWriter &writer, Float2 focus, float sigma);
+
+		const Texture2D &GetResult() const;
+
+		static const uint32_t TileSize = 64;
+		static const uint32_t FusedSlabHeight = 128;
+		static const uint32_t FusedResidentSize = 256 * 1024;
+		static const uint8_t MaxTileLevels = 6;	// log2(TileSize)
+
+	protected:
+		enum MipChainIndex : uint8_t
+		{
+			TABLE_DOWN_SAMPLE,
+			TABLE_UP_SAMPLE,
+
+			NUM_MIP_CHAIN
+		};
+
+		// Reduction of the current down-sampled levels, if any
+		enum PyramidState : uint8_t
+		{
+			PYRAMID_INVALID,
+			PYRAMID_BOX,
+			PYRAMID_HIGH_QUALITY
+		};
+
+		enum GraphIndex : uint8_t
+		{
+			GRAPH_PROCESS,
+			GRAPH_PROCESS_UP_SAMPLE,
+			GRAPH_PROCESS_UPDATE,
+			GRAPH_PROCESS_ROI,
+			GRAPH_PROCESS_UP_SAMPLE_ROI,
+			GRAPH_PROCESS_G,
+			GRAPH_PROCESS_FUSED,
+			GRAPH_PROCESS_STREAM,
+			GRAPH_PROCESS_SINGLE_PASS,
+
+			NUM_GRAPH
+		};
+
+		// Up sampling of a tile of the tiled and single-pass modes, see setUpSampleTiles()
+		enum TileUpSample : uint8_t
+		{
+			TILE_SKIPPED,		// Read by no finer tile
+			TILE_COPIED,		// Of the down-sampled texels, as the coarser levels weigh nothing
+			TILE_UP_SAMPLED
+		};
+
+		// Texels that the tiles of a graph run
+		enum TileFilter : uint8_t
+		{
+			TILES_ALL,
+			TILES_CHANGED,	// Only if an input tile has changed, see addUpdateTiles()
+			TILES_ROI		// Only those under the footprint of the region of interest
+		};
+
+		// Tiles of a level are consecutive tasks of a graph
+		struct TileGrid
+		{
+			uint32_t	FirstTask;
+			uint32_t	Cols;
+			uint32_t	Rows;
+			uint32_t	Width;
+			uint32_t	Height;
+			uint32_t	TileWidth;
+			uint32_t	TileHeight;
+		};
+
+		// Rows of a streamed level, produced in order into a ring of Rows.NumRows rows
+		struct RowStream
+		{
+			Surface					Rows;
+			std::vector<uint8_t>	Data;
+			uint32_t				Next;		// Next row to produce
+			uint32_t				MaxSpan;	// Rows to keep, measured by a dry run
+			bool					IsStarted;
+		};
+
+		// Rows [Y0, Y1) of the resident level (down sweep) or of the result (up sweep)
+		struct FusedSlab
+		{
+			uint32_t				Y0;
+			uint32_t				Y1;
+			uint32_t				ResidentRow0;	// Resident rows of the up sweep
+			uint32_t				ResidentRow1;
+			bool					IsUpSweep;
+			std::vector<RowStream>	Down;	// Levels 1 (0 if streamed) to m_residentLevel - 1
+			std::vector<RowStream>	Up;		// Levels 1 to m_residentLevel - 1
+			RowStream				Result;	// Row of the streamed result
+		};
+
+		// Level read by a tile of the update graph, within Margin texels of its footprint
+		struct TileInput
+		{
+			MipChainIndex	Chain;
+			uint8_t			Level;
+			uint32_t		Margin;
+		};
+
+		using RowFunc = std::function<void(uint32_t y, uint32_t x0, uint32_t x1)>;
+
+		friend class FilterBatch;
+
+		void setUpSampleDesc(Float2 focus, float sigma);
+		void copyTexel();
+
+		void createProcessGraph(GraphIndex graphIndex = GRAPH_PROCESS, TileFilter tileFilter = TILES_ALL);
+		void createUpSampleGraph(GraphIndex graphIndex, TileFilter tileFilter);
+		void addProcessTasks(TaskGraph &graph, TileFilter tileFilter = TILES_ALL);
+		void createProcessGGraph();
+		void createFusedGraph(GraphIndex graphIndex, uint32_t slabHeight);
+		void addProcessTiles(TaskGraph &graph, std::vector<TileGrid> &downTiles,
+			std::vector<TileGrid> &upTiles, uint8_t firstLevel, TileFilter tileFilter = TILES_ALL);
+		void addUpSampleTiles(TaskGraph &graph, const std::vector<TileGrid> &downTiles,
+			std::vector<TileGrid> &upTiles, uint8_t firstLevel, TileFilter tileFilter = TILES_ALL);
+		void createSinglePassGraph();
+		void reduceTile(uint32_t col, uint32_t row, uint8_t numTileLevels);
+		void reduceTail(uint8_t numTileLevels);
+		void upSampleCoarse(uint8_t coarseLevel, TileFilter tileFilter);
+		TileGrid addLevelTiles(TaskGraph &graph, MipChainIndex chain, uint8_t level,
+			TileFilter tileFilter, std::vector<TileInput> &&inputs, const RowFunc &rowFunc);
+
+		// Tiles of the update graph run only if a tile under their footprint in an
+		// input level has changed, and record whether their own texels have
+		TileGrid addUpdateTiles(TaskGraph &graph, MipChainIndex chain, uint8_t level,
+			std::vector<TileInput> &&inputs, const RowFunc &rowFunc);
+		bool isChanged(const TileInput &input, const Rect &rect, uint32_t width, uint32_t height) const;
+		void setChanged(MipChainIndex chain, uint8_t level, const Rect &rect, bool isChanged);
+		bool isUpSampleCurrent(Float2 focus, float sigma) const;
+
+		// Up-sampled tiles of the tiled and single-pass graphs run as the pre-pass
+		// of setUpSampleTiles() selects if isAdaptive, which returns false if it
+		// skips any tile
+		TileGrid addAdaptiveTiles(TaskGraph &graph, uint8_t level, const RowFunc &rowFunc);
+		bool setUpSampleTiles(bool isAdaptive);
+		float getMaxSigma(uint8_t level, const Rect &rect) const;
+
+		// Tiles of the region-of-interest graphs run only their texels within the
+		// rectangles of their levels that the region needs
+		TileGrid addRoiTiles(TaskGraph &graph, MipChainIndex chain, uint8_t level, const RowFunc &rowFunc);
+		void setRegionOfInterest(const Rect &roi);
+
+		bool createResources();
+		uint8_t selectResidentLevel() const;
+		uint8_t getNumTileLevels() const;
+		PyramidState getPyramidState() const;
+		uint8_t getCoarseLevel() const;
+		uint32_t getWidth(uint8_t level) const;
+		uint32_t getHeight(uint8_t level) const;
+		const Surface &getLevel(MipChainIndex chain, uint8_t level) const;
+		const Surface &getDownLevel(uint8_t level) const;
+
+		bool reduceSigmaMap();
+		const Surface *getSigmaMap(uint8_t level) const;
+
+		void initSlab(FusedSlab &slab, uint32_t y0, uint32_t y1, bool isUpSweep);
+		void runSlab(FusedSlab &slab, bool dryRun);
+		const Surface &requestDownRows(FusedSlab &slab, uint8_t level,
+			uint32_t row0, uint32_t row1, bool dryRun);
+		const Surface &requestUpRows(FusedSlab &slab, uint8_t level,
+			uint32_t row0, uint32_t row1, bool dryRun);
+
+		static TileGrid addTiles(TaskGraph &graph, const Surface &dst, const RowFunc &rowFunc);
+		static void addDependencies(TaskGraph &graph, const TileGrid &dst,
+			const TileGrid &src, uint32_t margin);
+		static void getFootprint(uint32_t &s0, uint32_t &s1, uint32_t i0, uint32_t i1,
+			uint32_t dstSize, uint32_t srcSize, uint32_t margin);
+		static bool updateRows(const Surface &dst, const RowFunc &rowFunc,
+			uint32_t x0, uint32_t x1, uint32_t y0, uint32_t y1);
+
+		Texture2D	m_filtered[NUM_MIP_CHAIN];	// From level m_levelBase up
+		Texture2D	m_sigmaMapSource;
+		Texture2D	m_sigmaMaps;	// Reduced to the sizes of the levels
+		WeightTable	m_weightTable;
+		TaskGraph	m_graphs[NUM_GRAPH];
+
+		std::vector<FusedSlab> m_fusedSlabs;
+
+		// A flag per TileSize x TileSize tile of each level, set if the last update
+		// changed it; those of the source are set by UpdateSource()
+		std::vector<std::vector<uint8_t>> m_changedTiles[NUM_MIP_CHAIN];
+
+		// A TileUpSample per TileSize x TileSize tile of each up-sampled level, and
+		// the largest sigma scale of each tile of the reduced sigma maps
+		std::vector<std::vector<uint8_t>> m_upSampleTiles;
+		std::vector<std::vector<float>> m_maxSigmaScales;
+
+		// Rectangle of each level that the region of interest needs
+		std::vector<Rect> m_roiRects[NUM_MIP_CHAIN];
+
+		std::shared_ptr<ThreadPool> m_threadPool;
+
+		const RowReader	*m_pReader;
+		const RowWriter	*m_pWriter;
+
+		Kernel::UpSampleDesc m_upSampleDesc;
+		float		m_sigmaG;
+		float		m_weightTolerance;
+
+		uint32_t	m_weightTableResolution;
+		float		m_weightTableMaxSigma;
+		uint32_t	m_coarseUpSampleSize;
+		uint32_t	m_width;
+		uint32_t	m_height;
+		uint8_t		m_numMips;
+		uint8_t		m_levelBase;
+		uint8_t		m_residentLevel;
+		bool		m_highQuality;
+		bool		m_hasSigmaMap;
+		bool		m_isStreaming;
+		bool		m_isStreamOk;
+		ExecutionMode m_executionMode;
+		PyramidState m_pyramid;
+		bool		m_isSourceChanged;		// Tiles of the source changed since the last Process()
+		bool		m_isUpSampleCurrent;	// Up-sample chain of the levels, for m_upSampleDesc
+		bool		m_isUpSampleStale;		// All the tiles of the update graph up sample again
+		bool		m_isUpSampleAdaptive;	// Up-sampled tiles run as m_upSampleTiles selects
+		Format		m_format;
+	};
+}
@@ -0,0 +1,78 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "CPUFilterBatch.h"
+
+using namespace std;
+using namespace CPU;
+
+FilterBatch::FilterBatch() :
+	m_filters(0),
+	m_threadPool(nullptr),
+	m_weightTableResolution(256),
+	m_weightTableMaxSigma(64.0f)
+{
+}
+
+FilterBatch::~FilterBatch()
+{
+}
+
+bool FilterBatch::Init(const Image *pImages, uint32_t numImages, bool highQuality)
+{
+	M_RETURN(numImages > 0 && !pImages, cerr, "The image list is NULL.", false);
+
+	m_graph.Clear();
+	m_filters.resize(numImages);
+	for (auto i = 0u; i < numImages; ++i)
+	{
+		const auto &image = pImages[i];
+		m_filters[i] = make_unique<Filter>();
+		N_RETURN(m_filters[i]->SetWeightTable(m_weightTableResolution, m_weightTableMaxSigma), false);
+		N_RETURN(m_filters[i]->Init(image.Width, image.Height, image.pSource, image.RowPitch, highQuality), false);
+	}
+
+	return true;
+}
+
+bool FilterBatch::SetWeightTable(uint32_t resolution, float maxSigma)
+{
+	m_weightTableResolution = resolution;
+	m_weightTableMaxSigma = maxSigma;
+
+	for (auto &filter : m_filters)
+		N_RETURN(filter->SetWeightTable(resolution, maxSigma), false);
+
+	return true;
+}
+
+void FilterBatch::SetThreadPool(const shared_ptr<ThreadPool> &threadPool)
+{
+	m_threadPool = threadPool;
+}
+
+void FilterBatch::Process(Float2 focus, float sigma)
+{
+	for (auto &filter : m_filters)
+	{
+		filter->setUpSampleDesc(focus, sigma);
+		filter->setUpSampleTiles(true);
+	}
+
+	// The images are independent, so their graphs are simply concatenated
+	if (m_graph.GetNumTasks() == 0)
+		for (auto &filter : m_filters) filter->addProcessTasks(m_graph);
+
+	m_graph.Execute(m_threadPool.get());
+}
+
+const Texture2D &FilterBatch::GetResult(uint32_t i) const
+{
+	return m_filters[i]->GetResult();
+}
+
+uint32_t FilterBatch::GetNumImages() const
+{
+	return static_cast<uint32_t>(m_filters.size());
+}
@@ -0,0 +1,49 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPUFilter.h"
+
+namespace CPU
+{
+	// Filters many images of mixed sizes per call. The tiles of every pyramid go
+	// into a single task graph, so the whole batch costs one graph execution
+	// (and one wake-up of the thread pool) instead of one per image, and small
+	// images fill the gaps between the dependent levels of the others.
+	class FilterBatch
+	{
+	public:
+		struct Image
+		{
+			uint32_t	Width;
+			uint32_t	Height;
+			const void	*pSource;
+			uint32_t	RowPitch;	// 0 for tightly packed rows
+		};
+
+		FilterBatch();
+		virtual ~FilterBatch();
+
+		bool Init(const Image *pImages, uint32_t numImages, bool highQuality = true);
+
+		// Applies to every image; see Filter::SetWeightTable()
+		bool SetWeightTable(uint32_t resolution, float maxSigma = 64.0f);
+		void SetThreadPool(const std::shared_ptr<ThreadPool> &threadPool);
+
+		void Process(Float2 focus, float sigma);
+
+		const Texture2D &GetResult(uint32_t i) const;
+		uint32_t GetNumImages() const;
+
+	protected:
+		std::vector<std::unique_ptr<Filter>> m_filters;
+		TaskGraph	m_graph;
+
+		std::shared_ptr<ThreadPool> m_threadPool;
+
+		uint32_t	m_weightTableResolution;
+		float		m_weightTableMaxSigma;
+	};
+}
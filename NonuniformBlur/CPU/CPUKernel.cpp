@@ -0,0 +1,668 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "CPUKernelISA.h"
+#include "CPUMipGaussian.h"
+#include "CPUWeightTable.h"
+
+#ifdef CPU_KERNEL_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+using namespace std;
+using namespace CPU;
+
+namespace
+{
+	// Bilinear footprint along one axis
+	struct Tap
+	{
+		uint32_t	I0;
+		uint32_t	I1;
+		float		W;	// Weight of I1
+	};
+
+	// Texel-space position of the sample point ((i + 0.5) / dstSize) in a source of
+	// srcSize texels, plus an integer texel offset as in SampleLevel(..., offset).
+	// The numerator is formed in integers so power-of-two ratios stay exact.
+	inline Tap ComputeTap(uint32_t i, uint32_t dstSize, uint32_t srcSize, int32_t offset = 0)
+	{
+		const auto num = static_cast<int64_t>(2 * i + 1) * srcSize - dstSize +
+			2 * static_cast<int64_t>(offset) * dstSize;
+		const auto t = static_cast<float>(num) / static_cast<float>(2 * dstSize);
+		const auto f = floorf(t);
+		const auto i0 = static_cast<int64_t>(f);
+		const auto last = static_cast<int64_t>(srcSize) - 1;
+
+		Tap tap;
+		tap.I0 = static_cast<uint32_t>((min)((max)(i0, int64_t(0)), last));
+		tap.I1 = static_cast<uint32_t>((min)((max)(i0 + 1, int64_t(0)), last));
+		tap.W = t - f;
+
+		return tap;
+	}
+
+	inline void SampleBilinear(float result[PixelSize], const Surface &src, const Tap &tx, const Tap &ty)
+	{
+		const auto row0 = src.GetRow(ty.I0);
+		const auto row1 = src.GetRow(ty.I1);
+		const auto p00 = &row0[tx.I0 * PixelSize], p01 = &row0[tx.I1 * PixelSize];
+		const auto p10 = &row1[tx.I0 * PixelSize], p11 = &row1[tx.I1 * PixelSize];
+
+		for (auto c = 0u; c < PixelSize; ++c)
+		{
+			const auto v0 = p00[c] + tx.W * (p01[c] - p00[c]);
+			const auto v1 = p10[c] + tx.W * (p11[c] - p10[c]);
+			result[c] = v0 + ty.W * (v1 - v0);
+		}
+	}
+
+	inline uint8_t ToUnorm(float v)
+	{
+		return static_cast<uint8_t>((min)((max)(v, 0.0f), 255.0f) + 0.5f);
+	}
+
+	Kernel::InstructionSet DetectInstructionSet()
+	{
+#ifdef CPU_KERNEL_X86
+		uint32_t regs[4] = {};
+		const auto cpuid = [&regs](uint32_t leaf, uint32_t subLeaf)
+		{
+#ifdef _MSC_VER
+			__cpuidex(reinterpret_cast<int*>(regs), leaf, subLeaf);
+#else
+			__cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+		};
+
+		cpuid(0, 0);
+		const auto maxLeaf = regs[0];
+		C_RETURN(maxLeaf < 1, Kernel::SCALAR);
+
+		cpuid(1, 0);
+		const auto hasSSE41 = (regs[2] & (1u << 19)) != 0;
+		const auto hasFMA = (regs[2] & (1u << 12)) != 0;
+		const auto hasOSXSAVE = (regs[2] & (1u << 27)) != 0;
+		const auto hasF16C = (regs[2] & (1u << 29)) != 0;
+		C_RETURN(!hasSSE41, Kernel::SCALAR);
+		C_RETURN(!hasOSXSAVE || maxLeaf < 7, Kernel::SSE4_1);
+
+		// Check that the OS saves the YMM (and ZMM) state
+#ifdef _MSC_VER
+		const auto xcr0 = _xgetbv(0);
+#else
+		uint32_t xcr0Lo, xcr0Hi;
+		__asm__("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+		const auto xcr0 = (static_cast<uint64_t>(xcr0Hi) << 32) | xcr0Lo;
+#endif
+		C_RETURN((xcr0 & 0x6) != 0x6, Kernel::SSE4_1);
+
+		cpuid(7, 0);
+		const auto hasAVX2 = (regs[1] & (1u << 5)) != 0;
+		const auto hasAVX512 = (regs[1] & (1u << 16)) != 0 && (regs[1] & (1u << 30)) != 0;	// F and BW
+		C_RETURN(!hasAVX2 || !hasFMA || !hasF16C, Kernel::SSE4_1);
+		C_RETURN(!hasAVX512 || (xcr0 & 0xe6) != 0xe6, Kernel::AVX2);
+
+		return Kernel::AVX512;
+#else
+		return Kernel::SCALAR;
+#endif
+	}
+
+	const Kernel::InstructionSet g_supportedInstructionSet = DetectInstructionSet();
+
+	struct KernelTable
+	{
+		Kernel::ResampleRowFunc		pfnResampleRow2x[2];
+		Kernel::UpSampleWeightFunc	pfnUpSampleWeights;
+		Kernel::LoadHalfFunc		pfnLoadHalfs;
+		Kernel::StoreHalfFunc		pfnStoreHalfs;
+	};
+
+	KernelTable GetKernelTable(Kernel::InstructionSet instructionSet)
+	{
+		// The half-float conversions of AVX-512 are those of AVX2, as F16C has
+		// nothing wider that the rows would use
+		switch (instructionSet)
+		{
+#ifdef CPU_KERNEL_X86
+		case Kernel::AVX512:
+			return { { Kernel::ResampleRow2xAVX512, Kernel::ResampleRowHQ2xAVX512 }, Kernel::UpSampleWeightsAVX512,
+				Kernel::LoadHalfsAVX2, Kernel::StoreHalfsAVX2 };
+		case Kernel::AVX2:
+			return { { Kernel::ResampleRow2xAVX2, Kernel::ResampleRowHQ2xAVX2 }, Kernel::UpSampleWeightsAVX2,
+				Kernel::LoadHalfsAVX2, Kernel::StoreHalfsAVX2 };
+		case Kernel::SSE4_1:
+			return { { Kernel::ResampleRow2xSSE41, Kernel::ResampleRowHQ2xSSE41 }, Kernel::UpSampleWeightsSSE41,
+				Kernel::LoadHalfs, Kernel::StoreHalfs };
+#endif
+		default:
+			return { { Kernel::ResampleRow2x, Kernel::ResampleRowHQ2x }, Kernel::UpSampleWeights,
+				Kernel::LoadHalfs, Kernel::StoreHalfs };
+		}
+	}
+
+	Kernel::InstructionSet g_instructionSet = g_supportedInstructionSet;
+	KernelTable g_kernels = GetKernelTable(g_supportedInstructionSet);
+
+	inline bool IsUnorm8(const Surface &surface)
+	{
+		return surface.TexelFormat == FORMAT_B8G8R8A8_UNORM;
+	}
+
+	// Texels [x0, x1) of row y as floats in [0, 255], the scale of the 8-bit path
+	void LoadTexels(float *pDst, const Surface &src, uint32_t y, uint32_t x0, uint32_t x1)
+	{
+		const auto n = (x1 - x0) * PixelSize;
+		const auto pRow = src.GetRow(y);
+
+		switch (src.TexelFormat)
+		{
+		case FORMAT_R10G10B10A2_UNORM:
+		{
+			const auto pTexels = reinterpret_cast<const uint32_t*>(pRow);
+			for (auto x = x0; x < x1; ++x, pDst += PixelSize)
+			{
+				const auto v = pTexels[x];
+				for (auto c = 0u; c < 3; ++c) pDst[c] = ((v >> (10 * c)) & 0x3ff) * (255.0f / 1023.0f);
+				pDst[3] = (v >> 30) * 85.0f;
+			}
+			break;
+		}
+		case FORMAT_R16G16B16A16_FLOAT:
+			g_kernels.pfnLoadHalfs(pDst, &reinterpret_cast<const uint16_t*>(pRow)[x0 * PixelSize], n);
+			break;
+		case FORMAT_R32G32B32A32_FLOAT:
+		{
+			const auto pChannels = &reinterpret_cast<const float*>(pRow)[x0 * PixelSize];
+			for (auto i = 0u; i < n; ++i) pDst[i] = pChannels[i] * 255.0f;
+			break;
+		}
+		default:
+		{
+			const auto pChannels = &pRow[x0 * PixelSize];
+			for (auto i = 0u; i < n; ++i) pDst[i] = pChannels[i];
+		}
+		}
+	}
+
+	void StoreTexels(const Surface &dst, uint32_t y, uint32_t x0, uint32_t x1, const float *pSrc)
+	{
+		const auto n = (x1 - x0) * PixelSize;
+		const auto pRow = dst.GetRow(y);
+
+		switch (dst.TexelFormat)
+		{
+		case FORMAT_R10G10B10A2_UNORM:
+		{
+			const auto toUnorm = [](float v, float scale)
+			{
+				return static_cast<uint32_t>((min)((max)(v, 0.0f), 255.0f) * scale + 0.5f);
+			};
+
+			const auto pTexels = reinterpret_cast<uint32_t*>(pRow);
+			for (auto x = x0; x < x1; ++x, pSrc += PixelSize)
+			{
+				auto v = toUnorm(pSrc[3], 3.0f / 255.0f) << 30;
+				for (auto c = 0u; c < 3; ++c) v |= toUnorm(pSrc[c], 1023.0f / 255.0f) << (10 * c);
+				pTexels[x] = v;
+			}
+			break;
+		}
+		case FORMAT_R16G16B16A16_FLOAT:
+			g_kernels.pfnStoreHalfs(&reinterpret_cast<uint16_t*>(pRow)[x0 * PixelSize], pSrc, n);
+			break;
+		case FORMAT_R32G32B32A32_FLOAT:
+		{
+			const auto pChannels = &reinterpret_cast<float*>(pRow)[x0 * PixelSize];
+			for (auto i = 0u; i < n; ++i) pChannels[i] = pSrc[i] * (1.0f / 255.0f);
+			break;
+		}
+		default:
+		{
+			const auto pChannels = &pRow[x0 * PixelSize];
+			for (auto i = 0u; i < n; ++i) pChannels[i] = ToUnorm(pSrc[i]);
+		}
+		}
+	}
+
+	// Footprint of a kernel in a surface of any format, converted to floats
+	struct TexelBlock
+	{
+		vector<float>	Data;
+		uint32_t		Row0;
+		uint32_t		Col0;
+		uint32_t		Cols;
+
+		void Load(const Surface &src, uint32_t row0, uint32_t row1, uint32_t col0, uint32_t col1)
+		{
+			Row0 = row0;
+			Col0 = col0;
+			Cols = col1 - col0 + 1;
+			Data.resize(static_cast<size_t>(row1 - row0 + 1) * Cols * PixelSize);
+			for (auto y = row0; y <= row1; ++y)
+				LoadTexels(&Data[static_cast<size_t>(y - row0) * Cols * PixelSize], src, y, col0, col1 + 1);
+		}
+
+		const float *Get(uint32_t x, uint32_t y) const
+		{
+			return &Data[(static_cast<size_t>(y - Row0) * Cols + x - Col0) * PixelSize];
+		}
+
+		void SampleBilinear(float result[PixelSize], const Tap &tx, const Tap &ty) const
+		{
+			const auto p00 = Get(tx.I0, ty.I0), p01 = Get(tx.I1, ty.I0);
+			const auto p10 = Get(tx.I0, ty.I1), p11 = Get(tx.I1, ty.I1);
+
+			for (auto c = 0u; c < PixelSize; ++c)
+			{
+				const auto v0 = p00[c] + tx.W * (p01[c] - p00[c]);
+				const auto v1 = p10[c] + tx.W * (p11[c] - p10[c]);
+				result[c] = v0 + ty.W * (v1 - v0);
+			}
+		}
+	};
+
+	// Resample() of surfaces not all in B8G8R8A8
+	void ResampleTexels(const Surface &dst, const Surface &src, uint32_t y,
+		uint32_t x0, uint32_t x1, bool highQuality)
+	{
+		uint32_t row0, row1, col0, col1, unused;
+		Kernel::GetResampleRows(row0, row1, y, dst.Height, src.Height, highQuality);
+		Kernel::GetResampleRows(col0, unused, x0, dst.Width, src.Width, highQuality);
+		Kernel::GetResampleRows(unused, col1, x1 - 1, dst.Width, src.Width, highQuality);
+
+		// Scratch kept per thread, as the rows of a tile are resampled one by one
+		thread_local TexelBlock block;
+		thread_local vector<float> result;
+		block.Load(src, row0, row1, col0, col1);
+		result.resize((x1 - x0) * PixelSize);
+
+		if (src.Width == 2 * dst.Width && src.Height == 2 * dst.Height)
+		{
+			// The integer 2x reductions in floats: rows r0 to r3 are 2y - 1 to 2y + 2
+			const uint32_t r[] = { row0, 2 * y, 2 * y + 1, row1 };
+			const auto last = src.Width - 1;
+			for (auto x = x0; x < x1; ++x)
+			{
+				const auto pResult = &result[(x - x0) * PixelSize];
+				const uint32_t cols[] = { x > 0 ? 2 * x - 1 : 0, 2 * x, 2 * x + 1, (min)(2 * x + 2, last) };
+				for (auto c = 0u; c < PixelSize; ++c)
+				{
+					float vb[4], w[2];
+					for (auto i = 0u; i < 4; ++i) vb[i] = block.Get(cols[i], r[1])[c] + block.Get(cols[i], r[2])[c];
+					if (highQuality)
+					{
+						for (auto i = 0u; i < 2; ++i)
+							w[i] = vb[i + 1] + block.Get(cols[i + 1], r[0])[c] + block.Get(cols[i + 1], r[3])[c];
+						pResult[c] = (vb[0] + vb[3] + 3.0f * (vb[1] + vb[2]) + w[0] + w[1]) / 24.0f;
+					}
+					else pResult[c] = (vb[1] + vb[2]) * 0.25f;
+				}
+			}
+		}
+		else if (highQuality)
+		{
+			const Tap ty[] =
+			{
+				ComputeTap(y, dst.Height, src.Height),
+				ComputeTap(y, dst.Height, src.Height, -1),
+				ComputeTap(y, dst.Height, src.Height, 1)
+			};
+
+			for (auto x = x0; x < x1; ++x)
+			{
+				const Tap tx[] =
+				{
+					ComputeTap(x, dst.Width, src.Width),
+					ComputeTap(x, dst.Width, src.Width, -1),
+					ComputeTap(x, dst.Width, src.Width, 1)
+				};
+
+				float srcs[5][PixelSize];
+				block.SampleBilinear(srcs[0], tx[0], ty[0]);
+				block.SampleBilinear(srcs[1], tx[1], ty[0]);
+				block.SampleBilinear(srcs[2], tx[2], ty[0]);
+				block.SampleBilinear(srcs[3], tx[0], ty[1]);
+				block.SampleBilinear(srcs[4], tx[0], ty[2]);
+
+				for (auto c = 0u; c < PixelSize; ++c)
+				{
+					auto sum = srcs[0][c] * 2.0f;
+					for (auto i = 1u; i < 5; ++i) sum += srcs[i][c];
+					result[(x - x0) * PixelSize + c] = sum / 6.0f;
+				}
+			}
+		}
+		else
+		{
+			const auto ty = ComputeTap(y, dst.Height, src.Height);
+			for (auto x = x0; x < x1; ++x)
+				block.SampleBilinear(&result[(x - x0) * PixelSize], ComputeTap(x, dst.Width, src.Width), ty);
+		}
+
+		StoreTexels(dst, y, x0, x1, result.data());
+	}
+}
+
+Kernel::InstructionSet Kernel::GetSupportedInstructionSet()
+{
+	return g_supportedInstructionSet;
+}
+
+Kernel::InstructionSet Kernel::GetInstructionSet()
+{
+	return g_instructionSet;
+}
+
+void Kernel::SetInstructionSet(InstructionSet instructionSet)
+{
+	g_instructionSet = (min)(instructionSet, g_supportedInstructionSet);
+	g_kernels = GetKernelTable(g_instructionSet);
+}
+
+const char *Kernel::GetInstructionSetName(InstructionSet instructionSet)
+{
+	static const char *names[] = { "Scalar", "SSE4.1", "AVX2", "AVX-512" };
+
+	return instructionSet < NUM_INSTRUCTION_SET ? names[instructionSet] : "Unknown";
+}
+
+void Kernel::ResampleRow2x(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+	uint32_t x0, uint32_t x1, uint32_t)
+{
+	for (auto x = x0; x < x1; ++x)
+	{
+		for (auto c = 0u; c < PixelSize; ++c)
+		{
+			const auto i = 2 * x * PixelSize + c;
+			const auto j = i + PixelSize;
+			const auto n = pSrcRows[1][i] + pSrcRows[1][j] + pSrcRows[2][i] + pSrcRows[2][j];
+			pDst[x * PixelSize + c] = static_cast<uint8_t>((n + 2) >> 2);
+		}
+	}
+}
+
+void Kernel::ResampleRowHQ2x(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+	uint32_t x0, uint32_t x1, uint32_t dstWidth)
+{
+	ResampleRowHQ2xChunked<1, 1>(pDst, pSrcRows, x0, x1, dstWidth,
+		ResampleVerticalHQ2x, ResampleHorizontalHQ2x);
+}
+
+void Kernel::UpSampleWeights(float *pWeights, const float *pSigmas,
+	uint32_t n, uint32_t level, uint32_t numLevels)
+{
+	for (auto i = 0u; i < n; ++i)
+		pWeights[i] = UpSampleWeight(pSigmas[i] * pSigmas[i], level, numLevels);
+}
+
+void Kernel::LoadHalfs(float *pDst, const uint16_t *pSrc, uint32_t n)
+{
+	for (auto i = 0u; i < n; ++i) pDst[i] = HalfToFloat(pSrc[i]) * 255.0f;
+}
+
+void Kernel::StoreHalfs(uint16_t *pDst, const float *pSrc, uint32_t n)
+{
+	for (auto i = 0u; i < n; ++i) pDst[i] = FloatToHalf(pSrc[i] * (1.0f / 255.0f));
+}
+
+void Kernel::Resample(const Surface &dst, const Surface &src, uint32_t y,
+	uint32_t x0, uint32_t x1, bool highQuality)
+{
+	if (!IsUnorm8(dst) || !IsUnorm8(src))
+	{
+		ResampleTexels(dst, src, y, x0, x1, highQuality);
+
+		return;
+	}
+
+	const auto pDst = dst.GetRow(y);
+
+	// Exact 2x reductions, which are all levels of even dimensions, take the
+	// vectorized integer path; its results equal the bilinear path below.
+	if (src.Width == 2 * dst.Width && src.Height == 2 * dst.Height)
+	{
+		const uint8_t *const srcRows[] =
+		{
+			src.GetRow(y > 0 ? 2 * y - 1 : 0),
+			src.GetRow(2 * y),
+			src.GetRow(2 * y + 1),
+			src.GetRow((min)(2 * y + 2, src.Height - 1))
+		};
+
+		g_kernels.pfnResampleRow2x[highQuality ? 1 : 0](pDst, srcRows, x0, x1, dst.Width);
+
+		return;
+	}
+
+	if (highQuality)
+	{
+		// 5-tap filter of _HIGH_QUALITY_
+		const Tap ty[] =
+		{
+			ComputeTap(y, dst.Height, src.Height),
+			ComputeTap(y, dst.Height, src.Height, -1),
+			ComputeTap(y, dst.Height, src.Height, 1)
+		};
+
+		for (auto x = x0; x < x1; ++x)
+		{
+			const Tap tx[] =
+			{
+				ComputeTap(x, dst.Width, src.Width),
+				ComputeTap(x, dst.Width, src.Width, -1),
+				ComputeTap(x, dst.Width, src.Width, 1)
+			};
+
+			float srcs[5][PixelSize];
+			SampleBilinear(srcs[0], src, tx[0], ty[0]);
+			SampleBilinear(srcs[1], src, tx[1], ty[0]);
+			SampleBilinear(srcs[2], src, tx[2], ty[0]);
+			SampleBilinear(srcs[3], src, tx[0], ty[1]);
+			SampleBilinear(srcs[4], src, tx[0], ty[2]);
+
+			for (auto c = 0u; c < PixelSize; ++c)
+			{
+				auto result = srcs[0][c] * 2.0f;
+				for (auto i = 1u; i < 5; ++i) result += srcs[i][c];
+				pDst[x * PixelSize + c] = ToUnorm(result / 6.0f);
+			}
+		}
+	}
+	else
+	{
+		const auto ty = ComputeTap(y, dst.Height, src.Height);
+
+		for (auto x = x0; x < x1; ++x)
+		{
+			float result[PixelSize];
+			SampleBilinear(result, src, ComputeTap(x, dst.Width, src.Width), ty);
+			for (auto c = 0u; c < PixelSize; ++c) pDst[x * PixelSize + c] = ToUnorm(result[c]);
+		}
+	}
+}
+
+void Kernel::UpSample(const Surface &dst, const Surface &src, const Surface &coarser,
+	const UpSampleDesc &desc, uint32_t y, uint32_t x0, uint32_t x1)
+{
+	const auto pDst = dst.GetRow(y);
+	const auto pSrc = src.GetRow(y);
+	const auto ty = ComputeTap(y, dst.Height, coarser.Height);
+	const auto ry = static_cast<float>(2 * y + 1) / dst.Height - 1.0f - desc.Focus.y;
+	const auto isUnorm8 = IsUnorm8(dst) && IsUnorm8(src) && IsUnorm8(coarser);
+
+	thread_local TexelBlock coarserBlock;
+	float sigmas[UpSampleChunkSize], weights[UpSampleChunkSize];
+	for (auto xs = x0; xs < x1; xs += UpSampleChunkSize)
+	{
+		const auto xe = (min)(xs + UpSampleChunkSize, x1);
+
+		// Compute deviation
+		if (desc.pSigmaMap)
+		{
+			const auto pScales = reinterpret_cast<const float*>(desc.pSigmaMap->GetRow(y));
+			for (auto x = xs; x < xe; ++x) sigmas[x - xs] = desc.Sigma * (max)(pScales[x], 0.0f);
+		}
+		else for (auto x = xs; x < xe; ++x)
+		{
+			const auto rx = static_cast<float>(2 * x + 1) / dst.Width - 1.0f - desc.Focus.x;
+			const auto s = (min)((max)(rx * rx + ry * ry + 0.25f, 0.0f), 1.0f);
+			sigmas[x - xs] = desc.Sigma * s;
+		}
+
+		// The Gaussian-approximating Haar coefficients dominate the cost of the pass
+		if (desc.pWeightTable) desc.pWeightTable->Lookup(weights, sigmas, xe - xs, desc.Level);
+		else g_kernels.pfnUpSampleWeights(weights, sigmas, xe - xs, desc.Level, desc.NumLevels);
+
+		if (isUnorm8) for (auto x = xs; x < xe; ++x)
+		{
+			// Fetch the resolved color at the coarser level; the current level is
+			// sampled at its own texel centers, hence read directly
+			float coarserColor[PixelSize];
+			SampleBilinear(coarserColor, coarser, ComputeTap(x, dst.Width, coarser.Width), ty);
+
+			const auto w = weights[x - xs];
+			for (auto c = 0u; c < PixelSize; ++c)
+			{
+				const auto i = x * PixelSize + c;
+				pDst[i] = ToUnorm(coarserColor[c] + w * (pSrc[i] - coarserColor[c]));
+			}
+		}
+		else
+		{
+			// The same in floats, converting the rows of the chunk
+			float srcColors[UpSampleChunkSize * PixelSize];
+			LoadTexels(srcColors, src, y, xs, xe);
+			coarserBlock.Load(coarser, ty.I0, ty.I1, ComputeTap(xs, dst.Width, coarser.Width).I0,
+				ComputeTap(xe - 1, dst.Width, coarser.Width).I1);
+
+			for (auto x = xs; x < xe; ++x)
+			{
+				float coarserColor[PixelSize];
+				coarserBlock.SampleBilinear(coarserColor, ComputeTap(x, dst.Width, coarser.Width), ty);
+
+				const auto w = weights[x - xs];
+				const auto pColor = &srcColors[(x - xs) * PixelSize];
+				for (auto c = 0u; c < PixelSize; ++c)
+					pColor[c] = coarserColor[c] + w * (pColor[c] - coarserColor[c]);
+			}
+
+			StoreTexels(dst, y, xs, xe, srcColors);
+		}
+	}
+}
+
+float Kernel::GetUpSampleWeight(const UpSampleDesc &desc, float sigma)
+{
+	// As UpSample() evaluates the weights of its texels
+	C_RETURN(desc.pWeightTable, desc.pWeightTable->Lookup(sigma, desc.Level));
+
+	float weight;
+	g_kernels.pfnUpSampleWeights(&weight, &sigma, 1, desc.Level, desc.NumLevels);
+
+	return weight;
+}
+
+void Kernel::ResampleSigma(const Surface &dst, const Surface &src, uint32_t y, uint32_t x0, uint32_t x1)
+{
+	const auto pDst = reinterpret_cast<float*>(dst.GetRow(y));
+	const auto ty = ComputeTap(y, dst.Height, src.Height);
+	const auto pRow0 = reinterpret_cast<const float*>(src.GetRow(ty.I0));
+	const auto pRow1 = reinterpret_cast<const float*>(src.GetRow(ty.I1));
+
+	for (auto x = x0; x < x1; ++x)
+	{
+		const auto tx = ComputeTap(x, dst.Width, src.Width);
+		const auto v0 = pRow0[tx.I0] + tx.W * (pRow0[tx.I1] - pRow0[tx.I0]);
+		const auto v1 = pRow1[tx.I0] + tx.W * (pRow1[tx.I1] - pRow1[tx.I0]);
+		pDst[x] = v0 + ty.W * (v1 - v0);
+	}
+}
+
+void Kernel::GetResampleRows(uint32_t &row0, uint32_t &row1, uint32_t y,
+	uint32_t dstHeight, uint32_t srcHeight, bool highQuality)
+{
+	// Same row selection as Resample()
+	if (srcHeight == 2 * dstHeight)
+	{
+		row0 = y > 0 ? 2 * y - 1 : 0;
+		row1 = (min)(2 * y + 2, srcHeight - 1);
+	}
+	else if (highQuality)
+	{
+		row0 = ComputeTap(y, dstHeight, srcHeight, -1).I0;
+		row1 = ComputeTap(y, dstHeight, srcHeight, 1).I1;
+	}
+	else
+	{
+		const auto ty = ComputeTap(y, dstHeight, srcHeight);
+		row0 = ty.I0;
+		row1 = ty.I1;
+	}
+}
+
+void Kernel::GetUpSampleRows(uint32_t &row0, uint32_t &row1, uint32_t y,
+	uint32_t dstHeight, uint32_t coarserHeight)
+{
+	const auto ty = ComputeTap(y, dstHeight, coarserHeight);
+	row0 = ty.I0;
+	row1 = ty.I1;
+}
+
+void Kernel::MipGaussian(const Surface &dst, const Surface *pLevels, uint32_t numLevels,
+	float sigma, uint32_t y, uint32_t x0, uint32_t x1)
+{
+	const auto pDst = dst.GetRow(y);
+	const auto sigma2 = sigma * sigma;
+
+	// Scratch kept per thread, as the rows of a tile are filtered one by one
+	thread_local vector<float> weights;
+	thread_local vector<Tap> ty;
+	weights.resize(numLevels);
+	ty.resize(numLevels);
+	auto wsum = 0.0f;
+	for (auto i = 0u; i < numLevels; ++i)
+	{
+		weights[i] = MipWeight(sigma2, i);
+		ty[i] = ComputeTap(y, dst.Height, pLevels[i].Height);
+		wsum += weights[i];
+	}
+
+	// Levels of other formats are converted to floats under the footprint of the row
+	auto isUnorm8 = IsUnorm8(dst);
+	thread_local vector<TexelBlock> blocks;
+	blocks.resize((max)(numLevels, static_cast<uint32_t>(blocks.size())));
+	for (auto i = 0u; i < numLevels; ++i)
+	{
+		if (IsUnorm8(pLevels[i])) continue;
+		blocks[i].Load(pLevels[i], ty[i].I0, ty[i].I1, ComputeTap(x0, dst.Width, pLevels[i].Width).I0,
+			ComputeTap(x1 - 1, dst.Width, pLevels[i].Width).I1);
+		isUnorm8 = false;
+	}
+
+	thread_local vector<float> results;
+	if (!isUnorm8) results.resize((x1 - x0) * PixelSize);
+	for (auto x = x0; x < x1; ++x)
+	{
+		float result[PixelSize] = {};
+		for (auto i = 0u; i < numLevels; ++i)
+		{
+			float color[PixelSize];
+			const auto tx = ComputeTap(x, dst.Width, pLevels[i].Width);
+			if (IsUnorm8(pLevels[i])) SampleBilinear(color, pLevels[i], tx, ty[i]);
+			else blocks[i].SampleBilinear(color, tx, ty[i]);
+			for (auto c = 0u; c < PixelSize; ++c) result[c] += color[c] * weights[i];
+		}
+
+		if (isUnorm8) for (auto c = 0u; c < PixelSize; ++c) pDst[x * PixelSize + c] = ToUnorm(result[c] / wsum);
+		else for (auto c = 0u; c < PixelSize; ++c) results[(x - x0) * PixelSize + c] = result[c] / wsum;
+	}
+
+	if (!isUnorm8) StoreTexels(dst, y, x0, x1, results.data());
+}
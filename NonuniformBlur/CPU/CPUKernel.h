@@ -0,0 +1,73 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPUType.h"
+
+namespace CPU
+{
+	class WeightTable;
+
+	// Row kernels of the compute shaders. Each call writes texels [x0, x1) of row y
+	// in the destination surface, sampling the sources with LINEAR_CLAMP semantics.
+	// Surfaces of B8G8R8A8 take the integer paths; any other format converts the
+	// rows to floats and back, with the half floats converted by F16C.
+	namespace Kernel
+	{
+		enum InstructionSet : uint8_t
+		{
+			SCALAR,
+			SSE4_1,
+			AVX2,		// With FMA and F16C
+			AVX512,		// F and BW
+
+			NUM_INSTRUCTION_SET
+		};
+
+		// The best instruction set of the running processor is selected by default;
+		// SetInstructionSet() can lower it (requests above the supported set are clamped).
+		InstructionSet GetSupportedInstructionSet();
+		InstructionSet GetInstructionSet();
+		void SetInstructionSet(InstructionSet instructionSet);
+		const char *GetInstructionSetName(InstructionSet instructionSet);
+
+		struct UpSampleDesc
+		{
+			Float2		Focus;
+			float		Sigma;
+			uint32_t	Level;
+			uint32_t	NumLevels;
+			const WeightTable *pWeightTable;	// Optional, replaces the per-texel weight evaluation
+			const Surface *pSigmaMap;	// Optional, sigma scales of the size of dst, replaces the radial falloff
+		};
+
+		// CSResample.hlsl: src is the next finer level of dst
+		void Resample(const Surface &dst, const Surface &src, uint32_t y,
+			uint32_t x0, uint32_t x1, bool highQuality);
+
+		// CSUpSample.hlsl: src is the down-sampled level of the same size as dst,
+		// coarser is the resolved result of the next coarser level
+		void UpSample(const Surface &dst, const Surface &src, const Surface &coarser,
+			const UpSampleDesc &desc, uint32_t y, uint32_t x0, uint32_t x1);
+
+		// Lerp factor of UpSample() for a texel of the given sigma, at desc.Level
+		float GetUpSampleWeight(const UpSampleDesc &desc, float sigma);
+
+		// Bilinear resampling of sigma maps, whose texels are single floats
+		void ResampleSigma(const Surface &dst, const Surface &src, uint32_t y, uint32_t x0, uint32_t x1);
+
+		// Rows [row0, row1] of src that Resample() reads for row y of dst
+		void GetResampleRows(uint32_t &row0, uint32_t &row1, uint32_t y,
+			uint32_t dstHeight, uint32_t srcHeight, bool highQuality);
+
+		// Rows [row0, row1] of coarser that UpSample() reads for row y of dst
+		void GetUpSampleRows(uint32_t &row0, uint32_t &row1, uint32_t y,
+			uint32_t dstHeight, uint32_t coarserHeight);
+
+		// CSMipGaussian.hlsl: pLevels is the full down-sampled mip chain
+		void MipGaussian(const Surface &dst, const Surface *pLevels, uint32_t numLevels,
+			float sigma, uint32_t y, uint32_t x0, uint32_t x1);
+	}
+}
@@ -0,0 +1,174 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "CPUKernelISA.h"
+
+#ifdef CPU_KERNEL_X86
+
+#include <immintrin.h>
+#include "CPUMipGaussian.h"
+
+using namespace std;
+using namespace CPU;
+
+namespace
+{
+	// Loads 8 source texels (4 destination texels) and splits them into even and
+	// odd texels widened to 16 bits
+	inline void LoadEvenOdd(__m256i &even, __m256i &odd, const uint8_t *pSrc)
+	{
+		const auto v = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc)),
+			_mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+		even = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v));
+		odd = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1));
+	}
+
+	// Packs 2 x 4 texels of 16-bit channels to 8 texels in order
+	inline __m256i Pack(const __m256i &lo, const __m256i &hi)
+	{
+		return _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+	}
+
+	// 4 destination texels of the 2x2 box
+	inline __m256i Box2x(const uint8_t *const pSrcRows[4], uint32_t x)
+	{
+		__m256i e1, o1, e2, o2;
+		LoadEvenOdd(e1, o1, &pSrcRows[1][2 * x * PixelSize]);
+		LoadEvenOdd(e2, o2, &pSrcRows[2][2 * x * PixelSize]);
+		const auto n = _mm256_add_epi16(_mm256_add_epi16(e1, o1), _mm256_add_epi16(e2, o2));
+
+		return _mm256_srli_epi16(_mm256_add_epi16(n, _mm256_set1_epi16(2)), 2);
+	}
+
+	inline void VerticalHQ2x(uint16_t *ve, uint16_t *vo, uint16_t *wp,
+		const uint8_t *const pSrcRows[4], uint32_t x)
+	{
+		__m256i e[4], o[4];
+		for (auto i = 0u; i < 4; ++i) LoadEvenOdd(e[i], o[i], &pSrcRows[i][2 * x * PixelSize]);
+
+		const auto vbe = _mm256_add_epi16(e[1], e[2]);
+		const auto vbo = _mm256_add_epi16(o[1], o[2]);
+		const auto w = _mm256_add_epi16(_mm256_add_epi16(vbe, vbo),
+			_mm256_add_epi16(_mm256_add_epi16(e[0], e[3]), _mm256_add_epi16(o[0], o[3])));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(ve), vbe);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(vo), vbo);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(wp), w);
+	}
+
+	// 4 destination texels of (N + 12) / 24, see CPUKernelSSE41.cpp
+	inline __m256i HorizontalHQ2x(const uint16_t *ve, const uint16_t *vo, const uint16_t *wp)
+	{
+		const auto load = [](const uint16_t *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); };
+		const auto s = _mm256_add_epi16(load(ve), load(vo));
+		auto n = _mm256_add_epi16(load(vo - PixelSize), load(ve + PixelSize));
+		n = _mm256_add_epi16(n, _mm256_add_epi16(s, _mm256_slli_epi16(s, 1)));
+		n = _mm256_add_epi16(n, _mm256_add_epi16(load(wp), _mm256_set1_epi16(12)));
+
+		return _mm256_mulhi_epu16(_mm256_srli_epi16(n, 3), _mm256_set1_epi16(21846));
+	}
+
+	// See FastExpP in CPUKernelISA.h
+	inline __m256 Exp(__m256 x)
+	{
+		const auto n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(Kernel::FastExpLog2E)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		auto r = _mm256_fnmadd_ps(n, _mm256_set1_ps(Kernel::FastExpLn2Hi), x);
+		r = _mm256_fnmadd_ps(n, _mm256_set1_ps(Kernel::FastExpLn2Lo), r);
+
+		auto p = _mm256_set1_ps(Kernel::FastExpP[0]);
+		for (auto i = 1u; i < 6; ++i) p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(Kernel::FastExpP[i]));
+		p = _mm256_add_ps(_mm256_fmadd_ps(_mm256_mul_ps(p, r), r, r), _mm256_set1_ps(1.0f));
+
+		const auto scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(
+			_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23));
+
+		return _mm256_and_ps(_mm256_mul_ps(p, scale), _mm256_cmp_ps(x, _mm256_set1_ps(Kernel::FastExpMin), _CMP_GE_OQ));
+	}
+
+	// 8 lerp factors, see CPUKernelSSE41.cpp
+	inline __m256 LerpFactor(__m256 sigma, uint32_t level, uint32_t numLevels)
+	{
+		const auto a = _mm256_div_ps(_mm256_set1_ps(-1.0f),
+			_mm256_mul_ps(_mm256_set1_ps(PI), _mm256_mul_ps(sigma, sigma)));
+
+		auto g0 = Exp(_mm256_mul_ps(a, _mm256_set1_ps(0.5f)));
+		auto wsum = _mm256_setzero_ps(), weight = _mm256_setzero_ps();
+		for (auto i = level; i < numLevels; ++i)
+		{
+			const auto g1 = Exp(_mm256_mul_ps(a, _mm256_set1_ps(ldexpf(1.0f, 2 * i + 1))));
+			const auto w = _mm256_mul_ps(_mm256_set1_ps(ldexpf(1.0f, 2 * i)), _mm256_sub_ps(g0, g1));
+			weight = i == level ? w : weight;
+			wsum = _mm256_add_ps(wsum, w);
+			g0 = g1;
+		}
+
+		return _mm256_blendv_ps(_mm256_set1_ps(1.0f), _mm256_div_ps(weight, wsum),
+			_mm256_cmp_ps(wsum, _mm256_setzero_ps(), _CMP_GT_OQ));
+	}
+}
+
+void Kernel::ResampleRow2xAVX2(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+	uint32_t x0, uint32_t x1, uint32_t dstWidth)
+{
+	auto x = x0;
+	for (; x + 8 <= x1; x += 8)
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&pDst[x * PixelSize]),
+			Pack(Box2x(pSrcRows, x), Box2x(pSrcRows, x + 4)));
+
+	ResampleRow2x(pDst, pSrcRows, x, x1, dstWidth);
+}
+
+void Kernel::ResampleRowHQ2xAVX2(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+	uint32_t x0, uint32_t x1, uint32_t dstWidth)
+{
+	ResampleRowHQ2xChunked<4, 8>(pDst, pSrcRows, x0, x1, dstWidth, VerticalHQ2x,
+		[](uint8_t *pDst, const uint16_t *ve, const uint16_t *vo, const uint16_t *wp)
+	{
+		const auto lo = HorizontalHQ2x(ve, vo, wp);
+		const auto hi = HorizontalHQ2x(ve + 4 * PixelSize, vo + 4 * PixelSize, wp + 4 * PixelSize);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst), Pack(lo, hi));
+	});
+}
+
+void Kernel::UpSampleWeightsAVX2(float *pWeights, const float *pSigmas,
+	uint32_t n, uint32_t level, uint32_t numLevels)
+{
+	auto i = 0u;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(&pWeights[i], LerpFactor(_mm256_loadu_ps(&pSigmas[i]), level, numLevels));
+
+	if (i < n)
+	{
+		float sigmas[8] = {}, weights[8];
+		memcpy(sigmas, &pSigmas[i], sizeof(float) * (n - i));
+		_mm256_storeu_ps(weights, LerpFactor(_mm256_loadu_ps(sigmas), level, numLevels));
+		memcpy(&pWeights[i], weights, sizeof(float) * (n - i));
+	}
+}
+
+void Kernel::LoadHalfsAVX2(float *pDst, const uint16_t *pSrc, uint32_t n)
+{
+	const auto scale = _mm256_set1_ps(255.0f);
+
+	auto i = 0u;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(&pDst[i], _mm256_mul_ps(_mm256_cvtph_ps(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(&pSrc[i]))), scale));
+
+	LoadHalfs(&pDst[i], &pSrc[i], n - i);
+}
+
+void Kernel::StoreHalfsAVX2(uint16_t *pDst, const float *pSrc, uint32_t n)
+{
+	const auto scale = _mm256_set1_ps(1.0f / 255.0f);
+
+	auto i = 0u;
+	for (; i + 8 <= n; i += 8)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&pDst[i]), _mm256_cvtps_ph(
+			_mm256_mul_ps(_mm256_loadu_ps(&pSrc[i]), scale), _MM_FROUND_TO_NEAREST_INT));
+
+	StoreHalfs(&pDst[i], &pSrc[i], n - i);
+}
+
+#endif
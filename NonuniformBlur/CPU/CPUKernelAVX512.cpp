@@ -0,0 +1,150 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "CPUKernelISA.h"
+
+#ifdef CPU_KERNEL_X86
+
+#include <immintrin.h>
+#include "CPUMipGaussian.h"
+
+// GCC's AVX-512 headers build some intrinsics on deliberately undefined vectors
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+using namespace std;
+using namespace CPU;
+
+namespace
+{
+	// Loads 16 source texels (8 destination texels) and splits them into even and
+	// odd texels widened to 16 bits
+	inline void LoadEvenOdd(__m512i &even, __m512i &odd, const uint8_t *pSrc)
+	{
+		const auto v = _mm512_permutexvar_epi32(_mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14,
+			1, 3, 5, 7, 9, 11, 13, 15), _mm512_loadu_si512(pSrc));
+		even = _mm512_cvtepu8_epi16(_mm512_castsi512_si256(v));
+		odd = _mm512_cvtepu8_epi16(_mm512_extracti64x4_epi64(v, 1));
+	}
+
+	// Narrows 8 texels of 16-bit channels, all known to be in [0, 255]
+	inline void Store(uint8_t *pDst, const __m512i &v)
+	{
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst), _mm512_cvtepi16_epi8(v));
+	}
+
+	// 8 destination texels of the 2x2 box
+	inline __m512i Box2x(const uint8_t *const pSrcRows[4], uint32_t x)
+	{
+		__m512i e1, o1, e2, o2;
+		LoadEvenOdd(e1, o1, &pSrcRows[1][2 * x * PixelSize]);
+		LoadEvenOdd(e2, o2, &pSrcRows[2][2 * x * PixelSize]);
+		const auto n = _mm512_add_epi16(_mm512_add_epi16(e1, o1), _mm512_add_epi16(e2, o2));
+
+		return _mm512_srli_epi16(_mm512_add_epi16(n, _mm512_set1_epi16(2)), 2);
+	}
+
+	inline void VerticalHQ2x(uint16_t *ve, uint16_t *vo, uint16_t *wp,
+		const uint8_t *const pSrcRows[4], uint32_t x)
+	{
+		__m512i e[4], o[4];
+		for (auto i = 0u; i < 4; ++i) LoadEvenOdd(e[i], o[i], &pSrcRows[i][2 * x * PixelSize]);
+
+		const auto vbe = _mm512_add_epi16(e[1], e[2]);
+		const auto vbo = _mm512_add_epi16(o[1], o[2]);
+		const auto w = _mm512_add_epi16(_mm512_add_epi16(vbe, vbo),
+			_mm512_add_epi16(_mm512_add_epi16(e[0], e[3]), _mm512_add_epi16(o[0], o[3])));
+		_mm512_storeu_si512(ve, vbe);
+		_mm512_storeu_si512(vo, vbo);
+		_mm512_storeu_si512(wp, w);
+	}
+
+	// 8 destination texels of (N + 12) / 24, see CPUKernelSSE41.cpp
+	inline __m512i HorizontalHQ2x(const uint16_t *ve, const uint16_t *vo, const uint16_t *wp)
+	{
+		const auto s = _mm512_add_epi16(_mm512_loadu_si512(ve), _mm512_loadu_si512(vo));
+		auto n = _mm512_add_epi16(_mm512_loadu_si512(vo - PixelSize), _mm512_loadu_si512(ve + PixelSize));
+		n = _mm512_add_epi16(n, _mm512_add_epi16(s, _mm512_slli_epi16(s, 1)));
+		n = _mm512_add_epi16(n, _mm512_add_epi16(_mm512_loadu_si512(wp), _mm512_set1_epi16(12)));
+
+		return _mm512_mulhi_epu16(_mm512_srli_epi16(n, 3), _mm512_set1_epi16(21846));
+	}
+
+	// See FastExpP in CPUKernelISA.h
+	inline __m512 Exp(__m512 x)
+	{
+		const auto n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(Kernel::FastExpLog2E)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		auto r = _mm512_fnmadd_ps(n, _mm512_set1_ps(Kernel::FastExpLn2Hi), x);
+		r = _mm512_fnmadd_ps(n, _mm512_set1_ps(Kernel::FastExpLn2Lo), r);
+
+		auto p = _mm512_set1_ps(Kernel::FastExpP[0]);
+		for (auto i = 1u; i < 6; ++i) p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(Kernel::FastExpP[i]));
+		p = _mm512_add_ps(_mm512_fmadd_ps(_mm512_mul_ps(p, r), r, r), _mm512_set1_ps(1.0f));
+
+		const auto mask = _mm512_cmp_ps_mask(x, _mm512_set1_ps(Kernel::FastExpMin), _CMP_GE_OQ);
+
+		return _mm512_maskz_scalef_ps(mask, p, n);
+	}
+
+	// 16 lerp factors, see CPUKernelSSE41.cpp
+	inline __m512 LerpFactor(__m512 sigma, uint32_t level, uint32_t numLevels)
+	{
+		const auto a = _mm512_div_ps(_mm512_set1_ps(-1.0f),
+			_mm512_mul_ps(_mm512_set1_ps(PI), _mm512_mul_ps(sigma, sigma)));
+
+		auto g0 = Exp(_mm512_mul_ps(a, _mm512_set1_ps(0.5f)));
+		auto wsum = _mm512_setzero_ps(), weight = _mm512_setzero_ps();
+		for (auto i = level; i < numLevels; ++i)
+		{
+			const auto g1 = Exp(_mm512_mul_ps(a, _mm512_set1_ps(ldexpf(1.0f, 2 * i + 1))));
+			const auto w = _mm512_mul_ps(_mm512_set1_ps(ldexpf(1.0f, 2 * i)), _mm512_sub_ps(g0, g1));
+			weight = i == level ? w : weight;
+			wsum = _mm512_add_ps(wsum, w);
+			g0 = g1;
+		}
+
+		const auto mask = _mm512_cmp_ps_mask(wsum, _mm512_setzero_ps(), _CMP_GT_OQ);
+
+		return _mm512_mask_div_ps(_mm512_set1_ps(1.0f), mask, weight, wsum);
+	}
+}
+
+void Kernel::ResampleRow2xAVX512(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+	uint32_t x0, uint32_t x1, uint32_t dstWidth)
+{
+	auto x = x0;
+	for (; x + 8 <= x1; x += 8) Store(&pDst[x * PixelSize], Box2x(pSrcRows, x));
+
+	ResampleRow2x(pDst, pSrcRows, x, x1, dstWidth);
+}
+
+void Kernel::ResampleRowHQ2xAVX512(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+	uint32_t x0, uint32_t x1, uint32_t dstWidth)
+{
+	ResampleRowHQ2xChunked<8, 8>(pDst, pSrcRows, x0, x1, dstWidth, VerticalHQ2x,
+		[](uint8_t *pDst, const uint16_t *ve, const uint16_t *vo, const uint16_t *wp)
+	{
+		Store(pDst, HorizontalHQ2x(ve, vo, wp));
+	});
+}
+
+void Kernel::UpSampleWeightsAVX512(float *pWeights, const float *pSigmas,
+	uint32_t n, uint32_t level, uint32_t numLevels)
+{
+	auto i = 0u;
+	for (; i + 16 <= n; i += 16)
+		_mm512_storeu_ps(&pWeights[i], LerpFactor(_mm512_loadu_ps(&pSigmas[i]), level, numLevels));
+
+	if (i < n)
+	{
+		const auto mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+		_mm512_mask_storeu_ps(&pWeights[i], mask, LerpFactor(
+			_mm512_maskz_loadu_ps(mask, &pSigmas[i]), level, numLevels));
+	}
+}
+
+#endif
@@ -0,0 +1,227 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPUKernel.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_KERNEL_X86
+#endif
+
+// Per-ISA row kernels, selected at run time by CPUKernel.cpp. The resample
+// variants produce bit-identical results to the scalar integer path; the
+// up-sample weights are within the error bound documented below.
+namespace CPU
+{
+	namespace Kernel
+	{
+		// Exact 2x reduction of CSResample.hlsl. pSrcRows holds the source rows
+		// 2y - 1, 2y, 2y + 1 and 2y + 2 (clamped); [x0, x1) is in destination texels.
+		using ResampleRowFunc = void (*)(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+			uint32_t x0, uint32_t x1, uint32_t dstWidth);
+
+		// Lerp factors of CSUpSample.hlsl for n texels of the given (radial) sigmas
+		using UpSampleWeightFunc = void (*)(float *pWeights, const float *pSigmas,
+			uint32_t n, uint32_t level, uint32_t numLevels);
+
+		// Conversions between n channels of R16G16B16A16_FLOAT, in [0, 1], and floats
+		// in [0, 255] as the 8-bit path computes them; rounding is to nearest even
+		using LoadHalfFunc = void (*)(float *pDst, const uint16_t *pSrc, uint32_t n);
+		using StoreHalfFunc = void (*)(uint16_t *pDst, const float *pSrc, uint32_t n);
+
+		// Buffer of vertical sums consumed by the horizontal pass of the 5-tap filter
+		static const uint32_t ResampleChunkSize = 512;
+
+		// Texels of which the up-sample kernel evaluates sigmas and weights at a time
+		static const uint32_t UpSampleChunkSize = 256;
+
+		void ResampleRow2x(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+			uint32_t x0, uint32_t x1, uint32_t dstWidth);
+		void ResampleRowHQ2x(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+			uint32_t x0, uint32_t x1, uint32_t dstWidth);
+		void UpSampleWeights(float *pWeights, const float *pSigmas,
+			uint32_t n, uint32_t level, uint32_t numLevels);
+		void LoadHalfs(float *pDst, const uint16_t *pSrc, uint32_t n);
+		void StoreHalfs(uint16_t *pDst, const float *pSrc, uint32_t n);
+
+#ifdef CPU_KERNEL_X86
+		void ResampleRow2xSSE41(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+			uint32_t x0, uint32_t x1, uint32_t dstWidth);
+		void ResampleRowHQ2xSSE41(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+			uint32_t x0, uint32_t x1, uint32_t dstWidth);
+		void UpSampleWeightsSSE41(float *pWeights, const float *pSigmas,
+			uint32_t n, uint32_t level, uint32_t numLevels);
+
+		void ResampleRow2xAVX2(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+			uint32_t x0, uint32_t x1, uint32_t dstWidth);
+		void ResampleRowHQ2xAVX2(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+			uint32_t x0, uint32_t x1, uint32_t dstWidth);
+		void UpSampleWeightsAVX2(float *pWeights, const float *pSigmas,
+			uint32_t n, uint32_t level, uint32_t numLevels);
+		void LoadHalfsAVX2(float *pDst, const uint16_t *pSrc, uint32_t n);	// With F16C
+		void StoreHalfsAVX2(uint16_t *pDst, const float *pSrc, uint32_t n);
+
+		void ResampleRow2xAVX512(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+			uint32_t x0, uint32_t x1, uint32_t dstWidth);
+		void ResampleRowHQ2xAVX512(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+			uint32_t x0, uint32_t x1, uint32_t dstWidth);
+		void UpSampleWeightsAVX512(float *pWeights, const float *pSigmas,
+			uint32_t n, uint32_t level, uint32_t numLevels);
+#endif
+
+		//--------------------------------------------------------------------------------------
+		// Vectorized exp() of the up-sample weights (Cephes expf). With x = n ln2 + r,
+		// |r| <= ln2 / 2, e^x = 2^n (1 + r + r^2 P(r)). For x in [FastExpMin, 0] the
+		// relative error against the exact exponential is below 1.02 ulp (8.6e-8),
+		// checked on every float in the range; x < FastExpMin, where expf() turns
+		// denormal, returns 0. Inputs must not be positive. The Gaussian terms of
+		// CSUpSample.hlsl are differences of such values, so the lerp factors are
+		// within 3.2e-5 of the expf() path for sigmas up to 64, which is the error
+		// of the single-precision reference itself and 1/100 of an 8-bit step.
+		//--------------------------------------------------------------------------------------
+		static const float FastExpMin = -87.3365448f;	// ln(FLT_MIN)
+		static const float FastExpLog2E = 1.44269504088896341f;
+		static const float FastExpLn2Hi = 0.693359375f;
+		static const float FastExpLn2Lo = -2.12194440e-4f;
+		static const float FastExpP[] =
+		{
+			1.9875691500e-4f,
+			1.3981999507e-3f,
+			8.3334519073e-3f,
+			4.1665795894e-2f,
+			1.6666665459e-1f,
+			5.0000001201e-1f
+		};
+
+		//--------------------------------------------------------------------------------------
+		// Scalar half-float conversions, bit-identical to F16C (VCVTPH2PS, and
+		// VCVTPS2PH with round to nearest even); NaNs become quiet NaNs.
+		//--------------------------------------------------------------------------------------
+		static inline float HalfToFloat(uint16_t h)
+		{
+			const uint32_t shiftedExp = 0x7c00u << 13;
+			uint32_t u = (h & 0x7fffu) << 13;
+			const auto exp = u & shiftedExp;
+			u += (127 - 15) << 23;
+			if (exp == shiftedExp) u += (128 - 16) << 23;	// Inf or NaN
+			else if (exp == 0)	// Zero or denormal, renormalized by the FPU
+			{
+				u += 1 << 23;
+				float f;
+				memcpy(&f, &u, sizeof(float));
+				f -= 6.103515625e-5f;	// 2^-14
+				memcpy(&u, &f, sizeof(float));
+			}
+			u |= static_cast<uint32_t>(h & 0x8000u) << 16;
+
+			float f;
+			memcpy(&f, &u, sizeof(float));
+
+			return f;
+		}
+
+		static inline uint16_t FloatToHalf(float f)
+		{
+			uint32_t u;
+			memcpy(&u, &f, sizeof(float));
+			const auto sign = (u >> 16) & 0x8000u;
+			u &= 0x7fffffffu;
+
+			uint32_t h;
+			if (u >= (127 + 16) << 23) h = u > 0x7f800000u ? 0x7e00u : 0x7c00u;
+			else if (u < 113 << 23)
+			{
+				// Denormal or zero: the addition aligns and rounds the mantissa
+				const uint32_t magicBits = ((127 - 15) + (23 - 10) + 1) << 23;
+				float magic, v;
+				memcpy(&magic, &magicBits, sizeof(float));
+				memcpy(&v, &u, sizeof(float));
+				v += magic;
+				memcpy(&u, &v, sizeof(float));
+				h = u - magicBits;
+			}
+			else
+			{
+				const auto isMantissaOdd = (u >> 13) & 1;
+				u += ((15u - 127u) << 23) + 0xfff + isMantissaOdd;
+				h = u >> 13;
+			}
+
+			return static_cast<uint16_t>(h | sign);
+		}
+
+		//--------------------------------------------------------------------------------------
+		// Shared steps of the 5-tap 2x reduction. With R0..R3 the four source rows,
+		// Vb = R1 + R2 and W = R0 + R1 + R2 + R3 per source texel, the filter is
+		//   N = Vb[2x - 1] + Vb[2x + 2] + 3 * (Vb[2x] + Vb[2x + 1]) + W[2x] + W[2x + 1]
+		// and the result is (N + 12) / 24. The vertical step stores Vb split into even
+		// (ve) and odd (vo) texels, and the pair sum of W (wp), 4 channels per texel.
+		// These are static so that each ISA translation unit keeps its own copy.
+		//--------------------------------------------------------------------------------------
+		static inline void ResampleVerticalHQ2x(uint16_t *ve, uint16_t *vo, uint16_t *wp,
+			const uint8_t *const pSrcRows[4], uint32_t x)
+		{
+			for (auto c = 0u; c < PixelSize; ++c)
+			{
+				const auto i = 2 * x * PixelSize + c;
+				const auto j = i + PixelSize;
+				ve[c] = static_cast<uint16_t>(pSrcRows[1][i] + pSrcRows[2][i]);
+				vo[c] = static_cast<uint16_t>(pSrcRows[1][j] + pSrcRows[2][j]);
+				wp[c] = static_cast<uint16_t>(ve[c] + vo[c] + pSrcRows[0][i] + pSrcRows[3][i] +
+					pSrcRows[0][j] + pSrcRows[3][j]);
+			}
+		}
+
+		static inline void ResampleHorizontalHQ2x(uint8_t *pDst, const uint16_t *ve,
+			const uint16_t *vo, const uint16_t *wp)
+		{
+			for (auto c = 0u; c < PixelSize; ++c)
+			{
+				const auto n = (vo - PixelSize)[c] + (ve + PixelSize)[c] + 3 * (ve[c] + vo[c]) + wp[c];
+				pDst[c] = static_cast<uint8_t>((n + 12) / 24);
+			}
+		}
+
+		// Runs the two steps over [x0, x1) in chunks that stay resident in L1. The
+		// vertical sums cover one extra texel on either side, replicated at the edges.
+		template<uint32_t VStep, uint32_t HStep, typename VerticalFunc, typename HorizontalFunc>
+		static inline void ResampleRowHQ2xChunked(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+			uint32_t x0, uint32_t x1, uint32_t dstWidth, VerticalFunc vertical, HorizontalFunc horizontal)
+		{
+			alignas(64) uint16_t ve[(ResampleChunkSize + 2) * PixelSize];
+			alignas(64) uint16_t vo[(ResampleChunkSize + 2) * PixelSize];
+			alignas(64) uint16_t wp[(ResampleChunkSize + 2) * PixelSize];
+
+			for (auto xs = x0; xs < x1; xs += ResampleChunkSize)
+			{
+				const auto xe = (std::min)(xs + ResampleChunkSize, x1);
+
+				// Buffer element of texel x is x - xs + 1
+				const auto b0 = xs > 0 ? xs - 1 : 0u;
+				const auto b1 = (std::min)(xe + 1, dstWidth);
+				auto x = b0;
+				for (; x + VStep <= b1; x += VStep)
+					vertical(&ve[(x + 1 - xs) * PixelSize], &vo[(x + 1 - xs) * PixelSize],
+						&wp[(x + 1 - xs) * PixelSize], pSrcRows, x);
+				for (; x < b1; ++x)
+					ResampleVerticalHQ2x(&ve[(x + 1 - xs) * PixelSize], &vo[(x + 1 - xs) * PixelSize],
+						&wp[(x + 1 - xs) * PixelSize], pSrcRows, x);
+
+				// Clamp to edge
+				if (xs == 0) memcpy(vo, &ve[PixelSize], sizeof(uint16_t) * PixelSize);
+				if (xe == dstWidth) memcpy(&ve[(xe + 1 - xs) * PixelSize],
+					&vo[(xe - xs) * PixelSize], sizeof(uint16_t) * PixelSize);
+
+				x = xs;
+				for (; x + HStep <= xe; x += HStep)
+					horizontal(&pDst[x * PixelSize], &ve[(x + 1 - xs) * PixelSize],
+						&vo[(x + 1 - xs) * PixelSize], &wp[(x + 1 - xs) * PixelSize]);
+				for (; x < xe; ++x)
+					ResampleHorizontalHQ2x(&pDst[x * PixelSize], &ve[(x + 1 - xs) * PixelSize],
+						&vo[(x + 1 - xs) * PixelSize], &wp[(x + 1 - xs) * PixelSize]);
+			}
+		}
+	}
+}
@@ -0,0 +1,143 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "CPUKernelISA.h"
+
+#ifdef CPU_KERNEL_X86
+
+#include <smmintrin.h>
+#include "CPUMipGaussian.h"
+
+using namespace std;
+using namespace CPU;
+
+namespace
+{
+	// Loads 4 source texels (2 destination texels) and splits them into even and
+	// odd texels widened to 16 bits
+	inline void LoadEvenOdd(__m128i &even, __m128i &odd, const uint8_t *pSrc)
+	{
+		const auto v = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc)),
+			_MM_SHUFFLE(3, 1, 2, 0));
+		even = _mm_cvtepu8_epi16(v);
+		odd = _mm_cvtepu8_epi16(_mm_srli_si128(v, 8));
+	}
+
+	// 2 destination texels of the 2x2 box
+	inline __m128i Box2x(const uint8_t *const pSrcRows[4], uint32_t x)
+	{
+		__m128i e1, o1, e2, o2;
+		LoadEvenOdd(e1, o1, &pSrcRows[1][2 * x * PixelSize]);
+		LoadEvenOdd(e2, o2, &pSrcRows[2][2 * x * PixelSize]);
+		const auto n = _mm_add_epi16(_mm_add_epi16(e1, o1), _mm_add_epi16(e2, o2));
+
+		return _mm_srli_epi16(_mm_add_epi16(n, _mm_set1_epi16(2)), 2);
+	}
+
+	inline void VerticalHQ2x(uint16_t *ve, uint16_t *vo, uint16_t *wp,
+		const uint8_t *const pSrcRows[4], uint32_t x)
+	{
+		__m128i e[4], o[4];
+		for (auto i = 0u; i < 4; ++i) LoadEvenOdd(e[i], o[i], &pSrcRows[i][2 * x * PixelSize]);
+
+		const auto vbe = _mm_add_epi16(e[1], e[2]);
+		const auto vbo = _mm_add_epi16(o[1], o[2]);
+		const auto w = _mm_add_epi16(_mm_add_epi16(vbe, vbo),
+			_mm_add_epi16(_mm_add_epi16(e[0], e[3]), _mm_add_epi16(o[0], o[3])));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(ve), vbe);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(vo), vbo);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(wp), w);
+	}
+
+	// 2 destination texels of (N + 12) / 24, with the division as (n >> 3) * 21846 >> 16,
+	// exact for n < 6144
+	inline __m128i HorizontalHQ2x(const uint16_t *ve, const uint16_t *vo, const uint16_t *wp)
+	{
+		const auto load = [](const uint16_t *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); };
+		const auto s = _mm_add_epi16(load(ve), load(vo));
+		auto n = _mm_add_epi16(load(vo - PixelSize), load(ve + PixelSize));
+		n = _mm_add_epi16(n, _mm_add_epi16(s, _mm_slli_epi16(s, 1)));
+		n = _mm_add_epi16(n, _mm_add_epi16(load(wp), _mm_set1_epi16(12)));
+
+		return _mm_mulhi_epu16(_mm_srli_epi16(n, 3), _mm_set1_epi16(21846));
+	}
+
+	// See FastExpP in CPUKernelISA.h
+	inline __m128 Exp(__m128 x)
+	{
+		const auto n = _mm_round_ps(_mm_mul_ps(x, _mm_set1_ps(Kernel::FastExpLog2E)),
+			_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		auto r = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(Kernel::FastExpLn2Hi)));
+		r = _mm_sub_ps(r, _mm_mul_ps(n, _mm_set1_ps(Kernel::FastExpLn2Lo)));
+
+		auto p = _mm_set1_ps(Kernel::FastExpP[0]);
+		for (auto i = 1u; i < 6; ++i) p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(Kernel::FastExpP[i]));
+		p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, r), r), r), _mm_set1_ps(1.0f));
+
+		const auto scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23));
+
+		return _mm_and_ps(_mm_mul_ps(p, scale), _mm_cmpge_ps(x, _mm_set1_ps(Kernel::FastExpMin)));
+	}
+
+	// 4 lerp factors, evaluated as UpSampleWeight() in CPUMipGaussian.h
+	inline __m128 LerpFactor(__m128 sigma, uint32_t level, uint32_t numLevels)
+	{
+		// -2^(2 mip - 1) / (PI sigma^2) is exactly 2^(2 mip - 1) * a
+		const auto a = _mm_div_ps(_mm_set1_ps(-1.0f), _mm_mul_ps(_mm_set1_ps(PI), _mm_mul_ps(sigma, sigma)));
+
+		auto g0 = Exp(_mm_mul_ps(a, _mm_set1_ps(0.5f)));
+		auto wsum = _mm_setzero_ps(), weight = _mm_setzero_ps();
+		for (auto i = level; i < numLevels; ++i)
+		{
+			const auto g1 = Exp(_mm_mul_ps(a, _mm_set1_ps(ldexpf(1.0f, 2 * i + 1))));
+			const auto w = _mm_mul_ps(_mm_set1_ps(ldexpf(1.0f, 2 * i)), _mm_sub_ps(g0, g1));
+			weight = i == level ? w : weight;
+			wsum = _mm_add_ps(wsum, w);
+			g0 = g1;
+		}
+
+		return _mm_blendv_ps(_mm_set1_ps(1.0f), _mm_div_ps(weight, wsum), _mm_cmpgt_ps(wsum, _mm_setzero_ps()));
+	}
+}
+
+void Kernel::ResampleRow2xSSE41(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+	uint32_t x0, uint32_t x1, uint32_t dstWidth)
+{
+	auto x = x0;
+	for (; x + 4 <= x1; x += 4)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&pDst[x * PixelSize]),
+			_mm_packus_epi16(Box2x(pSrcRows, x), Box2x(pSrcRows, x + 2)));
+
+	ResampleRow2x(pDst, pSrcRows, x, x1, dstWidth);
+}
+
+void Kernel::ResampleRowHQ2xSSE41(uint8_t *pDst, const uint8_t *const pSrcRows[4],
+	uint32_t x0, uint32_t x1, uint32_t dstWidth)
+{
+	ResampleRowHQ2xChunked<2, 4>(pDst, pSrcRows, x0, x1, dstWidth, VerticalHQ2x,
+		[](uint8_t *pDst, const uint16_t *ve, const uint16_t *vo, const uint16_t *wp)
+	{
+		const auto lo = HorizontalHQ2x(ve, vo, wp);
+		const auto hi = HorizontalHQ2x(ve + 2 * PixelSize, vo + 2 * PixelSize, wp + 2 * PixelSize);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pDst), _mm_packus_epi16(lo, hi));
+	});
+}
+
+void Kernel::UpSampleWeightsSSE41(float *pWeights, const float *pSigmas,
+	uint32_t n, uint32_t level, uint32_t numLevels)
+{
+	auto i = 0u;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(&pWeights[i], LerpFactor(_mm_loadu_ps(&pSigmas[i]), level, numLevels));
+
+	if (i < n)
+	{
+		float sigmas[4] = {}, weights[4];
+		memcpy(sigmas, &pSigmas[i], sizeof(float) * (n - i));
+		_mm_storeu_ps(weights, LerpFactor(_mm_loadu_ps(sigmas), level, numLevels));
+		memcpy(&pWeights[i], weights, sizeof(float) * (n - i));
+	}
+}
+
+#endif
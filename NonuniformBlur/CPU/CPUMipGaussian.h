@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPUType.h"
+
+// CPU mirror of CSMipGaussian.hlsli. Everything is evaluated in single precision,
+// as on the GPU, so the CPU engine stays comparable with the compute shaders.
+namespace CPU
+{
+	static const float PI = 3.141592654f;
+
+	inline float GaussianExp(float sigma2, float mip)
+	{
+		return -exp2f(2.0f * mip - 1.0f) / (PI * sigma2);
+	}
+
+	inline float GaussianBasis(float sigma2, float mip)
+	{
+		return mip < 0.0f ? 0.0f : expf(GaussianExp(sigma2, mip));
+	}
+
+	inline float MipGaussianWeight(uint32_t mip, float gx, float gy)
+	{
+		return ldexpf(1.0f, 2 * mip) * (gx - gy);
+	}
+
+	inline float MipWeight(float sigma2, uint32_t mip, int mipStep = 1)
+	{
+		const float g[] =
+		{
+			GaussianBasis(sigma2, static_cast<float>(mip)),
+			GaussianBasis(sigma2, mipStep > 0 ? static_cast<float>(mip + mipStep) : -1.0f)
+		};
+
+		return MipGaussianWeight(mip, g[0], g[1]);
+	}
+
+	// Lerp factor between the current level and the resolved coarser level,
+	// evaluated exactly as the loop in CSUpSample.hlsl
+	inline float UpSampleWeight(float sigma2, uint32_t level, uint32_t numLevels)
+	{
+		float g[] = { GaussianBasis(sigma2, 0.0f), 0.0f };
+		auto wsum = 0.0f, weight = 0.0f;
+		for (auto i = level; i < numLevels; ++i)
+		{
+			// Compute next term
+			g[1] = GaussianBasis(sigma2, i + 1.0f);
+
+			const auto w = MipGaussianWeight(i, g[0], g[1]);
+			weight = i == level ? w : weight;
+			wsum += w;
+
+			// For next iteration
+			g[0] = g[1];
+		}
+
+		return wsum > 0.0f ? weight / wsum : 1.0f;
+	}
+}
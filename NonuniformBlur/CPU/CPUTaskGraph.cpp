@@ -0,0 +1,80 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include <cassert>
+#include "CPUTaskGraph.h"
+
+using namespace std;
+using namespace CPU;
+
+TaskGraph::TaskGraph() :
+	m_nodes(0),
+	m_pending(nullptr),
+	m_numCompleted(0)
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+}
+
+uint32_t TaskGraph::AddTask(Task &&task)
+{
+	m_nodes.push_back({ move(task), vector<uint32_t>(0), 0 });
+	m_pending.reset();
+
+	return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+void TaskGraph::AddDependency(uint32_t task, uint32_t dependency)
+{
+	assert(dependency < task && task < m_nodes.size());
+	m_nodes[dependency].Dependents.push_back(task);
+	++m_nodes[task].NumDependencies;
+}
+
+void TaskGraph::Clear()
+{
+	m_nodes.clear();
+	m_pending.reset();
+}
+
+void TaskGraph::Execute(ThreadPool *pThreadPool)
+{
+	const auto numTasks = static_cast<uint32_t>(m_nodes.size());
+	if (!pThreadPool || pThreadPool->GetNumThreads() <= 1)
+	{
+		for (const auto &node : m_nodes) node.Func();
+
+		return;
+	}
+
+	if (!m_pending) m_pending.reset(new atomic<uint32_t>[numTasks]);
+	for (auto i = 0u; i < numTasks; ++i) m_pending[i] = m_nodes[i].NumDependencies;
+	m_numCompleted = 0;
+
+	for (auto i = 0u; i < numTasks; ++i)
+		if (m_nodes[i].NumDependencies == 0)
+			pThreadPool->Submit([this, pThreadPool, i]() { run(*pThreadPool, i); });
+
+	pThreadPool->WorkUntil([this, numTasks]() { return m_numCompleted == numTasks; });
+}
+
+uint32_t TaskGraph::GetNumTasks() const
+{
+	return static_cast<uint32_t>(m_nodes.size());
+}
+
+void TaskGraph::run(ThreadPool &threadPool, uint32_t task)
+{
+	const auto &node = m_nodes[task];
+	node.Func();
+
+	// Enable the dependents of which this was the last dependency
+	for (const auto dependent : node.Dependents)
+		if (--m_pending[dependent] == 0)
+			threadPool.Submit([this, &threadPool, dependent]() { run(threadPool, dependent); });
+
+	++m_numCompleted;
+}
@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPUThreadPool.h"
+
+namespace CPU
+{
+	//--------------------------------------------------------------------------------------
+	// Static graph of tasks with explicit dependencies. A task is scheduled as soon
+	// as all of its dependencies have finished, so there are no pass-wide barriers.
+	// Dependencies always point to earlier tasks, hence the insertion order is a
+	// valid serial schedule. A graph can be executed any number of times.
+	//--------------------------------------------------------------------------------------
+	class TaskGraph
+	{
+	public:
+		using Task = std::function<void()>;
+
+		TaskGraph();
+		virtual ~TaskGraph();
+
+		uint32_t AddTask(Task &&task);
+		void AddDependency(uint32_t task, uint32_t dependency);	// dependency < task
+		void Clear();
+
+		// Runs every task on the thread pool, or serially without one
+		void Execute(ThreadPool *pThreadPool = nullptr);
+
+		uint32_t GetNumTasks() const;
+
+	protected:
+		struct Node
+		{
+			Task					Func;
+			std::vector<uint32_t>	Dependents;
+			uint32_t				NumDependencies;
+		};
+
+		void run(ThreadPool &threadPool, uint32_t task);
+
+		std::vector<Node>		m_nodes;
+		std::unique_ptr<std::atomic<uint32_t>[]> m_pending;
+		std::atomic<uint32_t>	m_numCompleted;
+	};
+}
@@ -0,0 +1,124 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "CPUTexture.h"
+
+using namespace std;
+using namespace CPU;
+
+// Row pitches are kept at cache-line granularity for the row kernels
+static const uint32_t RowAlignment = 64;
+
+Texture2D::Texture2D() :
+	m_data(0),
+	m_levels(0)
+{
+}
+
+Texture2D::~Texture2D()
+{
+}
+
+bool Texture2D::Create(uint32_t width, uint32_t height, uint8_t numMips, Format format, Format mipFormat)
+{
+	M_RETURN(width == 0 || height == 0 || numMips == 0, cerr, "Invalid texture dimensions.", false);
+	M_RETURN(format >= NUM_FORMAT || mipFormat >= NUM_FORMAT, cerr, "Invalid texture format.", false);
+
+	// Compute the layout of all levels
+	size_t size = 0;
+	m_levels.resize(numMips);
+	for (auto i = 0u; i < numMips; ++i)
+	{
+		auto &level = m_levels[i];
+		level.pData = nullptr;
+		level.Width = (max)(width >> i, 1u);
+		level.Height = (max)(height >> i, 1u);
+		level.TexelFormat = i > 0 ? mipFormat : format;
+		level.RowPitch = (level.Width * GetTexelSize(level.TexelFormat) + RowAlignment - 1) / RowAlignment * RowAlignment;
+		level.NumRows = level.Height;
+		size += static_cast<size_t>(level.RowPitch) * level.Height;
+	}
+
+	m_data.assign(size, 0);
+
+	// Set data pointers
+	auto pData = m_data.data();
+	for (auto &level : m_levels)
+	{
+		level.pData = pData;
+		pData += static_cast<size_t>(level.RowPitch) * level.Height;
+	}
+
+	return true;
+}
+
+bool Texture2D::Upload(const void *pData, uint32_t rowPitch, uint8_t level)
+{
+	N_RETURN(pData && level < m_levels.size(), false);
+
+	const auto &surface = m_levels[level];
+	const auto rowSize = surface.Width * GetTexelSize(surface.TexelFormat);
+	rowPitch = rowPitch ? rowPitch : rowSize;
+
+	const auto pSrc = static_cast<const uint8_t*>(pData);
+	for (auto y = 0u; y < surface.Height; ++y)
+		memcpy(surface.GetRow(y), &pSrc[static_cast<size_t>(rowPitch) * y], rowSize);
+
+	return true;
+}
+
+bool Texture2D::Upload(const Rect &rect, const void *pData, uint32_t rowPitch, uint8_t level)
+{
+	N_RETURN(pData && level < m_levels.size(), false);
+
+	const auto &surface = m_levels[level];
+	N_RETURN(rect.Left <= rect.Right && rect.Right <= surface.Width &&
+		rect.Top <= rect.Bottom && rect.Bottom <= surface.Height, false);
+
+	const auto texelSize = GetTexelSize(surface.TexelFormat);
+	const auto rowSize = (rect.Right - rect.Left) * texelSize;
+	rowPitch = rowPitch ? rowPitch : rowSize;
+
+	const auto pSrc = static_cast<const uint8_t*>(pData);
+	for (auto y = rect.Top; y < rect.Bottom; ++y)
+		memcpy(&surface.GetRow(y)[rect.Left * texelSize],
+			&pSrc[static_cast<size_t>(rowPitch) * (y - rect.Top)], rowSize);
+
+	return true;
+}
+
+bool Texture2D::Readback(void *pData, uint32_t rowPitch, uint8_t level) const
+{
+	N_RETURN(pData && level < m_levels.size(), false);
+
+	const auto &surface = m_levels[level];
+	const auto rowSize = surface.Width * GetTexelSize(surface.TexelFormat);
+	rowPitch = rowPitch ? rowPitch : rowSize;
+
+	const auto pDst = static_cast<uint8_t*>(pData);
+	for (auto y = 0u; y < surface.Height; ++y)
+		memcpy(&pDst[static_cast<size_t>(rowPitch) * y], surface.GetRow(y), rowSize);
+
+	return true;
+}
+
+const Surface &Texture2D::GetSurface(uint8_t level) const
+{
+	return m_levels[level];
+}
+
+uint32_t Texture2D::GetWidth(uint8_t level) const
+{
+	return m_levels[level].Width;
+}
+
+uint32_t Texture2D::GetHeight(uint8_t level) const
+{
+	return m_levels[level].Height;
+}
+
+uint8_t Texture2D::GetNumMips() const
+{
+	return static_cast<uint8_t>(m_levels.size());
+}
@@ -0,0 +1,36 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPUType.h"
+
+namespace CPU
+{
+	//--------------------------------------------------------------------------------------
+	// 2D Texture with a full mip chain in system memory
+	//--------------------------------------------------------------------------------------
+	class Texture2D
+	{
+	public:
+		Texture2D();
+		virtual ~Texture2D();
+
+		// The first level is of format and the others of mipFormat
+		bool Create(uint32_t width, uint32_t height, uint8_t numMips = 1,
+			Format format = FORMAT_B8G8R8A8_UNORM, Format mipFormat = FORMAT_B8G8R8A8_UNORM);
+		bool Upload(const void *pData, uint32_t rowPitch = 0, uint8_t level = 0);
+		bool Upload(const Rect &rect, const void *pData, uint32_t rowPitch = 0, uint8_t level = 0);	// pData holds rect alone
+		bool Readback(void *pData, uint32_t rowPitch = 0, uint8_t level = 0) const;
+
+		const Surface &GetSurface(uint8_t level = 0) const;
+		uint32_t	GetWidth(uint8_t level = 0) const;
+		uint32_t	GetHeight(uint8_t level = 0) const;
+		uint8_t		GetNumMips() const;
+
+	protected:
+		std::vector<uint8_t> m_data;
+		std::vector<Surface> m_levels;
+	};
+}
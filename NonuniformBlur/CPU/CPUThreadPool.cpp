@@ -0,0 +1,164 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "CPUThreadPool.h"
+
+using namespace std;
+using namespace CPU;
+
+// The pool and queue of the running worker thread
+static thread_local const ThreadPool *t_pPool = nullptr;
+static thread_local uint32_t t_queueIndex = 0;
+
+ThreadPool::ThreadPool() :
+	m_workers(0),
+	m_queues(nullptr),
+	m_numQueues(0),
+	m_numQueued(0),
+	m_nextQueue(0),
+	m_stop(false)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+	Destroy();
+}
+
+bool ThreadPool::Create(uint32_t numThreads)
+{
+	Destroy();
+
+	numThreads = numThreads > 0 ? numThreads : (max)(thread::hardware_concurrency(), 1u);
+	const auto numWorkers = numThreads - 1;
+
+	m_numQueues = numWorkers + 1;
+	m_queues.reset(new Queue[m_numQueues]);
+	m_numQueued = 0;
+	m_stop = false;
+
+	m_workers.reserve(numWorkers);
+	for (auto i = 0u; i < numWorkers; ++i)
+		m_workers.emplace_back(&ThreadPool::workerMain, this, i);
+
+	return true;
+}
+
+void ThreadPool::Destroy()
+{
+	{
+		lock_guard<mutex> lock(m_sleepMutex);
+		m_stop = true;
+	}
+	m_wakeUp.notify_all();
+
+	for (auto &worker : m_workers) worker.join();
+	m_workers.clear();
+	m_queues.reset();
+	m_numQueues = 0;
+}
+
+void ThreadPool::Submit(Task &&task)
+{
+	// Without any queue, run in place
+	if (m_numQueues == 0)
+	{
+		task();
+		return;
+	}
+
+	auto &queue = m_queues[t_pPool == this ? t_queueIndex : m_numQueues - 1];
+	{
+		lock_guard<mutex> lock(queue.Mutex);
+		queue.Tasks.push_back(move(task));
+	}
+
+	++m_numQueued;
+	{
+		lock_guard<mutex> lock(m_sleepMutex);
+	}
+	m_wakeUp.notify_one();
+}
+
+void ThreadPool::WorkUntil(const function<bool()> &isDone)
+{
+	const auto index = t_pPool == this ? t_queueIndex : m_numQueues - 1;
+
+	Task task;
+	while (!isDone())
+	{
+		if (m_numQueues > 0 && (popTask(task, index) || stealTask(task, index))) task();
+		else this_thread::yield();
+	}
+}
+
+uint32_t ThreadPool::GetNumThreads() const
+{
+	return (max)(m_numQueues, 1u);
+}
+
+void ThreadPool::workerMain(uint32_t index)
+{
+	t_pPool = this;
+	t_queueIndex = index;
+
+	Task task;
+	while (true)
+	{
+		if (popTask(task, index) || stealTask(task, index))
+		{
+			task();
+			continue;
+		}
+
+		unique_lock<mutex> lock(m_sleepMutex);
+		m_wakeUp.wait(lock, [this]() { return m_stop || m_numQueued > 0; });
+		if (m_stop) return;
+	}
+}
+
+bool ThreadPool::popTask(Task &task, uint32_t index)
+{
+	auto &queue = m_queues[index];
+	lock_guard<mutex> lock(queue.Mutex);
+	C_RETURN(queue.Tasks.empty(), false);
+
+	// Workers take their newest task, the shared queue is served in order
+	if (index + 1 < m_numQueues)
+	{
+		task = move(queue.Tasks.back());
+		queue.Tasks.pop_back();
+	}
+	else
+	{
+		task = move(queue.Tasks.front());
+		queue.Tasks.pop_front();
+	}
+	--m_numQueued;
+
+	return true;
+}
+
+bool ThreadPool::stealTask(Task &task, uint32_t index)
+{
+	// Start at a different victim each time to spread the contention
+	const auto offset = m_nextQueue++;
+	for (auto i = 0u; i < m_numQueues; ++i)
+	{
+		const auto victim = (offset + i) % m_numQueues;
+		if (victim == index) continue;
+
+		auto &queue = m_queues[victim];
+		lock_guard<mutex> lock(queue.Mutex);
+		if (queue.Tasks.empty()) continue;
+
+		task = move(queue.Tasks.front());
+		queue.Tasks.pop_front();
+		--m_numQueued;
+
+		return true;
+	}
+
+	return false;
+}
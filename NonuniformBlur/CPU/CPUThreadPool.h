@@ -0,0 +1,64 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "CPUType.h"
+
+namespace CPU
+{
+	//--------------------------------------------------------------------------------------
+	// Work-stealing thread pool. Every worker owns a deque: tasks submitted from a
+	// worker go to the back of its own deque and are popped from there (LIFO, so
+	// freshly enabled work runs while its inputs are still in cache), and idle
+	// workers steal from the front of the others. Threads outside the pool submit
+	// to a shared queue and join the work while they wait.
+	//--------------------------------------------------------------------------------------
+	class ThreadPool
+	{
+	public:
+		using Task = std::function<void()>;
+
+		ThreadPool();
+		virtual ~ThreadPool();
+
+		// numThreads counts the waiting caller; 0 uses every hardware thread
+		bool Create(uint32_t numThreads = 0);
+		void Destroy();
+
+		void Submit(Task &&task);
+
+		// Runs queued tasks on the calling thread until isDone() returns true
+		void WorkUntil(const std::function<bool()> &isDone);
+
+		uint32_t GetNumThreads() const;
+
+	protected:
+		struct Queue
+		{
+			std::mutex			Mutex;
+			std::deque<Task>	Tasks;
+		};
+
+		void workerMain(uint32_t index);
+		bool popTask(Task &task, uint32_t index);
+		bool stealTask(Task &task, uint32_t index);
+
+		std::vector<std::thread>			m_workers;
+		std::unique_ptr<Queue[]>			m_queues;	// One per worker, plus the shared queue
+		uint32_t							m_numQueues;
+
+		std::mutex					m_sleepMutex;
+		std::condition_variable		m_wakeUp;
+		std::atomic<uint32_t>		m_numQueued;
+		std::atomic<uint32_t>		m_nextQueue;
+		bool						m_stop;
+	};
+}
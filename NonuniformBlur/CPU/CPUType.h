@@ -0,0 +1,76 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+// Same control-flow helpers as XUSGType.h, without any Windows dependency
+#ifndef C_RETURN
+#define M_RETURN(x, o, m, r)	if (x) { o << m << std::endl; return r; }
+#define C_RETURN(x, r)			if (x) return r
+#define N_RETURN(x, r)			C_RETURN(!(x), r)
+#define X_RETURN(x, f, r)		{ x = f; N_RETURN(x, r); }
+#endif
+
+namespace CPU
+{
+	struct Float2
+	{
+		float x;
+		float y;
+	};
+
+	// Texels [Left, Right) x [Top, Bottom) of a level
+	struct Rect
+	{
+		uint32_t Left;
+		uint32_t Top;
+		uint32_t Right;
+		uint32_t Bottom;
+	};
+
+	// Texel formats of the levels. The channels keep the order of the B8G8R8A8
+	// texels in every format; the float formats hold them in [0, 1].
+	enum Format : uint8_t
+	{
+		FORMAT_B8G8R8A8_UNORM,
+		FORMAT_R10G10B10A2_UNORM,
+		FORMAT_R16G16B16A16_FLOAT,
+		FORMAT_R32G32B32A32_FLOAT,	// Reference for the others
+
+		NUM_FORMAT
+	};
+
+	// A single mip level of an image, B8G8R8A8 unless TexelFormat says otherwise.
+	// Rows are addressed modulo NumRows, so the same view describes a fully
+	// resident level (NumRows == Height) as well as a rolling band of rows.
+	struct Surface
+	{
+		uint8_t		*pData;
+		uint32_t	Width;
+		uint32_t	Height;
+		uint32_t	RowPitch;
+		uint32_t	NumRows;
+		Format		TexelFormat;
+
+		uint8_t *GetRow(uint32_t y) const { return pData + static_cast<size_t>(y % NumRows) * RowPitch; }
+	};
+
+	// Bytes (and channels) of a B8G8R8A8 texel
+	static const uint32_t PixelSize = 4;
+
+	inline uint32_t GetTexelSize(Format format)
+	{
+		static const uint32_t texelSizes[] = { 4, 4, 8, 16 };
+
+		return format < NUM_FORMAT ? texelSizes[format] : 0;
+	}
+}
@@ -0,0 +1,104 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "CPUWeightTable.h"
+#include "CPUMipGaussian.h"
+
+using namespace std;
+using namespace CPU;
+
+WeightTable::WeightTable() :
+	m_resolution(0),
+	m_numLevels(0),
+	m_maxSigma(0.0f),
+	m_axisScale(0.0f)
+{
+}
+
+WeightTable::~WeightTable()
+{
+}
+
+bool WeightTable::Create(uint32_t numLevels, float maxSigma, uint32_t resolution)
+{
+	M_RETURN(resolution < 2, cerr, "The weight table needs at least 2 entries per level.", false);
+	M_RETURN(!(maxSigma > 0.0f), cerr, "The maximum sigma of the weight table must be positive.", false);
+
+	m_resolution = resolution;
+	m_numLevels = numLevels;
+	m_maxSigma = maxSigma;
+	m_weights.resize(size_t(resolution) * numLevels);
+
+	const auto axisRange = log2f(1.0f + maxSigma);
+	m_axisScale = 1.0f / axisRange;
+	for (auto i = 0u; i < resolution; ++i)
+	{
+		const auto sigma = exp2f(axisRange * i / (resolution - 1)) - 1.0f;
+		for (auto level = 0u; level < numLevels; ++level)
+			m_weights[size_t(level) * resolution + i] = UpSampleWeight(sigma * sigma, level, numLevels);
+	}
+
+	return true;
+}
+
+float WeightTable::Lookup(float sigma, uint32_t level) const
+{
+	return lookup(&m_weights[size_t(level) * m_resolution], sigma);
+}
+
+void WeightTable::Lookup(float *pWeights, const float *pSigmas, uint32_t n, uint32_t level) const
+{
+	const auto pRow = &m_weights[size_t(level) * m_resolution];
+	for (auto i = 0u; i < n; ++i) pWeights[i] = lookup(pRow, pSigmas[i]);
+}
+
+const float *WeightTable::GetData() const
+{
+	return m_weights.data();
+}
+
+uint32_t WeightTable::GetResolution() const
+{
+	return m_resolution;
+}
+
+uint32_t WeightTable::GetNumLevels() const
+{
+	return m_numLevels;
+}
+
+float WeightTable::GetMaxSigma() const
+{
+	return m_maxSigma;
+}
+
+float WeightTable::GetAxisScale() const
+{
+	return m_axisScale;
+}
+
+float WeightTable::GetUpperSigma(float sigma, float maxSigma, uint32_t resolution)
+{
+	// Without a table, the weights are exact at sigma
+	C_RETURN(resolution < 2, sigma);
+
+	// Same addressing as lookup(), and the same sigma as the entry of Create()
+	const auto axisRange = log2f(1.0f + maxSigma);
+	const auto axisScale = 1.0f / axisRange;
+	const auto u = (min)((max)(log2f(1.0f + (max)(sigma, 0.0f)) * axisScale, 0.0f), 1.0f);
+	const auto i = (min)(static_cast<uint32_t>(u * (resolution - 1)), resolution - 2) + 1;
+
+	return exp2f(axisRange * i / (resolution - 1)) - 1.0f;
+}
+
+float WeightTable::lookup(const float *pRow, float sigma) const
+{
+	// Same addressing as the texture fetch in CSUpSample.hlsl
+	const auto u = (min)((max)(log2f(1.0f + (max)(sigma, 0.0f)) * m_axisScale, 0.0f), 1.0f);
+	const auto t = u * (m_resolution - 1);
+	const auto i = (min)(static_cast<uint32_t>(t), m_resolution - 2);
+	const auto w = t - i;
+
+	return pRow[i] + w * (pRow[i + 1] - pRow[i]);
+}
@@ -0,0 +1,50 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "CPUType.h"
+
+namespace CPU
+{
+	// Normalized up-sample weights (weight / wsum of CSUpSample.hlsl) tabulated over
+	// sigma for each level of a mip chain of numLevels levels. Row l holds level l;
+	// entry i of a row is sampled at sigma = 2^(i / (resolution - 1) * log2(1 + maxSigma)) - 1,
+	// so the axis is dense at small sigmas, where the weights change the most. The
+	// data is a flat array for the CPU paths and uploads as a resolution x numLevels
+	// R32_FLOAT texture for the GPU path. With linear interpolation and the default
+	// resolution of 256, lookups are within 1.2e-3 of the exact weights (0.3 of an
+	// 8-bit step) for 12 levels; sigmas above maxSigma are clamped.
+	class WeightTable
+	{
+	public:
+		WeightTable();
+		virtual ~WeightTable();
+
+		bool Create(uint32_t numLevels, float maxSigma = 64.0f, uint32_t resolution = 256);
+
+		float Lookup(float sigma, uint32_t level) const;
+		void Lookup(float *pWeights, const float *pSigmas, uint32_t n, uint32_t level) const;
+
+		const float *GetData() const;
+		uint32_t GetResolution() const;
+		uint32_t GetNumLevels() const;
+		float GetMaxSigma() const;
+		float GetAxisScale() const;	// 1 / log2(1 + maxSigma)
+
+		// Sigma of the entry after the one below sigma, which a lookup of sigma
+		// interpolates with, in a table of maxSigma and resolution
+		static float GetUpperSigma(float sigma, float maxSigma, uint32_t resolution);
+
+	protected:
+		float lookup(const float *pRow, float sigma) const;
+
+		std::vector<float>	m_weights;
+
+		uint32_t	m_resolution;
+		uint32_t	m_numLevels;
+		float		m_maxSigma;
+		float		m_axisScale;
+	};
+}
@@ -1,6 +1,8 @@
 #include "stdafx.h"
+#include <cassert>
 #include "Filter.h"
 #include "Advanced/XUSGDDSLoader.h"
+#include "CPUMipGaussian.h"
 
 using namespace std;
 using namespace DirectX;
@@ -8,7 +10,23 @@ using namespace XUSG;
 
 Filter::Filter(const Device &device) :
 	m_device(device),
-	m_numMips(11)
+	m_barrierScheduler(D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+	m_weightTableResolution(256),
+	m_weightTableMaxSigma(64.0f),
+	m_weightTolerance(0.0f),
+	m_depthTolerance(0.0f),
+	m_maxSigmaScale(1.0f),
+	m_coarseUpSampleSize(0),
+	m_format(DXGI_FORMAT_B8G8R8A8_UNORM),
+	m_numMips(11),
+	m_maxMips(11),
+	m_numTileLevels(0),
+	m_coarseTableLevel(0),
+	m_frameIndex(0),
+	m_isSinglePass(false),
+	m_isPyramidValid(false),
+	m_isPyramidSinglePass(false),
+	m_dirtyRect(0, 0, 0, 0)
 {
 	m_computePipelineCache.SetDevice(device);
 	m_descriptorTableCache.SetDevice(device);
@@ -34,41 +52,119 @@ bool Filter::Init(const CommandList &commandList, uint32_t width, uint32_t heigh
 
 	// Create resources and pipelines
 	const auto viewportSize = static_cast<float>((max)(width, height));
-	m_numMips = static_cast<uint8_t>(log2f(viewportSize) + 1.0f);
+	m_maxMips = static_cast<uint8_t>(log2f(viewportSize) + 1.0f);
+	m_numMips = m_maxMips;
 
+	// Level 0 of the chains is the source and the result, in B8G8R8A8 textures of
+	// their own, as the other formats cannot be copied from the source or to the
+	// back buffer; the chains hold the levels from 1 on
+	const auto numChainMips = static_cast<uint8_t>((max)(m_maxMips - 1, 1));
 	for (auto &image : m_filtered)
-		image.Create(m_device, width, height, DXGI_FORMAT_B8G8R8A8_UNORM, 1,
-			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, m_numMips);
+		N_RETURN(image.Create(m_device, (max)(width >> 1, 1u), (max)(height >> 1, 1u), m_format, 1,
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, numChainMips), false);
+	N_RETURN(m_source.Create(m_device, width, height, DXGI_FORMAT_B8G8R8A8_UNORM), false);
+	N_RETURN(m_result.Create(m_device, width, height, DXGI_FORMAT_B8G8R8A8_UNORM, 1,
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), false);
 
-	N_RETURN(createPipelineLayouts(), false);
-	N_RETURN(createPipelines(), false);
-	N_RETURN(createDescriptorTables(), false);
+	// The single pass reduces the tiles while the levels halve exactly, and
+	// hands the last tile level and the next one to the tail in the scratch buffer
+	const uint8_t numPasses = m_numMips > 0 ? m_numMips - 1 : 0;
+	const auto maxTileLevels = (min)(static_cast<uint8_t>(MaxTileLevels), numPasses);
+	m_numTileLevels = 0;
+	while (m_numTileLevels < maxTileLevels &&
+		(width >> m_numTileLevels) % 2 == 0 && (height >> m_numTileLevels) % 2 == 0)
+		++m_numTileLevels;
 
-	// Copy source
+	if (m_numTileLevels > 0)
 	{
-		const TextureCopyLocation dst(m_filtered[TABLE_DOWN_SAMPLE].GetResource().get(), 0);
-		const TextureCopyLocation src(source->GetResource().get(), 0);
+		const auto numTexels = [width, height](uint8_t level)
+		{
+			return (max)(width >> level, 1u) * (max)(height >> level, 1u);
+		};
+		const auto numTailTexels = m_numTileLevels < numPasses ?
+			numTexels(m_numTileLevels) + numTexels(m_numTileLevels + 1) : 0;
 
-		ResourceBarrier barriers[2];
-		auto numBarriers = m_filtered[TABLE_DOWN_SAMPLE].SetBarrier(barriers, D3D12_RESOURCE_STATE_COPY_DEST, 0, 0);
-		numBarriers = source->SetBarrier(barriers, D3D12_RESOURCE_STATE_COPY_SOURCE, numBarriers, 0);
-		commandList.Barrier(numBarriers, barriers);
+		// Zeroed on creation, as the counter expects; the tail levels are packed
+		// to RGBA8, or RGBA16F for the other formats
+		const auto texelSize = sizeof(uint32_t) * (m_format == DXGI_FORMAT_B8G8R8A8_UNORM ? 1 : 2);
+		N_RETURN(m_singlePassScratch.Create(m_device, sizeof(uint32_t) + texelSize * numTailTexels,
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_HEAP_TYPE_DEFAULT,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, 0), false);
+	}
 
-		commandList.CopyTextureRegion(dst, 0, 0, 0, src);
+	// The coarse up sampling binds every level that fits the groupshared memory
+	m_coarseTableLevel = getCoarseLevel(width, height, MaxCoarseUpSampleSize);
 
-		numBarriers = m_filtered[TABLE_DOWN_SAMPLE].SetBarrier(barriers,
-			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, 0, 0);
-		commandList.Barrier(numBarriers, barriers);
-	}
+	// The levels in use start from the fewest, deepened by Process() as needed
+	m_numMips = getNumMips(0.0f);
+
+	// Normalized up-sample weights, a row per level
+	N_RETURN(m_weights.Create(m_device, m_weightTableResolution, m_maxMips, DXGI_FORMAT_R32_FLOAT), false);
+	uploaders.push_back(nullptr);
+	N_RETURN(uploadWeights(commandList, uploaders.back()), false);
+
+	N_RETURN(createPipelineLayouts(), false);
+	N_RETURN(createPipelines(), false);
+	N_RETURN(createDescriptorTables(), false);
+
+	copySource(commandList, source);
+	InvalidateSource();
 
 	return true;
 }
 
 void Filter::Process(const CommandList &commandList, DirectX::XMFLOAT2 focus, float sigma)
 {
+	process(commandList, focus, sigma, nullptr);
+}
+
+void Filter::Process(const CommandList &commandList, DirectX::XMFLOAT2 focus, float sigma, const RectRange &roi)
+{
+	const auto &desc = m_source.GetResource()->GetDesc();
+	const RectRange rect((max)(roi.left, 0L), (max)(roi.top, 0L),
+		(min)(roi.right, static_cast<LONG>(desc.Width)), (min)(roi.bottom, static_cast<LONG>(desc.Height)));
+	C_RETURN(rect.right <= rect.left || rect.bottom <= rect.top, );
+
+	process(commandList, focus, sigma, &rect);
+}
+
+void Filter::process(const CommandList &commandList, XMFLOAT2 focus, float sigma, const RectRange *pRoi)
+{
+	// Before binding the pools, since the tables of the deeper chains may grow them
+	N_RETURN(deepen(commandList, sigma), );
+
 	const uint8_t numPasses = m_numMips > 0 ? m_numMips - 1 : 0;
-	const uint32_t width = static_cast<uint32_t>(m_filtered[TABLE_DOWN_SAMPLE].GetResource()->GetDesc().Width);
-	const auto height = m_filtered[TABLE_DOWN_SAMPLE].GetResource()->GetDesc().Height;
+	const uint32_t width = static_cast<uint32_t>(m_source.GetResource()->GetDesc().Width);
+	const auto height = m_source.GetResource()->GetDesc().Height;
+	const auto isSinglePass = m_isSinglePass && m_numTileLevels > 0;
+	if (pRoi) setRegionOfInterest(*pRoi, width, height);
+
+	// The up sampling writes none of the down-sampled levels, nor the coarsest
+	// level of its own chain, so they hold until the source or the filter changes.
+	// The per-level passes update the dirty rectangles of the source alone, which
+	// the single pass cannot, as its tail reads whole levels.
+	const auto isDirty = m_dirtyRect.right > m_dirtyRect.left && m_dirtyRect.bottom > m_dirtyRect.top;
+	const auto isPyramidKept = m_isPyramidValid && m_isPyramidSinglePass == isSinglePass;
+	const auto isDownSampled = isPyramidKept && !isDirty;
+	const auto isUpdate = isPyramidKept && isDirty && !isSinglePass;
+
+	// A region of interest reduces only the rectangles of the levels it needs,
+	// from the whole source, so the levels are partial after
+	const auto isPartial = pRoi && !isDownSampled && !isSinglePass;
+
+	// The up sampling starts from the level before the cutoff, of which the
+	// down-sampled texels stand for the resolved ones, unless the coarse pass
+	// covers that level anyway
+	const auto coarseLevel = getCoarseLevel(width, height, (min)(m_coarseUpSampleSize, MaxCoarseUpSampleSize));
+	const auto isCoarse = !m_sigmaMap && coarseLevel + 1 < numPasses;
+	const auto cutoffLevel = getCutoffLevel(focus, sigma, pRoi, width, height);
+	const auto firstLevel = static_cast<uint8_t>(cutoffLevel > 0 ? cutoffLevel - 1 : 0);
+	const auto isCutoff = cutoffLevel < numPasses && firstLevel + 1 < numPasses &&
+		(!isCoarse || firstLevel < coarseLevel);
+
+	// Before binding the pools, since the table may grow them
+	const auto sigmaMapTable = m_sigmaMap ? getSigmaMapTable() : nullptr;
+	C_RETURN(m_sigmaMap && !sigmaMapTable, );
 
 	// Set Descriptor pools
 	const DescriptorPool descriptorPools[] =
@@ -78,68 +174,212 @@ void Filter::Process(const CommandList &commandList, DirectX::XMFLOAT2 focus, fl
 	};
 	commandList.SetDescriptorPools(static_cast<uint32_t>(size(descriptorPools)), descriptorPools);
 
+	// The up-sample levels and the reduced sigma levels are written only after
+	// the down sampling, so start their transitions now and end each right
+	// before its first write
+	const auto pSigmaMaps = m_sigmaMaps.GetResource().get();
+	trackBarrierStates();
+	if (numPasses > 0)
+	{
+		const auto numUpLevels = isCutoff ? firstLevel + 1 : numPasses;
+		for (auto i = 0ui8; i < numUpLevels; ++i)
+			transitionLevel(TABLE_UP_SAMPLE, i, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+		if (!isDownSampled)
+			transitionLevel(TABLE_UP_SAMPLE, numPasses, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+		if (m_sigmaMap) for (auto i = 0ui8; i < numPasses; ++i)
+			m_barrierScheduler.BeginTransition(pSigmaMaps, i, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	}
+
 	// Generate Mips
-	commandList.SetComputePipelineLayout(m_pipelineLayouts[RESAMPLE]);
-	commandList.SetPipelineState(m_pipelines[RESAMPLE]);
-	commandList.SetComputeDescriptorTable(0, m_samplerTable);
+	if (isSinglePass && !isDownSampled)
+	{
+		// All the levels in one dispatch of a group per 64x64 tile
+		commandList.SetComputePipelineLayout(m_pipelineLayouts[RESAMPLE_SINGLE_PASS]);
+		commandList.SetPipelineState(m_pipelines[RESAMPLE_SINGLE_PASS]);
+		commandList.SetComputeDescriptorTable(0, m_samplerTable);
 
-	ResourceBarrier barriers[2];
-	auto numBarriers = 0u;
-	for (auto i = 0ui8; i + 1 < numPasses; ++i)
+		for (auto i = 1ui8; i < numPasses; ++i)
+			transitionLevel(TABLE_DOWN_SAMPLE, i, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		transitionLevel(TABLE_UP_SAMPLE, numPasses, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		flushBarriers(commandList);
+
+		const auto tileSize = 1u << MaxTileLevels;
+		const auto numGroupsX = (width + tileSize - 1) / tileSize;
+		const auto numGroupsY = (height + tileSize - 1) / tileSize;
+		struct
+		{
+			uint32_t	NumTileLevels;
+			uint32_t	NumLevels;
+			uint32_t	NumGroups;
+			float		Quantization;
+		} cb = { (min)(m_numTileLevels, numPasses), numPasses, numGroupsX * numGroupsY, getQuantization() };
+		commandList.SetComputeDescriptorTable(1, m_singlePassTable);
+		commandList.SetCompute32BitConstants(2, 4, &cb);
+		commandList.Dispatch(numGroupsX, numGroupsY, 1);
+
+		for (auto i = 1ui8; i < numPasses; ++i)
+			transitionLevel(TABLE_DOWN_SAMPLE, i, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+	}
+	else if (!isDownSampled)
 	{
-		const auto j = i + 1;
-		numBarriers = m_filtered[TABLE_DOWN_SAMPLE].SetBarrier(barriers, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, numBarriers, j);
-		commandList.Barrier(numBarriers, barriers);
+		commandList.SetComputePipelineLayout(m_pipelineLayouts[RESAMPLE]);
+		commandList.SetPipelineState(m_pipelines[RESAMPLE]);
+		commandList.SetComputeDescriptorTable(0, m_samplerTable);
 
-		commandList.SetComputeDescriptorTable(1, m_uavSrvTables[TABLE_DOWN_SAMPLE][i]);
-		commandList.Dispatch((max)((width >> j) / 8, 1u), (max)((height >> j) / 8, 1u), 1);
-		
-		numBarriers = m_filtered[TABLE_DOWN_SAMPLE].SetBarrier(barriers, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, 0, j);
+		// Each level is read by the very next dispatch, so its transition back to a
+		// shader resource batches with the transition of the level written next
+		auto rect = m_dirtyRect;
+		for (auto i = 0ui8; i + 1 < numPasses; ++i)
+		{
+			const auto j = i + 1;
+			transitionLevel(TABLE_DOWN_SAMPLE, j, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			flushBarriers(commandList);
+
+			// Groups of the rectangle of the level to reduce, or of the whole level
+			uint32_t offset[] = { 0, 0 };
+			auto numGroupsX = (max)((width >> j) / 8, 1u);
+			auto numGroupsY = (max)((height >> j) / 8, 1u);
+			if (isPartial) getGroupRange(m_roiRects[TABLE_DOWN_SAMPLE][j], offset, numGroupsX, numGroupsY);
+			else if (isUpdate)
+			{
+				rect = getLevelRect(rect, (max)(width >> i, 1u), (max)(height >> i, 1u),
+					(max)(width >> j, 1u), (max)(height >> j, 1u));
+				getGroupRange(rect, offset, numGroupsX, numGroupsY);
+			}
+
+			commandList.SetComputeDescriptorTable(1, m_uavSrvTables[TABLE_DOWN_SAMPLE][i]);
+			commandList.SetCompute32BitConstants(2, 2, offset);
+			commandList.Dispatch(numGroupsX, numGroupsY, 1);
+
+			transitionLevel(TABLE_DOWN_SAMPLE, j, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		}
+
+		if (numPasses > 0)
+		{
+			transitionLevel(TABLE_UP_SAMPLE, numPasses, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			flushBarriers(commandList);
+
+			const uint32_t offset[] = { 0, 0 };
+			commandList.SetComputeDescriptorTable(1, m_uavSrvTables[TABLE_DOWN_SAMPLE][numPasses]);
+			commandList.SetCompute32BitConstants(2, 2, offset);
+			commandList.Dispatch(1, 1, 1);
+		}
 	}
+	m_isPyramidValid = !isPartial;
+	m_isPyramidSinglePass = isSinglePass;
+	m_dirtyRect = RectRange(0, 0, 0, 0);
 
-	if (numPasses > 0)
+	// Reduce the sigma map to the levels to up sample
+	if (m_sigmaMap)
 	{
-		numBarriers = m_filtered[TABLE_UP_SAMPLE].SetBarrier(barriers, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, numBarriers, numPasses);
-		commandList.Barrier(numBarriers, barriers);
+		commandList.SetComputePipelineLayout(m_pipelineLayouts[RESAMPLE]);
+		commandList.SetPipelineState(m_pipelines[RESAMPLE_SIGMA]);
+		commandList.SetComputeDescriptorTable(0, m_samplerTable);
 
-		commandList.SetComputeDescriptorTable(1, m_uavSrvTables[TABLE_DOWN_SAMPLE][numPasses]);
-		commandList.Dispatch(1, 1, 1);
+		m_barrierScheduler.Transition(m_sigmaMap->GetResource().get(), BarrierScheduler::AllSubresources,
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		for (auto i = 0ui8; i < numPasses; ++i)
+		{
+			m_barrierScheduler.Transition(pSigmaMaps, i, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			flushBarriers(commandList);
+
+			commandList.SetComputeDescriptorTable(1, i > 0 ? m_sigmaMapTables[i] : sigmaMapTable);
+			commandList.Dispatch((max)((width >> i) / 8, 1u), (max)((height >> i) / 8, 1u), 1);
+
+			m_barrierScheduler.Transition(pSigmaMaps, i, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		}
 	}
 
 	// Up sampling
-	commandList.SetComputePipelineLayout(m_pipelineLayouts[UP_SAMPLE]);
-	commandList.SetPipelineState(m_pipelines[UP_SAMPLE]);
-	commandList.SetComputeDescriptorTable(0, m_samplerTable);
-
 	struct G
 	{
 		XMFLOAT2	Focus;
 		float		Sigma;
 		uint16_t	Level;
 		uint16_t	NumLevels;
-	} cb = { focus, sigma, 0, static_cast<uint16_t>(m_numMips) };
+		float		WeightAxisScale;
+		uint32_t	TableLevel;
+		float		Quantization;
+	} cb = { focus, sigma, 0, static_cast<uint16_t>(m_numMips), m_weightTableData.GetAxisScale(),
+		m_coarseTableLevel, getQuantization() };
 
-	for (auto i = 0ui8; i < numPasses; ++i)
+	// A sigma map has no focus, and its scales are clamped in place of it to the
+	// largest one, to which the chains in use are deep enough
+	if (m_sigmaMap) cb.Focus = XMFLOAT2(m_maxSigmaScale, 0.0f);
+
+	// None of the levels past the cutoff, or the coarse levels in one group,
+	// each of them otherwise a dispatch and a barrier for a few texels
+	auto i = 0ui8;
+	if (isCutoff) i = static_cast<uint8_t>(numPasses - 1 - firstLevel);
+	else if (isCoarse)
+	{
+		transitionLevel(TABLE_UP_SAMPLE, numPasses, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		for (auto j = coarseLevel; j < numPasses; ++j)
+			transitionLevel(TABLE_UP_SAMPLE, j, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		flushBarriers(commandList);
+
+		commandList.SetComputePipelineLayout(m_pipelineLayouts[UP_SAMPLE_COARSE]);
+		commandList.SetPipelineState(m_pipelines[UP_SAMPLE_COARSE]);
+		commandList.SetComputeDescriptorTable(0, m_samplerTable);
+		commandList.SetComputeDescriptorTable(1, m_coarseUpSampleTable);
+		commandList.SetComputeDescriptorTable(3, m_weightTable);
+
+		cb.Level = coarseLevel;
+		commandList.SetCompute32BitConstants(2, 7, &cb);
+		commandList.Dispatch(1, 1, 1);
+
+		i = static_cast<uint8_t>(numPasses - coarseLevel);
+	}
+
+	const auto upSample = m_sigmaMap ? UP_SAMPLE_SIGMA_MAP : UP_SAMPLE;
+	commandList.SetComputePipelineLayout(m_pipelineLayouts[upSample]);
+	commandList.SetPipelineState(m_pipelines[upSample]);
+	commandList.SetComputeDescriptorTable(0, m_samplerTable);
+	commandList.SetComputeDescriptorTable(3, m_weightTable);
+
+	// Past the cutoff, each group of the levels still drops the coarser one by the
+	// bound of its own sigmas
+	commandList.SetCompute32BitConstants(2, 1, &m_weightTolerance, 7);
+
+	for (; i < numPasses; ++i)
 	{
 		const auto c = numPasses - i;
 		const auto j = c - 1;
-		//const auto w = computeWeight(j);
-		numBarriers = m_filtered[TABLE_UP_SAMPLE].SetBarrier(barriers, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, 0, c);
-		numBarriers = m_filtered[TABLE_UP_SAMPLE].SetBarrier(barriers, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, numBarriers, j);
-		commandList.Barrier(numBarriers, barriers);
+		const auto isCutoffLevel = isCutoff && j == firstLevel;
+		if (!isCutoffLevel) transitionLevel(TABLE_UP_SAMPLE, c, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		transitionLevel(TABLE_UP_SAMPLE, j, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		flushBarriers(commandList);
+
+		// Groups of the rectangle of the level that the region of interest needs
+		uint32_t offset[] = { 0, 0 };
+		auto numGroupsX = (max)((width >> j) / 8, 1u);
+		auto numGroupsY = (max)((height >> j) / 8, 1u);
+		if (pRoi) getGroupRange(m_roiRects[TABLE_UP_SAMPLE][j], offset, numGroupsX, numGroupsY);
 
 		cb.Level = j;
-		commandList.SetComputeDescriptorTable(1, m_uavSrvTables[TABLE_UP_SAMPLE][i]);
-		commandList.SetCompute32BitConstants(2, 4, &cb);
-		commandList.Dispatch((max)((width >> j) / 8, 1u), (max)((height >> j) / 8, 1u), 1);
+		commandList.SetComputeDescriptorTable(1, isCutoffLevel ? m_cutoffTables[j] : m_uavSrvTables[TABLE_UP_SAMPLE][i]);
+		if (m_sigmaMap) commandList.SetComputeDescriptorTable(4, m_sigmaMapSrvTables[j]);
+		commandList.SetCompute32BitConstants(2, 5, &cb);
+		commandList.SetCompute32BitConstants(2, 2, offset, 5);
+		commandList.Dispatch(numGroupsX, numGroupsY, 1);
 	}
+
+	flushBarriers(commandList);
+	commitBarrierStates();
 }
 
 void Filter::ProcessG(const CommandList &commandList)
 {
+	// The levels below are those of the per-level down sampling of Process(),
+	// but the coarsest one of the up-sample chain is not written
+	if (m_isPyramidSinglePass || m_dirtyRect.right > m_dirtyRect.left) InvalidateSource();
+
+	const auto sigma = 24.0f;
+	N_RETURN(deepen(commandList, sigma), );
+
 	const uint8_t numPasses = m_numMips > 0 ? m_numMips - 1 : 0;
-	const uint32_t width = static_cast<uint32_t>(m_filtered[TABLE_DOWN_SAMPLE].GetResource()->GetDesc().Width);
-	const auto height = m_filtered[TABLE_DOWN_SAMPLE].GetResource()->GetDesc().Height;
+	const uint32_t width = static_cast<uint32_t>(m_source.GetResource()->GetDesc().Width);
+	const auto height = m_source.GetResource()->GetDesc().Height;
 
 	// Set Descriptor pools
 	const DescriptorPool descriptorPools[] =
@@ -156,27 +396,29 @@ void Filter::ProcessG(const CommandList &commandList)
 
 	ResourceBarrier barriers[2];
 	auto numBarriers = 0u;
+	const uint32_t offset[] = { 0, 0 };
 	for (auto i = 0ui8; i < numPasses; ++i)
 	{
 		const auto j = i + 1;
-		numBarriers = m_filtered[TABLE_DOWN_SAMPLE].SetBarrier(barriers, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, numBarriers, j);
+		numBarriers = m_filtered[TABLE_DOWN_SAMPLE].SetBarrier(barriers, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, numBarriers, i);
 		commandList.Barrier(numBarriers, barriers);
 
 		commandList.SetComputeDescriptorTable(1, m_uavSrvTables[TABLE_DOWN_SAMPLE][i]);
+		commandList.SetCompute32BitConstants(2, 2, offset);
 		commandList.Dispatch((max)((width >> j) / 8, 1u), (max)((height >> j) / 8, 1u), 1);
 
-		numBarriers = m_filtered[TABLE_DOWN_SAMPLE].SetBarrier(barriers, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, 0, j);
+		numBarriers = m_filtered[TABLE_DOWN_SAMPLE].SetBarrier(barriers, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, 0, i);
 	}
 
-	numBarriers = m_filtered[TABLE_UP_SAMPLE].SetBarrier(barriers, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, numBarriers, 0);
+	numBarriers = m_result.SetBarrier(barriers, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, numBarriers, 0);
 	commandList.Barrier(numBarriers, barriers);
 
-	// Gaussian
+	// Gaussian, sampling level 0 from the source
 	struct G
 	{
 		float		Sigma;
 		uint32_t	NumLevels;
-	} cb = { 24.0f, m_numMips };
+	} cb = { sigma, m_numMips };
 	commandList.SetComputePipelineLayout(m_pipelineLayouts[GAUSSIAN]);
 	commandList.SetPipelineState(m_pipelines[GAUSSIAN]);
 	commandList.SetComputeDescriptorTable(0, m_samplerTable);
@@ -185,9 +427,37 @@ void Filter::ProcessG(const CommandList &commandList)
 	commandList.Dispatch((max)(width / 8, 1u), (max)(height / 8, 1u), 1);
 }
 
+void Filter::UpdateSource(const CommandList &commandList, const shared_ptr<ResourceBase> &source)
+{
+	copySource(commandList, source);
+	InvalidateSource();
+}
+
+void Filter::UpdateSource(const CommandList &commandList, const shared_ptr<ResourceBase> &source,
+	const RectRange &dirtyRect)
+{
+	const auto &desc = m_source.GetResource()->GetDesc();
+	const RectRange rect((max)(dirtyRect.left, 0L), (max)(dirtyRect.top, 0L),
+		(min)(dirtyRect.right, static_cast<LONG>(desc.Width)), (min)(dirtyRect.bottom, static_cast<LONG>(desc.Height)));
+	C_RETURN(rect.right <= rect.left || rect.bottom <= rect.top, );
+
+	copySource(commandList, source, &rect);
+
+	// Accumulated until the next Process()
+	if (m_dirtyRect.right > m_dirtyRect.left && m_dirtyRect.bottom > m_dirtyRect.top)
+		m_dirtyRect = RectRange((min)(m_dirtyRect.left, rect.left), (min)(m_dirtyRect.top, rect.top),
+			(max)(m_dirtyRect.right, rect.right), (max)(m_dirtyRect.bottom, rect.bottom));
+	else m_dirtyRect = rect;
+}
+
+void Filter::InvalidateSource()
+{
+	m_isPyramidValid = false;
+}
+
 Texture2D &Filter::GetResult()
 {
-	return m_filtered[TABLE_UP_SAMPLE];
+	return m_result;
 }
 
 bool Filter::createPipelineLayouts()
@@ -199,6 +469,7 @@ bool Filter::createPipelineLayouts()
 		utilPipelineLayout.SetRange(1, DescriptorType::SRV, 1, 0);
 		utilPipelineLayout.SetRange(1, DescriptorType::UAV, 1, 0, 0,
 			D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		utilPipelineLayout.SetConstants(2, 2, 0);
 		X_RETURN(m_pipelineLayouts[RESAMPLE], utilPipelineLayout.GetPipelineLayout(
 			m_pipelineLayoutCache, D3D12_ROOT_SIGNATURE_FLAG_NONE, L"ResamplingLayout"), false);
 	}
@@ -210,16 +481,56 @@ bool Filter::createPipelineLayouts()
 		utilPipelineLayout.SetRange(1, DescriptorType::SRV, 2, 0);
 		utilPipelineLayout.SetRange(1, DescriptorType::UAV, 1, 0, 0,
 			D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
-		utilPipelineLayout.SetConstants(2, 4, 0);
+		utilPipelineLayout.SetConstants(2, 8, 0);
+		utilPipelineLayout.SetRange(3, DescriptorType::SRV, 1, 2);
 		X_RETURN(m_pipelineLayouts[UP_SAMPLE], utilPipelineLayout.GetPipelineLayout(
 			m_pipelineLayoutCache, D3D12_ROOT_SIGNATURE_FLAG_NONE, L"UpSamplingLayout"), false);
+
+		// With the sigma map of the level
+		utilPipelineLayout.SetRange(4, DescriptorType::SRV, 1, 3);
+		X_RETURN(m_pipelineLayouts[UP_SAMPLE_SIGMA_MAP], utilPipelineLayout.GetPipelineLayout(
+			m_pipelineLayoutCache, D3D12_ROOT_SIGNATURE_FLAG_NONE, L"UpSamplingSigmaMapLayout"), false);
 	}
 
-	// Gaussian
+	// Single-pass resampling, with the levels as a UAV array and the scratch
+	// buffer in a space of its own
+	if (m_numTileLevels > 0)
 	{
+		const uint32_t numPasses = m_maxMips - 1;
 		Util::PipelineLayout utilPipelineLayout;
 		utilPipelineLayout.SetRange(0, DescriptorType::SAMPLER, 1, 0);
 		utilPipelineLayout.SetRange(1, DescriptorType::SRV, 1, 0);
+		utilPipelineLayout.SetRange(1, DescriptorType::UAV, numPasses, 0, 0,
+			D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		utilPipelineLayout.SetRange(1, DescriptorType::UAV, 1, 0, 1);
+		utilPipelineLayout.SetConstants(2, 4, 0);
+		X_RETURN(m_pipelineLayouts[RESAMPLE_SINGLE_PASS], utilPipelineLayout.GetPipelineLayout(
+			m_pipelineLayoutCache, D3D12_ROOT_SIGNATURE_FLAG_NONE, L"SinglePassResamplingLayout"), false);
+	}
+
+	// Coarse up sampling, with the levels as arrays
+	if (m_coarseTableLevel + 1u < m_maxMips)
+	{
+		const auto numLevels = m_maxMips - 1u - m_coarseTableLevel;
+		Util::PipelineLayout utilPipelineLayout;
+		utilPipelineLayout.SetRange(0, DescriptorType::SAMPLER, 1, 0);
+		utilPipelineLayout.SetRange(1, DescriptorType::SRV, numLevels + 1, 0);
+		utilPipelineLayout.SetRange(1, DescriptorType::UAV, numLevels, 0, 0,
+			D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		utilPipelineLayout.SetConstants(2, 7, 0);
+		utilPipelineLayout.SetRange(3, DescriptorType::SRV, 1, 0, 1);
+		X_RETURN(m_pipelineLayouts[UP_SAMPLE_COARSE], utilPipelineLayout.GetPipelineLayout(
+			m_pipelineLayoutCache, D3D12_ROOT_SIGNATURE_FLAG_NONE, L"CoarseUpSamplingLayout"), false);
+	}
+
+	// The sigma map is reduced with the resampling layout
+	m_pipelineLayouts[RESAMPLE_SIGMA] = m_pipelineLayouts[RESAMPLE];
+
+	// Gaussian
+	{
+		Util::PipelineLayout utilPipelineLayout;
+		utilPipelineLayout.SetRange(0, DescriptorType::SAMPLER, 1, 0);
+		utilPipelineLayout.SetRange(1, DescriptorType::SRV, 2, 0);
 		utilPipelineLayout.SetRange(1, DescriptorType::UAV, 1, 0, 0,
 			D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
 		utilPipelineLayout.SetConstants(2, 2, 0);
@@ -232,9 +543,24 @@ bool Filter::createPipelineLayouts()
 
 bool Filter::createPipelines()
 {
+	// Load all the shaders in parallel, so that creating each pipeline overlaps
+	// with loading the rest
+	m_shaderPool.CreateShaderAsync(Shader::Stage::CS, RESAMPLE, L"CSResample.cso");
+	m_shaderPool.CreateShaderAsync(Shader::Stage::CS, UP_SAMPLE, L"CSUpSample.cso");
+	m_shaderPool.CreateShaderAsync(Shader::Stage::CS, GAUSSIAN, L"CSMipGaussian.cso");
+	m_shaderPool.CreateShaderAsync(Shader::Stage::CS, RESAMPLE_SIGMA, L"CSResampleSigma.cso");
+	m_shaderPool.CreateShaderAsync(Shader::Stage::CS, UP_SAMPLE_SIGMA_MAP, L"CSUpSampleSigmaMap.cso");
+	if (m_numTileLevels > 0)
+		m_shaderPool.CreateShaderAsync(Shader::Stage::CS, RESAMPLE_SINGLE_PASS, L"CSResampleSinglePass.cso");
+	if (m_coarseTableLevel + 1u < m_maxMips)
+		m_shaderPool.CreateShaderAsync(Shader::Stage::CS, UP_SAMPLE_COARSE, L"CSUpSampleCoarse.cso");
+
+	// Compiled by a previous run, next to the shader objects
+	m_computePipelineCache.LoadPipelineLibrary(L"FilterPipelines.bin");
+
 	// Resampling
 	{
-		N_RETURN(m_shaderPool.CreateShader(Shader::Stage::CS, RESAMPLE, L"CSResample.cso"), false);
+		N_RETURN(m_shaderPool.GetShader(Shader::Stage::CS, RESAMPLE), false);
 
 		Compute::State state;
 		state.SetPipelineLayout(m_pipelineLayouts[RESAMPLE]);
@@ -244,7 +570,7 @@ bool Filter::createPipelines()
 
 	// Up sampling
 	{
-		N_RETURN(m_shaderPool.CreateShader(Shader::Stage::CS, UP_SAMPLE, L"CSUpSample.cso"), false);
+		N_RETURN(m_shaderPool.GetShader(Shader::Stage::CS, UP_SAMPLE), false);
 
 		Compute::State state;
 		state.SetPipelineLayout(m_pipelineLayouts[UP_SAMPLE]);
@@ -254,7 +580,7 @@ bool Filter::createPipelines()
 
 	// Gaussian
 	{
-		N_RETURN(m_shaderPool.CreateShader(Shader::Stage::CS, GAUSSIAN, L"CSMipGaussian.cso"), false);
+		N_RETURN(m_shaderPool.GetShader(Shader::Stage::CS, GAUSSIAN), false);
 
 		Compute::State state;
 		state.SetPipelineLayout(m_pipelineLayouts[GAUSSIAN]);
@@ -262,12 +588,300 @@ bool Filter::createPipelines()
 		X_RETURN(m_pipelines[GAUSSIAN], state.GetPipeline(m_computePipelineCache, L"GAUSSIAN"), false);
 	}
 
+	// Sigma map reduction
+	{
+		N_RETURN(m_shaderPool.GetShader(Shader::Stage::CS, RESAMPLE_SIGMA), false);
+
+		Compute::State state;
+		state.SetPipelineLayout(m_pipelineLayouts[RESAMPLE_SIGMA]);
+		state.SetShader(m_shaderPool.GetShader(Shader::Stage::CS, RESAMPLE_SIGMA));
+		X_RETURN(m_pipelines[RESAMPLE_SIGMA], state.GetPipeline(m_computePipelineCache, L"SigmaMapResampling"), false);
+	}
+
+	// Up sampling with a sigma map
+	{
+		N_RETURN(m_shaderPool.GetShader(Shader::Stage::CS, UP_SAMPLE_SIGMA_MAP), false);
+
+		Compute::State state;
+		state.SetPipelineLayout(m_pipelineLayouts[UP_SAMPLE_SIGMA_MAP]);
+		state.SetShader(m_shaderPool.GetShader(Shader::Stage::CS, UP_SAMPLE_SIGMA_MAP));
+		X_RETURN(m_pipelines[UP_SAMPLE_SIGMA_MAP], state.GetPipeline(m_computePipelineCache, L"UpSamplingSigmaMap"), false);
+	}
+
+	// Single-pass resampling
+	if (m_numTileLevels > 0)
+	{
+		N_RETURN(m_shaderPool.GetShader(Shader::Stage::CS, RESAMPLE_SINGLE_PASS), false);
+
+		Compute::State state;
+		state.SetPipelineLayout(m_pipelineLayouts[RESAMPLE_SINGLE_PASS]);
+		state.SetShader(m_shaderPool.GetShader(Shader::Stage::CS, RESAMPLE_SINGLE_PASS));
+		X_RETURN(m_pipelines[RESAMPLE_SINGLE_PASS], state.GetPipeline(m_computePipelineCache, L"SinglePassResampling"), false);
+	}
+
+	// Coarse up sampling
+	if (m_coarseTableLevel + 1u < m_maxMips)
+	{
+		N_RETURN(m_shaderPool.GetShader(Shader::Stage::CS, UP_SAMPLE_COARSE), false);
+
+		Compute::State state;
+		state.SetPipelineLayout(m_pipelineLayouts[UP_SAMPLE_COARSE]);
+		state.SetShader(m_shaderPool.GetShader(Shader::Stage::CS, UP_SAMPLE_COARSE));
+		X_RETURN(m_pipelines[UP_SAMPLE_COARSE], state.GetPipeline(m_computePipelineCache, L"CoarseUpSampling"), false);
+	}
+
+	N_RETURN(m_shaderPool.WaitForShaders(), false);
+	m_computePipelineCache.SavePipelineLibrary(L"FilterPipelines.bin");
+
 	return true;
 }
 
+DescriptorTable Filter::getSigmaMapTable()
+{
+	const Descriptor descriptors[] =
+	{
+		m_sigmaMap->GetSRV(),
+		m_sigmaMaps.GetUAV(0)
+	};
+	Util::DescriptorTable utilUavSrvTable;
+	utilUavSrvTable.SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+
+	// Transient, so that maps bound for a frame each do not accumulate in the
+	// pool; a full partition of this frame is an error, as caching the table
+	// instead would accumulate them again
+	const auto table = utilUavSrvTable.CreateTransientCbvSrvUavTable(m_descriptorTableCache);
+	assert(table);
+	M_RETURN(!table, cerr, "The transient descriptors of the frame are used up; raise Filter::TransientDescriptorCount.", nullptr);
+
+	return table;
+}
+
+Descriptor Filter::getLevelSRV(UavSrvTableIndex chain, uint8_t level) const
+{
+	// The textures of the chains hold the levels from 1 on; level 0 is the source
+	// when read, and the result when written
+	return level > 0 ? m_filtered[chain].GetSRVLevel(level - 1) :
+		chain == TABLE_DOWN_SAMPLE ? m_source.GetSRV() : m_result.GetSRV();
+}
+
+Descriptor Filter::getLevelUAV(UavSrvTableIndex chain, uint8_t level) const
+{
+	return level > 0 ? m_filtered[chain].GetUAV(level - 1) : m_result.GetUAV();
+}
+
+void Filter::transitionLevel(UavSrvTableIndex chain, uint8_t level, ResourceState state, bool isBegin)
+{
+	// Level 0 is transitioned only as the result, since the source is never written
+	const auto pResource = level > 0 ? m_filtered[chain].GetResource().get() : m_result.GetResource().get();
+	const uint32_t subresource = level > 0 ? level - 1 : 0;
+	if (isBegin) m_barrierScheduler.BeginTransition(pResource, subresource, state);
+	else m_barrierScheduler.Transition(pResource, subresource, state);
+}
+
+float Filter::getQuantization() const
+{
+	// Steps of the unorm formats, to which the single-pass and the coarse shaders
+	// round the levels they keep; the float formats are rounded to halves
+	switch (m_format)
+	{
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+		return 255.0f;
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+		return 1023.0f;
+	default:
+		return 0.0f;
+	}
+}
+
+void Filter::setRegionOfInterest(const RectRange &roi, uint32_t width, uint32_t height)
+{
+	const uint8_t numPasses = m_numMips > 0 ? m_numMips - 1 : 0;
+	const auto levelRect = [width, height](const RectRange &rect, uint8_t level, uint8_t dstLevel)
+	{
+		return getLevelRect(rect, (max)(width >> level, 1u), (max)(height >> level, 1u),
+			(max)(width >> dstLevel, 1u), (max)(height >> dstLevel, 1u));
+	};
+
+	auto &downRects = m_roiRects[TABLE_DOWN_SAMPLE];
+	auto &upRects = m_roiRects[TABLE_UP_SAMPLE];
+	downRects.resize(m_numMips);
+	upRects.resize(m_numMips);
+
+	// Each up-sampled level needs the coarser one under its bilinear taps, and the
+	// same texels of the down-sampled level, of which the next coarser level needs
+	// those under its taps too; the coarsest level is up sampled
+	upRects[0] = roi;
+	for (auto c = 1ui8; c <= numPasses; ++c) upRects[c] = levelRect(upRects[c - 1], c - 1, c);
+
+	auto coarser = upRects[numPasses];
+	for (auto i = numPasses - 1; i > 0; --i)
+	{
+		const auto &upRect = upRects[i];
+		const auto srcRect = levelRect(coarser, i + 1, i);
+		downRects[i] = RectRange((min)(upRect.left, srcRect.left), (min)(upRect.top, srcRect.top),
+			(max)(upRect.right, srcRect.right), (max)(upRect.bottom, srcRect.bottom));
+		coarser = downRects[i];
+	}
+}
+
+void Filter::getGroupRange(const RectRange &rect, uint32_t offset[2], uint32_t &numGroupsX, uint32_t &numGroupsY)
+{
+	// Groups of 8x8 aligned to the level
+	offset[0] = static_cast<uint32_t>(rect.left) & ~7u;
+	offset[1] = static_cast<uint32_t>(rect.top) & ~7u;
+	numGroupsX = (static_cast<uint32_t>(rect.right) - offset[0] + 7) / 8;
+	numGroupsY = (static_cast<uint32_t>(rect.bottom) - offset[1] + 7) / 8;
+}
+
+RectRange Filter::getLevelRect(const RectRange &rect, uint32_t srcWidth, uint32_t srcHeight,
+	uint32_t width, uint32_t height)
+{
+	// The texels of a level under the footprint of a rectangle of another level,
+	// or sampling it, with a margin of 2 texels for the bilinear and offset taps
+	const auto scale = [](LONG i, uint32_t srcSize, uint32_t size, bool isEnd)
+	{
+		const auto s = (max)(isEnd ? i + 2 : i - 2, 0L);
+		const auto v = (static_cast<uint64_t>(s) * size + (isEnd ? srcSize - 1 : 0)) / srcSize;
+
+		return static_cast<LONG>((min)(v, static_cast<uint64_t>(size)));
+	};
+
+	return RectRange(scale(rect.left, srcWidth, width, false), scale(rect.top, srcHeight, height, false),
+		scale(rect.right, srcWidth, width, true), scale(rect.bottom, srcHeight, height, true));
+}
+
+uint8_t Filter::getNumMips(float sigma) const
+{
+	C_RETURN(m_depthTolerance < 0.0f, m_maxMips);
+
+	// The radial falloff scales sigma by 1 at most, and a sigma map by its largest
+	// scale; a lookup also takes the weights of the entry after sigma, which are
+	// larger on the coarser levels
+	const auto scale = m_sigmaMap ? m_maxSigmaScale : 1.0f;
+	const auto maxSigma = CPU::WeightTable::GetUpperSigma(sigma * scale, m_weightTableMaxSigma, m_weightTableResolution);
+
+	// Dropping the levels past the coarsest one changes the normalized weight of
+	// each level by at most their part of the weights from the coarsest one on
+	const auto sigma2 = maxSigma * maxSigma;
+	auto numMips = (min)(2ui8, m_maxMips);
+	while (numMips < m_maxMips && 1.0f - CPU::UpSampleWeight(sigma2, numMips - 1u, m_maxMips) > m_depthTolerance)
+		++numMips;
+
+	return numMips;
+}
+
+uint8_t Filter::getCoarseLevel(uint32_t width, uint32_t height, uint32_t size) const
+{
+	// The finest level of which the dimensions fit the size
+	const uint8_t numPasses = m_numMips > 0 ? m_numMips - 1 : 0;
+	auto level = numPasses;
+	while (level > 0 && (max)(width >> (level - 1), 1u) <= size && (max)(height >> (level - 1), 1u) <= size)
+		--level;
+
+	return level;
+}
+
+void Filter::copySource(const CommandList &commandList, const shared_ptr<ResourceBase> &source,
+	const RectRange *pRect)
+{
+	const TextureCopyLocation dst(m_source.GetResource().get(), 0);
+	const TextureCopyLocation src(source->GetResource().get(), 0);
+
+	ResourceBarrier barriers[2];
+	auto numBarriers = m_source.SetBarrier(barriers, D3D12_RESOURCE_STATE_COPY_DEST, 0, 0);
+	numBarriers = source->SetBarrier(barriers, D3D12_RESOURCE_STATE_COPY_SOURCE, numBarriers, 0);
+	commandList.Barrier(numBarriers, barriers);
+
+	if (pRect)
+	{
+		const BoxRange box(pRect->left, pRect->top, pRect->right, pRect->bottom);
+		commandList.CopyTextureRegion(dst, pRect->left, pRect->top, 0, src, &box);
+	}
+	else commandList.CopyTextureRegion(dst, 0, 0, 0, src);
+
+	numBarriers = m_source.SetBarrier(barriers, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, 0, 0);
+	commandList.Barrier(numBarriers, barriers);
+}
+
+void Filter::trackBarrierStates()
+{
+	// The resources keep the states between frames and for the other passes, of
+	// all their levels, as the chains may deepen into those not in use
+	m_barrierScheduler.Reset();
+	for (auto &image : m_filtered)
+		for (auto i = 0ui8; i < image.GetNumMips(); ++i)
+			m_barrierScheduler.SetState(image.GetResource().get(), i, image.GetResourceState(i));
+	m_barrierScheduler.SetState(m_result.GetResource().get(), 0, m_result.GetResourceState(0));
+
+	if (m_sigmaMap)
+	{
+		for (auto i = 0ui8; i < m_maxMips; ++i)
+			m_barrierScheduler.SetState(m_sigmaMaps.GetResource().get(), i, m_sigmaMaps.GetResourceState(i));
+		m_barrierScheduler.SetState(m_sigmaMap->GetResource().get(),
+			BarrierScheduler::AllSubresources, m_sigmaMap->GetResourceState());
+	}
+}
+
+void Filter::commitBarrierStates()
+{
+	for (auto &image : m_filtered)
+		for (auto i = 0ui8; i < image.GetNumMips(); ++i)
+			image.SetResourceState(static_cast<ResourceState>(
+				m_barrierScheduler.GetState(image.GetResource().get(), i)), i);
+	m_result.SetResourceState(static_cast<ResourceState>(
+		m_barrierScheduler.GetState(m_result.GetResource().get(), 0)), 0);
+
+	if (m_sigmaMap)
+	{
+		for (auto i = 0ui8; i < m_maxMips; ++i)
+			m_sigmaMaps.SetResourceState(static_cast<ResourceState>(
+				m_barrierScheduler.GetState(m_sigmaMaps.GetResource().get(), i)), i);
+		m_sigmaMap->SetResourceState(static_cast<ResourceState>(
+			m_barrierScheduler.GetState(m_sigmaMap->GetResource().get(), BarrierScheduler::AllSubresources)));
+	}
+}
+
+void Filter::flushBarriers(const CommandList &commandList)
+{
+	m_barrierScheduler.Flush([&commandList](uint32_t numBarriers, const BarrierScheduler::Barrier *pBarriers)
+	{
+		commandList.Barrier(numBarriers, pBarriers);
+	});
+}
+
 bool Filter::createDescriptorTables()
 {
+	// Room for 2 + 3 + 3 descriptors per pass, the weights, the single pass, the
+	// coarse up sampling and the transient tables
+	m_descriptorTableCache.ReserveDescriptorPool(CBV_SRV_UAV_POOL, 11 * m_maxMips + 1 + TransientDescriptorCount * FrameCount);
+	m_descriptorTableCache.ReserveDescriptorPool(SAMPLER_POOL, 1);
+	N_RETURN(m_descriptorTableCache.AllocateTransientPool(CBV_SRV_UAV_POOL, TransientDescriptorCount, FrameCount), false);
+
+	N_RETURN(createLevelTables(), false);
+
+	// Create the sampler table
+	Util::DescriptorTable samplerTable;
+	const auto sampler = LINEAR_CLAMP;
+	samplerTable.SetSamplers(0, 1, &sampler, m_descriptorTableCache);
+	X_RETURN(m_samplerTable, samplerTable.GetSamplerTable(m_descriptorTableCache), false);
+
+	// Create the weight table
+	{
+		const auto descriptor = m_weights.GetSRV();
+		Util::DescriptorTable utilSrvTable;
+		utilSrvTable.SetDescriptors(0, 1, &descriptor);
+		X_RETURN(m_weightTable, utilSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+	}
+
+	return true;
+}
+
+bool Filter::createLevelTables()
+{
+	// The tables of the levels in use, of which the coarsest one is up sampled;
+	// most of those of a shallower chain are looked up again in the cache
 	const uint8_t numPasses = m_numMips > 0 ? m_numMips - 1 : 0;
+	vector<Util::DescriptorTable> levelTables;
 	m_uavSrvTables[TABLE_DOWN_SAMPLE].resize(m_numMips);
 	m_uavSrvTables[TABLE_UP_SAMPLE].resize(m_numMips);
 	for (auto i = 0ui8; i < numPasses; ++i)
@@ -276,12 +890,13 @@ bool Filter::createDescriptorTables()
 		{
 			const Descriptor descriptors[] =
 			{
-				m_filtered[TABLE_DOWN_SAMPLE].GetSRVLevel(i),
-				m_filtered[TABLE_DOWN_SAMPLE].GetUAV(i + 1)
+				getLevelSRV(TABLE_DOWN_SAMPLE, i),
+				getLevelUAV(TABLE_DOWN_SAMPLE, i + 1)
 			};
 			Util::DescriptorTable utilUavSrvTable;
 			utilUavSrvTable.SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
 			X_RETURN(m_uavSrvTables[TABLE_DOWN_SAMPLE][i], utilUavSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+			levelTables.push_back(utilUavSrvTable);
 		}
 
 		{
@@ -289,84 +904,270 @@ bool Filter::createDescriptorTables()
 			const auto current = coarser - 1;
 			const Descriptor descriptors[] =
 			{
-				m_filtered[TABLE_DOWN_SAMPLE].GetSRVLevel(current),
-				m_filtered[TABLE_UP_SAMPLE].GetSRVLevel(coarser),
-				m_filtered[TABLE_UP_SAMPLE].GetUAV(current)
+				getLevelSRV(TABLE_DOWN_SAMPLE, current),
+				getLevelSRV(TABLE_UP_SAMPLE, coarser),
+				getLevelUAV(TABLE_UP_SAMPLE, current)
 			};
 			Util::DescriptorTable utilUavSrvTable;
 			utilUavSrvTable.SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
 			X_RETURN(m_uavSrvTables[TABLE_UP_SAMPLE][i], utilUavSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+			levelTables.push_back(utilUavSrvTable);
 		}
 	}
 
+	// The cutoff level is down sampled only, and up samples the level before it
+	m_cutoffTables.resize(numPasses > 1 ? numPasses - 1 : 0);
+	for (auto i = 0ui8; i + 1 < numPasses; ++i)
+	{
+		const Descriptor descriptors[] =
+		{
+			getLevelSRV(TABLE_DOWN_SAMPLE, i),
+			getLevelSRV(TABLE_DOWN_SAMPLE, i + 1),
+			getLevelUAV(TABLE_UP_SAMPLE, i)
+		};
+		Util::DescriptorTable utilUavSrvTable;
+		utilUavSrvTable.SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_cutoffTables[i], utilUavSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+		levelTables.push_back(utilUavSrvTable);
+	}
+
 	if (numPasses > 0)
 	{
 		{
 			const Descriptor descriptors[] =
 			{
-				m_filtered[TABLE_DOWN_SAMPLE].GetSRVLevel(numPasses - 1),
-				m_filtered[TABLE_UP_SAMPLE].GetUAV(numPasses)
+				getLevelSRV(TABLE_DOWN_SAMPLE, numPasses - 1),
+				getLevelUAV(TABLE_UP_SAMPLE, numPasses)
 			};
 			Util::DescriptorTable utilUavSrvTable;
 			utilUavSrvTable.SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
 			X_RETURN(m_uavSrvTables[TABLE_DOWN_SAMPLE][numPasses], utilUavSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+			levelTables.push_back(utilUavSrvTable);
 		}
 
 		{
 			const Descriptor descriptors[] =
 			{
-				m_filtered[TABLE_DOWN_SAMPLE].GetSRV(),
-				m_filtered[TABLE_UP_SAMPLE].GetUAV()
+				getLevelSRV(TABLE_DOWN_SAMPLE, 0),
+				m_filtered[TABLE_DOWN_SAMPLE].GetSRV(),	// Levels from 1 on
+				getLevelUAV(TABLE_UP_SAMPLE, 0)
 			};
 			Util::DescriptorTable utilUavSrvTable;
 			utilUavSrvTable.SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
 			X_RETURN(m_uavSrvTables[TABLE_UP_SAMPLE][numPasses], utilUavSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+			levelTables.push_back(utilUavSrvTable);
 		}
 	}
 
-	// Create the sampler table
-	Util::DescriptorTable samplerTable;
-	const auto sampler = LINEAR_CLAMP;
-	samplerTable.SetSamplers(0, 1, &sampler, m_descriptorTableCache);
-	X_RETURN(m_samplerTable, samplerTable.GetSamplerTable(m_descriptorTableCache), false);
+	// The source, the levels and the scratch buffer of the single pass, laid out
+	// for the whole chain, of which the levels past those in use are not written
+	const uint8_t maxPasses = m_maxMips > 0 ? m_maxMips - 1 : 0;
+	if (m_numTileLevels > 0)
+	{
+		vector<Descriptor> descriptors(maxPasses + 2);
+		descriptors[0] = getLevelSRV(TABLE_DOWN_SAMPLE, 0);
+		for (auto i = 1ui8; i <= maxPasses; ++i) descriptors[i] = getLevelUAV(TABLE_DOWN_SAMPLE, i);
+		descriptors[numPasses] = getLevelUAV(TABLE_UP_SAMPLE, numPasses);
+		descriptors[maxPasses + 1] = m_singlePassScratch.GetUAV();
+		Util::DescriptorTable utilUavSrvTable;
+		utilUavSrvTable.SetDescriptors(0, static_cast<uint32_t>(descriptors.size()), descriptors.data());
+		X_RETURN(m_singlePassTable, utilUavSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+		levelTables.push_back(utilUavSrvTable);
+	}
+
+	// The down-sampled and the resolved coarse levels, from the coarsest
+	// resolved one the other way round, laid out for the whole chain
+	if (m_coarseTableLevel < numPasses)
+	{
+		const auto numLevels = maxPasses - m_coarseTableLevel;
+		vector<Descriptor> descriptors(2 * numLevels + 1);
+		for (auto i = 0u; i <= numLevels; ++i)
+		{
+			const auto level = static_cast<uint8_t>(m_coarseTableLevel + i);
+			descriptors[i] = getLevelSRV(TABLE_DOWN_SAMPLE, level);
+			if (i < numLevels) descriptors[numLevels + 1 + i] = getLevelUAV(TABLE_UP_SAMPLE, level);
+		}
+		descriptors[numPasses - m_coarseTableLevel] = getLevelSRV(TABLE_UP_SAMPLE, numPasses);
+		Util::DescriptorTable utilUavSrvTable;
+		utilUavSrvTable.SetDescriptors(0, static_cast<uint32_t>(descriptors.size()), descriptors.data());
+		X_RETURN(m_coarseUpSampleTable, utilUavSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+		levelTables.push_back(utilUavSrvTable);
+	}
+
+	// The tables of the shallower chains that are no longer in use are removed
+	// once the GPU is done with this frame, see SetFrameIndex()
+	for (const auto &levelTable : m_levelTables)
+		if (none_of(levelTables.cbegin(), levelTables.cend(), [&levelTable](const Util::DescriptorTable &table)
+			{ return table.GetKey() == levelTable.GetKey(); }))
+			m_staleLevelTables[m_frameIndex].push_back(levelTable);
+	m_levelTables = move(levelTables);
 
 	return true;
 }
 
-float Filter::computeWeight(uint32_t mip) const
+bool Filter::uploadWeights(const CommandList &commandList, Resource &uploader)
 {
-	const auto sigma = 24.0;//0.84089642f;
+	// Normalized over the levels in use; the rows past them are never sampled
+	const auto rowSize = static_cast<size_t>(m_weightTableResolution);
+	N_RETURN(m_weightTableData.Create(m_numMips, m_weightTableMaxSigma, m_weightTableResolution), false);
+	vector<float> weights(rowSize * m_maxMips, 1.0f);
+	copy_n(m_weightTableData.GetData(), rowSize * m_numMips, weights.begin());
 
-	const auto GaussianExp = [](double sigma2, double mip)
-	{
-		return -exp2(2.0 * mip - 1.0) / (XM_PI * sigma2);
-	};
+	return m_weights.Upload(commandList, uploader, weights.data(), sizeof(float),
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+}
 
-	const auto GaussianBasis = [GaussianExp](double sigma2, double mip)
-	{
-		return mip < 0.0 ? 0.0 : exp(GaussianExp(sigma2, mip));
-	};
+bool Filter::deepen(const CommandList &commandList, float sigma)
+{
+	const auto numMips = getNumMips(sigma);
+	C_RETURN(numMips <= m_numMips, true);
+
+	// The levels are all reduced again, down to the new coarsest one
+	m_numMips = numMips;
+	InvalidateSource();
+
+	// The copy runs with this frame, which keeps the uploader until it comes round,
+	// so each deepening of the frame takes one of its own and none of them waits
+	auto &uploaders = m_weightUploaders[m_frameIndex];
+	uploaders.push_back(nullptr);
+	N_RETURN(uploadWeights(commandList, uploaders.back()), false);
 
-	const auto MipWeight = [GaussianBasis](double fSigma2, uint32_t mip, double mipStep = 1.0)
+	return createLevelTables();
+}
+
+bool Filter::SetSigmaMap(const shared_ptr<ResourceBase> &sigmaMap, float maxScale)
+{
+	m_sigmaMap = sigmaMap;
+	m_maxSigmaScale = (max)(maxScale, 0.0f);
+	C_RETURN(!m_sigmaMap, true);
+
+	// Reduced levels of the whole chain, as the chains in use may deepen into any
+	// of them, and their tables, created on first use; the first level reads the
+	// given map through a transient table in Process()
+	const auto numPasses = m_maxMips > 0 ? m_maxMips - 1 : 0;
+	if (!m_sigmaMaps.GetResource())
 	{
-		const double g[] =
+		const auto &desc = m_source.GetResource()->GetDesc();
+		N_RETURN(m_sigmaMaps.Create(m_device, static_cast<uint32_t>(desc.Width), desc.Height,
+			DXGI_FORMAT_R16_FLOAT, 1, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, m_maxMips), false);
+		m_descriptorTableCache.ReserveDescriptorPool(CBV_SRV_UAV_POOL, 3 * numPasses);
+
+		m_sigmaMapSrvTables.resize(numPasses);
+		for (auto i = 0ui8; i < numPasses; ++i)
 		{
-			GaussianBasis(fSigma2, mip),
-			GaussianBasis(fSigma2, mipStep > 0 ? mip + mipStep : -1)
-		};
+			const auto descriptor = m_sigmaMaps.GetSRVLevel(i);
+			Util::DescriptorTable utilSrvTable;
+			utilSrvTable.SetDescriptors(0, 1, &descriptor);
+			X_RETURN(m_sigmaMapSrvTables[i], utilSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+		}
 
-		return static_cast<float>((1 << (2 * mip)) * (g[0] - g[1]));
+		// Get UAV and SRVs
+		m_sigmaMapTables.resize(numPasses);
+		for (auto i = 1ui8; i < numPasses; ++i)
+		{
+			const Descriptor descriptors[] =
+			{
+				m_sigmaMaps.GetSRVLevel(i - 1),
+				m_sigmaMaps.GetUAV(i)
+			};
+			Util::DescriptorTable utilUavSrvTable;
+			utilUavSrvTable.SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+			X_RETURN(m_sigmaMapTables[i], utilUavSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+		}
+	}
+
+	return true;
+}
+
+void Filter::SetFrameIndex(uint8_t frameIndex)
+{
+	m_descriptorTableCache.SetFrameIndex(frameIndex);
+	m_frameIndex = frameIndex;
+
+	// The GPU is done with the deepenings of the frame's previous use, and with
+	// the frames before it, so the tables that they replaced are removed along
+	// with their uploaders
+	for (const auto &levelTable : m_staleLevelTables[frameIndex])
+		m_descriptorTableCache.RemoveCbvSrvUavTable(levelTable);
+	m_staleLevelTables[frameIndex].clear();
+	m_weightUploaders[frameIndex].clear();
+}
+
+const BarrierScheduler::Stats &Filter::GetBarrierStats() const
+{
+	return m_barrierScheduler.GetStats();
+}
+
+void Filter::SetIntermediateFormat(DXGI_FORMAT format)
+{
+	m_format = format;
+}
+
+void Filter::SetSinglePassDownSample(bool singlePass)
+{
+	m_isSinglePass = singlePass;
+}
+
+void Filter::SetCoarseUpSampleSize(uint32_t size)
+{
+	m_coarseUpSampleSize = size;
+}
+
+void Filter::SetWeightTolerance(float tolerance)
+{
+	m_weightTolerance = tolerance;
+}
+
+void Filter::SetDepthTolerance(float tolerance)
+{
+	m_depthTolerance = tolerance;
+}
+
+void Filter::SetWeightTable(uint32_t resolution, float maxSigma)
+{
+	m_weightTableResolution = resolution;
+	m_weightTableMaxSigma = maxSigma;
+}
+
+uint8_t Filter::getCutoffLevel(XMFLOAT2 focus, float sigma, const RectRange *pRoi,
+	uint32_t width, uint32_t height) const
+{
+	const uint8_t numPasses = m_numMips > 0 ? m_numMips - 1 : 0;
+	C_RETURN(m_weightTolerance < 0.0f, numPasses);
+
+	// The radial falloff of CSUpSample.hlsl is the largest at the texel centers
+	// of either end of a range that are the farthest from the focus, and a sigma
+	// map is clamped to its largest scale
+	const auto maxDistance2 = [](LONG i0, LONG i1, uint32_t size, float focus)
+	{
+		const auto r0 = static_cast<float>(2 * i0 + 1) / size - 1.0f - focus;
+		const auto r1 = static_cast<float>(2 * i1 - 1) / size - 1.0f - focus;
+
+		return (max)(r0 * r0, r1 * r1);
 	};
 
-	auto sum = 0.0f, weight = 0.0f;
-	for (auto i = mip; i < m_numMips; ++i)
+	// The weight of a level falls as sigma grows, and rises with the level
+	for (auto j = 0ui8; j < numPasses; ++j)
 	{
-		const auto w = MipWeight(sigma * sigma, i);
-		weight = i == mip ? w : weight;
-		sum += w;
+		const auto levelWidth = (max)(width >> j, 1u);
+		const auto levelHeight = (max)(height >> j, 1u);
+		const auto rect = pRoi ? m_roiRects[TABLE_UP_SAMPLE][j] :
+			RectRange(0, 0, static_cast<LONG>(levelWidth), static_cast<LONG>(levelHeight));
+		const auto r2 = maxDistance2(rect.left, rect.right, levelWidth, focus.x) +
+			maxDistance2(rect.top, rect.bottom, levelHeight, focus.y);
+		const auto maxSigma = sigma * (m_sigmaMap ? m_maxSigmaScale : (min)((max)(r2 + 0.25f, 0.0f), 1.0f));
+		C_RETURN(1.0f - computeWeight(j, maxSigma) <= m_weightTolerance, j);
 	}
 
-	return sum > 0.0f ? weight / sum : 1.0f;
-	//return mip == 6 ? 1.0f : 0.0f;
-	//return mip < 6 ? 0.005f : 1.0f;//0.25f / (m_numMips - mip) : 1.0f;
+	return numPasses;
+}
+
+float Filter::computeWeight(uint32_t mip, float sigma) const
+{
+	// The table is empty before Init() or without a resolution, so the weight
+	// it would hold is evaluated instead
+	if (mip >= m_weightTableData.GetNumLevels() || m_weightTableData.GetResolution() < 2)
+		return CPU::UpSampleWeight(sigma * sigma, mip, m_numMips);
+
+	return m_weightTableData.Lookup(sigma, mip);
 }
@@ -6,6 +6,7 @@
 
 #include "DXFramework.h"
 #include "Core/XUSG.h"
+#include "CPUWeightTable.h"
 
 class Filter
 {
@@ -17,12 +18,91 @@ public:
 		std::shared_ptr<XUSG::ResourceBase> &source, std::vector<XUSG::Resource> &uploaders,
 		const wchar_t *fileName = L"Lenna.dds");
 
+	// Process() down samples the source only when it has changed since the last
+	// call, or the down sampling has; otherwise it only up samples the levels kept
+	// from then for the new focus and sigma
 	void Process(const XUSG::CommandList &commandList, DirectX::XMFLOAT2 focus, float sigma);
+
+	// Evaluates the result within roi only, dispatching the up sampling and, if the
+	// levels are not kept, the down sampling over the rectangles of the levels that
+	// it needs; the rest of the result is undefined. The down sampling, unless in
+	// the single pass, is then partial, so the next Process() runs it again.
+	void Process(const XUSG::CommandList &commandList, DirectX::XMFLOAT2 focus, float sigma,
+		const XUSG::RectRange &roi);
 	void ProcessG(const XUSG::CommandList &commandList);
 
+	// Copies a new source of the dimensions of the first, and has the next
+	// Process() down sample it
+	void UpdateSource(const XUSG::CommandList &commandList, const std::shared_ptr<XUSG::ResourceBase> &source);
+
+	// Copies dirtyRect of a new source alone; the next Process() down samples only
+	// the rectangles of the levels that it reaches, unless in the single pass. The
+	// up sampling still covers the levels whole, as each texel of the result
+	// blends in the coarsest levels.
+	void UpdateSource(const XUSG::CommandList &commandList, const std::shared_ptr<XUSG::ResourceBase> &source,
+		const XUSG::RectRange &dirtyRect);
+
+	// Has the next Process() down sample the source again, e.g. after it was
+	// written in place
+	void InvalidateSource();
+
 	XUSG::Texture2D &GetResult();
 
+	// Per-pixel sigma scales in channel r of any resolution, replacing the radial
+	// falloff around the focus; Process() reduces them to every level along with
+	// the image. The scales are clamped to maxScale, by which the depth of the
+	// chains is bounded as it is by 1 for the radial falloff. nullptr restores the
+	// radial falloff; call after Init().
+	bool SetSigmaMap(const std::shared_ptr<XUSG::ResourceBase> &sigmaMap, float maxScale = 1.0f);
+
+	// Resolution and sigma range of the up-sample weight table; call before Init()
+	void SetWeightTable(uint32_t resolution, float maxSigma = 64.0f);
+
+	// Format of the levels between the source and the result; call before Init().
+	// B8G8R8A8_UNORM quantizes each level to 8 bits, which bands at large sigmas;
+	// R16G16B16A16_FLOAT, R11G11B10_FLOAT and R10G10B10A2_UNORM keep more bits.
+	// The source and the result, level 0 of the chains, stay B8G8R8A8.
+	void SetIntermediateFormat(DXGI_FORMAT format);
+
+	// Generates the down-sampling chain in a single dispatch, reducing 64x64 tiles
+	// in groupshared memory with the 2x2 box of CSResample.hlsl (not its 5-tap
+	// _HIGH_QUALITY_ filter). Sources of odd dimensions keep a dispatch per level.
+	void SetSinglePassDownSample(bool singlePass);
+
+	// Up samples all the levels of at most size x size texels in one dispatch of a
+	// single group, instead of a dispatch each; 0 disables it, and sizes are
+	// clamped to MaxCoarseUpSampleSize. Ignored with a sigma map.
+	void SetCoarseUpSampleSize(uint32_t size);
+
+	// Largest weight of the coarser levels that Process() drops: the up sampling
+	// starts from the finest level of which the coarser ones weigh no more over
+	// the whole frame, blending its down-sampled level in for its resolved one,
+	// so a sharp frame is a single dispatch. Past it, each 8x8 group of a level
+	// that bounds its sigmas likewise copies the level through, so the sharp parts
+	// of a frame skip the coarser levels. 0 only drops the levels of no weight at
+	// all, and a negative tolerance up samples every level.
+	void SetWeightTolerance(float tolerance);
+
+	// Largest weight of the levels past the coarsest one that the chains leave
+	// out: Process() reduces the source only down to the first level of which the
+	// coarser ones weigh no more at the largest sigma so far, deepening the chains
+	// and their descriptor tables when a larger one comes; 0 only leaves out those
+	// of no weight at all, and a negative tolerance keeps every level. A sigma map
+	// scales the sigma by its largest scale, see SetSigmaMap().
+	void SetDepthTolerance(float tolerance);
+
+	// Recycles the transient descriptors of the frame, which hold the bindings that
+	// may change every frame; call before Process() once the GPU is done with the
+	// frame's previous use, as with its command allocator. It also releases what
+	// the deepenings of that use replaced, and their uploaders.
+	void SetFrameIndex(uint8_t frameIndex);
+
+	// Barriers issued by Process() so far
+	const XUSG::BarrierScheduler::Stats &GetBarrierStats() const;
+
 	static const uint32_t FrameCount = 3;
+	static const uint32_t TransientDescriptorCount = 16;	// Per frame, 2 per Process() with a sigma map, which fails past them
+	static const uint32_t MaxCoarseUpSampleSize = 32;	// Of the groupshared levels of CSUpSampleCoarse.hlsl
 
 protected:
 	enum PipelineIndex : uint8_t
@@ -30,6 +110,10 @@ protected:
 		RESAMPLE,
 		UP_SAMPLE,
 		GAUSSIAN,
+		RESAMPLE_SIGMA,
+		UP_SAMPLE_SIGMA_MAP,
+		RESAMPLE_SINGLE_PASS,
+		UP_SAMPLE_COARSE,
 
 		NUM_PIPELINE
 	};
@@ -42,11 +126,40 @@ protected:
 		NUM_UAV_SRV
 	};
 
+	void process(const XUSG::CommandList &commandList, DirectX::XMFLOAT2 focus, float sigma,
+		const XUSG::RectRange *pRoi);
+	void setRegionOfInterest(const XUSG::RectRange &roi, uint32_t width, uint32_t height);
+
 	bool createPipelineLayouts();
 	bool createPipelines();
 	bool createDescriptorTables();
-
-	float computeWeight(uint32_t mip) const;
+	bool createLevelTables();
+	bool uploadWeights(const XUSG::CommandList &commandList, XUSG::Resource &uploader);
+	bool deepen(const XUSG::CommandList &commandList, float sigma);
+
+	XUSG::DescriptorTable getSigmaMapTable();
+	XUSG::Descriptor getLevelSRV(UavSrvTableIndex chain, uint8_t level) const;
+	XUSG::Descriptor getLevelUAV(UavSrvTableIndex chain, uint8_t level) const;
+	float getQuantization() const;
+	uint8_t getCoarseLevel(uint32_t width, uint32_t height, uint32_t size) const;
+	uint8_t getNumMips(float sigma) const;
+	uint8_t getCutoffLevel(DirectX::XMFLOAT2 focus, float sigma, const XUSG::RectRange *pRoi,
+		uint32_t width, uint32_t height) const;
+
+	static XUSG::RectRange getLevelRect(const XUSG::RectRange &rect, uint32_t srcWidth,
+		uint32_t srcHeight, uint32_t width, uint32_t height);
+	static void getGroupRange(const XUSG::RectRange &rect, uint32_t offset[2],
+		uint32_t &numGroupsX, uint32_t &numGroupsY);
+
+	void copySource(const XUSG::CommandList &commandList, const std::shared_ptr<XUSG::ResourceBase> &source,
+		const XUSG::RectRange *pRect = nullptr);
+
+	void trackBarrierStates();
+	void commitBarrierStates();
+	void flushBarriers(const XUSG::CommandList &commandList);
+	void transitionLevel(UavSrvTableIndex chain, uint8_t level, XUSG::ResourceState state, bool isBegin = false);
+
+	float computeWeight(uint32_t mip, float sigma) const;
 
 	XUSG::Device m_device;
 
@@ -54,14 +167,52 @@ protected:
 	XUSG::Compute::PipelineCache	m_computePipelineCache;
 	XUSG::PipelineLayoutCache		m_pipelineLayoutCache;
 	XUSG::DescriptorTableCache		m_descriptorTableCache;
+	XUSG::BarrierScheduler			m_barrierScheduler;
 
 	XUSG::PipelineLayout	m_pipelineLayouts[NUM_PIPELINE];
 	XUSG::Pipeline			m_pipelines[NUM_PIPELINE];
 
 	std::vector<XUSG::DescriptorTable> m_uavSrvTables[NUM_UAV_SRV];
+	std::vector<XUSG::DescriptorTable> m_cutoffTables;	// Up sampling of level i from down-sampled level i + 1
+	std::vector<XUSG::DescriptorTable> m_sigmaMapTables;	// Reduction of level i - 1 into i, from 1
+	std::vector<XUSG::DescriptorTable> m_sigmaMapSrvTables;
+	std::vector<XUSG::Util::DescriptorTable> m_levelTables;			// Keys of the tables of the levels in use
+	std::vector<XUSG::Util::DescriptorTable> m_staleLevelTables[FrameCount];	// Replaced by the deepenings of each frame
 	XUSG::DescriptorTable	m_samplerTable;
-
-	XUSG::Texture2D			m_filtered[NUM_UAV_SRV];
-
-	uint8_t					m_numMips;
+	XUSG::DescriptorTable	m_weightTable;
+	XUSG::DescriptorTable	m_singlePassTable;
+	XUSG::DescriptorTable	m_coarseUpSampleTable;
+
+	XUSG::Texture2D			m_filtered[NUM_UAV_SRV];	// Levels 1 to m_maxMips - 1, as mips from 0
+	XUSG::Texture2D			m_source;	// Level 0 of the down sampling
+	XUSG::Texture2D			m_result;	// Level 0 of the up sampling
+	XUSG::Texture2D			m_weights;	// A row per level, of those in use
+	XUSG::Texture2D			m_sigmaMaps;
+	XUSG::RawBuffer			m_singlePassScratch;	// Group counter and tail levels
+
+	std::shared_ptr<XUSG::ResourceBase> m_sigmaMap;
+	std::vector<XUSG::Resource> m_weightUploaders[FrameCount];	// Of the weights of the deepenings of each frame
+
+	CPU::WeightTable		m_weightTableData;
+	uint32_t				m_weightTableResolution;
+	uint32_t				m_coarseUpSampleSize;
+	float					m_weightTableMaxSigma;
+	float					m_weightTolerance;
+	float					m_depthTolerance;
+	float					m_maxSigmaScale;
+	DXGI_FORMAT				m_format;
+
+	uint8_t					m_numMips;	// Of the chains in use, see SetDepthTolerance()
+	uint8_t					m_maxMips;
+	uint8_t					m_numTileLevels;	// Reduced within the tiles of the single pass
+	uint8_t					m_coarseTableLevel;	// Finest level that can be up sampled in the coarse pass
+	uint8_t					m_frameIndex;
+	bool					m_isSinglePass;
+	bool					m_isPyramidValid;		// Down-sampled levels of the current source
+	bool					m_isPyramidSinglePass;	// By the single pass, with its box filter
+
+	XUSG::RectRange			m_dirtyRect;	// Of the source since the last Process()
+	std::vector<XUSG::RectRange> m_roiRects[NUM_UAV_SRV];	// Of the levels the region of interest needs
+
+	static const uint8_t MaxTileLevels = 6;	// log2 of the tile size of the single pass
 };
@@ -0,0 +1,365 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+#include "FilterBatch.h"
+
+using namespace std;
+using namespace DirectX;
+using namespace XUSG;
+
+FilterBatch::FilterBatch(const Device &device) :
+	m_device(device),
+	m_weightTableResolution(256),
+	m_weightTableMaxSigma(64.0f),
+	m_maxNumMips(0)
+{
+	m_computePipelineCache.SetDevice(device);
+	m_descriptorTableCache.SetDevice(device);
+	m_pipelineLayoutCache.SetDevice(device);
+}
+
+FilterBatch::~FilterBatch()
+{
+}
+
+bool FilterBatch::Init(const CommandList &commandList, const vector<shared_ptr<ResourceBase>> &sources,
+	vector<Resource> &uploaders)
+{
+	// Group the images by size
+	map<pair<uint32_t, uint32_t>, uint32_t> bucketIndices;
+	m_buckets.clear();
+	m_imageSlots.resize(sources.size());
+	m_maxNumMips = 0;
+	for (auto i = 0u; i < sources.size(); ++i)
+	{
+		const auto &desc = sources[i]->GetResource()->GetDesc();
+		const auto size = make_pair(static_cast<uint32_t>(desc.Width), static_cast<uint32_t>(desc.Height));
+		const auto bucketIndex = bucketIndices.emplace(size, static_cast<uint32_t>(m_buckets.size())).first->second;
+		if (bucketIndex == m_buckets.size())
+		{
+			m_buckets.emplace_back(make_unique<Bucket>());
+			auto &bucket = *m_buckets.back();
+			bucket.Width = size.first;
+			bucket.Height = size.second;
+			bucket.NumMips = static_cast<uint8_t>(log2f(static_cast<float>((max)(size.first, size.second))) + 1.0f);
+			m_maxNumMips = (max)(m_maxNumMips, bucket.NumMips);
+		}
+
+		auto &bucket = *m_buckets[bucketIndex];
+		m_imageSlots[i] = make_pair(bucketIndex, static_cast<uint32_t>(bucket.Images.size()));
+		bucket.Images.push_back(i);
+	}
+
+	// Enough for the transitions of every slice of 2 resources at a time
+	m_barriers.resize(2 * sources.size() + 2);
+
+	N_RETURN(createPipelineLayouts(), false);
+	N_RETURN(createPipelines(), false);
+
+	// Reserve the descriptors of all the buckets up front, 2 + 3 per pass and the weights
+	auto numDescriptors = 0u;
+	for (const auto &pBucket : m_buckets) numDescriptors += 5 * (pBucket->NumMips - 1) + 1;
+	m_descriptorTableCache.ReserveDescriptorPool(CBV_SRV_UAV_POOL, numDescriptors);
+	m_descriptorTableCache.ReserveDescriptorPool(SAMPLER_POOL, 1);
+
+	// Create resources
+	for (auto &pBucket : m_buckets)
+	{
+		auto &bucket = *pBucket;
+		const auto arraySize = (max)(static_cast<uint32_t>(bucket.Images.size()), 2u);
+		for (auto &image : bucket.Filtered)
+			N_RETURN(image.Create(m_device, bucket.Width, bucket.Height, DXGI_FORMAT_B8G8R8A8_UNORM, arraySize,
+				D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, bucket.NumMips), false);
+
+		// Normalized up-sample weights, a row per level
+		N_RETURN(bucket.WeightTableData.Create(bucket.NumMips, m_weightTableMaxSigma, m_weightTableResolution), false);
+		N_RETURN(bucket.Weights.Create(m_device, m_weightTableResolution, bucket.NumMips, DXGI_FORMAT_R32_FLOAT), false);
+		uploaders.push_back(nullptr);
+		N_RETURN(bucket.Weights.Upload(commandList, uploaders.back(), bucket.WeightTableData.GetData(),
+			sizeof(float), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE), false);
+
+		N_RETURN(createDescriptorTables(bucket), false);
+	}
+
+	// Create the sampler table
+	Util::DescriptorTable samplerTable;
+	const auto sampler = LINEAR_CLAMP;
+	samplerTable.SetSamplers(0, 1, &sampler, m_descriptorTableCache);
+	X_RETURN(m_samplerTable, samplerTable.GetSamplerTable(m_descriptorTableCache), false);
+
+	// Copy sources into level 0 of their slices
+	{
+		auto numBarriers = 0u;
+		for (auto i = 0u; i < sources.size(); ++i)
+		{
+			const auto &bucket = *m_buckets[m_imageSlots[i].first];
+			const auto subresource = getSubresource(bucket, 0, m_imageSlots[i].second);
+			numBarriers = bucket.Filtered[TABLE_DOWN_SAMPLE].SetBarrier(m_barriers.data(),
+				D3D12_RESOURCE_STATE_COPY_DEST, numBarriers, subresource);
+			numBarriers = sources[i]->SetBarrier(m_barriers.data(), D3D12_RESOURCE_STATE_COPY_SOURCE, numBarriers, 0);
+		}
+		commandList.Barrier(numBarriers, m_barriers.data());
+
+		numBarriers = 0;
+		for (auto i = 0u; i < sources.size(); ++i)
+		{
+			const auto &bucket = *m_buckets[m_imageSlots[i].first];
+			const auto subresource = getSubresource(bucket, 0, m_imageSlots[i].second);
+			const TextureCopyLocation dst(bucket.Filtered[TABLE_DOWN_SAMPLE].GetResource().get(), subresource);
+			const TextureCopyLocation src(sources[i]->GetResource().get(), 0);
+			commandList.CopyTextureRegion(dst, 0, 0, 0, src);
+
+			numBarriers = bucket.Filtered[TABLE_DOWN_SAMPLE].SetBarrier(m_barriers.data(),
+				D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, numBarriers, subresource);
+		}
+		commandList.Barrier(numBarriers, m_barriers.data());
+	}
+
+	return true;
+}
+
+void FilterBatch::Process(const CommandList &commandList, XMFLOAT2 focus, float sigma)
+{
+	const uint8_t maxNumPasses = m_maxNumMips > 0 ? m_maxNumMips - 1 : 0;
+	const auto pBarriers = m_barriers.data();
+
+	// Set Descriptor pools
+	const DescriptorPool descriptorPools[] =
+	{
+		m_descriptorTableCache.GetDescriptorPool(CBV_SRV_UAV_POOL),
+		m_descriptorTableCache.GetDescriptorPool(SAMPLER_POOL)
+	};
+	commandList.SetDescriptorPools(static_cast<uint32_t>(size(descriptorPools)), descriptorPools);
+
+	// Generate Mips; the coarsest level of each size goes to its up-sampling chain
+	commandList.SetComputePipelineLayout(m_pipelineLayouts[RESAMPLE]);
+	commandList.SetPipelineState(m_pipelines[RESAMPLE]);
+	commandList.SetComputeDescriptorTable(0, m_samplerTable);
+
+	auto numBarriers = 0u;
+	for (auto j = 1ui8; j <= maxNumPasses; ++j)
+	{
+		for (const auto &pBucket : m_buckets)
+		{
+			const auto numPasses = pBucket->NumMips - 1;
+			if (j > numPasses) continue;
+
+			auto &dst = pBucket->Filtered[j < numPasses ? TABLE_DOWN_SAMPLE : TABLE_UP_SAMPLE];
+			for (auto slice = 0u; slice < pBucket->Images.size(); ++slice)
+				numBarriers = dst.SetBarrier(pBarriers, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+					numBarriers, getSubresource(*pBucket, j, slice));
+		}
+		commandList.Barrier(numBarriers, pBarriers);
+
+		numBarriers = 0;
+		for (const auto &pBucket : m_buckets)
+		{
+			auto &bucket = *pBucket;
+			const auto numPasses = bucket.NumMips - 1;
+			if (j > numPasses) continue;
+
+			const auto numSlices = static_cast<uint32_t>(bucket.Images.size());
+			commandList.SetComputeDescriptorTable(1, bucket.UavSrvTables[TABLE_DOWN_SAMPLE][j - 1]);
+			commandList.Dispatch(((max)(bucket.Width >> j, 1u) + 7) / 8, ((max)(bucket.Height >> j, 1u) + 7) / 8, numSlices);
+
+			// Merged into the barriers of the next level
+			if (j < numPasses)
+				for (auto slice = 0u; slice < numSlices; ++slice)
+					numBarriers = bucket.Filtered[TABLE_DOWN_SAMPLE].SetBarrier(pBarriers,
+						D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, numBarriers, getSubresource(bucket, j, slice));
+		}
+	}
+
+	// Up sampling, aligned at the coarsest level of each size
+	commandList.SetComputePipelineLayout(m_pipelineLayouts[UP_SAMPLE]);
+	commandList.SetPipelineState(m_pipelines[UP_SAMPLE]);
+	commandList.SetComputeDescriptorTable(0, m_samplerTable);
+
+	struct G
+	{
+		XMFLOAT2	Focus;
+		float		Sigma;
+		uint16_t	Level;
+		uint16_t	NumLevels;
+		float		WeightAxisScale;
+	} cb = { focus, sigma, 0, 0, 0.0f };
+
+	for (auto i = 0ui8; i < maxNumPasses; ++i)
+	{
+		for (const auto &pBucket : m_buckets)
+		{
+			const uint8_t numPasses = pBucket->NumMips - 1;
+			if (i >= numPasses) continue;
+
+			const auto c = numPasses - i;
+			const auto j = c - 1;
+			auto &up = pBucket->Filtered[TABLE_UP_SAMPLE];
+			for (auto slice = 0u; slice < pBucket->Images.size(); ++slice)
+			{
+				numBarriers = up.SetBarrier(pBarriers, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+					numBarriers, getSubresource(*pBucket, c, slice));
+				numBarriers = up.SetBarrier(pBarriers, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+					numBarriers, getSubresource(*pBucket, j, slice));
+			}
+		}
+		commandList.Barrier(numBarriers, pBarriers);
+
+		numBarriers = 0;
+		for (const auto &pBucket : m_buckets)
+		{
+			auto &bucket = *pBucket;
+			const uint8_t numPasses = bucket.NumMips - 1;
+			if (i >= numPasses) continue;
+
+			const auto j = numPasses - i - 1;
+			cb.Level = j;
+			cb.NumLevels = bucket.NumMips;
+			cb.WeightAxisScale = bucket.WeightTableData.GetAxisScale();
+			commandList.SetComputeDescriptorTable(1, bucket.UavSrvTables[TABLE_UP_SAMPLE][i]);
+			commandList.SetCompute32BitConstants(2, 5, &cb);
+			commandList.SetComputeDescriptorTable(3, bucket.WeightTable);
+			commandList.Dispatch(((max)(bucket.Width >> j, 1u) + 7) / 8, ((max)(bucket.Height >> j, 1u) + 7) / 8,
+				static_cast<uint32_t>(bucket.Images.size()));
+		}
+	}
+}
+
+Texture2D &FilterBatch::GetResult(uint32_t i)
+{
+	return m_buckets[m_imageSlots[i].first]->Filtered[TABLE_UP_SAMPLE];
+}
+
+uint32_t FilterBatch::GetResultSlice(uint32_t i) const
+{
+	return m_imageSlots[i].second;
+}
+
+uint32_t FilterBatch::GetNumImages() const
+{
+	return static_cast<uint32_t>(m_imageSlots.size());
+}
+
+void FilterBatch::SetWeightTable(uint32_t resolution, float maxSigma)
+{
+	m_weightTableResolution = resolution;
+	m_weightTableMaxSigma = maxSigma;
+}
+
+bool FilterBatch::createPipelineLayouts()
+{
+	// Resampling
+	{
+		Util::PipelineLayout utilPipelineLayout;
+		utilPipelineLayout.SetRange(0, DescriptorType::SAMPLER, 1, 0);
+		utilPipelineLayout.SetRange(1, DescriptorType::SRV, 1, 0);
+		utilPipelineLayout.SetRange(1, DescriptorType::UAV, 1, 0, 0,
+			D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		X_RETURN(m_pipelineLayouts[RESAMPLE], utilPipelineLayout.GetPipelineLayout(
+			m_pipelineLayoutCache, D3D12_ROOT_SIGNATURE_FLAG_NONE, L"ResamplingArrayLayout"), false);
+	}
+
+	// Up sampling
+	{
+		Util::PipelineLayout utilPipelineLayout;
+		utilPipelineLayout.SetRange(0, DescriptorType::SAMPLER, 1, 0);
+		utilPipelineLayout.SetRange(1, DescriptorType::SRV, 2, 0);
+		utilPipelineLayout.SetRange(1, DescriptorType::UAV, 1, 0, 0,
+			D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		utilPipelineLayout.SetConstants(2, 5, 0);
+		utilPipelineLayout.SetRange(3, DescriptorType::SRV, 1, 2);
+		X_RETURN(m_pipelineLayouts[UP_SAMPLE], utilPipelineLayout.GetPipelineLayout(
+			m_pipelineLayoutCache, D3D12_ROOT_SIGNATURE_FLAG_NONE, L"UpSamplingArrayLayout"), false);
+	}
+
+	return true;
+}
+
+bool FilterBatch::createPipelines()
+{
+	// Load all the shaders in parallel, so that creating each pipeline overlaps
+	// with loading the rest
+	m_shaderPool.CreateShaderAsync(Shader::Stage::CS, RESAMPLE, L"CSResampleArray.cso");
+	m_shaderPool.CreateShaderAsync(Shader::Stage::CS, UP_SAMPLE, L"CSUpSampleArray.cso");
+
+	// Compiled by a previous run, next to the shader objects
+	m_computePipelineCache.LoadPipelineLibrary(L"FilterBatchPipelines.bin");
+
+	// Resampling
+	{
+		N_RETURN(m_shaderPool.GetShader(Shader::Stage::CS, RESAMPLE), false);
+
+		Compute::State state;
+		state.SetPipelineLayout(m_pipelineLayouts[RESAMPLE]);
+		state.SetShader(m_shaderPool.GetShader(Shader::Stage::CS, RESAMPLE));
+		X_RETURN(m_pipelines[RESAMPLE], state.GetPipeline(m_computePipelineCache, L"ResamplingArray"), false);
+	}
+
+	// Up sampling
+	{
+		N_RETURN(m_shaderPool.GetShader(Shader::Stage::CS, UP_SAMPLE), false);
+
+		Compute::State state;
+		state.SetPipelineLayout(m_pipelineLayouts[UP_SAMPLE]);
+		state.SetShader(m_shaderPool.GetShader(Shader::Stage::CS, UP_SAMPLE));
+		X_RETURN(m_pipelines[UP_SAMPLE], state.GetPipeline(m_computePipelineCache, L"UpSamplingArray"), false);
+	}
+
+	N_RETURN(m_shaderPool.WaitForShaders(), false);
+	m_computePipelineCache.SavePipelineLibrary(L"FilterBatchPipelines.bin");
+
+	return true;
+}
+
+bool FilterBatch::createDescriptorTables(Bucket &bucket)
+{
+	const uint8_t numPasses = bucket.NumMips - 1;
+	auto &down = bucket.Filtered[TABLE_DOWN_SAMPLE];
+	auto &up = bucket.Filtered[TABLE_UP_SAMPLE];
+	bucket.UavSrvTables[TABLE_DOWN_SAMPLE].resize(numPasses);
+	bucket.UavSrvTables[TABLE_UP_SAMPLE].resize(numPasses);
+	for (auto i = 0ui8; i < numPasses; ++i)
+	{
+		// Level i + 1 from level i, the coarsest one into the up-sampling chain
+		{
+			const Descriptor descriptors[] =
+			{
+				down.GetSRVLevel(i),
+				i + 1 < numPasses ? down.GetUAV(i + 1) : up.GetUAV(i + 1)
+			};
+			Util::DescriptorTable utilUavSrvTable;
+			utilUavSrvTable.SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+			X_RETURN(bucket.UavSrvTables[TABLE_DOWN_SAMPLE][i], utilUavSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+		}
+
+		{
+			const auto coarser = numPasses - i;
+			const auto current = coarser - 1;
+			const Descriptor descriptors[] =
+			{
+				down.GetSRVLevel(current),
+				up.GetSRVLevel(coarser),
+				up.GetUAV(current)
+			};
+			Util::DescriptorTable utilUavSrvTable;
+			utilUavSrvTable.SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+			X_RETURN(bucket.UavSrvTables[TABLE_UP_SAMPLE][i], utilUavSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+		}
+	}
+
+	// Create the weight table
+	{
+		const auto descriptor = bucket.Weights.GetSRV();
+		Util::DescriptorTable utilSrvTable;
+		utilSrvTable.SetDescriptors(0, 1, &descriptor);
+		X_RETURN(bucket.WeightTable, utilSrvTable.GetCbvSrvUavTable(m_descriptorTableCache), false);
+	}
+
+	return true;
+}
+
+uint32_t FilterBatch::getSubresource(const Bucket &bucket, uint8_t level, uint32_t slice)
+{
+	return level + slice * bucket.NumMips;
+}
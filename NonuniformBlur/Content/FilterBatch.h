@@ -0,0 +1,93 @@
+//--------------------------------------------------------------------------------------
+// By XU, Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "DXFramework.h"
+#include "Core/XUSG.h"
+#include "CPUWeightTable.h"
+
+// Filters many images per command list. Images of the same size are packed into
+// the slices of texture arrays, so each level of each size takes one dispatch and
+// the barriers of all images at a level are issued together.
+class FilterBatch
+{
+public:
+	FilterBatch(const XUSG::Device &device);
+	virtual ~FilterBatch();
+
+	bool Init(const XUSG::CommandList &commandList,
+		const std::vector<std::shared_ptr<XUSG::ResourceBase>> &sources,
+		std::vector<XUSG::Resource> &uploaders);
+
+	void Process(const XUSG::CommandList &commandList, DirectX::XMFLOAT2 focus, float sigma);
+
+	// The result of image i is array slice GetResultSlice(i) of GetResult(i)
+	XUSG::Texture2D &GetResult(uint32_t i);
+	uint32_t GetResultSlice(uint32_t i) const;
+	uint32_t GetNumImages() const;
+
+	// Resolution and sigma range of the up-sample weight tables; call before Init()
+	void SetWeightTable(uint32_t resolution, float maxSigma = 64.0f);
+
+protected:
+	enum PipelineIndex : uint8_t
+	{
+		RESAMPLE,
+		UP_SAMPLE,
+
+		NUM_PIPELINE
+	};
+
+	enum UavSrvTableIndex : uint8_t
+	{
+		TABLE_DOWN_SAMPLE,
+		TABLE_UP_SAMPLE,
+
+		NUM_UAV_SRV
+	};
+
+	// Images of one size. The arrays keep at least 2 slices, so their views are
+	// always arrays.
+	struct Bucket
+	{
+		uint32_t				Width;
+		uint32_t				Height;
+		uint8_t					NumMips;
+		std::vector<uint32_t>	Images;
+
+		XUSG::Texture2D			Filtered[NUM_UAV_SRV];
+		XUSG::Texture2D			Weights;
+		CPU::WeightTable		WeightTableData;
+
+		std::vector<XUSG::DescriptorTable> UavSrvTables[NUM_UAV_SRV];
+		XUSG::DescriptorTable	WeightTable;
+	};
+
+	bool createPipelineLayouts();
+	bool createPipelines();
+	bool createDescriptorTables(Bucket &bucket);
+
+	static uint32_t getSubresource(const Bucket &bucket, uint8_t level, uint32_t slice);
+
+	XUSG::Device m_device;
+
+	XUSG::ShaderPool				m_shaderPool;
+	XUSG::Compute::PipelineCache	m_computePipelineCache;
+	XUSG::PipelineLayoutCache		m_pipelineLayoutCache;
+	XUSG::DescriptorTableCache		m_descriptorTableCache;
+
+	XUSG::PipelineLayout	m_pipelineLayouts[NUM_PIPELINE];
+	XUSG::Pipeline			m_pipelines[NUM_PIPELINE];
+
+	XUSG::DescriptorTable	m_samplerTable;
+
+	std::vector<std::unique_ptr<Bucket>>		m_buckets;
+	std::vector<std::pair<uint32_t, uint32_t>>	m_imageSlots;	// Bucket and slice of each image
+	std::vector<XUSG::ResourceBarrier>			m_barriers;
+
+	uint32_t				m_weightTableResolution;
+	float					m_weightTableMaxSigma;
+	uint8_t					m_maxNumMips;
+};
@@ -17,6 +17,7 @@ cbuffer cb
 // Textures
 //--------------------------------------------------------------------------------------
 Texture2D			g_txSource;
+Texture2D			g_txLevels;	// Levels from 1 on, as mips from 0; level 0 is g_txSource
 RWTexture2D<float4>	g_txDest;
 
 //--------------------------------------------------------------------------------------
@@ -35,8 +36,9 @@ void main(uint2 DTid : SV_DispatchThreadID)
 
 	float4 srcs[12];
 	const float2 tex = (DTid + 0.5) / dim;
-	for (uint i = 0; i < g_numLevels; ++i)
-		srcs[i] = g_txSource.SampleLevel(g_smpLinear, tex, i);
+	srcs[0] = g_txSource.SampleLevel(g_smpLinear, tex, 0);
+	for (uint i = 1; i < g_numLevels; ++i)
+		srcs[i] = g_txLevels.SampleLevel(g_smpLinear, tex, i - 1);
 
 	const float sigma2 = g_sigma * g_sigma;
 	float wsum = 0.0;
@@ -2,11 +2,32 @@
 // By Stars XU Tianchen
 //--------------------------------------------------------------------------------------
 
+#ifndef _ARRAY_
+//--------------------------------------------------------------------------------------
+// Constant buffer
+//--------------------------------------------------------------------------------------
+cbuffer cb : register (b0)
+{
+	uint2	g_offset;	// First texel of the dispatch, within the rectangle of the level to reduce
+};
+#endif
+
 //--------------------------------------------------------------------------------------
 // Textures
 //--------------------------------------------------------------------------------------
+#ifdef _ARRAY_
+Texture2DArray				g_txSource;
+RWTexture2DArray<float4>	g_txDest;
+#define TEXCOORD(uv)		float3(uv, DTid.z)
+#define DEST_INDEX			uint3(pos, DTid.z)
+#define OFFSET				0
+#else
 Texture2D			g_txSource;
 RWTexture2D<float4>	g_txDest;
+#define TEXCOORD(uv)		(uv)
+#define DEST_INDEX			pos
+#define OFFSET				g_offset
+#endif
 
 //--------------------------------------------------------------------------------------
 // Texture samplers
@@ -17,28 +38,34 @@ SamplerState	g_smpLinear;
 // Compute shader
 //--------------------------------------------------------------------------------------
 [numthreads(8, 8, 1)]
-void main(uint2 DTid : SV_DispatchThreadID )
+void main(uint3 DTid : SV_DispatchThreadID )
 {
 	float2 dim;
+#ifdef _ARRAY_
+	float arraySize;
+	g_txDest.GetDimensions(dim.x, dim.y, arraySize);
+#else
 	g_txDest.GetDimensions(dim.x, dim.y);
+#endif
 
-	const float2 tex = (DTid + 0.5) / dim;
+	const uint2 pos = DTid.xy + OFFSET;
+	const float2 tex = (pos + 0.5) / dim;
 
 #ifdef _HIGH_QUALITY_
 	float4 srcs[5];
-	srcs[0] = g_txSource.SampleLevel(g_smpLinear, tex, 0.0);
-	srcs[1] = g_txSource.SampleLevel(g_smpLinear, tex, 0.0, int2(-1, 0));
-	srcs[2] = g_txSource.SampleLevel(g_smpLinear, tex, 0.0, int2(1, 0));
-	srcs[3] = g_txSource.SampleLevel(g_smpLinear, tex, 0.0, int2(0, -1));
-	srcs[4] = g_txSource.SampleLevel(g_smpLinear, tex, 0.0, int2(0, 1));
+	srcs[0] = g_txSource.SampleLevel(g_smpLinear, TEXCOORD(tex), 0.0);
+	srcs[1] = g_txSource.SampleLevel(g_smpLinear, TEXCOORD(tex), 0.0, int2(-1, 0));
+	srcs[2] = g_txSource.SampleLevel(g_smpLinear, TEXCOORD(tex), 0.0, int2(1, 0));
+	srcs[3] = g_txSource.SampleLevel(g_smpLinear, TEXCOORD(tex), 0.0, int2(0, -1));
+	srcs[4] = g_txSource.SampleLevel(g_smpLinear, TEXCOORD(tex), 0.0, int2(0, 1));
 
 	float4 result = srcs[0] * 2.0;
 	[unroll]
 	for (uint i = 1; i < 5; ++i) result += srcs[i];
 	result /= 6.0;
 #else
-	const float4 result = g_txSource.SampleLevel(g_smpLinear, tex, 0.0);
+	const float4 result = g_txSource.SampleLevel(g_smpLinear, TEXCOORD(tex), 0.0);
 #endif
 
-	g_txDest[DTid] = result;
+	g_txDest[DEST_INDEX] = result;
 }
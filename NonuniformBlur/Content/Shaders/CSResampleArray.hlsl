@@ -0,0 +1,7 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+// Resampling of the slices of texture arrays, one slice per thread group layer
+#define _ARRAY_
+#include "CSResample.hlsl"
@@ -0,0 +1,27 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+Texture2D<float>	g_txSource;
+RWTexture2D<float>	g_txDest;
+
+//--------------------------------------------------------------------------------------
+// Texture samplers
+//--------------------------------------------------------------------------------------
+SamplerState	g_smpLinear;
+
+//--------------------------------------------------------------------------------------
+// Compute shader: bilinear reduction of the sigma map, one level per dispatch
+//--------------------------------------------------------------------------------------
+[numthreads(8, 8, 1)]
+void main(uint2 DTid : SV_DispatchThreadID)
+{
+	float2 dim;
+	g_txDest.GetDimensions(dim.x, dim.y);
+
+	const float2 tex = (DTid + 0.5) / dim;
+	g_txDest[DTid] = g_txSource.SampleLevel(g_smpLinear, tex, 0.0);
+}
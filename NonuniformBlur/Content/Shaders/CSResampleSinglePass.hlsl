@@ -0,0 +1,218 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#define TILE_SIZE		64
+#define GROUP_SIZE		16
+#define MAX_TILE_LEVELS	6
+
+//--------------------------------------------------------------------------------------
+// Constant buffer
+//--------------------------------------------------------------------------------------
+cbuffer cb : register (b0)
+{
+	uint	g_numTileLevels;	// Levels reduced within the tiles, up to MAX_TILE_LEVELS
+	uint	g_numLevels;		// Levels written, all but the source
+	uint	g_numGroups;
+	float	g_quantization;		// Steps of the unorm format of the levels, 0 for a float one
+};
+
+//--------------------------------------------------------------------------------------
+// Textures and buffers
+//--------------------------------------------------------------------------------------
+Texture2D					g_txSource	: register (t0);
+RWTexture2D<float4>			g_txDests[]	: register (u0);	// Levels 1 to g_numLevels
+
+// The group counter in the first 4 bytes, then 2 packed levels in turn for the
+// tail, since typed loads of B8G8R8A8 UAVs are not supported: RGBA8 for the
+// 8-bit format, RGBA16F for the others
+globallycoherent RWByteAddressBuffer g_rwScratch : register (u0, space1);
+
+//--------------------------------------------------------------------------------------
+// Texture samplers
+//--------------------------------------------------------------------------------------
+SamplerState	g_smpLinear	: register (s0);
+
+//--------------------------------------------------------------------------------------
+// Groupshared memory
+//--------------------------------------------------------------------------------------
+groupshared float4	g_texels[TILE_SIZE / 2][TILE_SIZE / 2];
+groupshared bool	g_isLastGroup;
+
+//--------------------------------------------------------------------------------------
+// Each level is quantized to the format of the levels as the per-level passes
+// store it before the next level reads it; float formats are rounded to halves
+// (exactly for R16G16B16A16_FLOAT, with more bits than R11G11B10_FLOAT keeps)
+//--------------------------------------------------------------------------------------
+float4 quantize(float4 color)
+{
+	return g_quantization > 0.0 ? round(saturate(color) * g_quantization) / g_quantization :
+		f16tof32(f32tof16(color));
+}
+
+bool isUnorm8()
+{
+	return g_quantization == 255.0;
+}
+
+uint getTexelStride()
+{
+	return isUnorm8() ? 4 : 8;
+}
+
+uint2 getLevelSize(uint2 size, uint level)
+{
+	return max(size >> level, 1);
+}
+
+void storeScratch(uint offset, uint2 size, uint2 pos, float4 color)
+{
+	const uint address = offset + (size.x * pos.y + pos.x) * getTexelStride();
+	if (isUnorm8())
+	{
+		const uint4 v = uint4(round(saturate(color) * 255.0));
+		g_rwScratch.Store(address, v.x | (v.y << 8) | (v.z << 16) | (v.w << 24));
+	}
+	else
+	{
+		const uint4 v = f32tof16(color);
+		g_rwScratch.Store2(address, v.xz | (v.yw << 16));
+	}
+}
+
+float4 loadScratch(uint offset, uint2 size, uint2 pos)
+{
+	const uint address = offset + (size.x * pos.y + pos.x) * getTexelStride();
+	if (isUnorm8())
+	{
+		const uint v = g_rwScratch.Load(address);
+
+		return float4(v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, v >> 24) / 255.0;
+	}
+
+	// Halves hold the 10-bit steps to within their rounding
+	const uint2 v = g_rwScratch.Load2(address);
+
+	return quantize(f16tof32(uint4(v.x, v.x >> 16, v.y, v.y >> 16)));
+}
+
+//--------------------------------------------------------------------------------------
+// LINEAR_CLAMP sampling of a level in the scratch buffer at the center of a
+// texel of the next level, the same taps as CSResample.hlsl
+//--------------------------------------------------------------------------------------
+float4 sampleScratch(uint offset, uint2 srcSize, uint2 dstSize, uint2 pos)
+{
+	const float2 uv = max((pos + 0.5) * srcSize / dstSize - 0.5, 0.0);
+	const uint2 i0 = min(uint2(uv), srcSize - 1);
+	const uint2 i1 = min(i0 + 1, srcSize - 1);
+	const float2 w = uv - i0;
+
+	const float4 c0 = lerp(loadScratch(offset, srcSize, uint2(i0.x, i0.y)),
+		loadScratch(offset, srcSize, uint2(i1.x, i0.y)), w.x);
+	const float4 c1 = lerp(loadScratch(offset, srcSize, uint2(i0.x, i1.y)),
+		loadScratch(offset, srcSize, uint2(i1.x, i1.y)), w.x);
+
+	return lerp(c0, c1, w.y);
+}
+
+//--------------------------------------------------------------------------------------
+// Compute shader: the whole down-sampling chain in one dispatch. Each group
+// reduces a 64x64 tile of the source through g_numTileLevels levels, which are
+// exact 2x reductions, in groupshared memory; the last group to finish then
+// resamples the remaining levels.
+//--------------------------------------------------------------------------------------
+[numthreads(GROUP_SIZE, GROUP_SIZE, 1)]
+void main(uint2 GTid : SV_GroupThreadID, uint2 Gid : SV_GroupID, uint GIndex : SV_GroupIndex)
+{
+	uint2 size;
+	g_txSource.GetDimensions(size.x, size.y);
+
+	// Level 1, 2x2 texels a thread, sampled from the source
+	uint2 levelSize = getLevelSize(size, 1);
+	[unroll]
+	for (uint i = 0; i < 4; ++i)
+	{
+		const uint2 pos = GTid * 2 + uint2(i & 1, i >> 1);
+		const uint2 dst = Gid * (TILE_SIZE / 2) + pos;
+		const float2 tex = (dst + 0.5) / levelSize;
+		const float4 color = quantize(g_txSource.SampleLevel(g_smpLinear, tex, 0.0));
+		if (all(dst < levelSize)) g_txDests[0][dst] = color;
+		g_texels[pos.y][pos.x] = color;
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	// The rest of the tile levels, each halving the texels of the one before
+	uint tileSize = TILE_SIZE / 2;
+	for (uint level = 2; level <= g_numTileLevels; ++level)
+	{
+		tileSize >>= 1;
+		levelSize = getLevelSize(size, level);
+		const bool isActive = all(GTid < tileSize);
+
+		float4 color = 0.0;
+		if (isActive)
+		{
+			const uint2 src = GTid * 2;
+			color = g_texels[src.y][src.x] + g_texels[src.y][src.x + 1] +
+				g_texels[src.y + 1][src.x] + g_texels[src.y + 1][src.x + 1];
+			color = quantize(color * 0.25);
+		}
+		GroupMemoryBarrierWithGroupSync();
+
+		const uint2 dst = Gid * tileSize + GTid;
+		if (isActive)
+		{
+			if (all(dst < levelSize)) g_txDests[level - 1][dst] = color;
+			g_texels[GTid.y][GTid.x] = color;
+		}
+		GroupMemoryBarrierWithGroupSync();
+	}
+
+	// Done if the tiles cover the chain
+	if (g_numTileLevels >= g_numLevels) return;
+
+	// Hand the last tile level over to the tail
+	uint offset = 4;
+	{
+		levelSize = getLevelSize(size, g_numTileLevels);
+		const uint2 dst = Gid * tileSize + GTid;
+		if (all(GTid < tileSize) && all(dst < levelSize))
+			storeScratch(offset, levelSize, dst, g_texels[GTid.y][GTid.x]);
+	}
+	DeviceMemoryBarrierWithGroupSync();
+
+	if (GIndex == 0)
+	{
+		uint numFinished;
+		g_rwScratch.InterlockedAdd(0, 1, numFinished);
+		g_isLastGroup = numFinished + 1 == g_numGroups;
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	if (!g_isLastGroup) return;
+
+	// Reset the counter for the next dispatch
+	if (GIndex == 0) g_rwScratch.Store(0, 0);
+
+	// Tail levels, the scratch levels alternating between 2 regions
+	uint2 srcSize = levelSize;
+	uint dstOffset = offset + srcSize.x * srcSize.y * getTexelStride();
+	for (uint level = g_numTileLevels + 1; level <= g_numLevels; ++level)
+	{
+		levelSize = getLevelSize(size, level);
+		const uint numTexels = levelSize.x * levelSize.y;
+		for (uint i = GIndex; i < numTexels; i += GROUP_SIZE * GROUP_SIZE)
+		{
+			const uint2 dst = uint2(i % levelSize.x, i / levelSize.x);
+			const float4 color = sampleScratch(offset, srcSize, levelSize, dst);
+			g_txDests[level - 1][dst] = color;
+			storeScratch(dstOffset, levelSize, dst, color);
+		}
+		DeviceMemoryBarrierWithGroupSync();
+
+		const uint srcOffset = offset;
+		offset = dstOffset;
+		dstOffset = srcOffset;
+		srcSize = levelSize;
+	}
+}
@@ -2,69 +2,146 @@
 // By Stars XU Tianchen
 //--------------------------------------------------------------------------------------
 
-#include "CSMipGaussian.hlsli"
-
 //--------------------------------------------------------------------------------------
 // Constant buffer
 //--------------------------------------------------------------------------------------
 cbuffer cb
 {
+#ifdef _SIGMA_MAP_
+	float	g_maxScale;	// Of the sigma map, in place of the focus
+	float	g_reserved;
+#else
 	float2	g_focus;
+#endif
 	float	g_sigma;
 	uint	g_levelData;
+	float	g_weightAxisScale;	// 1 / log2(1 + max sigma) of the weight table
+#ifndef _ARRAY_
+	uint2	g_offset;	// First texel of the dispatch, within the region of interest of the level
+	float	g_weightTolerance;	// Of the coarser level in a group that copies the level through
+#endif
 };
 
 //--------------------------------------------------------------------------------------
 // Textures
 //--------------------------------------------------------------------------------------
+#ifdef _ARRAY_
+Texture2DArray		g_txSource;
+Texture2DArray		g_txCoarser;
+#define TEXCOORD(uv)	float3(uv, DTid.z)
+#define DEST_INDEX		uint3(pos, DTid.z)
+#define OFFSET			0
+#else
 Texture2D			g_txSource;
 Texture2D			g_txCoarser;
+#define TEXCOORD(uv)	(uv)
+#define DEST_INDEX		pos
+#define OFFSET			g_offset
+#endif
+Texture2D<float>	g_txWeights;	// Normalized weights of the levels over log2(1 + sigma)
+#ifdef _SIGMA_MAP_
+Texture2D<float>	g_txSigmaMap;	// Sigma scales reduced to the size of the current level
+#endif
+#ifdef _ARRAY_
+RWTexture2DArray<float4> g_txDest;
+#else
 RWTexture2D<float4>	g_txDest;
+#endif
 
 //--------------------------------------------------------------------------------------
 // Texture samplers
 //--------------------------------------------------------------------------------------
 SamplerState	g_smpLinear;
 
+#if defined(_SIGMA_MAP_) && !defined(_ARRAY_)
+groupshared uint g_groupScale;	// Largest sigma scale of the group, as the bits of a float
+#endif
+
+//--------------------------------------------------------------------------------------
+// Gaussian-approximating Haar coefficients (weights of box filters), tabulated
+// by CPU::WeightTable
+//--------------------------------------------------------------------------------------
+float GetWeight(float sigma, uint level)
+{
+	float2 tableDim;
+	g_txWeights.GetDimensions(tableDim.x, tableDim.y);
+	const float u = saturate(log2(1.0 + sigma) * g_weightAxisScale);
+	const float2 uv = float2(u * (tableDim.x - 1.0) + 0.5, level + 0.5) / tableDim;
+
+	return g_txWeights.SampleLevel(g_smpLinear, uv, 0);
+}
+
+#ifndef _ARRAY_
+//--------------------------------------------------------------------------------------
+// Largest squared distance to the focus of the texel centers of a range, which
+// is at either end
+//--------------------------------------------------------------------------------------
+float MaxDistance2(uint i0, uint i1, float size, float focus)
+{
+	const float r0 = (2.0 * i0 + 1.0) / size - 1.0 - focus;
+	const float r1 = (2.0 * i1 - 1.0) / size - 1.0 - focus;
+
+	return max(r0 * r0, r1 * r1);
+}
+#endif
+
 //--------------------------------------------------------------------------------------
 // Compute shader
 //--------------------------------------------------------------------------------------
 [numthreads(8, 8, 1)]
-void main(uint2 DTid : SV_DispatchThreadID)
+void main(uint3 DTid : SV_DispatchThreadID, uint3 Gid : SV_GroupID, uint GI : SV_GroupIndex)
 {
 	float2 dim;
+#ifdef _ARRAY_
+	float arraySize;
+	g_txDest.GetDimensions(dim.x, dim.y, arraySize);
+#else
 	g_txDest.GetDimensions(dim.x, dim.y);
+#endif
 
-	// Fetch the color of the current level and the resolved color at the coarser level
-	const float2 tex = (DTid + 0.5) / dim;
-	const float4 src = g_txSource.SampleLevel(g_smpLinear, tex, 0);
-	const float4 coarser = g_txCoarser.SampleLevel(g_smpLinear, tex, 0);
+	// Fetch the color of the current level
+	const uint2 pos = DTid.xy + OFFSET;
+	const float2 tex = (pos + 0.5) / dim;
+	const float4 src = g_txSource.SampleLevel(g_smpLinear, TEXCOORD(tex), 0);
 
 	// Compute deviation
+#ifdef _SIGMA_MAP_
+	const float s = clamp(g_txSigmaMap[pos], 0.0, g_maxScale);
+#else
 	const float2 r = (2.0 * tex - 1.0) - g_focus;
 	const float s = saturate(dot(r, r) + 0.25);
+#endif
 	const float sigma = g_sigma * s;
-	const float sigma2 = sigma * sigma;
 
-	// Decode mip level and total number of levels
+	// Decode mip level
 	const uint level = g_levelData & 0xffff;
-	const uint numLevels = g_levelData >> 16;
 
-	// Gaussian-approximating Haar coefficients (weights of box filters) 
-	float2 g = { GaussianBasis(sigma2, 0.0), 0 };
-	float wsum = 0.0, weight = 0.0;
-	for (uint i = level; i < numLevels; ++i)
+#ifndef _ARRAY_
+	// A group of which the coarser level weighs no more than the tolerance at its
+	// largest sigma copies the level through, as CPU::Filter does with its tiles
+	if (g_weightTolerance >= 0.0)
 	{
-		// Compute next term
-		g.y = GaussianBasis(sigma2, i + 1.0);
-
-		const float w = MipGaussianWeight(i, g);
-		weight = i == level ? w : weight;
-		wsum += w;
-
-		// For next iteration
-		g.x = g.y;
+		const uint2 groupPos = Gid.xy * 8 + OFFSET;
+		const uint2 groupEnd = min(groupPos + 8, uint2(dim));
+#ifdef _SIGMA_MAP_
+		if (GI == 0) g_groupScale = 0;
+		GroupMemoryBarrierWithGroupSync();
+		if (all(pos < groupEnd)) InterlockedMax(g_groupScale, asuint(s));	// The bits of s >= 0 order as the floats
+		GroupMemoryBarrierWithGroupSync();
+		const float maxScale = asfloat(g_groupScale);
+#else
+		const float maxScale = saturate(MaxDistance2(groupPos.x, groupEnd.x, dim.x, g_focus.x) +
+			MaxDistance2(groupPos.y, groupEnd.y, dim.y, g_focus.y) + 0.25);
+#endif
+		if (1.0 - GetWeight(g_sigma * maxScale, level) <= g_weightTolerance)
+		{
+			g_txDest[DEST_INDEX] = src;
+			return;
+		}
 	}
+#endif
 
-	g_txDest[DTid] = lerp(coarser, src, wsum > 0.0 ? weight / wsum : 1.0);
+	// Blend in the resolved color at the coarser level
+	const float4 coarser = g_txCoarser.SampleLevel(g_smpLinear, TEXCOORD(tex), 0);
+	g_txDest[DEST_INDEX] = lerp(coarser, src, GetWeight(sigma, level));
 }
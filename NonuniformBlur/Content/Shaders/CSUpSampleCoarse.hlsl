@@ -0,0 +1,132 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#define GROUP_SIZE			16
+#define MAX_COARSE_SIZE		32
+
+//--------------------------------------------------------------------------------------
+// Constant buffer
+//--------------------------------------------------------------------------------------
+cbuffer cb : register (b0)
+{
+	float2	g_focus;
+	float	g_sigma;
+	uint	g_levelData;		// Finest level to resolve | number of levels << 16
+	float	g_weightAxisScale;	// 1 / log2(1 + max sigma) of the weight table
+	uint	g_tableLevel;		// Level of the first textures in the arrays
+	float	g_quantization;		// Steps of the unorm format of the levels, 0 for a float one
+};
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+Texture2D			g_txSources[]	: register (t0);	// Down-sampled levels, then the coarsest resolved one
+RWTexture2D<float4>	g_txDests[]		: register (u0);	// Resolved levels
+Texture2D<float>	g_txWeights		: register (t0, space1);
+
+//--------------------------------------------------------------------------------------
+// Texture samplers
+//--------------------------------------------------------------------------------------
+SamplerState	g_smpLinear	: register (s0);
+
+//--------------------------------------------------------------------------------------
+// Groupshared memory: the coarser resolved level and the current one in turn,
+// in halves quantized to the format of the levels as they are stored. Halves
+// hold the 8- and 10-bit steps to within their rounding.
+//--------------------------------------------------------------------------------------
+groupshared uint2 g_colors[2][MAX_COARSE_SIZE * MAX_COARSE_SIZE];
+
+float4 quantize(float4 color)
+{
+	return g_quantization > 0.0 ? round(saturate(color) * g_quantization) / g_quantization :
+		f16tof32(f32tof16(color));
+}
+
+uint2 pack(float4 color)
+{
+	const uint4 v = f32tof16(quantize(color));
+
+	return v.xz | (v.yw << 16);
+}
+
+float4 unpack(uint2 v)
+{
+	return quantize(f16tof32(uint4(v.x, v.x >> 16, v.y, v.y >> 16)));
+}
+
+//--------------------------------------------------------------------------------------
+// LINEAR_CLAMP sampling of the coarser level in groupshared memory
+//--------------------------------------------------------------------------------------
+float4 sampleCoarser(uint buffer, uint2 coarserSize, float2 tex)
+{
+	const float2 uv = max(tex * coarserSize - 0.5, 0.0);
+	const uint2 i0 = min(uint2(uv), coarserSize - 1);
+	const uint2 i1 = min(i0 + 1, coarserSize - 1);
+	const float2 w = uv - i0;
+
+	const float4 c0 = lerp(unpack(g_colors[buffer][coarserSize.x * i0.y + i0.x]),
+		unpack(g_colors[buffer][coarserSize.x * i0.y + i1.x]), w.x);
+	const float4 c1 = lerp(unpack(g_colors[buffer][coarserSize.x * i1.y + i0.x]),
+		unpack(g_colors[buffer][coarserSize.x * i1.y + i1.x]), w.x);
+
+	return lerp(c0, c1, w.y);
+}
+
+//--------------------------------------------------------------------------------------
+// Compute shader: the up sampling of CSUpSample.hlsl for all the levels of at
+// most MAX_COARSE_SIZE x MAX_COARSE_SIZE texels, by a single group with the
+// coarser level in groupshared memory
+//--------------------------------------------------------------------------------------
+[numthreads(GROUP_SIZE, GROUP_SIZE, 1)]
+void main(uint GIndex : SV_GroupIndex)
+{
+	const uint firstLevel = g_levelData & 0xffff;
+	const uint coarsestLevel = (g_levelData >> 16) - 1;
+
+	float2 tableDim;
+	g_txWeights.GetDimensions(tableDim.x, tableDim.y);
+
+	// Coarsest level, resolved by the down sampling
+	uint2 coarserSize;
+	const uint coarsestIndex = coarsestLevel - g_tableLevel;
+	g_txSources[coarsestIndex].GetDimensions(coarserSize.x, coarserSize.y);
+	for (uint i = GIndex; i < coarserSize.x * coarserSize.y; i += GROUP_SIZE * GROUP_SIZE)
+		g_colors[0][i] = pack(g_txSources[coarsestIndex][uint2(i % coarserSize.x, i / coarserSize.x)]);
+	GroupMemoryBarrierWithGroupSync();
+
+	uint buffer = 0;
+	for (uint level = coarsestLevel; level-- > firstLevel;)
+	{
+		const uint index = level - g_tableLevel;
+		uint2 size;
+		g_txDests[index].GetDimensions(size.x, size.y);
+
+		for (uint i = GIndex; i < size.x * size.y; i += GROUP_SIZE * GROUP_SIZE)
+		{
+			const uint2 pos = uint2(i % size.x, i / size.x);
+			const float2 tex = (pos + 0.5) / size;
+
+			// The current level is sampled at its own texel centers
+			const float4 src = g_txSources[index][pos];
+			const float4 coarser = sampleCoarser(buffer, coarserSize, tex);
+
+			// Compute deviation
+			const float2 r = (2.0 * tex - 1.0) - g_focus;
+			const float sigma = g_sigma * saturate(dot(r, r) + 0.25);
+
+			// Gaussian-approximating Haar coefficients, tabulated by CPU::WeightTable
+			const float u = saturate(log2(1.0 + sigma) * g_weightAxisScale);
+			const float2 uv = float2(u * (tableDim.x - 1.0) + 0.5, level + 0.5) / tableDim;
+			const float weight = g_txWeights.SampleLevel(g_smpLinear, uv, 0);
+
+			const float4 result = lerp(coarser, src, weight);
+			g_txDests[index][pos] = result;
+			g_colors[buffer ^ 1][i] = pack(result);
+		}
+		GroupMemoryBarrierWithGroupSync();
+
+		buffer ^= 1;
+		coarserSize = size;
+	}
+}
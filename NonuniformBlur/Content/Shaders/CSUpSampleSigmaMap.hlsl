@@ -0,0 +1,7 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+// Up sampling with the sigma scales of a reduced sigma map
+#define _SIGMA_MAP_
+#include "CSUpSample.hlsl"
@@ -19,7 +19,10 @@ NonUniformBlur::NonUniformBlur(uint32_t width, uint32_t height, std::wstring nam
 	m_focus(0.0, 0.0),
 	m_sigma(24.0),
 	m_frameIndex(0),
-	m_showFPS(true)
+	m_showFPS(true),
+	m_isSinglePass(false),
+	m_isCoarseUpSample(false),
+	m_intermediateFormat(DXGI_FORMAT_B8G8R8A8_UNORM)
 {
 }
 
@@ -133,6 +136,7 @@ void NonUniformBlur::LoadAssets()
 
 	m_filter = make_unique<Filter>(m_device);
 	if (!m_filter) ThrowIfFailed(E_FAIL);
+	m_filter->SetIntermediateFormat(m_intermediateFormat);
 
 	shared_ptr<ResourceBase> source;
 	vector<Resource> uploaders(0);
@@ -219,6 +223,31 @@ void NonUniformBlur::OnKeyUp(uint8_t key)
 	case 0x70:	//case VK_F1:
 		m_showFPS = !m_showFPS;
 		break;
+	case 0x71:	//case VK_F2:
+		m_isSinglePass = !m_isSinglePass;
+		m_filter->SetSinglePassDownSample(m_isSinglePass);
+		break;
+	case 0x72:	//case VK_F3:
+		m_isCoarseUpSample = !m_isCoarseUpSample;
+		m_filter->SetCoarseUpSampleSize(m_isCoarseUpSample ? Filter::MaxCoarseUpSampleSize : 0);
+		break;
+	}
+}
+
+// "-format fp16", "-format r11g11b10" or "-format r10g10b10a2" selects the
+// format of the intermediate levels
+void NonUniformBlur::ParseCommandLineArgs(wchar_t *argv[], int argc)
+{
+	DXFramework::ParseCommandLineArgs(argv, argc);
+
+	for (auto i = 1; i + 1 < argc; ++i)
+	{
+		if (_wcsicmp(argv[i], L"-format") != 0 && _wcsicmp(argv[i], L"/format") != 0) continue;
+
+		const auto format = argv[++i];
+		if (_wcsicmp(format, L"fp16") == 0) m_intermediateFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
+		else if (_wcsicmp(format, L"r11g11b10") == 0) m_intermediateFormat = DXGI_FORMAT_R11G11B10_FLOAT;
+		else if (_wcsicmp(format, L"r10g10b10a2") == 0) m_intermediateFormat = DXGI_FORMAT_R10G10B10A2_UNORM;
 	}
 }
 
@@ -235,6 +264,7 @@ void NonUniformBlur::PopulateCommandList()
 	ThrowIfFailed(m_commandList.Reset(m_commandAllocators[m_frameIndex], nullptr));
 
 	// Record commands.
+	m_filter->SetFrameIndex(m_frameIndex);
 	m_filter->Process(m_commandList, m_focus, m_sigma);
 
 	{
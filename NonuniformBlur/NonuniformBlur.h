@@ -33,6 +33,7 @@ public:
 	virtual void OnDestroy();
 
 	virtual void OnKeyUp(uint8_t /*key*/);
+	virtual void ParseCommandLineArgs(wchar_t *argv[], int argc);
 
 private:
 	XUSG::DescriptorTableCache m_descriptorTableCache;
@@ -62,6 +63,9 @@ private:
 	// Application state
 	bool		m_showFPS;
 	bool		m_isPaused;
+	bool		m_isSinglePass;
+	bool		m_isCoarseUpSample;
+	DXGI_FORMAT	m_intermediateFormat;
 	StepTimer	m_timer;
 
 	void LoadPipeline();
@@ -0,0 +1,15 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <iostream>
+
+// Reports the failed condition with its location, and fails the test case
+#define T_CHECK(x)	if (!(x)) { std::cerr << __FILE__ << "(" << __LINE__ << "): " << #x << std::endl; return false; }
+
+// Runs a test case, counting it in numFailed if it fails
+#define T_RUN(f, numFailed) \
+	if (f()) std::cout << "[ OK ] " << #f << std::endl; \
+	else { std::cout << "[FAIL] " << #f << std::endl; ++numFailed; }
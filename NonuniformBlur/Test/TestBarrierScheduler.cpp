@@ -0,0 +1,215 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "XUSGBarrierScheduler.h"
+#include "Test.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	// The values of the Direct3D resource states
+	const uint32_t SRV = 0x40;
+	const uint32_t UAV = 0x8;
+	const uint32_t COPY_DEST = 0x400;
+
+	using Barrier = BarrierScheduler::Barrier;
+
+	// Records the barrier calls, as a command list would issue them
+	struct Sink
+	{
+		uint32_t Flush(BarrierScheduler &scheduler)
+		{
+			Calls.emplace_back();
+
+			return scheduler.Flush([this](uint32_t numBarriers, const Barrier *pBarriers)
+			{
+				Calls.back().assign(pBarriers, pBarriers + numBarriers);
+			});
+		}
+
+		const vector<Barrier> &Last() const { return Calls.back(); }
+
+		vector<vector<Barrier>> Calls;
+	};
+
+	bool isBarrier(const Barrier &barrier, const void *pResource, uint32_t subresource,
+		uint32_t stateBefore, uint32_t stateAfter, BarrierScheduler::BarrierType type)
+	{
+		return barrier.pResource == pResource && barrier.Subresource == subresource &&
+			barrier.StateBefore == stateBefore && barrier.StateAfter == stateAfter && barrier.Type == type;
+	}
+}
+
+bool TestSplitBarriers()
+{
+	BarrierScheduler scheduler(UAV);
+	Sink sink;
+	int resource;
+	scheduler.SetState(&resource, 0, SRV);
+
+	// The begin goes out with the next flush, and the end with the next transition
+	scheduler.BeginTransition(&resource, 0, UAV);
+	T_CHECK(scheduler.IsSplit(&resource, 0));
+	T_CHECK(sink.Flush(scheduler) == 1);
+	T_CHECK(isBarrier(sink.Last()[0], &resource, 0, SRV, UAV, BarrierScheduler::BEGIN_ONLY));
+
+	scheduler.Transition(&resource, 0, UAV);
+	T_CHECK(!scheduler.IsSplit(&resource, 0) && scheduler.GetState(&resource, 0) == UAV);
+	T_CHECK(sink.Flush(scheduler) == 1);
+	T_CHECK(isBarrier(sink.Last()[0], &resource, 0, SRV, UAV, BarrierScheduler::END_ONLY));
+
+	// Ending to another state ends the split one first, then transitions from it
+	scheduler.BeginTransition(&resource, 0, SRV);
+	T_CHECK(sink.Flush(scheduler) == 1);
+	scheduler.Transition(&resource, 0, COPY_DEST);
+	T_CHECK(sink.Flush(scheduler) == 2);
+	T_CHECK(isBarrier(sink.Last()[0], &resource, 0, UAV, SRV, BarrierScheduler::END_ONLY));
+	T_CHECK(isBarrier(sink.Last()[1], &resource, 0, SRV, COPY_DEST, BarrierScheduler::TRANSITION));
+
+	// A begin ended before any flush is one whole transition
+	scheduler.BeginTransition(&resource, 0, SRV);
+	scheduler.Transition(&resource, 0, SRV);
+	T_CHECK(sink.Flush(scheduler) == 1);
+	T_CHECK(isBarrier(sink.Last()[0], &resource, 0, COPY_DEST, SRV, BarrierScheduler::TRANSITION));
+
+	// A second begin while one is in flight is ignored
+	scheduler.BeginTransition(&resource, 0, UAV);
+	scheduler.BeginTransition(&resource, 0, COPY_DEST);
+	T_CHECK(sink.Flush(scheduler) == 1);
+	T_CHECK(isBarrier(sink.Last()[0], &resource, 0, SRV, UAV, BarrierScheduler::BEGIN_ONLY));
+	scheduler.Transition(&resource, 0, UAV);
+	T_CHECK(sink.Flush(scheduler) == 1);
+
+	// Every begin got its end
+	auto numBegins = 0u, numEnds = 0u;
+	for (const auto &call : sink.Calls)
+		for (const auto &barrier : call)
+		{
+			if (barrier.Type == BarrierScheduler::BEGIN_ONLY) ++numBegins;
+			if (barrier.Type == BarrierScheduler::END_ONLY) ++numEnds;
+		}
+	T_CHECK(numBegins == 3 && numEnds == 3);
+	T_CHECK(scheduler.GetStats().NumSplitBarriers == 6);
+
+	return true;
+}
+
+bool TestMerging()
+{
+	BarrierScheduler scheduler(UAV);
+	Sink sink;
+	int resource0, resource1;
+	scheduler.SetState(&resource0, 0, SRV);
+	scheduler.SetState(&resource0, 1, SRV);
+	scheduler.SetState(&resource1, 0, UAV);
+
+	// Transitions with nothing run in between fold into one
+	scheduler.Transition(&resource0, 0, COPY_DEST);
+	scheduler.Transition(&resource0, 0, UAV);
+	scheduler.Transition(&resource0, 1, UAV);
+	T_CHECK(sink.Flush(scheduler) == 2);
+	T_CHECK(sink.Calls.size() == 1 && scheduler.GetStats().NumFolded == 1);
+	T_CHECK(isBarrier(sink.Last()[0], &resource0, 0, SRV, UAV, BarrierScheduler::TRANSITION));
+	T_CHECK(isBarrier(sink.Last()[1], &resource0, 1, SRV, UAV, BarrierScheduler::TRANSITION));
+
+	// Back to the original state, they cancel out, and a flush of nothing
+	// issues no call
+	scheduler.Transition(&resource0, 0, SRV);
+	T_CHECK(sink.Flush(scheduler) == 1);
+	scheduler.Transition(&resource0, 0, COPY_DEST);
+	scheduler.Transition(&resource0, 0, SRV);
+	T_CHECK(sink.Flush(scheduler) == 0);
+	T_CHECK(scheduler.GetStats().NumFlushes == 2);
+	scheduler.Transition(&resource0, 0, UAV);
+	T_CHECK(sink.Flush(scheduler) == 1);
+
+	// Writes in the UAV state are ordered by one UAV barrier per resource
+	scheduler.Transition(&resource0, 0, UAV);
+	scheduler.Transition(&resource0, 1, UAV);
+	scheduler.Transition(&resource1, 0, UAV);
+	scheduler.UAVBarrier(&resource1);
+	T_CHECK(sink.Flush(scheduler) == 2);
+	T_CHECK(isBarrier(sink.Last()[0], &resource0, BarrierScheduler::AllSubresources, UAV, UAV, BarrierScheduler::UAV));
+	T_CHECK(isBarrier(sink.Last()[1], &resource1, BarrierScheduler::AllSubresources, UAV, UAV, BarrierScheduler::UAV));
+
+	// As are a read and a write again
+	scheduler.Transition(&resource1, 0, SRV);
+	scheduler.Transition(&resource1, 0, UAV);
+	T_CHECK(sink.Flush(scheduler) == 1);
+	T_CHECK(isBarrier(sink.Last()[0], &resource1, BarrierScheduler::AllSubresources, UAV, UAV, BarrierScheduler::UAV));
+	T_CHECK(scheduler.GetStats().NumUAVBarriers == 3);
+
+	return true;
+}
+
+bool TestSubresources()
+{
+	BarrierScheduler scheduler(UAV);
+	Sink sink;
+	int chain, whole;
+	for (auto i = 0u; i < 3; ++i) scheduler.SetState(&chain, i, SRV);
+	scheduler.SetState(&whole, BarrierScheduler::AllSubresources, SRV);
+
+	// Subresources are tracked apart
+	scheduler.Transition(&chain, 1, UAV);
+	T_CHECK(sink.Flush(scheduler) == 1);
+	T_CHECK(isBarrier(sink.Last()[0], &chain, 1, SRV, UAV, BarrierScheduler::TRANSITION));
+	T_CHECK(scheduler.GetState(&chain, 0) == SRV && scheduler.GetState(&chain, 1) == UAV);
+	T_CHECK(scheduler.GetState(&chain, BarrierScheduler::AllSubresources) == 0);
+
+	// All the subresources of one tracked apart transition each from its own state
+	scheduler.Transition(&chain, BarrierScheduler::AllSubresources, COPY_DEST);
+	T_CHECK(sink.Flush(scheduler) == 3);
+	T_CHECK(isBarrier(sink.Last()[0], &chain, 0, SRV, COPY_DEST, BarrierScheduler::TRANSITION));
+	T_CHECK(isBarrier(sink.Last()[1], &chain, 1, UAV, COPY_DEST, BarrierScheduler::TRANSITION));
+	T_CHECK(isBarrier(sink.Last()[2], &chain, 2, SRV, COPY_DEST, BarrierScheduler::TRANSITION));
+	T_CHECK(scheduler.GetState(&chain, BarrierScheduler::AllSubresources) == COPY_DEST);
+
+	// And so do split ones
+	scheduler.BeginTransition(&chain, BarrierScheduler::AllSubresources, SRV);
+	T_CHECK(scheduler.IsSplit(&chain, BarrierScheduler::AllSubresources));
+	T_CHECK(sink.Flush(scheduler) == 3);
+	scheduler.Transition(&chain, 2, SRV);
+	T_CHECK(scheduler.IsSplit(&chain, BarrierScheduler::AllSubresources));
+	scheduler.Transition(&chain, BarrierScheduler::AllSubresources, SRV);
+	T_CHECK(!scheduler.IsSplit(&chain, BarrierScheduler::AllSubresources));
+	T_CHECK(sink.Flush(scheduler) == 3);
+	T_CHECK(isBarrier(sink.Last()[0], &chain, 2, COPY_DEST, SRV, BarrierScheduler::END_ONLY));
+	T_CHECK(isBarrier(sink.Last()[1], &chain, 0, COPY_DEST, SRV, BarrierScheduler::END_ONLY));
+	T_CHECK(isBarrier(sink.Last()[2], &chain, 1, COPY_DEST, SRV, BarrierScheduler::END_ONLY));
+
+	// A resource tracked as a whole transitions with one barrier
+	scheduler.Transition(&whole, BarrierScheduler::AllSubresources, UAV);
+	T_CHECK(sink.Flush(scheduler) == 1);
+	T_CHECK(isBarrier(sink.Last()[0], &whole, BarrierScheduler::AllSubresources, SRV, UAV, BarrierScheduler::TRANSITION));
+	T_CHECK(scheduler.GetState(&whole, BarrierScheduler::AllSubresources) == UAV);
+
+	// Tracking the chain as a whole forgets its subresources
+	scheduler.SetState(&chain, BarrierScheduler::AllSubresources, SRV);
+	T_CHECK(scheduler.GetState(&chain, 0) == 0);
+	scheduler.Transition(&chain, BarrierScheduler::AllSubresources, UAV);
+	T_CHECK(sink.Flush(scheduler) == 1);
+	T_CHECK(isBarrier(sink.Last()[0], &chain, BarrierScheduler::AllSubresources, SRV, UAV, BarrierScheduler::TRANSITION));
+
+	// Untracked ones are assumed to be in the state already
+	int untracked;
+	scheduler.Transition(&untracked, 0, SRV);
+	scheduler.Transition(&untracked, BarrierScheduler::AllSubresources, SRV);
+	T_CHECK(sink.Flush(scheduler) == 0);
+	T_CHECK(scheduler.GetState(&untracked, 0) == SRV);
+
+	return true;
+}
+
+int main()
+{
+	auto numFailed = 0;
+	T_RUN(TestSplitBarriers, numFailed);
+	T_RUN(TestMerging, numFailed);
+	T_RUN(TestSubresources, numFailed);
+
+	return numFailed > 0 ? 1 : 0;
+}
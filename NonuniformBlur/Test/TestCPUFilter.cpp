@@ -0,0 +1,307 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include "CPUFilterBatch.h"
+#include "Test.h"
+
+using namespace std;
+using namespace CPU;
+
+namespace
+{
+	// Odd in both dimensions, over several tiles, and with a source larger than
+	// FusedResidentSize, so the fused and streaming modes keep level 0 in rings
+	const uint32_t Width = 301;
+	const uint32_t Height = 257;
+	const Float2 Focus = { 0.3f, -0.2f };
+	const float Sigma = 24.0f;
+
+	vector<uint8_t> createSource(uint32_t width, uint32_t height)
+	{
+		vector<uint8_t> source(size_t(width) * height * PixelSize);
+		auto seed = 1u;
+		for (auto &v : source)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			v = static_cast<uint8_t>(seed >> 24);
+		}
+
+		return source;
+	}
+
+	vector<uint8_t> readback(const Texture2D &image)
+	{
+		const auto &surface = image.GetSurface();
+		vector<uint8_t> data(size_t(surface.Width) * surface.Height * PixelSize);
+		image.Readback(data.data());
+
+		return data;
+	}
+
+	// Compares every level of two images of the same layout, byte for byte
+	bool isEqual(const Texture2D &a, const Texture2D &b)
+	{
+		for (auto i = 0u; i < a.GetNumMips(); ++i)
+		{
+			const auto &sa = a.GetSurface(i);
+			const auto &sb = b.GetSurface(i);
+			for (auto y = 0u; y < sa.Height; ++y)
+				C_RETURN(memcmp(sa.GetRow(y), sb.GetRow(y), sa.Width * GetTexelSize(sa.TexelFormat)) != 0, false);
+		}
+
+		return true;
+	}
+
+	void buildMipChain(Texture2D &image, bool highQuality)
+	{
+		for (auto i = 1u; i < image.GetNumMips(); ++i)
+		{
+			const auto &dst = image.GetSurface(i);
+			const auto &src = image.GetSurface(i - 1);
+			for (auto y = 0u; y < dst.Height; ++y)
+				Kernel::Resample(dst, src, y, 0, dst.Width, highQuality);
+		}
+	}
+
+	// Runs f with each instruction set of the processor, comparing its image with
+	// that of the scalar path
+	template<typename Func>
+	bool isEqualPerInstructionSet(Texture2D &image, Texture2D &reference, Func f)
+	{
+		Kernel::SetInstructionSet(Kernel::SCALAR);
+		f(reference);
+		auto isExact = true;
+		for (auto i = 1u; i <= Kernel::GetSupportedInstructionSet(); ++i)
+		{
+			const auto instructionSet = static_cast<Kernel::InstructionSet>(i);
+			Kernel::SetInstructionSet(instructionSet);
+			f(image);
+			if (!isEqual(image, reference))
+			{
+				cerr << Kernel::GetInstructionSetName(instructionSet) << " differs from scalar" << endl;
+				isExact = false;
+			}
+		}
+		Kernel::SetInstructionSet(Kernel::GetSupportedInstructionSet());
+
+		return isExact;
+	}
+
+	bool initFilter(Filter &filter, const vector<uint8_t> &source, bool highQuality = true)
+	{
+		N_RETURN(filter.SetWeightTable(256), false);
+
+		return filter.Init(Width, Height, source.data(), 0, highQuality);
+	}
+}
+
+bool TestResampleInstructionSets()
+{
+	const auto source = createSource(Width, Height);
+	const auto numMips = static_cast<uint8_t>(log2f(static_cast<float>((max)(Width, Height))) + 1.0f);
+
+	// The levels of the wider formats convert each row to floats and back
+	for (auto format = 0u; format < NUM_FORMAT; ++format)
+	{
+		for (auto highQuality : { false, true })
+		{
+			Texture2D image, reference;
+			T_CHECK(image.Create(Width, Height, numMips, FORMAT_B8G8R8A8_UNORM, static_cast<Format>(format)));
+			T_CHECK(reference.Create(Width, Height, numMips, FORMAT_B8G8R8A8_UNORM, static_cast<Format>(format)));
+			T_CHECK(image.Upload(source.data()));
+			T_CHECK(reference.Upload(source.data()));
+			T_CHECK(isEqualPerInstructionSet(image, reference,
+				[highQuality](Texture2D &chain) { buildMipChain(chain, highQuality); }));
+		}
+	}
+
+	return true;
+}
+
+bool TestHalfInstructionSets()
+{
+	// Every half in [0, 1], denormals included, read and written by the resampling
+	// of a half-float level, of which the finer one holds them as they are
+	const uint32_t width = 256, height = 64;
+	Texture2D image, reference;
+	T_CHECK(image.Create(width, height, 3, FORMAT_B8G8R8A8_UNORM, FORMAT_R16G16B16A16_FLOAT));
+	T_CHECK(reference.Create(width, height, 3, FORMAT_B8G8R8A8_UNORM, FORMAT_R16G16B16A16_FLOAT));
+
+	const auto fillHalfs = [](Texture2D &chain)
+	{
+		const auto &surface = chain.GetSurface(1);
+		auto h = 0u;
+		for (auto y = 0u; y < surface.Height; ++y)
+		{
+			const auto pRow = reinterpret_cast<uint16_t*>(surface.GetRow(y));
+			for (auto i = 0u; i < surface.Width * PixelSize; ++i, h = (h + 1) % 0x3c01)
+				pRow[i] = static_cast<uint16_t>(h);
+		}
+	};
+
+	T_CHECK(isEqualPerInstructionSet(image, reference, [&fillHalfs](Texture2D &chain)
+	{
+		fillHalfs(chain);
+		const auto &dst = chain.GetSurface(2);
+		for (auto y = 0u; y < dst.Height; ++y)
+			Kernel::Resample(dst, chain.GetSurface(1), y, 0, dst.Width, true);
+	}));
+
+	return true;
+}
+
+bool TestExecutionModes()
+{
+	const auto source = createSource(Width, Height);
+	auto threadPool = make_shared<ThreadPool>();
+	T_CHECK(threadPool->Create(2));
+
+	Filter filter;
+	T_CHECK(initFilter(filter, source));
+	filter.SetThreadPool(threadPool);
+	filter.Process(Focus, Sigma);
+	const auto tiled = readback(filter.GetResult());
+
+	// The up sampling alone, of the levels kept from the last call
+	filter.Process(Focus, Sigma);
+	T_CHECK(readback(filter.GetResult()) == tiled);
+
+	filter.SetExecutionMode(Filter::EXECUTION_FUSED);
+	filter.InvalidateSource();
+	filter.Process(Focus, Sigma);
+	T_CHECK(readback(filter.GetResult()) == tiled);
+	filter.SetExecutionMode(Filter::EXECUTION_TILED);
+
+	filter.SetCoarseUpSampleSize(32);
+	filter.InvalidateSource();
+	filter.Process(Focus, Sigma);
+	T_CHECK(readback(filter.GetResult()) == tiled);
+	filter.SetCoarseUpSampleSize(0);
+
+	// The single pass reduces with the 2x2 box
+	Filter boxFilter;
+	T_CHECK(initFilter(boxFilter, source, false));
+	boxFilter.Process(Focus, Sigma);
+	const auto boxTiled = readback(boxFilter.GetResult());
+	boxFilter.SetExecutionMode(Filter::EXECUTION_SINGLE_PASS);
+	boxFilter.InvalidateSource();
+	boxFilter.Process(Focus, Sigma);
+	T_CHECK(readback(boxFilter.GetResult()) == boxTiled);
+
+	// The source never resides, and is read by rows
+	Filter streamFilter;
+	T_CHECK(streamFilter.SetWeightTable(256));
+	T_CHECK(streamFilter.InitStream(Width, Height));
+	streamFilter.SetThreadPool(threadPool);
+	const auto rowSize = Width * PixelSize;
+	vector<uint8_t> streamed(source.size());
+	T_CHECK(streamFilter.ProcessStream([&source, rowSize](uint32_t y, uint8_t *pRow)
+	{
+		memcpy(pRow, &source[size_t(rowSize) * y], rowSize);
+		return true;
+	}, [&streamed, rowSize](uint32_t y, const uint8_t *pRow)
+	{
+		memcpy(&streamed[size_t(rowSize) * y], pRow, rowSize);
+		return true;
+	}, Focus, Sigma));
+	T_CHECK(streamed == tiled);
+
+	return true;
+}
+
+bool TestPartialUpdates()
+{
+	auto source = createSource(Width, Height);
+	Filter filter, reference;
+	T_CHECK(initFilter(filter, source));
+	T_CHECK(initFilter(reference, source));
+	filter.Process(Focus, Sigma);
+
+	// A rectangle of the source across tile borders, of which only the tiles that
+	// it reaches run again
+	const Rect rect = { 50, 60, 131, 97 };
+	const auto rectWidth = rect.Right - rect.Left, rectHeight = rect.Bottom - rect.Top;
+	vector<uint8_t> overlay(size_t(rectWidth) * rectHeight * PixelSize);
+	for (auto i = 0u; i < overlay.size(); ++i) overlay[i] = static_cast<uint8_t>(i * 7);
+	for (auto y = 0u; y < rectHeight; ++y)
+		memcpy(&source[(size_t(Width) * (rect.Top + y) + rect.Left) * PixelSize],
+			&overlay[size_t(rectWidth) * y * PixelSize], rectWidth * PixelSize);
+
+	T_CHECK(filter.UpdateSource(rect, overlay.data()));
+	filter.Process(Focus, Sigma);
+	T_CHECK(reference.UpdateSource(source.data()));
+	reference.Process(Focus, Sigma);
+	const auto full = readback(reference.GetResult());
+	T_CHECK(readback(filter.GetResult()) == full);
+
+	// A region of interest matches the whole result within it, of the levels kept
+	// and of those reduced again
+	const Rect roi = { 70, 33, 203, 190 };
+	for (auto isKept : { true, false })
+	{
+		Filter roiFilter;
+		T_CHECK(initFilter(roiFilter, source));
+		if (isKept) roiFilter.Process(Float2{ 0.0f, 0.0f }, 4.0f);
+		roiFilter.Process(Focus, Sigma, roi);
+
+		const auto cropped = readback(roiFilter.GetResult());
+		for (auto y = roi.Top; y < roi.Bottom; ++y)
+		{
+			const auto offset = (size_t(Width) * y + roi.Left) * PixelSize;
+			T_CHECK(memcmp(&cropped[offset], &full[offset], (roi.Right - roi.Left) * PixelSize) == 0);
+		}
+	}
+
+	return true;
+}
+
+bool TestBatch()
+{
+	// Images of mixed sizes, odd ones included, from the same source rows
+	const auto source = createSource(Width, Height);
+	const uint32_t sizes[][2] = { { 64, 48 }, { 129, 67 }, { 1, 1 }, { 300, 17 }, { 33, 256 } };
+	const auto numImages = static_cast<uint32_t>(sizeof(sizes) / sizeof(sizes[0]));
+
+	vector<FilterBatch::Image> images(numImages);
+	vector<unique_ptr<Filter>> filters(numImages);
+	for (auto i = 0u; i < numImages; ++i)
+	{
+		images[i] = { sizes[i][0], sizes[i][1], source.data(), Width * PixelSize };
+		filters[i] = make_unique<Filter>();
+		T_CHECK(filters[i]->Init(images[i].Width, images[i].Height, source.data(), images[i].RowPitch));
+		filters[i]->Process(Focus, Sigma);
+	}
+
+	FilterBatch batch;
+	T_CHECK(batch.Init(images.data(), numImages));
+	batch.Process(Focus, Sigma);
+	for (auto i = 0u; i < numImages; ++i)
+		T_CHECK(readback(batch.GetResult(i)) == readback(filters[i]->GetResult()));
+
+	return true;
+}
+
+bool TestInvalidImages()
+{
+	const auto source = createSource(1, 1);
+	Filter filter;
+	T_CHECK(!filter.Init(0, 16, source.data()));
+	T_CHECK(!filter.Init(16, 0, source.data()));
+	T_CHECK(!filter.InitStream(0, 0));
+
+	return true;
+}
+
+int main()
+{
+	auto numFailed = 0;
+	T_RUN(TestResampleInstructionSets, numFailed);
+	T_RUN(TestHalfInstructionSets, numFailed);
+	T_RUN(TestExecutionModes, numFailed);
+	T_RUN(TestPartialUpdates, numFailed);
+	T_RUN(TestBatch, numFailed);
+	T_RUN(TestInvalidImages, numFailed);
+
+	return numFailed > 0 ? 1 : 0;
+}
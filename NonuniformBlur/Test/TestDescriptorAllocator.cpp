@@ -0,0 +1,178 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include <memory>
+#include <vector>
+#include "XUSGDescriptorAllocator.h"
+#include "Test.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	const uint32_t Stride = 32;
+
+	// A pool of integers standing in for a descriptor heap, with tables as
+	// handles into it that the growth rebases in place, as DescriptorTableCache
+	// does for its cached tables
+	struct Pool
+	{
+		bool Grow(uint32_t capacity)
+		{
+			// A new heap at another address, with the tables re-created at their offsets
+			vector<int> data(capacity, -1);
+			const auto start = ++NumGrowths * 0x100000ull;
+			for (const auto &table : Tables)
+			{
+				const auto offset = DescriptorAllocator::GetOffset(table->Handle, Start, Stride);
+				for (auto i = 0u; i < table->Size; ++i) data[offset + i] = Data[offset + i];
+				table->Handle = start + offset * Stride;
+			}
+
+			Data.swap(data);
+			Start = start;
+
+			return true;
+		}
+
+		struct Table
+		{
+			uint64_t Handle;
+			uint32_t Size;
+		};
+
+		vector<int> Data;
+		vector<shared_ptr<Table>> Tables;
+		uint64_t Start = 0;
+		uint32_t NumGrowths = 0;
+	};
+
+	bool allocate(DescriptorAllocator &allocator, Pool &pool, uint32_t numDescriptors, int value)
+	{
+		uint32_t offset;
+		T_CHECK(allocator.Allocate(numDescriptors, offset, [&pool](uint32_t capacity) { return pool.Grow(capacity); }));
+		T_CHECK(offset + numDescriptors <= pool.Data.size());
+
+		for (auto i = 0u; i < numDescriptors; ++i)
+		{
+			T_CHECK(pool.Data[offset + i] == -1);
+			pool.Data[offset + i] = value;
+		}
+
+		pool.Tables.emplace_back(make_shared<Pool::Table>(Pool::Table{ pool.Start + offset * Stride, numDescriptors }));
+
+		return true;
+	}
+
+	void release(DescriptorAllocator &allocator, Pool &pool, uint32_t table)
+	{
+		const auto offset = DescriptorAllocator::GetOffset(pool.Tables[table]->Handle, pool.Start, Stride);
+		const auto numDescriptors = pool.Tables[table]->Size;
+		for (auto i = 0u; i < numDescriptors; ++i) pool.Data[offset + i] = -1;
+		allocator.Free(offset, numDescriptors);
+		pool.Tables[table]->Size = 0;
+	}
+}
+
+bool TestSplit()
+{
+	DescriptorAllocator allocator;
+	Pool pool;
+	for (auto i = 0; i < 4; ++i) T_CHECK(allocate(allocator, pool, 4, i));
+	T_CHECK(allocator.GetCount() == 16);
+
+	// A smaller table takes the front of the released range, leaving the rest free
+	release(allocator, pool, 1);
+	T_CHECK(allocate(allocator, pool, 3, 4));
+	T_CHECK(pool.Tables.back()->Handle == pool.Start + 4 * Stride);
+	T_CHECK(allocator.GetFreeRanges().size() == 1 && allocator.GetFreeRanges().at(7) == 1);
+
+	// Then an exact fit takes the rest, and a larger table appends
+	T_CHECK(allocate(allocator, pool, 1, 5));
+	T_CHECK(allocator.GetFreeRanges().empty());
+	T_CHECK(allocate(allocator, pool, 2, 6));
+	T_CHECK(pool.Tables.back()->Handle == pool.Start + 16 * Stride);
+	T_CHECK(allocator.GetCount() == 18);
+
+	return true;
+}
+
+bool TestMerge()
+{
+	DescriptorAllocator allocator;
+	Pool pool;
+	for (auto i = 0; i < 8; ++i) T_CHECK(allocate(allocator, pool, 3, i));
+
+	// Releasing 2, 4 and then 3 merges them into one range with both neighbors
+	release(allocator, pool, 2);
+	release(allocator, pool, 4);
+	T_CHECK(allocator.GetFreeRanges().size() == 2);
+	release(allocator, pool, 3);
+	T_CHECK(allocator.GetFreeRanges().size() == 1 && allocator.GetFreeRanges().at(6) == 9);
+
+	// Releasing the last tables shrinks the tail, absorbing a free range it reaches
+	release(allocator, pool, 7);
+	T_CHECK(allocator.GetCount() == 21);
+	release(allocator, pool, 6);
+	release(allocator, pool, 5);
+	T_CHECK(allocator.GetCount() == 6 && allocator.GetFreeRanges().empty());
+
+	// The merged range serves a table larger than any of its parts
+	T_CHECK(allocate(allocator, pool, 5, 8));
+	T_CHECK(pool.Tables.back()->Handle == pool.Start + 6 * Stride);
+
+	return true;
+}
+
+bool TestGrow()
+{
+	DescriptorAllocator allocator;
+	Pool pool;
+
+	// Appending 100 tables grows the pool geometrically
+	for (auto i = 0; i < 100; ++i) T_CHECK(allocate(allocator, pool, 1 + i % 5, i));
+	T_CHECK(allocator.GetCount() == 300);
+	T_CHECK(allocator.GetCapacity() == pool.Data.size());
+	T_CHECK(pool.NumGrowths <= 10);
+
+	// Every table is rewritten at its offset and rebased to the final pool
+	for (auto i = 0u; i < pool.Tables.size(); ++i)
+	{
+		const auto &table = *pool.Tables[i];
+		const auto offset = DescriptorAllocator::GetOffset(table.Handle, pool.Start, Stride);
+		for (auto j = 0u; j < table.Size; ++j) T_CHECK(pool.Data[offset + j] == static_cast<int>(i));
+	}
+
+	// A request larger than the doubled capacity grows to fit it exactly
+	const auto capacity = allocator.GetCapacity();
+	T_CHECK(allocate(allocator, pool, capacity * 3, 100));
+	T_CHECK(allocator.GetCapacity() == 300 + capacity * 3);
+
+	// The growth stops doubling at the maximum capacity, as for sampler heaps
+	DescriptorAllocator bounded(6);
+	Pool boundedPool;
+	T_CHECK(allocate(bounded, boundedPool, 4, 0));
+	T_CHECK(allocate(bounded, boundedPool, 1, 1));
+	T_CHECK(bounded.GetCapacity() == 6);
+	T_CHECK(allocate(bounded, boundedPool, 2, 2));
+	T_CHECK(bounded.GetCapacity() == 7);
+
+	// A failed growth fails the allocation, and leaves the count as it was
+	uint32_t offset;
+	T_CHECK(!bounded.Allocate(1, offset, [](uint32_t) { return false; }));
+	T_CHECK(bounded.GetCount() == 7);
+
+	return true;
+}
+
+int main()
+{
+	auto numFailed = 0;
+	T_RUN(TestSplit, numFailed);
+	T_RUN(TestMerge, numFailed);
+	T_RUN(TestGrow, numFailed);
+
+	return numFailed > 0 ? 1 : 0;
+}
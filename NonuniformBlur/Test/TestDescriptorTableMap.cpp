@@ -0,0 +1,160 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include <map>
+#include <memory>
+#include <random>
+#include "XUSGDescriptorTableMap.h"
+#include "Test.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	// Stand-ins for the Direct3D handle types
+	struct Descriptor
+	{
+		size_t ptr;
+	};
+
+	struct Sampler
+	{
+		uint32_t Filter;
+	};
+
+	using Key = BasicDescriptorTableKey<Descriptor, Sampler>;
+	using Map = BasicDescriptorTableMap<Key, shared_ptr<int>>;
+
+	// Handles of one heap, which differ only by multiples of the stride
+	Key makeKey(mt19937 &rng, vector<size_t> &handles)
+	{
+		Key key;
+		const auto numDescriptors = 1 + rng() % 4;
+		handles.resize(numDescriptors);
+		for (auto i = 0u; i < numDescriptors; ++i)
+		{
+			const Descriptor descriptor = { 0x10000 + 32 * (rng() % 48) };
+			key.SetDescriptors(i, 1, &descriptor);
+			handles[i] = descriptor.ptr;
+		}
+
+		return key;
+	}
+}
+
+bool TestKey()
+{
+	const Descriptor descriptors[] = { { 0x100 }, { 0x120 }, { 0x140 } };
+
+	// Setting the handles at once or one by one gives the same key
+	Key key1, key2;
+	key1.SetDescriptors(0, 3, descriptors);
+	for (auto i = 0u; i < 3; ++i) key2.SetDescriptors(i, 1, &descriptors[i]);
+	T_CHECK(key1 == key2 && key1.GetHash() == key2.GetHash());
+	T_CHECK(key1.GetNumDescriptors() == 3 && key1.GetDescriptors()[2].ptr == 0x140);
+
+	// A gap is null, and the order of the handles matters
+	Key key3, key4;
+	key3.SetDescriptors(2, 1, &descriptors[2]);
+	T_CHECK(key3.GetNumDescriptors() == 3 && key3.GetDescriptors()[0].ptr == 0);
+	key4.SetDescriptors(0, 1, &descriptors[1]);
+	key4.SetDescriptors(1, 1, &descriptors[0]);
+	key4.SetDescriptors(2, 1, &descriptors[2]);
+	T_CHECK(!(key1 == key4) && key1.GetHash() != key4.GetHash());
+
+	// Samplers are keyed by their addresses
+	const Sampler samplers[2] = {};
+	const Sampler *const pSamplers[] = { &samplers[0], &samplers[1] };
+	Key key5;
+	key5.SetSamplers(0, 2, pSamplers);
+	T_CHECK(key5.GetSamplers()[1] == &samplers[1]);
+
+	// Handles past the capacity empty the key for good, instead of truncating it
+	vector<Descriptor> many(Key::MaxDescriptors + 1, descriptors[0]);
+	Key key6;
+	T_CHECK(key6.SetDescriptors(0, Key::MaxDescriptors, many.data()));
+	T_CHECK(key6.GetNumDescriptors() == Key::MaxDescriptors);
+	T_CHECK(!key6.SetDescriptors(Key::MaxDescriptors, 1, many.data()));
+	T_CHECK(key6.GetNumDescriptors() == 0 && key6 == Key());
+	T_CHECK(!key6.SetDescriptors(0, 1, many.data()) && key6.GetNumDescriptors() == 0);
+	Key key7;
+	T_CHECK(!key7.SetDescriptors(0, Key::MaxDescriptors + 1, many.data()));
+	T_CHECK(!key7.SetSamplers(UINT32_MAX, 2, pSamplers) && key7.GetNumDescriptors() == 0);
+
+	return true;
+}
+
+bool TestRandomOps()
+{
+	// Random finds, inserts and erases, checked against std::map, with enough
+	// erases that the probing runs over removed slots and rehashes
+	Map tables;
+	map<vector<size_t>, int> reference;
+	mt19937 rng(1);
+	vector<size_t> handles;
+	for (auto i = 0; i < 200000; ++i)
+	{
+		const auto key = makeKey(rng, handles);
+		const auto pTable = tables.Find(key);
+		const auto refIter = reference.find(handles);
+		T_CHECK((pTable != nullptr) == (refIter != reference.end()));
+		if (pTable) T_CHECK(**pTable == refIter->second);
+
+		if (rng() % 3 < 2)
+		{
+			if (!pTable)
+			{
+				T_CHECK(*tables.Insert(key, make_shared<int>(i)) == i);
+				reference[handles] = i;
+			}
+		}
+		else
+		{
+			T_CHECK(tables.Erase(key) == (pTable != nullptr));
+			if (refIter != reference.end()) reference.erase(refIter);
+		}
+
+		T_CHECK(tables.GetSize() == reference.size());
+	}
+
+	// Every entry is visited once
+	size_t numVisited = 0;
+	tables.ForEach([&](const Key &key, shared_ptr<int> &table)
+	{
+		vector<size_t> handles(key.GetNumDescriptors());
+		for (auto i = 0u; i < key.GetNumDescriptors(); ++i) handles[i] = key.GetDescriptors()[i].ptr;
+		if (reference.at(handles) == *table) ++numVisited;
+	});
+	T_CHECK(numVisited == reference.size());
+
+	return true;
+}
+
+bool TestDuplicateInsert()
+{
+#ifdef NDEBUG
+	// Release builds keep the value already in the map; debug builds assert
+	Map tables;
+	const Descriptor descriptor = { 0x100 };
+	Key key;
+	key.SetDescriptors(0, 1, &descriptor);
+	tables.Insert(key, make_shared<int>(1));
+	T_CHECK(*tables.Insert(key, make_shared<int>(2)) == 1);
+	T_CHECK(tables.GetSize() == 1 && **tables.Find(key) == 1);
+	T_CHECK(tables.Erase(key) && !tables.Find(key));
+#endif
+
+	return true;
+}
+
+int main()
+{
+	auto numFailed = 0;
+	T_RUN(TestKey, numFailed);
+	T_RUN(TestRandomOps, numFailed);
+	T_RUN(TestDuplicateInsert, numFailed);
+
+	return numFailed > 0 ? 1 : 0;
+}
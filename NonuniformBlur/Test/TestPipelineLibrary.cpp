@@ -0,0 +1,254 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include "XUSGPipelineLibrary.h"
+#include "Test.h"
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	// In the working directory of the test
+	const char *const FileName = "TestPipelineLibrary.bin";
+
+	// Stands in for the device: compiling makes a blob of the key, and a blob
+	// is accepted if it is the one of the key, as for the same driver
+	struct Device
+	{
+		bool Create(const PipelineLibrary::Key &key, const void *pBlob, size_t size)
+		{
+			if (pBlob)
+			{
+				++NumLoads;
+
+				return size == sizeof(key) && memcmp(pBlob, &key, size) == 0 && !RejectsBlobs;
+			}
+
+			++NumCompiles;
+
+			return true;
+		}
+
+		PipelineLibrary::CreateResult Create(PipelineLibrary &library, const PipelineLibrary::Key &key)
+		{
+			const auto result = library.Create(key, [&](const void *pBlob, size_t size) { return Create(key, pBlob, size); });
+			if (result == PipelineLibrary::CREATE_COMPILED) library.SetBlob(key, &key, sizeof(key));
+
+			return result;
+		}
+
+		uint32_t NumLoads = 0;
+		uint32_t NumCompiles = 0;
+		bool RejectsBlobs = false;
+	};
+
+	const PipelineLibrary::Key Keys[] = { { 1, 2 }, { 3, 2 }, { 1, 4 } };
+
+	bool save(PipelineLibrary &library)
+	{
+		ofstream fileStream(FileName, ios::out | ios::binary | ios::trunc);
+		T_CHECK(fileStream && library.Save(fileStream));
+
+		return true;
+	}
+
+	bool load(PipelineLibrary &library)
+	{
+		ifstream fileStream(FileName, ios::in | ios::binary);
+
+		return fileStream && library.Load(fileStream);
+	}
+
+	// Rewrites the file through a function of its bytes
+	template<typename Func>
+	bool rewrite(Func func)
+	{
+		ifstream inStream(FileName, ios::in | ios::binary);
+		vector<char> data((istreambuf_iterator<char>(inStream)), istreambuf_iterator<char>());
+		inStream.close();
+		func(data);
+
+		ofstream outStream(FileName, ios::out | ios::binary | ios::trunc);
+		T_CHECK(outStream.write(data.data(), data.size()));
+
+		return true;
+	}
+
+	// A first run compiles all the pipelines and saves their blobs
+	bool saveCompiled()
+	{
+		PipelineLibrary library;
+		Device device;
+		for (const auto &key : Keys)
+			T_CHECK(device.Create(library, key) == PipelineLibrary::CREATE_COMPILED);
+		T_CHECK(device.NumCompiles == 3 && library.IsDirty());
+		T_CHECK(save(library));
+		T_CHECK(!library.IsDirty());
+
+		return true;
+	}
+
+	// A later run compiles all the pipelines again, with the file or without
+	bool loadsNothing(bool loaded)
+	{
+		PipelineLibrary library;
+		Device device;
+		T_CHECK(load(library) == loaded);
+		T_CHECK(library.GetNumBlobs() == 0);
+		for (const auto &key : Keys)
+			T_CHECK(device.Create(library, key) == PipelineLibrary::CREATE_COMPILED);
+		T_CHECK(device.NumLoads == 0 && device.NumCompiles == 3);
+
+		return true;
+	}
+}
+
+bool TestRoundTrip()
+{
+	T_CHECK(saveCompiled());
+
+	// The next run loads every pipeline from its blob
+	PipelineLibrary library;
+	Device device;
+	T_CHECK(load(library));
+	T_CHECK(library.GetNumBlobs() == 3 && !library.IsDirty());
+	for (const auto &key : Keys)
+		T_CHECK(device.Create(library, key) == PipelineLibrary::CREATE_LOADED);
+	T_CHECK(device.NumLoads == 3 && device.NumCompiles == 0 && !library.IsDirty());
+
+	// Keys with no content hash are compiled but never cached
+	const PipelineLibrary::Key uncached = { 0, 2 };
+	T_CHECK(device.Create(library, uncached) == PipelineLibrary::CREATE_COMPILED);
+	T_CHECK(library.GetNumBlobs() == 3 && !library.GetBlob(uncached));
+
+	return true;
+}
+
+bool TestTruncated()
+{
+	T_CHECK(saveCompiled());
+	T_CHECK(rewrite([](vector<char> &data) { data.resize(data.size() - 5); }));
+	T_CHECK(loadsNothing(false));
+
+	// Down to a part of the header
+	T_CHECK(rewrite([](vector<char> &data) { data.resize(7); }));
+	T_CHECK(loadsNothing(false));
+
+	// An empty file, as a crash in the middle of saving may leave
+	T_CHECK(rewrite([](vector<char> &data) { data.clear(); }));
+	T_CHECK(loadsNothing(false));
+
+	// And no file at all
+	remove(FileName);
+	T_CHECK(loadsNothing(false));
+
+	return true;
+}
+
+bool TestCorrupt()
+{
+	// A flipped bit in a blob fails the checksum
+	T_CHECK(saveCompiled());
+	T_CHECK(rewrite([](vector<char> &data) { data[data.size() - 8] ^= 1; }));
+	T_CHECK(loadsNothing(false));
+
+	// As does a flipped bit in a key
+	T_CHECK(saveCompiled());
+	T_CHECK(rewrite([](vector<char> &data) { data[40] ^= 1; }));
+	T_CHECK(loadsNothing(false));
+
+	return true;
+}
+
+bool TestCrafted()
+{
+	// A last blob without its padding, and an entry claimed past it, under a
+	// checksum that matches, as of a file rewritten on purpose
+	PipelineLibrary library;
+	const uint8_t blob[] = { 1, 2, 3 };
+	library.SetBlob(Keys[0], blob, sizeof(blob));
+	vector<uint8_t> data;
+	library.Serialize(data);
+	data.resize(data.size() - 5);
+
+	// The header holds the number of entries at byte 8, and the size and the
+	// checksum of the payload, which follows it, at bytes 16 and 24
+	const size_t headerSize = 32;
+	const uint32_t numEntries = 2;
+	const uint64_t payloadSize = data.size() - headerSize;
+	const auto checksum = PipelineLibrary::Hash(&data[headerSize], data.size() - headerSize);
+	memcpy(&data[8], &numEntries, sizeof(numEntries));
+	memcpy(&data[16], &payloadSize, sizeof(payloadSize));
+	memcpy(&data[24], &checksum, sizeof(checksum));
+
+	// Read from a buffer of the exact size, so that a read past it is caught
+	unique_ptr<uint8_t[]> pData(new uint8_t[data.size()]);
+	memcpy(pData.get(), data.data(), data.size());
+	T_CHECK(!library.Deserialize(pData.get(), data.size()));
+	T_CHECK(library.GetNumBlobs() == 0);
+
+	return true;
+}
+
+bool TestVersionMismatch()
+{
+	// A file of another version is ignored as a whole
+	T_CHECK(saveCompiled());
+	T_CHECK(rewrite([](vector<char> &data)
+	{
+		const auto version = PipelineLibrary::Version + 1;
+		memcpy(&data[sizeof(uint32_t)], &version, sizeof(uint32_t));
+	}));
+	T_CHECK(loadsNothing(false));
+
+	// And so is one of another format
+	T_CHECK(saveCompiled());
+	T_CHECK(rewrite([](vector<char> &data) { data[0] ^= 0xff; }));
+	T_CHECK(loadsNothing(false));
+
+	return true;
+}
+
+bool TestKeyMismatch()
+{
+	T_CHECK(saveCompiled());
+
+	// A pipeline whose shader or layout changed misses its blob and is compiled,
+	// while the others still load
+	PipelineLibrary library;
+	Device device;
+	T_CHECK(load(library));
+	const PipelineLibrary::Key changed = { 1, 5 };
+	T_CHECK(device.Create(library, changed) == PipelineLibrary::CREATE_COMPILED);
+	T_CHECK(device.Create(library, Keys[0]) == PipelineLibrary::CREATE_LOADED);
+	T_CHECK(library.GetNumBlobs() == 4 && library.IsDirty());
+
+	// A blob the runtime rejects, as from another driver, is dropped and the
+	// pipeline compiled and cached anew
+	device.RejectsBlobs = true;
+	T_CHECK(device.Create(library, Keys[1]) == PipelineLibrary::CREATE_COMPILED);
+	T_CHECK(device.NumLoads == 2 && device.NumCompiles == 2);
+	T_CHECK(library.GetNumBlobs() == 4 && library.GetBlob(Keys[1]));
+
+	return true;
+}
+
+int main()
+{
+	auto numFailed = 0;
+	T_RUN(TestRoundTrip, numFailed);
+	T_RUN(TestTruncated, numFailed);
+	T_RUN(TestCorrupt, numFailed);
+	T_RUN(TestCrafted, numFailed);
+	T_RUN(TestVersionMismatch, numFailed);
+	T_RUN(TestKeyMismatch, numFailed);
+	remove(FileName);
+
+	return numFailed > 0 ? 1 : 0;
+}
@@ -4,6 +4,7 @@
 
 #include "DXFrameworkHelper.h"
 #include "XUSGDDSLoader.h"
+#include "XUSGMappedFile.h"
 #include "dds.h"
 
 using namespace std;
@@ -18,9 +19,42 @@ struct handle_closer
 typedef public unique_ptr<void, handle_closer> ScopedHandle;
 inline HANDLE safe_handle(HANDLE h) { return (h == INVALID_HANDLE_VALUE) ? 0 : h; }
 
+static bool GetTextureData(const uint8_t *ddsData, size_t ddsDataSize,
+	const DDS_HEADER **header, const uint8_t **bitData, size_t *bitSize)
+{
+	// Need at least enough data to fill the header and magic number to be a valid DDS
+	C_RETURN(ddsDataSize < (sizeof(DDS_HEADER) + sizeof(uint32_t)), false);
+
+	// DDS files always start with the same magic number ("DDS ")
+	const auto dwMagicNumber = *reinterpret_cast<const uint32_t*>(ddsData);
+	C_RETURN(dwMagicNumber != DDS_MAGIC, false);
+
+	const auto hdr = reinterpret_cast<const DDS_HEADER*>(ddsData + sizeof(uint32_t));
+
+	// Verify header to validate DDS file
+	C_RETURN(hdr->size != sizeof(DDS_HEADER) || hdr->ddspf.size != sizeof(DDS_PIXELFORMAT), false);
+
+	auto offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+
+	// Check for extensions
+	if (hdr->ddspf.flags & DDS_FOURCC)
+		if (MAKEFOURCC('D', 'X', '1', '0') == hdr->ddspf.fourCC)
+			offset += sizeof(DDS_HEADER_DXT10);
+
+	// Must be long enough for all headers and magic value
+	C_RETURN(ddsDataSize < offset, false);
+
+	// setup the pointers in the process request
+	*header = hdr;
+	*bitData = ddsData + offset;
+	*bitSize = ddsDataSize - offset;
+
+	return true;
+}
+
 static bool LoadTextureDataFromFile(const wchar_t *fileName,
-	unique_ptr<uint8_t[]> &ddsData, DDS_HEADER **header,
-	uint8_t **bitData, size_t *bitSize)
+	unique_ptr<uint8_t[]> &ddsData, const DDS_HEADER **header,
+	const uint8_t **bitData, size_t *bitSize)
 {
 	F_RETURN(!header || !bitData || !bitSize, cerr, E_POINTER, false);
 
@@ -30,7 +64,7 @@ static bool LoadTextureDataFromFile(const wchar_t *fileName,
 
 	// Get the file size
 	fileStream.seekg(0, fileStream.end);
-	const auto fileSize = static_cast<uint32_t>(fileStream.tellg());
+	const auto fileSize = static_cast<size_t>(fileStream.tellg());
 	if (!fileStream.seekg(0))
 	{
 		fileStream.close();
@@ -49,31 +83,21 @@ static bool LoadTextureDataFromFile(const wchar_t *fileName,
 	F_RETURN(!fileStream.read(reinterpret_cast<char*>(ddsData.get()), fileSize),
 		cerr, GetLastError(), false);
 
-	// DDS files always start with the same magic number ("DDS ")
-	const auto dwMagicNumber = *(const uint32_t*)(ddsData.get());
-	C_RETURN(dwMagicNumber != DDS_MAGIC, false);
-
-	const auto hdr = reinterpret_cast<DDS_HEADER*>(ddsData.get() + sizeof(uint32_t));
-
-	// Verify header to validate DDS file
-	C_RETURN(hdr->size != sizeof(DDS_HEADER) || hdr->ddspf.size != sizeof(DDS_PIXELFORMAT), false);
-
-	auto offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
-
-	// Check for extensions
-	if (hdr->ddspf.flags & DDS_FOURCC)
-		if (MAKEFOURCC('D', 'X', '1', '0') == hdr->ddspf.fourCC)
-			offset += sizeof(DDS_HEADER_DXT10);
+	return GetTextureData(ddsData.get(), fileSize, header, bitData, bitSize);
+}
 
-	// Must be long enough for all headers and magic value
-	C_RETURN(fileSize < offset, false);
+// Maps the file instead of reading it, so that the subresource data reference
+// the pages of the mapping and only the upload heap holds a copy of the texels
+static bool MapTextureDataFromFile(const wchar_t *fileName, MappedFile &mappedFile,
+	const DDS_HEADER **header, const uint8_t **bitData, size_t *bitSize)
+{
+	F_RETURN(!header || !bitData || !bitSize, cerr, E_POINTER, false);
+	N_RETURN(mappedFile.Open(fileName), false);
 
-	// setup the pointers in the process request
-	*header = hdr;
-	*bitData = ddsData.get() + offset;
-	*bitSize = fileSize - offset;
+	// The upload copies every subresource in order
+	mappedFile.AdviseSequential();
 
-	return true;
+	return GetTextureData(mappedFile.GetData(), mappedFile.GetSize(), header, bitData, bitSize);
 }
 
 //--------------------------------------------------------------------------------------
@@ -651,27 +675,12 @@ bool Loader::CreateTextureFromMemory(const Device &device, const CommandList &co
 	F_RETURN(!device || !ddsData, cerr, E_INVALIDARG, false);
 
 	// Validate DDS file in memory
-	C_RETURN(ddsDataSize < sizeof(uint32_t) + sizeof(DDS_HEADER), false);
-	
-	const auto magicNumber = reinterpret_cast<const uint32_t&>(*ddsData);
-	C_RETURN(magicNumber != DDS_MAGIC, false);
-
-	// Verify header to validate DDS file
-	auto header = reinterpret_cast<const DDS_HEADER*>(ddsData + sizeof(uint32_t));
-	C_RETURN(header->size != sizeof(DDS_HEADER) ||
-		header->ddspf.size != sizeof(DDS_PIXELFORMAT), false);
-
-	auto offset = sizeof(DDS_HEADER) + sizeof(uint32_t);
-
-	// Check for extensions
-	if (header->ddspf.flags & DDS_FOURCC)
-		if (MAKEFOURCC('D', 'X', '1', '0') == header->ddspf.fourCC)
-			offset += sizeof(DDS_HEADER_DXT10);
-
-	// Must be long enough for all headers and magic value
-	C_RETURN(ddsDataSize < offset, false);
+	const DDS_HEADER *header = nullptr;
+	const uint8_t *bitData = nullptr;
+	size_t bitSize = 0;
+	N_RETURN(GetTextureData(ddsData, ddsDataSize, &header, &bitData, &bitSize), false);
 
-	N_RETURN(CreateTexture(device, commandList, header, ddsData + offset, ddsDataSize - offset,
+	N_RETURN(CreateTexture(device, commandList, header, bitData, bitSize,
 		maxsize, forceSRGB, texture, uploader, L"DDSTextureLoader"), false);
 
 	if (alphaMode) *alphaMode = GetAlphaMode(header);
@@ -686,12 +695,19 @@ bool Loader::CreateTextureFromFile(const Device &device, const CommandList &comm
 	if (alphaMode) *alphaMode = ALPHA_MODE_UNKNOWN;
 	F_RETURN(!device || !fileName, cerr, E_INVALIDARG, false);
 
-	DDS_HEADER *header = nullptr;
-	uint8_t *bitData = nullptr;
+	const DDS_HEADER *header = nullptr;
+	const uint8_t *bitData = nullptr;
 	size_t bitSize = 0;
 
+	// The mapping and the fallback buffer only need to live until the texels
+	// have been copied to the upload heap in CreateTexture()
+	MappedFile mappedFile;
 	unique_ptr<uint8_t[]> ddsData;
-	N_RETURN(LoadTextureDataFromFile(fileName, ddsData, &header, &bitData, &bitSize), false);
+	if (!MapTextureDataFromFile(fileName, mappedFile, &header, &bitData, &bitSize))
+	{
+		mappedFile.Close();
+		N_RETURN(LoadTextureDataFromFile(fileName, ddsData, &header, &bitData, &bitSize), false);
+	}
 
 	N_RETURN(CreateTexture(device, commandList, header, bitData, bitSize,
 		maxsize, forceSRGB, texture, uploader, fileName), false);
@@ -0,0 +1,150 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cwchar>
+#include <vector>
+#endif
+#include <iostream>
+#include "XUSGMappedFile.h"
+
+#ifndef M_RETURN
+#define M_RETURN(x, o, m, r)	if (x) { o << m << endl; return r; }
+#endif
+#ifndef C_RETURN
+#define C_RETURN(x, r)			if (x) return r
+#endif
+
+using namespace std;
+using namespace XUSG;
+
+MappedFile::MappedFile() :
+#ifdef _WIN32
+	m_hFile(nullptr),
+	m_hMapping(nullptr),
+#else
+	m_fd(-1),
+#endif
+	m_pData(nullptr),
+	m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const wchar_t *fileName)
+{
+	Close();
+
+	const auto hFile = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	M_RETURN(hFile == INVALID_HANDLE_VALUE, cerr, "Failed to open the file for mapping.", false);
+	m_hFile = hFile;
+
+	LARGE_INTEGER fileSize;
+	M_RETURN(!GetFileSizeEx(hFile, &fileSize), cerr, "Failed to get the file size.", false);
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+
+	// Empty files cannot be mapped
+	C_RETURN(m_size == 0, false);
+
+	m_hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	M_RETURN(!m_hMapping, cerr, "Failed to create the file mapping.", false);
+
+	m_pData = static_cast<uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+	M_RETURN(!m_pData, cerr, "Failed to map the view of the file.", false);
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData) UnmapViewOfFile(m_pData);
+	if (m_hMapping) CloseHandle(m_hMapping);
+	if (m_hFile) CloseHandle(m_hFile);
+
+	m_hFile = nullptr;
+	m_hMapping = nullptr;
+	m_pData = nullptr;
+	m_size = 0;
+}
+
+void MappedFile::AdviseSequential() const
+{
+	// The cache manager already reads ahead for sequential page faults
+}
+#else
+bool MappedFile::Open(const wchar_t *fileName)
+{
+	Close();
+
+	// POSIX file names are narrow, in the encoding of the current locale
+	const auto length = wcstombs(nullptr, fileName, 0);
+	M_RETURN(length == static_cast<size_t>(-1), cerr, "Failed to convert the file name.", false);
+	vector<char> path(length + 1);
+	wcstombs(path.data(), fileName, path.size());
+
+	m_fd = open(path.data(), O_RDONLY);
+	M_RETURN(m_fd < 0, cerr, "Failed to open the file for mapping.", false);
+
+	struct stat fileStat;
+	M_RETURN(fstat(m_fd, &fileStat) != 0, cerr, "Failed to get the file size.", false);
+	m_size = static_cast<size_t>(fileStat.st_size);
+
+	// Empty files cannot be mapped
+	C_RETURN(m_size == 0, false);
+
+	const auto pData = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+	M_RETURN(pData == MAP_FAILED, cerr, "Failed to map the file.", false);
+	m_pData = static_cast<uint8_t*>(pData);
+
+	// The mapping holds its own reference to the file
+	close(m_fd);
+	m_fd = -1;
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_pData) munmap(m_pData, m_size);
+	if (m_fd >= 0) close(m_fd);
+
+	m_fd = -1;
+	m_pData = nullptr;
+	m_size = 0;
+}
+
+void MappedFile::AdviseSequential() const
+{
+	if (m_pData)
+	{
+		madvise(m_pData, m_size, MADV_SEQUENTIAL);
+		madvise(m_pData, m_size, MADV_WILLNEED);
+	}
+}
+#endif
+
+const uint8_t *MappedFile::GetData() const
+{
+	return m_pData;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return m_size;
+}
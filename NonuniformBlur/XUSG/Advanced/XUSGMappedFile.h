@@ -0,0 +1,44 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace XUSG
+{
+	// Read-only view of a whole file, mapped into the address space with
+	// CreateFileMapping() on Windows and mmap() on POSIX systems, so that the
+	// pages are faulted in from the file cache on first access instead of being
+	// copied into a heap buffer.
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		MappedFile(const MappedFile &) = delete;
+		virtual ~MappedFile();
+
+		MappedFile &operator=(const MappedFile &) = delete;
+
+		bool Open(const wchar_t *fileName);
+		void Close();
+
+		const uint8_t *GetData() const;
+		size_t GetSize() const;
+
+		// Hints that the view will be read front to back once
+		void AdviseSequential() const;
+
+	protected:
+#ifdef _WIN32
+		void		*m_hFile;
+		void		*m_hMapping;
+#else
+		int			m_fd;
+#endif
+		uint8_t		*m_pData;
+		size_t		m_size;
+	};
+}
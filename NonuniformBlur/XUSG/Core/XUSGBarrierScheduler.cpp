@@ -0,0 +1,246 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include <cassert>
+#include "XUSGBarrierScheduler.h"
+
+#ifndef C_RETURN
+#define C_RETURN(x, r)			if (x) return r
+#endif
+
+using namespace std;
+using namespace XUSG;
+
+bool BarrierScheduler::SubresourceKey::operator<(const SubresourceKey &key) const
+{
+	return pResource != key.pResource ? pResource < key.pResource : Subresource < key.Subresource;
+}
+
+BarrierScheduler::BarrierScheduler(uint32_t uavState) :
+	m_states(),
+	m_queuedStates(0),
+	m_barriers(0),
+	m_stats(),
+	m_uavState(uavState)
+{
+}
+
+BarrierScheduler::~BarrierScheduler()
+{
+}
+
+void BarrierScheduler::SetState(void *pResource, uint32_t subresource, uint32_t state)
+{
+	if (subresource == AllSubresources)
+	{
+		assert(m_barriers.empty());
+		for (const auto &i : getSubresources(pResource)) m_states.erase(SubresourceKey{ pResource, i });
+	}
+
+	auto &subresourceState = m_states[SubresourceKey{ pResource, subresource }];
+	subresourceState.State = state;
+	subresourceState.SplitState = state;
+	subresourceState.QueuedIndex = NotQueued;
+	subresourceState.IsSplit = false;
+}
+
+uint32_t BarrierScheduler::GetState(void *pResource, uint32_t subresource) const
+{
+	const auto stateIter = m_states.find(SubresourceKey{ pResource, subresource });
+	if (stateIter == m_states.end() && subresource == AllSubresources)
+	{
+		const auto subresources = getSubresources(pResource);
+		C_RETURN(subresources.empty(), 0);
+
+		const auto state = GetState(pResource, subresources[0]);
+		for (const auto &i : subresources) C_RETURN(GetState(pResource, i) != state, 0);
+
+		return state;
+	}
+
+	return stateIter != m_states.end() ? stateIter->second.State : 0;
+}
+
+bool BarrierScheduler::IsSplit(void *pResource, uint32_t subresource) const
+{
+	const auto stateIter = m_states.find(SubresourceKey{ pResource, subresource });
+	if (stateIter == m_states.end() && subresource == AllSubresources)
+	{
+		for (const auto &i : getSubresources(pResource)) C_RETURN(IsSplit(pResource, i), true);
+
+		return false;
+	}
+
+	return stateIter != m_states.end() && stateIter->second.IsSplit;
+}
+
+void BarrierScheduler::Transition(void *pResource, uint32_t subresource, uint32_t state)
+{
+	const auto stateIter = m_states.find(SubresourceKey{ pResource, subresource });
+	if (stateIter == m_states.end())
+	{
+		if (subresource == AllSubresources)
+		{
+			const auto subresources = getSubresources(pResource);
+			for (const auto &i : subresources) Transition(pResource, i, state);
+			if (!subresources.empty()) return;
+		}
+		else assert(m_states.find(SubresourceKey{ pResource, AllSubresources }) == m_states.end());
+
+		// Untracked, so assumed to be in the state already
+		SetState(pResource, subresource, state);
+
+		return;
+	}
+	auto &subresourceState = stateIter->second;
+
+	// Complete the transition in flight first; a begin not issued yet becomes
+	// a whole transition instead
+	if (subresourceState.IsSplit)
+	{
+		auto i = 0u;
+		const auto numBarriers = static_cast<uint32_t>(m_barriers.size());
+		while (i < numBarriers && !(m_barriers[i].Type == BEGIN_ONLY &&
+			m_barriers[i].pResource == pResource && m_barriers[i].Subresource == subresource)) ++i;
+
+		if (i < numBarriers)
+		{
+			m_barriers[i].Type = TRANSITION;
+			subresourceState.QueuedIndex = i;
+			m_queuedStates.push_back(&subresourceState);
+		}
+		else queue(pResource, subresource, subresourceState.State, subresourceState.SplitState, END_ONLY);
+
+		subresourceState.State = subresourceState.SplitState;
+		subresourceState.IsSplit = false;
+		if (subresourceState.State == state) return;
+	}
+
+	if (subresourceState.QueuedIndex != NotQueued)
+	{
+		if (subresourceState.State == state) return;
+
+		// Nothing ran since the queued transition, so retarget it
+		m_barriers[subresourceState.QueuedIndex].StateAfter = state;
+		++m_stats.NumFolded;
+	}
+	else if (subresourceState.State == state)
+	{
+		if (state == m_uavState) UAVBarrier(pResource);
+
+		return;
+	}
+	else
+	{
+		subresourceState.QueuedIndex = static_cast<uint32_t>(m_barriers.size());
+		m_queuedStates.push_back(&subresourceState);
+		queue(pResource, subresource, subresourceState.State, state, TRANSITION);
+	}
+
+	subresourceState.State = state;
+}
+
+void BarrierScheduler::BeginTransition(void *pResource, uint32_t subresource, uint32_t state)
+{
+	const auto stateIter = m_states.find(SubresourceKey{ pResource, subresource });
+	if (stateIter == m_states.end())
+	{
+		if (subresource == AllSubresources)
+			for (const auto &i : getSubresources(pResource)) BeginTransition(pResource, i, state);
+
+		return;
+	}
+	auto &subresourceState = stateIter->second;
+	if (subresourceState.IsSplit || subresourceState.State == state) return;
+
+	// A queued transition may not be retargeted past the begin
+	queue(pResource, subresource, subresourceState.State, state, BEGIN_ONLY);
+	subresourceState.SplitState = state;
+	subresourceState.QueuedIndex = NotQueued;
+	subresourceState.IsSplit = true;
+}
+
+void BarrierScheduler::UAVBarrier(void *pResource)
+{
+	for (const auto &barrier : m_barriers)
+		if (barrier.Type == UAV && barrier.pResource == pResource) return;
+
+	queue(pResource, AllSubresources, m_uavState, m_uavState, UAV);
+}
+
+uint32_t BarrierScheduler::Flush(const EmitFunc &emit)
+{
+	// Drop the transitions folded back to their original states; the ones back
+	// to the UAV state still order the writes before and after
+	auto numBarriers = 0u;
+	for (const auto &barrier : m_barriers)
+	{
+		auto compacted = barrier;
+		if (barrier.Type == TRANSITION && barrier.StateBefore == barrier.StateAfter)
+		{
+			if (barrier.StateAfter != m_uavState) continue;
+			compacted.Subresource = AllSubresources;
+			compacted.Type = UAV;
+		}
+
+		// One UAV barrier per resource covers all its subresources
+		if (compacted.Type == UAV)
+		{
+			auto isIssued = false;
+			for (auto i = 0u; i < numBarriers && !isIssued; ++i)
+				isIssued = m_barriers[i].Type == UAV && m_barriers[i].pResource == compacted.pResource;
+			if (isIssued) continue;
+		}
+
+		m_barriers[numBarriers++] = compacted;
+		if (compacted.Type == BEGIN_ONLY || compacted.Type == END_ONLY) ++m_stats.NumSplitBarriers;
+		if (compacted.Type == UAV) ++m_stats.NumUAVBarriers;
+	}
+
+	if (numBarriers > 0)
+	{
+		emit(numBarriers, m_barriers.data());
+		++m_stats.NumFlushes;
+		m_stats.NumBarriers += numBarriers;
+	}
+
+	for (const auto &pState : m_queuedStates) pState->QueuedIndex = NotQueued;
+	m_queuedStates.clear();
+	m_barriers.clear();
+
+	return numBarriers;
+}
+
+void BarrierScheduler::Reset()
+{
+	m_states.clear();
+	m_queuedStates.clear();
+	m_barriers.clear();
+}
+
+const BarrierScheduler::Stats &BarrierScheduler::GetStats() const
+{
+	return m_stats;
+}
+
+void BarrierScheduler::ResetStats()
+{
+	m_stats = {};
+}
+
+void BarrierScheduler::queue(void *pResource, uint32_t subresource, uint32_t stateBefore,
+	uint32_t stateAfter, BarrierType type)
+{
+	m_barriers.push_back({ pResource, subresource, stateBefore, stateAfter, type });
+}
+
+vector<uint32_t> BarrierScheduler::getSubresources(void *pResource) const
+{
+	vector<uint32_t> subresources;
+	for (auto stateIter = m_states.lower_bound(SubresourceKey{ pResource, 0 });
+		stateIter != m_states.end() && stateIter->first.pResource == pResource; ++stateIter)
+		if (stateIter->first.Subresource != AllSubresources) subresources.push_back(stateIter->first.Subresource);
+
+	return subresources;
+}
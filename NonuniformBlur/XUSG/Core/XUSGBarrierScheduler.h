@@ -0,0 +1,115 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+namespace XUSG
+{
+	// Queues the resource transitions of a sequence of dispatches and issues each
+	// batch as one barrier call. Transitions of a subresource queued since the last
+	// flush fold into one, and a transition started by BeginTransition() is issued
+	// as a BEGIN_ONLY barrier at once and completed as an END_ONLY barrier when the
+	// subresource is next transitioned. States are plain integers, so the
+	// scheduling has no Direct3D dependencies.
+	class BarrierScheduler
+	{
+	public:
+		enum BarrierType : uint8_t
+		{
+			TRANSITION,
+			BEGIN_ONLY,
+			END_ONLY,
+			UAV,
+
+			NUM_BARRIER_TYPE
+		};
+
+		struct Barrier
+		{
+			void		*pResource;
+			uint32_t	Subresource;
+			uint32_t	StateBefore;
+			uint32_t	StateAfter;
+			BarrierType	Type;
+		};
+
+		struct Stats
+		{
+			uint32_t NumFlushes;		// Barrier calls issued
+			uint32_t NumBarriers;		// Barriers in those calls
+			uint32_t NumSplitBarriers;	// BEGIN_ONLY and END_ONLY halves
+			uint32_t NumUAVBarriers;
+			uint32_t NumFolded;			// Transitions merged into a queued one
+		};
+
+		using EmitFunc = std::function<void(uint32_t numBarriers, const Barrier *pBarriers)>;
+
+		static const uint32_t AllSubresources = 0xffffffff;
+
+		// uavState is the state that needs a UAV barrier between writes
+		BarrierScheduler(uint32_t uavState);
+		virtual ~BarrierScheduler();
+
+		// Subresources must be tracked before they are transitioned. A resource is
+		// tracked either as a whole, with AllSubresources, or per subresource; the
+		// calls with AllSubresources on a resource tracked per subresource apply to
+		// each of its tracked subresources. Tracking a resource as a whole forgets
+		// its subresources, so the queue must have been flushed. GetState() of all
+		// the subresources is the state they share, or 0 if they differ.
+		void SetState(void *pResource, uint32_t subresource, uint32_t state);
+		uint32_t GetState(void *pResource, uint32_t subresource) const;
+		bool IsSplit(void *pResource, uint32_t subresource) const;
+
+		void Transition(void *pResource, uint32_t subresource, uint32_t state);
+		void BeginTransition(void *pResource, uint32_t subresource, uint32_t state);
+		void UAVBarrier(void *pResource);
+
+		// Issues the queued barriers, if any, through emit; returns their number
+		uint32_t Flush(const EmitFunc &emit);
+
+		// Forgets the tracked states; the queue must have been flushed
+		void Reset();
+
+		const Stats &GetStats() const;
+		void ResetStats();
+
+	protected:
+		struct SubresourceKey
+		{
+			void		*pResource;
+			uint32_t	Subresource;
+
+			bool operator<(const SubresourceKey &key) const;
+		};
+
+		struct SubresourceState
+		{
+			uint32_t	State;			// Before any split transition in flight
+			uint32_t	SplitState;		// Target of the split transition in flight
+			uint32_t	QueuedIndex;	// Of the queued TRANSITION, or NotQueued
+			bool		IsSplit;
+		};
+
+		void queue(void *pResource, uint32_t subresource, uint32_t stateBefore,
+			uint32_t stateAfter, BarrierType type);
+
+		// The subresources of a resource tracked per subresource, none if it is
+		// tracked as a whole or not at all
+		std::vector<uint32_t> getSubresources(void *pResource) const;
+
+		static const uint32_t NotQueued = 0xffffffff;
+
+		std::map<SubresourceKey, SubresourceState> m_states;
+		std::vector<SubresourceState*> m_queuedStates;
+		std::vector<Barrier> m_barriers;
+
+		Stats		m_stats;
+		uint32_t	m_uavState;
+	};
+}
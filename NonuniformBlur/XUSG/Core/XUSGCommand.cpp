@@ -107,6 +107,29 @@ void CommandList::Barrier(uint32_t numBarriers, const ResourceBarrier *pBarriers
 	if (numBarriers > 0) m_commandList->ResourceBarrier(numBarriers, pBarriers);
 }
 
+void CommandList::Barrier(uint32_t numBarriers, const BarrierScheduler::Barrier *pBarriers) const
+{
+	static const BarrierFlags flags[BarrierScheduler::NUM_BARRIER_TYPE] =
+	{
+		D3D12_RESOURCE_BARRIER_FLAG_NONE,
+		D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY,
+		D3D12_RESOURCE_BARRIER_FLAG_END_ONLY,
+		D3D12_RESOURCE_BARRIER_FLAG_NONE
+	};
+
+	vector<ResourceBarrier> barriers(numBarriers);
+	for (auto i = 0u; i < numBarriers; ++i)
+	{
+		const auto &barrier = pBarriers[i];
+		const auto pResource = static_cast<Resource::element_type*>(barrier.pResource);
+		barriers[i] = barrier.Type == BarrierScheduler::UAV ? ResourceBarrier::UAV(pResource) :
+			ResourceBarrier::Transition(pResource, static_cast<ResourceState>(barrier.StateBefore),
+				static_cast<ResourceState>(barrier.StateAfter), barrier.Subresource, flags[barrier.Type]);
+	}
+
+	Barrier(numBarriers, barriers.data());
+}
+
 void CommandList::SetDescriptorPools(uint32_t numDescriptorPools, const DescriptorPool *pDescriptorPools) const
 {
 	vector<DescriptorPool::element_type*> ppDescriptorPools(numDescriptorPools);
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "XUSGType.h"
+#include "XUSGBarrierScheduler.h"
 
 namespace XUSG
 {
@@ -47,6 +48,7 @@ namespace XUSG
 		virtual void OMSetStencilRef(uint32_t stencilRef) const;
 		virtual void SetPipelineState(const Pipeline &pipelineState) const;
 		virtual void Barrier(uint32_t numBarriers, const ResourceBarrier *pBarriers) const;
+		virtual void Barrier(uint32_t numBarriers, const BarrierScheduler::Barrier *pBarriers) const;
 		//virtual void ExecuteBundle(GraphicsCommandList &commandList) const = 0;
 		virtual void SetDescriptorPools(uint32_t numDescriptorPools, const DescriptorPool *pDescriptorPools) const;
 		virtual void SetComputePipelineLayout(const PipelineLayout &pipelineLayout) const;
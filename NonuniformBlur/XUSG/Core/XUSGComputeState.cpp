@@ -4,6 +4,8 @@
 
 #include "DXFrameworkHelper.h"
 #include "XUSGComputeState.h"
+#include "XUSGPipelineLayout.h"
+#include "XUSGShader.h"
 
 using namespace std;
 using namespace XUSG;
@@ -23,12 +25,16 @@ State::~State()
 
 void State::SetPipelineLayout(const PipelineLayout &layout)
 {
-	m_pKey->PipelineLayout = layout.get();
+	// Layouts not created by a PipelineLayoutCache carry no hash
+	const auto hash = GetPipelineLayoutHash(layout);
+	m_pipelineLayout = layout;
+	m_pKey->PipelineLayout = hash ? hash : reinterpret_cast<uintptr_t>(layout.get());
 }
 
 void State::SetShader(Blob shader)
 {
-	m_pKey->Shader = shader.get();
+	m_shader = shader;
+	m_pKey->Shader = GetShaderHash(shader);
 }
 
 Pipeline State::CreatePipeline(PipelineCache &pipelineCache, const wchar_t *name) const
@@ -46,11 +52,22 @@ const string &State::GetKey() const
 	return m_key;
 }
 
+const PipelineLayout &State::GetPipelineLayout() const
+{
+	return m_pipelineLayout;
+}
+
+const Blob &State::GetShader() const
+{
+	return m_shader;
+}
+
 //--------------------------------------------------------------------------------------
 
 PipelineCache::PipelineCache() :
 	m_device(nullptr),
-	m_pipelines()
+	m_pipelines(),
+	m_library()
 {
 }
 
@@ -76,41 +93,81 @@ void PipelineCache::SetPipeline(const string &key, const Pipeline &pipeline)
 
 Pipeline PipelineCache::CreatePipeline(const State &state, const wchar_t *name)
 {
-	return createPipeline(reinterpret_cast<const State::Key*>(state.GetKey().data()), name);
+	return createPipeline(state, name);
 }
 
 Pipeline PipelineCache::GetPipeline(const State &state, const wchar_t *name)
 {
-	return getPipeline(state.GetKey(), name);
+	return getPipeline(state, name);
+}
+
+bool PipelineCache::LoadPipelineLibrary(const wstring &fileName)
+{
+	// A missing file just means a cold start
+	ifstream fileStream(fileName, ios::in | ios::binary);
+	C_RETURN(!fileStream, false);
+
+	return m_library.Load(fileStream);
+}
+
+bool PipelineCache::SavePipelineLibrary(const wstring &fileName)
+{
+	C_RETURN(!m_library.IsDirty(), true);
+
+	ofstream fileStream(fileName, ios::out | ios::binary | ios::trunc);
+	M_RETURN(!fileStream, cerr, "Failed to create the pipeline library file.", false);
+	M_RETURN(!m_library.Save(fileStream), cerr, "Failed to write the pipeline library file.", false);
+
+	return true;
 }
 
-Pipeline PipelineCache::createPipeline(const State::Key *pKey, const wchar_t *name)
+Pipeline PipelineCache::createPipeline(const State &state, const wchar_t *name)
 {
 	// Fill desc
 	PipelineDesc desc = {};
-	if (pKey->PipelineLayout)
-		desc.pRootSignature = static_cast<decltype(desc.pRootSignature)>(pKey->PipelineLayout);
+	if (state.GetPipelineLayout())
+		desc.pRootSignature = state.GetPipelineLayout().get();
 
-	if (pKey->Shader)
-		desc.CS = Shader::ByteCode(static_cast<BlobType*>(pKey->Shader));
+	if (state.GetShader())
+		desc.CS = Shader::ByteCode(state.GetShader().get());
 
-	// Create pipeline
+	// Only layouts with a content hash may be persisted
+	PipelineLibrary::Key libraryKey = {};
+	libraryKey.ShaderHash = reinterpret_cast<const State::Key*>(state.GetKey().data())->Shader;
+	libraryKey.LayoutHash = GetPipelineLayoutHash(state.GetPipelineLayout());
+
+	// The runtime rejects blobs of another adapter or driver, and then the
+	// pipeline is compiled anew
 	Pipeline pipeline;
-	V_RETURN(m_device->CreateComputePipelineState(&desc, IID_PPV_ARGS(&pipeline)), cerr, nullptr);
+	auto hr = S_OK;
+	const auto result = m_library.Create(libraryKey, [&](const void *pBlob, size_t size)
+	{
+		desc.CachedPSO.pCachedBlob = pBlob;
+		desc.CachedPSO.CachedBlobSizeInBytes = size;
+		hr = m_device->CreateComputePipelineState(&desc, IID_PPV_ARGS(&pipeline));
+
+		return SUCCEEDED(hr);
+	});
+	F_RETURN(result == PipelineLibrary::CREATE_FAILED, cerr, hr, nullptr);
+
+	Blob cachedBlob;
+	if (result == PipelineLibrary::CREATE_COMPILED && SUCCEEDED(pipeline->GetCachedBlob(&cachedBlob)))
+		m_library.SetBlob(libraryKey, cachedBlob->GetBufferPointer(), cachedBlob->GetBufferSize());
+
 	if (name) pipeline->SetName(name);
 
 	return pipeline;
 }
 
-Pipeline PipelineCache::getPipeline(const string &key, const wchar_t *name)
+Pipeline PipelineCache::getPipeline(const State &state, const wchar_t *name)
 {
+	const auto &key = state.GetKey();
 	const auto pPipeline = m_pipelines.find(key);
 
 	// Create one, if it does not exist
 	if (pPipeline == m_pipelines.end())
 	{
-		const auto pKey = reinterpret_cast<const State::Key*>(key.data());
-		const auto pipeline = createPipeline(pKey, name);
+		const auto pipeline = createPipeline(state, name);
 		m_pipelines[key] = pipeline;
 
 		return pipeline;
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "XUSGType.h"
+#include "XUSGPipelineLibrary.h"
 
 namespace XUSG
 {
@@ -15,10 +16,12 @@ namespace XUSG
 		class State
 		{
 		public:
+			// Hashes of the contents, so that equal pipelines share a key whichever
+			// objects they were set from
 			struct Key
 			{
-				void *PipelineLayout;
-				void *Shader;
+				uint64_t PipelineLayout;
+				uint64_t Shader;
 			};
 
 			State();
@@ -31,10 +34,15 @@ namespace XUSG
 			Pipeline GetPipeline(PipelineCache &pipelineCache, const wchar_t *name = nullptr) const;
 
 			const std::string &GetKey() const;
+			const PipelineLayout &GetPipelineLayout() const;
+			const Blob &GetShader() const;
 
 		protected:
 			Key *m_pKey;
 			std::string m_key;
+
+			PipelineLayout	m_pipelineLayout;
+			Blob			m_shader;
 		};
 
 		class PipelineCache
@@ -50,13 +58,20 @@ namespace XUSG
 			Pipeline CreatePipeline(const State &state, const wchar_t *name = nullptr);
 			Pipeline GetPipeline(const State &state, const wchar_t *name = nullptr);
 
+			// Compiled pipelines persisted across runs; saving writes only if
+			// pipelines were compiled since the load
+			bool LoadPipelineLibrary(const std::wstring &fileName);
+			bool SavePipelineLibrary(const std::wstring &fileName);
+
 		protected:
-			Pipeline createPipeline(const State::Key *pKey, const wchar_t *name);
-			Pipeline getPipeline(const std::string &key, const wchar_t *nam);
+			Pipeline createPipeline(const State &state, const wchar_t *name);
+			Pipeline getPipeline(const State &state, const wchar_t *name);
 
 			Device m_device;
 
-			std::unordered_map<std::string, Pipeline> m_pipelines;
+			std::unordered_map<std::string, Pipeline, PipelineKeyHasher> m_pipelines;
+
+			PipelineLibrary m_library;
 		};
 	}
 }
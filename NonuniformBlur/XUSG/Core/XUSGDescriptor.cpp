@@ -11,34 +11,34 @@ using namespace XUSG;
 
 Util::DescriptorTable::DescriptorTable()
 {
-	m_key.resize(0);
 }
 
 Util::DescriptorTable::~DescriptorTable()
 {
 }
 
-void Util::DescriptorTable::SetDescriptors(uint32_t start, uint32_t num, const Descriptor *srcDescriptors)
+bool Util::DescriptorTable::SetDescriptors(uint32_t start, uint32_t num, const Descriptor *srcDescriptors)
 {
-	const auto size = sizeof(Descriptor) * (start + num);
-	if (size > m_key.size())
-		m_key.resize(size);
+	M_RETURN(!m_key.SetDescriptors(start, num, srcDescriptors), cerr,
+		"A descriptor table cannot hold more than " << DescriptorTableKey::MaxDescriptors << " descriptors.", false);
 
-	const auto descriptors = reinterpret_cast<Descriptor*>(&m_key[0]);
-	memcpy(&descriptors[start], srcDescriptors, sizeof(Descriptor) * num);
+	return true;
 }
 
-void Util::DescriptorTable::SetSamplers(uint32_t start, uint32_t num,
+bool Util::DescriptorTable::SetSamplers(uint32_t start, uint32_t num,
 	const SamplerPreset *presets, DescriptorTableCache &descriptorTableCache)
 {
-	const auto size = sizeof(Sampler*) * (start + num);
-	if (size > m_key.size())
-		m_key.resize(size);
+	// The samplers are only looked up if they fit, as the key rejects them otherwise
+	const auto maxDescriptors = DescriptorTableKey::MaxDescriptors;
+	const Sampler *samplers[maxDescriptors];
+	const auto numFitting = start <= maxDescriptors && num <= maxDescriptors - start ? num : 0;
+	for (auto i = 0u; i < numFitting; ++i)
+		samplers[i] = descriptorTableCache.GetSampler(presets[i]).get();
 
-	const auto descriptors = reinterpret_cast<const Sampler**>(&m_key[0]);
+	M_RETURN(!m_key.SetSamplers(start, num, samplers), cerr,
+		"A descriptor table cannot hold more than " << maxDescriptors << " samplers.", false);
 
-	for (auto i = 0u; i < num; ++i)
-		descriptors[start + i] = descriptorTableCache.GetSampler(presets[i]).get();
+	return true;
 }
 
 DescriptorTable Util::DescriptorTable::CreateCbvSrvUavTable(DescriptorTableCache &descriptorTableCache)
@@ -61,6 +61,16 @@ DescriptorTable Util::DescriptorTable::GetSamplerTable(DescriptorTableCache &des
 	return descriptorTableCache.getSamplerTable(m_key);
 }
 
+DescriptorTable Util::DescriptorTable::CreateTransientCbvSrvUavTable(DescriptorTableCache &descriptorTableCache)
+{
+	return descriptorTableCache.createTransientTable(CBV_SRV_UAV_POOL, m_key);
+}
+
+DescriptorTable Util::DescriptorTable::CreateTransientSamplerTable(DescriptorTableCache &descriptorTableCache)
+{
+	return descriptorTableCache.createTransientTable(SAMPLER_POOL, m_key);
+}
+
 RenderTargetTable Util::DescriptorTable::CreateRtvTable(DescriptorTableCache &descriptorTableCache)
 {
 	return descriptorTableCache.createRtvTable(m_key);
@@ -71,7 +81,7 @@ RenderTargetTable Util::DescriptorTable::GetRtvTable(DescriptorTableCache &descr
 	return descriptorTableCache.getRtvTable(m_key);
 }
 
-const string &Util::DescriptorTable::GetKey() const
+const DescriptorTableKey &Util::DescriptorTable::GetKey() const
 {
 	return m_key;
 }
@@ -80,15 +90,18 @@ const string &Util::DescriptorTable::GetKey() const
 
 DescriptorTableCache::DescriptorTableCache() :
 	m_device(nullptr),
-	m_cbvSrvUavTables(0),
-	m_samplerTables(0),
-	m_rtvTables(0),
-	m_descriptorKeyPtrs(),
+	m_cbvSrvUavTables(),
+	m_samplerTables(),
+	m_rtvTables(),
+	m_allocators(),
 	m_descriptorPools(),
 	m_descriptorStrides(),
-	m_descriptorCounts(),
+	m_transientRings(),
+	m_frameIndex(0),
 	m_samplerPresets()
 {
+	m_allocators[SAMPLER_POOL].SetMaxCapacity(D3D12_MAX_SHADER_VISIBLE_SAMPLER_HEAP_SIZE);
+
 	// Sampler presets
 	m_pfnSamplers[SamplerPreset::POINT_WRAP] = SamplerPointWrap;
 	m_pfnSamplers[SamplerPreset::POINT_CLAMP] = SamplerPointClamp;
@@ -136,6 +149,15 @@ void DescriptorTableCache::AllocateDescriptorPool(DescriptorPoolType type, uint3
 	allocateDescriptorPool(type, numDescriptors);
 }
 
+void DescriptorTableCache::ReserveDescriptorPool(DescriptorPoolType type, uint32_t numDescriptors)
+{
+	// Room for numDescriptors more, so that the tables to come need no growth
+	const auto &descriptorPool = m_descriptorPools[type];
+	const auto descriptorCount = m_allocators[type].GetCount() + numDescriptors;
+	if (!descriptorPool || descriptorPool->GetDesc().NumDescriptors < descriptorCount)
+		allocateDescriptorPool(type, descriptorCount);
+}
+
 DescriptorTable DescriptorTableCache::CreateCbvSrvUavTable(const Util::DescriptorTable &util)
 {
 	return createCbvSrvUavTable(util.GetKey());
@@ -146,6 +168,11 @@ DescriptorTable DescriptorTableCache::GetCbvSrvUavTable(const Util::DescriptorTa
 	return getCbvSrvUavTable(util.GetKey());
 }
 
+bool DescriptorTableCache::RemoveCbvSrvUavTable(const Util::DescriptorTable &util)
+{
+	return removeCbvSrvUavTable(util.GetKey());
+}
+
 DescriptorTable DescriptorTableCache::CreateSamplerTable(const Util::DescriptorTable &util)
 {
 	return createSamplerTable(util.GetKey());
@@ -156,6 +183,11 @@ DescriptorTable DescriptorTableCache::GetSamplerTable(const Util::DescriptorTabl
 	return getSamplerTable(util.GetKey());
 }
 
+bool DescriptorTableCache::RemoveSamplerTable(const Util::DescriptorTable &util)
+{
+	return removeSamplerTable(util.GetKey());
+}
+
 RenderTargetTable DescriptorTableCache::CreateRtvTable(const Util::DescriptorTable &util)
 {
 	return createRtvTable(util.GetKey());
@@ -166,6 +198,40 @@ RenderTargetTable DescriptorTableCache::GetRtvTable(const Util::DescriptorTable
 	return getRtvTable(util.GetKey());
 }
 
+bool DescriptorTableCache::RemoveRtvTable(const Util::DescriptorTable &util)
+{
+	return removeRtvTable(util.GetKey());
+}
+
+bool DescriptorTableCache::AllocateTransientPool(DescriptorPoolType type,
+	uint32_t numDescriptorsPerFrame, uint32_t numFrames)
+{
+	assert(type != RTV_POOL);
+	auto &ring = m_transientRings[type];
+	N_RETURN(allocateDescriptorRange(type, numDescriptorsPerFrame * numFrames, ring.Offset), false);
+	ring.FrameSize = numDescriptorsPerFrame;
+	ring.NumFrames = numFrames;
+	ring.Count = 0;
+
+	return true;
+}
+
+void DescriptorTableCache::SetFrameIndex(uint32_t frameIndex)
+{
+	m_frameIndex = frameIndex;
+	for (auto &ring : m_transientRings) ring.Count = 0;
+}
+
+DescriptorTable DescriptorTableCache::CreateTransientCbvSrvUavTable(const Util::DescriptorTable &util)
+{
+	return createTransientTable(CBV_SRV_UAV_POOL, util.GetKey());
+}
+
+DescriptorTable DescriptorTableCache::CreateTransientSamplerTable(const Util::DescriptorTable &util)
+{
+	return createTransientTable(SAMPLER_POOL, util.GetKey());
+}
+
 const DescriptorPool &DescriptorTableCache::GetDescriptorPool(DescriptorPoolType type) const
 {
 	return m_descriptorPools[type];
@@ -187,7 +253,7 @@ bool DescriptorTableCache::allocateDescriptorPool(DescriptorPoolType type, uint3
 		D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER,
 		D3D12_DESCRIPTOR_HEAP_TYPE_RTV
 	};
-	
+
 	static const wchar_t *poolNames[] =
 	{
 		L".CbvSrvUavPool",
@@ -195,239 +261,257 @@ bool DescriptorTableCache::allocateDescriptorPool(DescriptorPoolType type, uint3
 		L".RtvPool"
 	};
 
+	// Never shrink below the descriptors in use
+	DescriptorPool descriptorPool;
 	D3D12_DESCRIPTOR_HEAP_DESC desc = {};
-	desc.NumDescriptors = numDescriptors;
+	desc.NumDescriptors = (max)(numDescriptors, m_allocators[type].GetCount());
 	desc.Type = heapTypes[type];
 	if (type != D3D12_DESCRIPTOR_HEAP_TYPE_RTV) desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	V_RETURN(m_device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&m_descriptorPools[type])), cerr, false);
-	if (!m_name.empty()) m_descriptorPools[type]->SetName((m_name + poolNames[type]).c_str());
-
-	m_descriptorCounts[type] = 0;
-
-	return true;
-}
-
-bool DescriptorTableCache::reallocateCbvSrvUavPool(const string &key)
-{
-	assert(key.size() > 0);
-	const auto numDescriptors = static_cast<uint32_t>(key.size() / sizeof(Descriptor));
-
-	// Allocate a new pool if neccessary
-	const auto &descriptorPool = m_descriptorPools[CBV_SRV_UAV_POOL];
-	const auto descriptorCount = m_descriptorCounts[CBV_SRV_UAV_POOL] + numDescriptors;
-	if (!descriptorPool || descriptorPool->GetDesc().NumDescriptors < descriptorCount)
+	V_RETURN(m_device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&descriptorPool)), cerr, false);
+	if (!m_name.empty()) descriptorPool->SetName((m_name + poolNames[type]).c_str());
+
+	// Recreate the cached descriptor tables at the same offsets, so that the free
+	// ranges stay valid, and update the table objects held by the callers in place
+	const auto &oldPool = m_descriptorPools[type];
+	const auto &descriptorStride = m_descriptorStrides[type];
+	if (oldPool)
 	{
-		N_RETURN(allocateDescriptorPool(CBV_SRV_UAV_POOL, descriptorCount), false);
-
-		// Recreate descriptor tables
-		for (const auto &pKey : m_descriptorKeyPtrs[CBV_SRV_UAV_POOL])
+		if (type == RTV_POOL)
 		{
-			const auto table = createCbvSrvUavTable(*pKey);
-			*m_cbvSrvUavTables[*pKey] = *table;
+			const auto oldStart = oldPool->GetCPUDescriptorHandleForHeapStart();
+			m_rtvTables.ForEach([&](const DescriptorTableKey &key, RenderTargetTable &table)
+			{
+				const auto offset = DescriptorAllocator::GetOffset(table->ptr, oldStart.ptr, descriptorStride);
+				writeDescriptors(type, descriptorPool, key, offset);
+				*table = Descriptor(descriptorPool->GetCPUDescriptorHandleForHeapStart(), offset, descriptorStride);
+			});
+		}
+		else
+		{
+			auto &tables = type == CBV_SRV_UAV_POOL ? m_cbvSrvUavTables : m_samplerTables;
+			const auto oldStart = oldPool->GetGPUDescriptorHandleForHeapStart();
+			tables.ForEach([&](const DescriptorTableKey &key, DescriptorTable &table)
+			{
+				const auto offset = DescriptorAllocator::GetOffset(table->ptr, oldStart.ptr, descriptorStride);
+				writeDescriptors(type, descriptorPool, key, offset);
+				*table = DescriptorView(descriptorPool->GetGPUDescriptorHandleForHeapStart(), offset, descriptorStride);
+			});
 		}
 	}
 
+	m_descriptorPools[type] = descriptorPool;
+	m_allocators[type].SetCapacity(desc.NumDescriptors);
+
 	return true;
 }
 
-bool DescriptorTableCache::reallocateSamplerPool(const string &key)
+bool DescriptorTableCache::allocateDescriptorRange(DescriptorPoolType type, uint32_t numDescriptors, uint32_t &offset)
 {
-	assert(key.size() > 0);
-	const auto numDescriptors = static_cast<uint32_t>(key.size() / sizeof(Sampler*));
-
-	// Allocate a new pool if neccessary
-	const auto &descriptorPool = m_descriptorPools[SAMPLER_POOL];
-	const auto descriptorCount = m_descriptorCounts[SAMPLER_POOL] + numDescriptors;
-	if (!descriptorPool || descriptorPool->GetDesc().NumDescriptors < descriptorCount)
-	{
-		N_RETURN(allocateDescriptorPool(SAMPLER_POOL, descriptorCount), false);
-
-		// Recreate descriptor tables
-		for (const auto &pKey : m_descriptorKeyPtrs[SAMPLER_POOL])
-		{
-			const auto table = createSamplerTable(*pKey);
-			*m_samplerTables[*pKey] = *table;
-		}
-	}
+	return m_allocators[type].Allocate(numDescriptors, offset,
+		[this, type](uint32_t capacity) { return allocateDescriptorPool(type, capacity); });
+}
 
-	return true;
+void DescriptorTableCache::freeDescriptorRange(DescriptorPoolType type, uint32_t offset, uint32_t numDescriptors)
+{
+	m_allocators[type].Free(offset, numDescriptors);
 }
 
-bool DescriptorTableCache::reallocateRtvPool(const string &key)
+void DescriptorTableCache::writeDescriptors(DescriptorPoolType type, const DescriptorPool &descriptorPool,
+	const DescriptorTableKey &key, uint32_t offset)
 {
-	assert(key.size() > 0);
-	const auto numDescriptors = static_cast<uint32_t>(key.size() / sizeof(Descriptor));
+	const auto numDescriptors = key.GetNumDescriptors();
+	const auto &descriptorStride = m_descriptorStrides[type];
+	Descriptor descriptor(descriptorPool->GetCPUDescriptorHandleForHeapStart(), offset, descriptorStride);
 
-	// Allocate a new pool if neccessary
-	const auto &descriptorPool = m_descriptorPools[RTV_POOL];
-	const auto descriptorCount = m_descriptorCounts[RTV_POOL] + numDescriptors;
-	if (!descriptorPool || descriptorPool->GetDesc().NumDescriptors < descriptorCount)
+	if (type == SAMPLER_POOL)
 	{
-		N_RETURN(allocateDescriptorPool(RTV_POOL, descriptorCount), false);
-
-		// Recreate descriptor tables
-		for (const auto &pKey : m_descriptorKeyPtrs[RTV_POOL])
+		const auto descriptors = key.GetSamplers();
+		for (auto i = 0u; i < numDescriptors; ++i)
 		{
-			const auto table = createRtvTable(*pKey);
-			*m_rtvTables[*pKey] = *table;
+			// Create a sampler
+			m_device->CreateSampler(descriptors[i], descriptor);
+			descriptor.Offset(descriptorStride);
 		}
 	}
-
-	return true;
+	else
+	{
+		// Copy the descriptors into one contiguous range; source ranges of a single
+		// descriptor each, since they may come from different heaps
+		const auto descriptors = key.GetDescriptors();
+		m_device->CopyDescriptors(1, &descriptor, &numDescriptors, numDescriptors, descriptors, nullptr,
+			type == RTV_POOL ? D3D12_DESCRIPTOR_HEAP_TYPE_RTV : D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	}
 }
 
-DescriptorTable DescriptorTableCache::createCbvSrvUavTable(const string &key)
+DescriptorTable DescriptorTableCache::createCbvSrvUavTable(const DescriptorTableKey &key)
 {
-	if (key.size() > 0)
+	if (key.GetNumDescriptors() > 0)
 	{
-		const auto numDescriptors = static_cast<uint32_t>(key.size() / sizeof(Descriptor));
-		const auto descriptors = reinterpret_cast<const Descriptor*>(&key[0]);
-
-		// Compute start addresses for CPU and GPU handles
-		const auto &descriptorPool = m_descriptorPools[CBV_SRV_UAV_POOL];
-		const auto &descriptorStride = m_descriptorStrides[CBV_SRV_UAV_POOL];
-		auto &descriptorCount = m_descriptorCounts[CBV_SRV_UAV_POOL];
-		Descriptor descriptor(descriptorPool->GetCPUDescriptorHandleForHeapStart(), descriptorCount, descriptorStride);
-		DescriptorTable table = make_shared<DescriptorView>(descriptorPool->GetGPUDescriptorHandleForHeapStart(),
-			descriptorCount, descriptorStride);
+		uint32_t offset;
+		N_RETURN(allocateDescriptorRange(CBV_SRV_UAV_POOL, key.GetNumDescriptors(), offset), nullptr);
 
 		// Create a descriptor table
-		for (auto i = 0u; i < numDescriptors; ++i)
-		{
-			// Copy a descriptor
-			m_device->CopyDescriptorsSimple(1, descriptor, descriptors[i], D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-			descriptor.Offset(descriptorStride);
-			++descriptorCount;
-		}
+		const auto &descriptorPool = m_descriptorPools[CBV_SRV_UAV_POOL];
+		writeDescriptors(CBV_SRV_UAV_POOL, descriptorPool, key, offset);
 
-		return table;
+		return make_shared<DescriptorView>(descriptorPool->GetGPUDescriptorHandleForHeapStart(),
+			offset, m_descriptorStrides[CBV_SRV_UAV_POOL]);
 	}
 
 	return nullptr;
 }
 
-DescriptorTable DescriptorTableCache::getCbvSrvUavTable(const string &key)
+DescriptorTable DescriptorTableCache::getCbvSrvUavTable(const DescriptorTableKey &key)
 {
-	if (key.size() > 0)
+	if (key.GetNumDescriptors() > 0)
 	{
-		const auto tableIter = m_cbvSrvUavTables.find(key);
+		const auto pTable = m_cbvSrvUavTables.Find(key);
 
 		// Create one, if it does not exist
-		if (tableIter == m_cbvSrvUavTables.end() && reallocateCbvSrvUavPool(key))
+		if (!pTable)
 		{
 			const auto table = createCbvSrvUavTable(key);
-			m_cbvSrvUavTables[key] = table;
-			m_descriptorKeyPtrs[CBV_SRV_UAV_POOL].push_back(&m_cbvSrvUavTables.find(key)->first);
+			if (table) m_cbvSrvUavTables.Insert(key, table);
 
 			return table;
 		}
 
-		return tableIter->second;
+		return *pTable;
 	}
 
 	return nullptr;
 }
 
-DescriptorTable DescriptorTableCache::createSamplerTable(const string &key)
+bool DescriptorTableCache::removeCbvSrvUavTable(const DescriptorTableKey &key)
+{
+	const auto pTable = m_cbvSrvUavTables.Find(key);
+	C_RETURN(!pTable, false);
+
+	const auto start = m_descriptorPools[CBV_SRV_UAV_POOL]->GetGPUDescriptorHandleForHeapStart();
+	const auto offset = DescriptorAllocator::GetOffset((*pTable)->ptr, start.ptr, m_descriptorStrides[CBV_SRV_UAV_POOL]);
+	freeDescriptorRange(CBV_SRV_UAV_POOL, offset, key.GetNumDescriptors());
+	m_cbvSrvUavTables.Erase(key);
+
+	return true;
+}
+
+DescriptorTable DescriptorTableCache::createSamplerTable(const DescriptorTableKey &key)
 {
-	if (key.size() > 0)
+	if (key.GetNumDescriptors() > 0)
 	{
-		const auto numDescriptors = static_cast<uint32_t>(key.size() / sizeof(Sampler*));
-		const auto descriptors = reinterpret_cast<const Sampler* const*>(&key[0]);
+		uint32_t offset;
+		N_RETURN(allocateDescriptorRange(SAMPLER_POOL, key.GetNumDescriptors(), offset), nullptr);
 
-		// Compute start addresses for CPU and GPU handles
-		const auto &descriptorPool = m_descriptorPools[SAMPLER_POOL];
-		const auto &descriptorStride = m_descriptorStrides[SAMPLER_POOL];
-		auto &descriptorCount = m_descriptorCounts[SAMPLER_POOL];
-		Descriptor descriptor(descriptorPool->GetCPUDescriptorHandleForHeapStart(), descriptorCount, descriptorStride);
-		DescriptorTable table = make_shared<DescriptorView>(descriptorPool->GetGPUDescriptorHandleForHeapStart(),
-			descriptorCount, descriptorStride);
-		
 		// Create a descriptor table
-		for (auto i = 0u; i < numDescriptors; ++i)
-		{
-			// Copy a descriptor
-			m_device->CreateSampler(descriptors[i], descriptor);
-			descriptor.Offset(descriptorStride);
-			++descriptorCount;
-		}
+		const auto &descriptorPool = m_descriptorPools[SAMPLER_POOL];
+		writeDescriptors(SAMPLER_POOL, descriptorPool, key, offset);
 
-		return table;
+		return make_shared<DescriptorView>(descriptorPool->GetGPUDescriptorHandleForHeapStart(),
+			offset, m_descriptorStrides[SAMPLER_POOL]);
 	}
 
 	return nullptr;
 }
 
-DescriptorTable DescriptorTableCache::getSamplerTable(const string &key)
+DescriptorTable DescriptorTableCache::getSamplerTable(const DescriptorTableKey &key)
 {
-	if (key.size() > 0)
+	if (key.GetNumDescriptors() > 0)
 	{
-		const auto tableIter = m_samplerTables.find(key);
+		const auto pTable = m_samplerTables.Find(key);
 
 		// Create one, if it does not exist
-		if (tableIter == m_samplerTables.end() && reallocateSamplerPool(key))
+		if (!pTable)
 		{
 			const auto table = createSamplerTable(key);
-			m_samplerTables[key] = table;
-			m_descriptorKeyPtrs[SAMPLER_POOL].push_back(&m_samplerTables.find(key)->first);
+			if (table) m_samplerTables.Insert(key, table);
 
 			return table;
 		}
 
-		return tableIter->second;
+		return *pTable;
 	}
 
 	return nullptr;
 }
 
-RenderTargetTable DescriptorTableCache::createRtvTable(const string &key)
+bool DescriptorTableCache::removeSamplerTable(const DescriptorTableKey &key)
 {
-	if (key.size() > 0)
-	{
-		const auto numDescriptors = static_cast<uint32_t>(key.size() / sizeof(Descriptor));
-		const auto descriptors = reinterpret_cast<const Descriptor*>(&key[0]);
+	const auto pTable = m_samplerTables.Find(key);
+	C_RETURN(!pTable, false);
 
-		// Compute start addresses for CPU and GPU handles
-		const auto &descriptorPool = m_descriptorPools[RTV_POOL];
-		const auto &descriptorStride = m_descriptorStrides[RTV_POOL];
-		auto &descriptorCount = m_descriptorCounts[RTV_POOL];
-		Descriptor descriptor(descriptorPool->GetCPUDescriptorHandleForHeapStart(), descriptorCount, descriptorStride);
-		RenderTargetTable table = make_shared<Descriptor>();
-		*table = descriptor;
+	const auto start = m_descriptorPools[SAMPLER_POOL]->GetGPUDescriptorHandleForHeapStart();
+	const auto offset = DescriptorAllocator::GetOffset((*pTable)->ptr, start.ptr, m_descriptorStrides[SAMPLER_POOL]);
+	freeDescriptorRange(SAMPLER_POOL, offset, key.GetNumDescriptors());
+	m_samplerTables.Erase(key);
+
+	return true;
+}
+
+RenderTargetTable DescriptorTableCache::createRtvTable(const DescriptorTableKey &key)
+{
+	if (key.GetNumDescriptors() > 0)
+	{
+		uint32_t offset;
+		N_RETURN(allocateDescriptorRange(RTV_POOL, key.GetNumDescriptors(), offset), nullptr);
 
 		// Create a descriptor table
-		for (auto i = 0u; i < numDescriptors; ++i)
-		{
-			// Copy a descriptor
-			m_device->CopyDescriptorsSimple(1, descriptor, descriptors[i], D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-			descriptor.Offset(descriptorStride);
-			++descriptorCount;
-		}
+		const auto &descriptorPool = m_descriptorPools[RTV_POOL];
+		writeDescriptors(RTV_POOL, descriptorPool, key, offset);
 
-		return table;
+		return make_shared<Descriptor>(descriptorPool->GetCPUDescriptorHandleForHeapStart(),
+			offset, m_descriptorStrides[RTV_POOL]);
 	}
 
 	return nullptr;
 }
 
-RenderTargetTable DescriptorTableCache::getRtvTable(const string &key)
+RenderTargetTable DescriptorTableCache::getRtvTable(const DescriptorTableKey &key)
 {
-	if (key.size() > 0)
+	if (key.GetNumDescriptors() > 0)
 	{
-		const auto tableIter = m_rtvTables.find(key);
+		const auto pTable = m_rtvTables.Find(key);
 
 		// Create one, if it does not exist
-		if (tableIter == m_rtvTables.end() && reallocateRtvPool(key))
+		if (!pTable)
 		{
 			const auto table = createRtvTable(key);
-			m_rtvTables[key] = table;
-			m_descriptorKeyPtrs[RTV_POOL].push_back(&m_rtvTables.find(key)->first);
+			if (table) m_rtvTables.Insert(key, table);
 
 			return table;
 		}
 
-		return tableIter->second;
+		return *pTable;
 	}
 
 	return nullptr;
 }
+
+bool DescriptorTableCache::removeRtvTable(const DescriptorTableKey &key)
+{
+	const auto pTable = m_rtvTables.Find(key);
+	C_RETURN(!pTable, false);
+
+	const auto start = m_descriptorPools[RTV_POOL]->GetCPUDescriptorHandleForHeapStart();
+	const auto offset = DescriptorAllocator::GetOffset((*pTable)->ptr, start.ptr, m_descriptorStrides[RTV_POOL]);
+	freeDescriptorRange(RTV_POOL, offset, key.GetNumDescriptors());
+	m_rtvTables.Erase(key);
+
+	return true;
+}
+
+DescriptorTable DescriptorTableCache::createTransientTable(DescriptorPoolType type, const DescriptorTableKey &key)
+{
+	// Append to the partition of the current frame, none if it is full
+	auto &ring = m_transientRings[type];
+	const auto numDescriptors = key.GetNumDescriptors();
+	C_RETURN(numDescriptors == 0 || ring.Count + numDescriptors > ring.FrameSize, nullptr);
+
+	const auto offset = ring.Offset + ring.FrameSize * (m_frameIndex % ring.NumFrames) + ring.Count;
+	ring.Count += numDescriptors;
+
+	const auto &descriptorPool = m_descriptorPools[type];
+	writeDescriptors(type, descriptorPool, key, offset);
+
+	return make_shared<DescriptorView>(descriptorPool->GetGPUDescriptorHandleForHeapStart(),
+		offset, m_descriptorStrides[type]);
+}
@@ -5,6 +5,8 @@
 #pragma once
 
 #include "XUSGType.h"
+#include "XUSGDescriptorAllocator.h"
+#include "XUSGDescriptorTableMap.h"
 
 namespace XUSG
 {
@@ -37,6 +39,9 @@ namespace XUSG
 		NUM_SAMPLER_PRESET
 	};
 	
+	using DescriptorTableKey = BasicDescriptorTableKey<Descriptor, Sampler>;
+	template<typename T> using DescriptorTableMap = BasicDescriptorTableMap<DescriptorTableKey, T>;
+
 	class DescriptorTableCache;
 
 	namespace Util
@@ -47,8 +52,10 @@ namespace XUSG
 			DescriptorTable();
 			virtual ~DescriptorTable();
 
-			void SetDescriptors(uint32_t start, uint32_t num, const Descriptor *srcDescriptors);
-			void SetSamplers(uint32_t start, uint32_t num, const SamplerPreset *presets,
+			// Fail past DescriptorTableKey::MaxDescriptors, leaving the table empty, so
+			// that no table is created from it
+			bool SetDescriptors(uint32_t start, uint32_t num, const Descriptor *srcDescriptors);
+			bool SetSamplers(uint32_t start, uint32_t num, const SamplerPreset *presets,
 				DescriptorTableCache &descriptorTableCache);
 
 			XUSG::DescriptorTable CreateCbvSrvUavTable(DescriptorTableCache &descriptorTableCache);
@@ -57,13 +64,16 @@ namespace XUSG
 			XUSG::DescriptorTable CreateSamplerTable(DescriptorTableCache &descriptorTableCache);
 			XUSG::DescriptorTable GetSamplerTable(DescriptorTableCache &descriptorTableCache);
 
+			XUSG::DescriptorTable CreateTransientCbvSrvUavTable(DescriptorTableCache &descriptorTableCache);
+			XUSG::DescriptorTable CreateTransientSamplerTable(DescriptorTableCache &descriptorTableCache);
+
 			RenderTargetTable CreateRtvTable(DescriptorTableCache &descriptorTableCache);
 			RenderTargetTable GetRtvTable(DescriptorTableCache &descriptorTableCache);
 
-			const std::string &GetKey() const;
+			const DescriptorTableKey &GetKey() const;
 
 		protected:
-			std::string m_key;
+			DescriptorTableKey m_key;
 		};
 	}
 
@@ -77,16 +87,37 @@ namespace XUSG
 		void SetDevice(const Device &device);
 		void SetName(const wchar_t *name);
 
+		// Pools grow geometrically as tables are added, re-creating the cached
+		// tables in place. Tables from Create*Table() are not cached, so they are
+		// only valid until the pool grows; reserve up front when using them.
+		// Removed tables return their ranges for reuse, so the GPU must be done
+		// with them.
 		void AllocateDescriptorPool(DescriptorPoolType type, uint32_t numDescriptors);
+		void ReserveDescriptorPool(DescriptorPoolType type, uint32_t numDescriptors);
 		
 		DescriptorTable CreateCbvSrvUavTable(const Util::DescriptorTable &util);
 		DescriptorTable GetCbvSrvUavTable(const Util::DescriptorTable &util);
+		bool RemoveCbvSrvUavTable(const Util::DescriptorTable &util);
 
 		DescriptorTable CreateSamplerTable(const Util::DescriptorTable &util);
 		DescriptorTable GetSamplerTable(const Util::DescriptorTable &util);
+		bool RemoveSamplerTable(const Util::DescriptorTable &util);
 
 		RenderTargetTable CreateRtvTable(const Util::DescriptorTable &util);
 		RenderTargetTable GetRtvTable(const Util::DescriptorTable &util);
+		bool RemoveRtvTable(const Util::DescriptorTable &util);
+
+		// Transient tables, for bindings that change every frame, come from a ring
+		// of numFrames partitions reserved in the pool instead of accumulating.
+		// SetFrameIndex() recycles the partition of that frame, so call it only
+		// once the GPU is done with the frame that last used it, as for command
+		// allocators. Growing the pool invalidates the transient tables of the
+		// current frame; the creation returns nullptr once its partition is full.
+		bool AllocateTransientPool(DescriptorPoolType type, uint32_t numDescriptorsPerFrame, uint32_t numFrames);
+		void SetFrameIndex(uint32_t frameIndex);
+
+		DescriptorTable CreateTransientCbvSrvUavTable(const Util::DescriptorTable &util);
+		DescriptorTable CreateTransientSamplerTable(const Util::DescriptorTable &util);
 
 		const DescriptorPool &GetDescriptorPool(DescriptorPoolType type) const;
 		
@@ -96,30 +127,46 @@ namespace XUSG
 		friend class Util::DescriptorTable;
 
 		bool allocateDescriptorPool(DescriptorPoolType type, uint32_t numDescriptors);
-		bool reallocateCbvSrvUavPool(const std::string &key);
-		bool reallocateSamplerPool(const std::string &key);
-		bool reallocateRtvPool(const std::string &key);
+		bool allocateDescriptorRange(DescriptorPoolType type, uint32_t numDescriptors, uint32_t &offset);
+		void freeDescriptorRange(DescriptorPoolType type, uint32_t offset, uint32_t numDescriptors);
+		void writeDescriptors(DescriptorPoolType type, const DescriptorPool &descriptorPool,
+			const DescriptorTableKey &key, uint32_t offset);
 		
-		DescriptorTable createCbvSrvUavTable(const std::string &key);
-		DescriptorTable getCbvSrvUavTable(const std::string &key);
+		DescriptorTable createCbvSrvUavTable(const DescriptorTableKey &key);
+		DescriptorTable getCbvSrvUavTable(const DescriptorTableKey &key);
+		bool removeCbvSrvUavTable(const DescriptorTableKey &key);
+
+		DescriptorTable createSamplerTable(const DescriptorTableKey &key);
+		DescriptorTable getSamplerTable(const DescriptorTableKey &key);
+		bool removeSamplerTable(const DescriptorTableKey &key);
 
-		DescriptorTable createSamplerTable(const std::string &key);
-		DescriptorTable getSamplerTable(const std::string &key);
+		RenderTargetTable createRtvTable(const DescriptorTableKey &key);
+		RenderTargetTable getRtvTable(const DescriptorTableKey &key);
+		bool removeRtvTable(const DescriptorTableKey &key);
 
-		RenderTargetTable createRtvTable(const std::string &key);
-		RenderTargetTable getRtvTable(const std::string &key);
+		DescriptorTable createTransientTable(DescriptorPoolType type, const DescriptorTableKey &key);
 
 		Device m_device;
 
-		std::unordered_map<std::string, DescriptorTable> m_cbvSrvUavTables;
-		std::unordered_map<std::string, DescriptorTable> m_samplerTables;
-		std::unordered_map<std::string, RenderTargetTable> m_rtvTables;
+		DescriptorTableMap<DescriptorTable> m_cbvSrvUavTables;
+		DescriptorTableMap<DescriptorTable> m_samplerTables;
+		DescriptorTableMap<RenderTargetTable> m_rtvTables;
 
-		std::vector<const std::string*> m_descriptorKeyPtrs[NUM_DESCRIPTOR_POOL];
+		DescriptorAllocator m_allocators[NUM_DESCRIPTOR_POOL];
 
 		DescriptorPool	m_descriptorPools[NUM_DESCRIPTOR_POOL];
 		uint32_t		m_descriptorStrides[NUM_DESCRIPTOR_POOL];
-		uint32_t		m_descriptorCounts[NUM_DESCRIPTOR_POOL];
+
+		struct TransientRing
+		{
+			uint32_t Offset;
+			uint32_t FrameSize;
+			uint32_t NumFrames;
+			uint32_t Count;
+		};
+
+		TransientRing	m_transientRings[NUM_DESCRIPTOR_POOL];
+		uint32_t		m_frameIndex;
 
 		std::shared_ptr<Sampler> m_samplerPresets[NUM_SAMPLER_PRESET];
 		std::function<Sampler()> m_pfnSamplers[NUM_SAMPLER_PRESET];
@@ -0,0 +1,119 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <iterator>
+#include "XUSGDescriptorAllocator.h"
+
+#ifndef C_RETURN
+#define C_RETURN(x, r)			if (x) return r
+#endif
+#ifndef N_RETURN
+#define N_RETURN(x, r)			C_RETURN(!(x), r)
+#endif
+
+using namespace std;
+using namespace XUSG;
+
+DescriptorAllocator::DescriptorAllocator(uint32_t maxCapacity) :
+	m_freeRanges(),
+	m_count(0),
+	m_capacity(0),
+	m_maxCapacity(maxCapacity)
+{
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+}
+
+bool DescriptorAllocator::Allocate(uint32_t numDescriptors, uint32_t &offset, const GrowFunc &pfnGrow)
+{
+	// Reuse the first released range that fits
+	for (auto rangeIter = m_freeRanges.begin(); rangeIter != m_freeRanges.end(); ++rangeIter)
+	{
+		if (rangeIter->second >= numDescriptors)
+		{
+			offset = rangeIter->first;
+			if (rangeIter->second > numDescriptors)
+				m_freeRanges[offset + numDescriptors] = rangeIter->second - numDescriptors;
+			m_freeRanges.erase(rangeIter);
+
+			return true;
+		}
+	}
+
+	// Otherwise append, growing the pool geometrically up to the maximum capacity,
+	// unless the request alone exceeds it
+	const auto numRequired = m_count + numDescriptors;
+	if (m_capacity < numRequired)
+	{
+		const auto newCapacity = (max)(numRequired, (min)((max)(m_capacity, m_capacity * 2), m_maxCapacity));
+		N_RETURN(pfnGrow(newCapacity), false);
+		m_capacity = (max)(m_capacity, newCapacity);
+	}
+
+	offset = m_count;
+	m_count = numRequired;
+
+	return true;
+}
+
+void DescriptorAllocator::Free(uint32_t offset, uint32_t numDescriptors)
+{
+	// Merge with the following range
+	const auto nextIter = m_freeRanges.find(offset + numDescriptors);
+	if (nextIter != m_freeRanges.end())
+	{
+		numDescriptors += nextIter->second;
+		m_freeRanges.erase(nextIter);
+	}
+
+	// Merge with the preceding range
+	const auto rangeIter = m_freeRanges.lower_bound(offset);
+	if (rangeIter != m_freeRanges.begin())
+	{
+		const auto prevIter = prev(rangeIter);
+		if (prevIter->first + prevIter->second == offset)
+		{
+			offset = prevIter->first;
+			numDescriptors += prevIter->second;
+			m_freeRanges.erase(prevIter);
+		}
+	}
+
+	// A range at the end returns to the unused tail
+	if (offset + numDescriptors == m_count) m_count = offset;
+	else m_freeRanges[offset] = numDescriptors;
+}
+
+void DescriptorAllocator::SetCapacity(uint32_t capacity)
+{
+	m_capacity = capacity;
+}
+
+void DescriptorAllocator::SetMaxCapacity(uint32_t maxCapacity)
+{
+	m_maxCapacity = maxCapacity;
+}
+
+uint32_t DescriptorAllocator::GetCapacity() const
+{
+	return m_capacity;
+}
+
+uint32_t DescriptorAllocator::GetCount() const
+{
+	return m_count;
+}
+
+const map<uint32_t, uint32_t> &DescriptorAllocator::GetFreeRanges() const
+{
+	return m_freeRanges;
+}
+
+uint32_t DescriptorAllocator::GetOffset(uint64_t handle, uint64_t start, uint32_t stride)
+{
+	return static_cast<uint32_t>((handle - start) / stride);
+}
@@ -0,0 +1,50 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+
+namespace XUSG
+{
+	// Bookkeeping of the descriptor ranges in a pool: first-fit reuse of released
+	// ranges, merged with their neighbors, before appending to the tail, which
+	// grows the pool geometrically so that adding N tables re-creates O(N)
+	// descriptors in total. The growth keeps every range at its offset, so the
+	// owner re-creates the tables in the new pool and rebases their handles with
+	// GetOffset(). It has no Direct3D dependencies.
+	class DescriptorAllocator
+	{
+	public:
+		// Creates the pool at the capacity given, returning whether it succeeded
+		using GrowFunc = std::function<bool(uint32_t)>;
+
+		DescriptorAllocator(uint32_t maxCapacity = UINT32_MAX);
+		virtual ~DescriptorAllocator();
+
+		bool Allocate(uint32_t numDescriptors, uint32_t &offset, const GrowFunc &pfnGrow);
+		void Free(uint32_t offset, uint32_t numDescriptors);
+
+		// The capacity of the pool, after the owner re-creates it
+		void SetCapacity(uint32_t capacity);
+		void SetMaxCapacity(uint32_t maxCapacity);
+
+		uint32_t GetCapacity() const;
+		uint32_t GetCount() const;
+		const std::map<uint32_t, uint32_t> &GetFreeRanges() const;
+
+		// The offset of a handle in the pool whose start handle is given
+		static uint32_t GetOffset(uint64_t handle, uint64_t start, uint32_t stride);
+
+	protected:
+		// Released ranges, offset to size, merged with their neighbors
+		std::map<uint32_t, uint32_t> m_freeRanges;
+
+		uint32_t m_count;
+		uint32_t m_capacity;
+		uint32_t m_maxCapacity;
+	};
+}
@@ -0,0 +1,225 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace XUSG
+{
+	// Descriptor handles, or sampler pointers, of a table stored inline with a
+	// 64-bit hash that is updated as they are set, so that building and looking
+	// up a key never allocates. The handle types are parameters, so that it has
+	// no Direct3D dependencies; XUSGDescriptor.h defines DescriptorTableKey.
+	// Setting handles past MaxDescriptors fails and empties the key for good, so
+	// that no table is created from it.
+	template<typename TDescriptor, typename TSampler>
+	class BasicDescriptorTableKey
+	{
+	public:
+		static const uint32_t MaxDescriptors = 32;
+
+		BasicDescriptorTableKey() :
+			m_hash(0),
+			m_numDescriptors(0),
+			m_isOverflowed(false)
+		{
+			updateHash();
+		}
+
+		bool SetDescriptors(uint32_t start, uint32_t num, const TDescriptor *descriptors)
+		{
+			if (!resize(start, num)) return false;
+			for (auto i = 0u; i < num; ++i) m_data[start + i] = descriptors[i].ptr;
+			updateHash();
+
+			return true;
+		}
+
+		bool SetSamplers(uint32_t start, uint32_t num, const TSampler *const *samplers)
+		{
+			if (!resize(start, num)) return false;
+			for (auto i = 0u; i < num; ++i) m_data[start + i] = reinterpret_cast<uintptr_t>(samplers[i]);
+			updateHash();
+
+			return true;
+		}
+
+		const TDescriptor *GetDescriptors() const
+		{
+			static_assert(sizeof(TDescriptor) == sizeof(uintptr_t), "A descriptor handle must be pointer-sized.");
+
+			return reinterpret_cast<const TDescriptor*>(m_data);
+		}
+
+		const TSampler *const *GetSamplers() const { return reinterpret_cast<const TSampler* const*>(m_data); }
+		uint32_t GetNumDescriptors() const { return m_numDescriptors; }
+		uint64_t GetHash() const { return m_hash; }
+
+		bool operator==(const BasicDescriptorTableKey &key) const
+		{
+			return m_hash == key.m_hash && m_numDescriptors == key.m_numDescriptors &&
+				memcmp(m_data, key.m_data, sizeof(uintptr_t) * m_numDescriptors) == 0;
+		}
+
+	protected:
+		bool resize(uint32_t start, uint32_t num)
+		{
+			if (m_isOverflowed || start > MaxDescriptors || num > MaxDescriptors - start)
+			{
+				m_isOverflowed = true;
+				m_numDescriptors = 0;
+				updateHash();
+
+				return false;
+			}
+
+			// Unset descriptors in a gap are null
+			const auto numDescriptors = start + num;
+			for (auto i = m_numDescriptors; i < numDescriptors; ++i) m_data[i] = 0;
+			m_numDescriptors = (std::max)(m_numDescriptors, numDescriptors);
+
+			return true;
+		}
+
+		void updateHash()
+		{
+			// FNV-1a over the handles as words, then a 64-bit finalizer, since handles in
+			// the same heap differ by multiples of the stride and share their low bits
+			auto hash = 0xcbf29ce484222325ull ^ m_numDescriptors;
+			for (auto i = 0u; i < m_numDescriptors; ++i)
+				hash = (hash ^ static_cast<uint64_t>(m_data[i])) * 0x100000001b3ull;
+
+			hash ^= hash >> 33;
+			hash *= 0xff51afd7ed558ccdull;
+			hash ^= hash >> 33;
+			hash *= 0xc4ceb9fe1a85ec53ull;
+			hash ^= hash >> 33;
+			m_hash = hash;
+		}
+
+		uintptr_t	m_data[MaxDescriptors];
+		uint64_t	m_hash;
+		uint32_t	m_numDescriptors;
+		bool		m_isOverflowed;
+	};
+
+	// Open-addressing hash map from descriptor table keys, with linear probing
+	// over a power-of-two number of slots
+	template<typename TKey, typename T>
+	class BasicDescriptorTableMap
+	{
+	public:
+		BasicDescriptorTableMap() : m_slots(0), m_numOccupied(0), m_numRemoved(0) {}
+
+		T *Find(const TKey &key)
+		{
+			const auto i = findSlot(key);
+
+			return i < m_slots.size() ? &m_slots[i].Value : nullptr;
+		}
+
+		// A key already in the map is a caller error, asserted in debug builds;
+		// otherwise the value in the map is kept and returned
+		T &Insert(const TKey &key, const T &value)
+		{
+			const auto i = findSlot(key);
+			assert(i == m_slots.size());
+			if (i < m_slots.size()) return m_slots[i].Value;
+
+			return insert(key, value);
+		}
+
+		bool Erase(const TKey &key)
+		{
+			const auto i = findSlot(key);
+			if (i >= m_slots.size()) return false;
+
+			m_slots[i].Value = T();
+			m_slots[i].State = SLOT_REMOVED;
+			--m_numOccupied;
+			++m_numRemoved;
+
+			return true;
+		}
+
+		template<typename Func>
+		void ForEach(Func func)
+		{
+			for (auto &slot : m_slots)
+				if (slot.State == SLOT_OCCUPIED) func(slot.Key, slot.Value);
+		}
+
+		size_t GetSize() const { return m_numOccupied; }
+
+	protected:
+		enum SlotState : uint8_t
+		{
+			SLOT_EMPTY,
+			SLOT_OCCUPIED,
+			SLOT_REMOVED
+		};
+
+		struct Slot
+		{
+			Slot() : State(SLOT_EMPTY) {}
+
+			TKey Key;
+			T Value;
+			SlotState State;
+		};
+
+		size_t findSlot(const TKey &key) const
+		{
+			const auto numSlots = m_slots.size();
+			if (numSlots > 0)
+			{
+				const auto mask = numSlots - 1;
+				for (auto i = static_cast<size_t>(key.GetHash()) & mask; m_slots[i].State != SLOT_EMPTY; i = (i + 1) & mask)
+					if (m_slots[i].State == SLOT_OCCUPIED && m_slots[i].Key == key) return i;
+			}
+
+			return numSlots;
+		}
+
+		T &insert(const TKey &key, const T &value)
+		{
+			// Keep at most 3/4 of the slots in use, counting the removed ones
+			if ((m_numOccupied + m_numRemoved + 1) * 4 > m_slots.size() * 3)
+				rehash((std::max)(m_numOccupied * 4 > m_slots.size() ? m_slots.size() * 2 : m_slots.size(), size_t(16)));
+
+			const auto mask = m_slots.size() - 1;
+			auto i = static_cast<size_t>(key.GetHash()) & mask;
+			while (m_slots[i].State == SLOT_OCCUPIED) i = (i + 1) & mask;
+			if (m_slots[i].State == SLOT_REMOVED) --m_numRemoved;
+
+			auto &slot = m_slots[i];
+			slot.Key = key;
+			slot.Value = value;
+			slot.State = SLOT_OCCUPIED;
+			++m_numOccupied;
+
+			return slot.Value;
+		}
+
+		void rehash(size_t numSlots)
+		{
+			std::vector<Slot> slots(numSlots);
+			m_slots.swap(slots);
+			m_numOccupied = 0;
+			m_numRemoved = 0;
+
+			for (auto &slot : slots)
+				if (slot.State == SLOT_OCCUPIED) insert(slot.Key, slot.Value);
+		}
+
+		std::vector<Slot> m_slots;
+		size_t m_numOccupied;
+		size_t m_numRemoved;
+	};
+}
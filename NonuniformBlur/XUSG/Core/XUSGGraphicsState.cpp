@@ -7,10 +7,47 @@
 #include "XUSGBlend.inl"
 #include "XUSGRasterizer.inl"
 #include "XUSGDepthStencil.inl"
+#include "XUSGPipelineLayout.h"
+#include "XUSGPipelineLibrary.h"
 
 using namespace XUSG;
 using namespace Graphics;
 
+// The descriptors are hashed member by member up to the last one before any
+// padding, since the padding bytes are not guaranteed to be zero
+static uint64_t HashBlend(const D3D12_BLEND_DESC &desc)
+{
+	auto hash = PipelineLibrary::Hash(&desc, offsetof(D3D12_BLEND_DESC, RenderTarget));
+	for (const auto &renderTarget : desc.RenderTarget)
+		hash = PipelineLibrary::Hash(&renderTarget, offsetof(D3D12_RENDER_TARGET_BLEND_DESC,
+			RenderTargetWriteMask) + sizeof(renderTarget.RenderTargetWriteMask), hash);
+
+	return hash;
+}
+
+static uint64_t HashDepthStencil(const D3D12_DEPTH_STENCIL_DESC &desc)
+{
+	auto hash = PipelineLibrary::Hash(&desc, offsetof(D3D12_DEPTH_STENCIL_DESC, StencilWriteMask) +
+		sizeof(desc.StencilWriteMask));
+	hash = PipelineLibrary::Hash(&desc.FrontFace, sizeof(desc.FrontFace), hash);
+
+	return PipelineLibrary::Hash(&desc.BackFace, sizeof(desc.BackFace), hash);
+}
+
+static uint64_t HashInputLayout(const D3D12_INPUT_LAYOUT_DESC &desc)
+{
+	uint64_t hash = desc.NumElements;
+	for (auto i = 0u; i < desc.NumElements; ++i)
+	{
+		const auto &element = desc.pInputElementDescs[i];
+		hash = PipelineLibrary::Hash(element.SemanticName, strlen(element.SemanticName), hash);
+		hash = PipelineLibrary::Hash(&element.SemanticIndex, sizeof(D3D12_INPUT_ELEMENT_DESC) -
+			offsetof(D3D12_INPUT_ELEMENT_DESC, SemanticIndex), hash);
+	}
+
+	return hash;
+}
+
 State::State()
 {
 	// Default state
@@ -27,27 +64,34 @@ State::~State()
 
 void State::SetPipelineLayout(const PipelineLayout &layout)
 {
-	m_pKey->PipelineLayout = layout.get();
+	// Layouts not created by a PipelineLayoutCache carry no hash
+	const auto hash = GetPipelineLayoutHash(layout);
+	m_pipelineLayout = layout;
+	m_pKey->PipelineLayout = hash ? hash : reinterpret_cast<uintptr_t>(layout.get());
 }
 
 void State::SetShader(Shader::Stage stage, Blob shader)
 {
-	m_pKey->Shaders[stage] = shader.get();
+	m_shaders[stage] = shader;
+	m_pKey->Shaders[stage] = GetShaderHash(shader);
 }
 
 void State::OMSetBlendState(const Blend &blend)
 {
-	m_pKey->Blend = blend.get();
+	m_blend = blend;
+	m_pKey->Blend = blend ? HashBlend(*blend) : 0;
 }
 
 void State::RSSetState(const Rasterizer &rasterizer)
 {
-	m_pKey->Rasterizer = rasterizer.get();
+	m_rasterizer = rasterizer;
+	m_pKey->Rasterizer = rasterizer ? PipelineLibrary::Hash(rasterizer.get(), sizeof(D3D12_RASTERIZER_DESC)) : 0;
 }
 
 void State::DSSetState(const DepthStencil &depthStencil)
 {
-	m_pKey->DepthStencil = depthStencil.get();
+	m_depthStencil = depthStencil;
+	m_pKey->DepthStencil = depthStencil ? HashDepthStencil(*depthStencil) : 0;
 }
 
 void State::OMSetBlendState(BlendPreset preset, PipelineCache &pipelineCache)
@@ -67,7 +111,8 @@ void State::DSSetState(DepthStencilPreset preset, PipelineCache &pipelineCache)
 
 void State::IASetInputLayout(const InputLayout &layout)
 {
-	m_pKey->InputLayout = layout.get();
+	m_inputLayout = layout;
+	m_pKey->InputLayout = layout ? HashInputLayout(*layout) : 0;
 }
 
 void State::IASetPrimitiveTopologyType(PrimitiveTopologyType type)
@@ -113,6 +158,36 @@ const string &State::GetKey() const
 	return m_key;
 }
 
+const PipelineLayout &State::GetPipelineLayout() const
+{
+	return m_pipelineLayout;
+}
+
+const Blob &State::GetShader(Shader::Stage stage) const
+{
+	return m_shaders[stage];
+}
+
+const Blend &State::GetBlendState() const
+{
+	return m_blend;
+}
+
+const Rasterizer &State::GetRasterizerState() const
+{
+	return m_rasterizer;
+}
+
+const DepthStencil &State::GetDepthStencilState() const
+{
+	return m_depthStencil;
+}
+
+const InputLayout &State::GetInputLayout() const
+{
+	return m_inputLayout;
+}
+
 //--------------------------------------------------------------------------------------
 
 PipelineCache::PipelineCache() :
@@ -187,12 +262,12 @@ InputLayout PipelineCache::CreateInputLayout(const InputElementTable &elementTab
 
 Pipeline PipelineCache::CreatePipeline(const State &state, const wchar_t *name)
 {
-	return createPipeline(reinterpret_cast<const State::Key*>(state.GetKey().data()), name);
+	return createPipeline(state, name);
 }
 
 Pipeline PipelineCache::GetPipeline(const State &state, const wchar_t *name)
 {
-	return getPipeline(state.GetKey(), name);
+	return getPipeline(state, name);
 }
 
 const Blend &PipelineCache::GetBlend(BlendPreset preset)
@@ -219,34 +294,35 @@ const DepthStencil &PipelineCache::GetDepthStencil(DepthStencilPreset preset)
 	return m_depthStencils[preset];
 }
 
-Pipeline PipelineCache::createPipeline(const State::Key *pKey, const wchar_t *name)
+Pipeline PipelineCache::createPipeline(const State &state, const wchar_t *name)
 {
 	// Fill desc
+	const auto pKey = reinterpret_cast<const State::Key*>(state.GetKey().data());
 	PipelineDesc desc = {};
-	if (pKey->PipelineLayout)
-		desc.pRootSignature = static_cast<decltype(desc.pRootSignature)>(pKey->PipelineLayout);
-
-	if (pKey->Shaders[Shader::Stage::VS])
-		desc.VS = Shader::ByteCode(static_cast<BlobType*>(pKey->Shaders[Shader::Stage::VS]));
-	if (pKey->Shaders[Shader::Stage::PS])
-		desc.PS = Shader::ByteCode(static_cast<BlobType*>(pKey->Shaders[Shader::Stage::PS]));
-	if (pKey->Shaders[Shader::Stage::DS])
-		desc.DS = Shader::ByteCode(static_cast<BlobType*>(pKey->Shaders[Shader::Stage::DS]));
-	if (pKey->Shaders[Shader::Stage::HS])
-		desc.HS = Shader::ByteCode(static_cast<BlobType*>(pKey->Shaders[Shader::Stage::HS]));
-	if (pKey->Shaders[Shader::Stage::GS])
-		desc.GS = Shader::ByteCode(static_cast<BlobType*>(pKey->Shaders[Shader::Stage::GS]));
-
-	const auto blend = static_cast<decltype(desc.BlendState)*>(pKey->Blend);
-	desc.BlendState = *(blend ? blend : GetBlend(BlendPreset::DEFAULT_OPAQUE).get());
+	if (state.GetPipelineLayout())
+		desc.pRootSignature = state.GetPipelineLayout().get();
+
+	if (state.GetShader(Shader::Stage::VS))
+		desc.VS = Shader::ByteCode(state.GetShader(Shader::Stage::VS).get());
+	if (state.GetShader(Shader::Stage::PS))
+		desc.PS = Shader::ByteCode(state.GetShader(Shader::Stage::PS).get());
+	if (state.GetShader(Shader::Stage::DS))
+		desc.DS = Shader::ByteCode(state.GetShader(Shader::Stage::DS).get());
+	if (state.GetShader(Shader::Stage::HS))
+		desc.HS = Shader::ByteCode(state.GetShader(Shader::Stage::HS).get());
+	if (state.GetShader(Shader::Stage::GS))
+		desc.GS = Shader::ByteCode(state.GetShader(Shader::Stage::GS).get());
+
+	const auto &blend = state.GetBlendState();
+	desc.BlendState = *(blend ? blend : GetBlend(BlendPreset::DEFAULT_OPAQUE));
 	desc.SampleMask = UINT_MAX;
 
-	const auto rasterizer = static_cast<decltype(desc.RasterizerState)*>(pKey->Rasterizer);
-	const auto depthStencil = static_cast<decltype(desc.DepthStencilState)*>(pKey->DepthStencil);
-	desc.RasterizerState = *(rasterizer ? rasterizer : GetRasterizer(RasterizerPreset::CULL_BACK).get());
-	desc.DepthStencilState = *(depthStencil ? depthStencil : GetDepthStencil(DepthStencilPreset::DEFAULT_LESS).get());
-	if (pKey->InputLayout)
-		desc.InputLayout = *static_cast<decltype(desc.InputLayout)*>(pKey->InputLayout);
+	const auto &rasterizer = state.GetRasterizerState();
+	const auto &depthStencil = state.GetDepthStencilState();
+	desc.RasterizerState = *(rasterizer ? rasterizer : GetRasterizer(RasterizerPreset::CULL_BACK));
+	desc.DepthStencilState = *(depthStencil ? depthStencil : GetDepthStencil(DepthStencilPreset::DEFAULT_LESS));
+	if (state.GetInputLayout())
+		desc.InputLayout = *state.GetInputLayout();
 	desc.PrimitiveTopologyType = static_cast<PrimitiveTopologyType>(pKey->PrimitiveTopologyType);
 	desc.NumRenderTargets = pKey->NumRenderTargets;
 
@@ -263,15 +339,15 @@ Pipeline PipelineCache::createPipeline(const State::Key *pKey, const wchar_t *na
 	return pipeline;
 }
 
-Pipeline PipelineCache::getPipeline(const string &key, const wchar_t *name)
+Pipeline PipelineCache::getPipeline(const State &state, const wchar_t *name)
 {
+	const auto &key = state.GetKey();
 	const auto pPipeline = m_pipelines.find(key);
 
 	// Create one, if it does not exist
 	if (pPipeline == m_pipelines.end())
 	{
-		const auto pKey = reinterpret_cast<const State::Key*>(key.data());
-		const auto pipeline = createPipeline(pKey, name);
+		const auto pipeline = createPipeline(state, name);
 		m_pipelines[key] = pipeline;
 
 		return pipeline;
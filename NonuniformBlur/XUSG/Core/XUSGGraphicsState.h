@@ -56,14 +56,16 @@ namespace XUSG
 		class State
 		{
 		public:
+			// Hashes of the contents, so that equal pipelines share a key whichever
+			// objects they were set from
 			struct Key
 			{
-				void	*PipelineLayout;
-				void	*Shaders[Shader::Stage::NUM_GRAPHICS];
-				void	*Blend;
-				void	*Rasterizer;
-				void	*DepthStencil;
-				void	*InputLayout;
+				uint64_t PipelineLayout;
+				uint64_t Shaders[Shader::Stage::NUM_GRAPHICS];
+				uint64_t Blend;
+				uint64_t Rasterizer;
+				uint64_t DepthStencil;
+				uint64_t InputLayout;
 				uint8_t	PrimitiveTopologyType;
 				uint8_t	NumRenderTargets;
 				uint8_t	RTVFormats[8];
@@ -97,10 +99,23 @@ namespace XUSG
 			Pipeline GetPipeline(PipelineCache &pipelineCache, const wchar_t *name = nullptr) const;
 
 			const std::string &GetKey() const;
+			const PipelineLayout &GetPipelineLayout() const;
+			const Blob &GetShader(Shader::Stage stage) const;
+			const Blend &GetBlendState() const;
+			const Rasterizer &GetRasterizerState() const;
+			const DepthStencil &GetDepthStencilState() const;
+			const InputLayout &GetInputLayout() const;
 
 		protected:
 			Key *m_pKey;
 			std::string m_key;
+
+			PipelineLayout	m_pipelineLayout;
+			Blob			m_shaders[Shader::Stage::NUM_GRAPHICS];
+			Blend			m_blend;
+			Rasterizer		m_rasterizer;
+			DepthStencil	m_depthStencil;
+			InputLayout		m_inputLayout;
 		};
 
 		class PipelineCache
@@ -125,14 +140,14 @@ namespace XUSG
 			const DepthStencil	&GetDepthStencil(DepthStencilPreset preset);
 
 		protected:
-			Pipeline createPipeline(const State::Key *pKey, const wchar_t *name);
-			Pipeline getPipeline(const std::string &key, const wchar_t *name);
+			Pipeline createPipeline(const State &state, const wchar_t *name);
+			Pipeline getPipeline(const State &state, const wchar_t *name);
 
 			Device m_device;
 
 			InputLayoutPool	m_inputLayoutPool;
 
-			std::unordered_map<std::string, Pipeline> m_pipelines;
+			std::unordered_map<std::string, Pipeline, PipelineKeyHasher> m_pipelines;
 			Blend			m_blends[NUM_BLEND_PRESET];
 			Rasterizer		m_rasterizers[NUM_RS_PRESET];
 			DepthStencil	m_depthStencils[NUM_DS_PRESET];
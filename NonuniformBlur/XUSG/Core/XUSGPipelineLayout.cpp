@@ -4,10 +4,15 @@
 
 #include "DXFrameworkHelper.h"
 #include "XUSGPipelineLayout.h"
+#include "XUSGPipelineLibrary.h"
 
 using namespace std;
 using namespace XUSG;
 
+// {6F1B2C4A-8E3D-4A57-9C21-5B7D0E93A6F4}
+static const GUID WKPDID_PipelineLayoutHash =
+{ 0x6f1b2c4a, 0x8e3d, 0x4a57, { 0x9c, 0x21, 0x5b, 0x7d, 0x0e, 0x93, 0xa6, 0xf4 } };
+
 Util::PipelineLayout::PipelineLayout() :
 	m_descriptorTableLayoutKeys(0),
 	m_isTableLayoutsCompleted(false)
@@ -219,6 +224,10 @@ PipelineLayout PipelineLayoutCache::createPipelineLayout(const string &key, cons
 		IID_PPV_ARGS(&layout)), cerr, nullptr);
 	if (name) layout->SetName(name);
 
+	// Identifies the layout by content in the on-disk pipeline libraries
+	const auto hash = PipelineLibrary::Hash(signature->GetBufferPointer(), signature->GetBufferSize());
+	layout->SetPrivateData(WKPDID_PipelineLayoutHash, sizeof(hash), &hash);
+
 	return layout;
 }
 
@@ -327,3 +336,14 @@ DescriptorTableLayout PipelineLayoutCache::getDescriptorTableLayout(const string
 
 	return layoutPtrIter->second;
 }
+
+//--------------------------------------------------------------------------------------
+
+uint64_t XUSG::GetPipelineLayoutHash(const PipelineLayout &layout)
+{
+	uint64_t hash = 0;
+	auto size = static_cast<uint32_t>(sizeof(hash));
+	C_RETURN(!layout || FAILED(layout->GetPrivateData(WKPDID_PipelineLayoutHash, &size, &hash)), 0);
+
+	return size == sizeof(hash) ? hash : 0;
+}
@@ -104,4 +104,8 @@ namespace XUSG
 		std::unordered_map<std::string, PipelineLayout> m_pipelineLayouts;
 		std::unordered_map<std::string, DescriptorTableLayout> m_descriptorTableLayouts;
 	};
+
+	// Hash of the serialized root signature, stored on the layout at creation; 0 for
+	// layouts created elsewhere
+	uint64_t GetPipelineLayoutHash(const PipelineLayout &layout);
 }
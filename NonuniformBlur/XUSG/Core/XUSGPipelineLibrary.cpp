@@ -0,0 +1,229 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#include <cstring>
+#include <iostream>
+#include "XUSGPipelineLibrary.h"
+
+#ifndef M_RETURN
+#define M_RETURN(x, o, m, r)	if (x) { o << m << endl; return r; }
+#endif
+#ifndef C_RETURN
+#define C_RETURN(x, r)			if (x) return r
+#endif
+
+using namespace std;
+using namespace XUSG;
+
+namespace
+{
+	const uint64_t Prime1 = 0x9e3779b185ebca87ull;
+	const uint64_t Prime2 = 0xc2b2ae3d27d4eb4full;
+	const uint64_t Prime3 = 0x165667b19e3779f9ull;
+
+	inline uint64_t RotateLeft(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline uint64_t Round(uint64_t hash, uint64_t word)
+	{
+		hash ^= RotateLeft(word * Prime2, 31) * Prime1;
+
+		return RotateLeft(hash, 27) * Prime1 + Prime3;
+	}
+
+	inline size_t Align8(size_t size)
+	{
+		return (size + 7) & ~size_t(7);
+	}
+}
+
+bool PipelineLibrary::Key::operator<(const Key &key) const
+{
+	return ShaderHash != key.ShaderHash ? ShaderHash < key.ShaderHash : LayoutHash < key.LayoutHash;
+}
+
+PipelineLibrary::PipelineLibrary() :
+	m_blobs(),
+	m_isDirty(false)
+{
+}
+
+PipelineLibrary::~PipelineLibrary()
+{
+}
+
+PipelineLibrary::CreateResult PipelineLibrary::Create(const Key &key, const CreateFunc &pfnCreate)
+{
+	// Start from the blob compiled by a previous run, if any
+	const auto pBlob = GetBlob(key);
+	if (pBlob)
+	{
+		C_RETURN(pfnCreate(pBlob->data(), pBlob->size()), CREATE_LOADED);
+		RemoveBlob(key);
+	}
+
+	return pfnCreate(nullptr, 0) ? CREATE_COMPILED : CREATE_FAILED;
+}
+
+void PipelineLibrary::SetBlob(const Key &key, const void *pData, size_t size)
+{
+	if (key.ShaderHash == 0 || key.LayoutHash == 0) return;
+
+	const auto pBytes = static_cast<const uint8_t*>(pData);
+	m_blobs[key].assign(pBytes, pBytes + size);
+	m_isDirty = true;
+}
+
+bool PipelineLibrary::RemoveBlob(const Key &key)
+{
+	C_RETURN(m_blobs.erase(key) == 0, false);
+	m_isDirty = true;
+
+	return true;
+}
+
+const vector<uint8_t> *PipelineLibrary::GetBlob(const Key &key) const
+{
+	const auto blobIter = m_blobs.find(key);
+
+	return blobIter != m_blobs.end() ? &blobIter->second : nullptr;
+}
+
+uint32_t PipelineLibrary::GetNumBlobs() const
+{
+	return static_cast<uint32_t>(m_blobs.size());
+}
+
+bool PipelineLibrary::IsDirty() const
+{
+	return m_isDirty;
+}
+
+bool PipelineLibrary::Deserialize(const uint8_t *pData, size_t size)
+{
+	m_blobs.clear();
+	m_isDirty = false;
+
+	Header header;
+	C_RETURN(!pData || size < sizeof(Header), false);
+	memcpy(&header, pData, sizeof(Header));
+	M_RETURN(header.Magic != Magic || header.Version != Version, cerr,
+		"Pipeline library of an unknown format.", false);
+	M_RETURN(header.PayloadSize != size - sizeof(Header) ||
+		header.Checksum != Hash(pData + sizeof(Header), size - sizeof(Header)),
+		cerr, "Pipeline library is truncated or corrupt.", false);
+
+	// The checksum is no guard against a crafted file, so the offset is kept
+	// within size, including the padding of each blob
+	auto offset = sizeof(Header);
+	for (auto i = 0u; i < header.NumEntries; ++i)
+	{
+		EntryHeader entry;
+		if (offset > size || size - offset < sizeof(EntryHeader)) break;
+		memcpy(&entry, pData + offset, sizeof(EntryHeader));
+		offset += sizeof(EntryHeader);
+
+		const auto remaining = size - offset;
+		if (entry.Size > remaining || Align8(static_cast<size_t>(entry.Size)) > remaining) break;
+		const auto pBlob = pData + offset;
+		m_blobs[entry.BlobKey].assign(pBlob, pBlob + entry.Size);
+		offset += Align8(static_cast<size_t>(entry.Size));
+	}
+
+	// The checksum passed, so a mismatch means a writer bug
+	if (m_blobs.size() != header.NumEntries || offset != size)
+	{
+		m_blobs.clear();
+		M_RETURN(true, cerr, "Pipeline library has inconsistent entries.", false);
+	}
+
+	return true;
+}
+
+void PipelineLibrary::Serialize(vector<uint8_t> &data)
+{
+	auto size = sizeof(Header);
+	for (const auto &blob : m_blobs) size += sizeof(EntryHeader) + Align8(blob.second.size());
+	data.assign(size, 0);
+
+	auto offset = sizeof(Header);
+	for (const auto &blob : m_blobs)
+	{
+		EntryHeader entry = {};
+		entry.BlobKey = blob.first;
+		entry.Size = blob.second.size();
+		memcpy(&data[offset], &entry, sizeof(EntryHeader));
+		offset += sizeof(EntryHeader);
+
+		if (!blob.second.empty()) memcpy(&data[offset], blob.second.data(), blob.second.size());
+		offset += Align8(blob.second.size());
+	}
+
+	Header header = {};
+	header.Magic = Magic;
+	header.Version = Version;
+	header.NumEntries = static_cast<uint32_t>(m_blobs.size());
+	header.PayloadSize = size - sizeof(Header);
+	header.Checksum = Hash(&data[sizeof(Header)], size - sizeof(Header));
+	memcpy(&data[0], &header, sizeof(Header));
+
+	m_isDirty = false;
+}
+
+bool PipelineLibrary::Load(istream &stream)
+{
+	m_blobs.clear();
+	m_isDirty = false;
+
+	stream.seekg(0, ios::end);
+	const auto size = stream.tellg();
+	C_RETURN(!stream || size < 0, false);
+
+	vector<uint8_t> data(static_cast<size_t>(size));
+	stream.seekg(0, ios::beg);
+	C_RETURN(!stream.read(reinterpret_cast<char*>(data.data()), data.size()), false);
+
+	return Deserialize(data.data(), data.size());
+}
+
+bool PipelineLibrary::Save(ostream &stream)
+{
+	vector<uint8_t> data;
+	Serialize(data);
+
+	return !!stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+uint64_t PipelineLibrary::Hash(const void *pData, size_t size, uint64_t seed)
+{
+	// 8 bytes a round, with the rounds and finalizer of xxHash64 though not its
+	// exact output; the tail is zero padded and the size mixed in
+	const auto pBytes = static_cast<const uint8_t*>(pData);
+	auto hash = seed + Prime3 + static_cast<uint64_t>(size) * Prime1;
+
+	auto i = size_t(0);
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, pBytes + i, 8);
+		hash = Round(hash, word);
+	}
+
+	if (i < size)
+	{
+		uint64_t word = 0;
+		memcpy(&word, pBytes + i, size - i);
+		hash = Round(hash, word);
+	}
+
+	hash ^= hash >> 33;
+	hash *= Prime2;
+	hash ^= hash >> 29;
+	hash *= Prime3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
@@ -0,0 +1,92 @@
+//--------------------------------------------------------------------------------------
+// By Stars XU Tianchen
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <vector>
+
+namespace XUSG
+{
+	// Compiled pipeline blobs keyed by the content of their inputs, serialized to a
+	// file that a later run loads to skip the compilation. It has no Direct3D
+	// dependencies; the pipeline caches fill it from ID3D12PipelineState::GetCachedBlob()
+	// and pass the blobs back as D3D12_CACHED_PIPELINE_STATE, so the runtime still
+	// rejects the blobs of another adapter or driver.
+	class PipelineLibrary
+	{
+	public:
+		struct Key
+		{
+			uint64_t ShaderHash;	// Of the shader bytecode
+			uint64_t LayoutHash;	// Of the serialized root signature
+
+			bool operator<(const Key &key) const;
+		};
+
+		enum CreateResult : uint8_t
+		{
+			CREATE_FAILED,
+			CREATE_LOADED,
+			CREATE_COMPILED
+		};
+
+		// Creates a pipeline from the given blob, or compiles it if none is given
+		using CreateFunc = std::function<bool(const void *pBlob, size_t size)>;
+
+		PipelineLibrary();
+		virtual ~PipelineLibrary();
+
+		// Creates the pipeline of the key from its blob, if any, and compiles it if
+		// there is none or the runtime rejects it, which drops the blob; the caller
+		// then passes the blob of a compiled pipeline to SetBlob(). A key with a
+		// zero hash is never cached.
+		CreateResult Create(const Key &key, const CreateFunc &pfnCreate);
+
+		void SetBlob(const Key &key, const void *pData, size_t size);
+		bool RemoveBlob(const Key &key);
+		const std::vector<uint8_t> *GetBlob(const Key &key) const;
+
+		uint32_t GetNumBlobs() const;
+		bool IsDirty() const;
+
+		// The whole file, validated on the way in; a file that fails any check
+		// leaves the library empty
+		bool Deserialize(const uint8_t *pData, size_t size);
+		void Serialize(std::vector<uint8_t> &data);
+
+		// The same, through a binary file stream
+		bool Load(std::istream &stream);
+		bool Save(std::ostream &stream);
+
+		static uint64_t Hash(const void *pData, size_t size, uint64_t seed = 0);
+
+		static const uint32_t Magic = 0x424c5058;	// "XPLB"
+		static const uint32_t Version = 1;
+
+	protected:
+		struct Header
+		{
+			uint32_t Magic;
+			uint32_t Version;
+			uint32_t NumEntries;
+			uint32_t Reserved;
+			uint64_t PayloadSize;
+			uint64_t Checksum;	// Of the payload
+		};
+
+		struct EntryHeader
+		{
+			Key BlobKey;
+			uint64_t Size;	// Followed by the blob, padded to 8 bytes
+		};
+
+		std::map<Key, std::vector<uint8_t>> m_blobs;
+		bool m_isDirty;
+	};
+}
@@ -260,6 +260,11 @@ ResourceState ResourceBase::GetResourceState(uint32_t i) const
 	return m_states[i];
 }
 
+void ResourceBase::SetResourceState(ResourceState state, uint32_t i)
+{
+	m_states[i] = state;
+}
+
 void ResourceBase::setDevice(const Device & device)
 {
 	m_device = device;
@@ -64,6 +64,9 @@ namespace XUSG
 			BarrierFlags flags = BarrierFlags(0));
 		ResourceState	GetResourceState(uint32_t i = 0) const;
 
+		// Records a state reached by barriers issued elsewhere, e.g. by a BarrierScheduler
+		void SetResourceState(ResourceState state, uint32_t i = 0);
+
 		//static void CreateReadBuffer(const Device &device,
 			//CPDXBuffer &pDstBuffer, const CPDXBuffer &pSrcBuffer);
 	protected:
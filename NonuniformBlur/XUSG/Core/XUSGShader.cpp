@@ -4,6 +4,7 @@
 
 #include "DXFrameworkHelper.h"
 #include "XUSGShader.h"
+#include "XUSGPipelineLibrary.h"
 
 using namespace std;
 using namespace XUSG;
@@ -11,7 +12,8 @@ using namespace Shader;
 
 ShaderPool::ShaderPool() :
 	m_shaders(),
-	m_reflectors()
+	m_reflectors(),
+	m_pendingShaders()
 {
 }
 
@@ -21,6 +23,7 @@ ShaderPool::~ShaderPool()
 
 void ShaderPool::SetShader(Shader::Stage stage, uint32_t index, const Blob &shader)
 {
+	m_pendingShaders[stage].erase(index);
 	checkShaderStorage(stage, index) = shader;
 }
 
@@ -37,26 +40,66 @@ void ShaderPool::SetReflector(Shader::Stage stage, uint32_t index, const Reflect
 
 Blob ShaderPool::CreateShader(Shader::Stage stage, uint32_t index, const wstring &fileName)
 {
-	auto &shader = checkShaderStorage(stage, index);
-	V_RETURN(D3DReadFileToBlob(fileName.c_str(), &shader), cerr, nullptr);
+	m_pendingShaders[stage].erase(index);
 
 	auto &reflector = checkReflectorStorage(stage, index);
 	reflector = make_shared<Reflector>();
-	N_RETURN(reflector->SetShader(shader), nullptr);
+
+	auto &shader = checkShaderStorage(stage, index);
+	shader = loadShader(fileName, reflector);
 
 	return shader;
 }
 
 Blob ShaderPool::GetShader(Shader::Stage stage, uint32_t index) const
 {
+	const auto pendingIter = m_pendingShaders[stage].find(index);
+	C_RETURN(pendingIter != m_pendingShaders[stage].end(), pendingIter->second.get());
+
 	return index < m_shaders[stage].size() ? m_shaders[stage][index] : nullptr;
 }
 
 ReflectorPtr ShaderPool::GetReflector(Shader::Stage stage, uint32_t index) const
 {
+	// Reflected by the same worker that loads the shader
+	const auto pendingIter = m_pendingShaders[stage].find(index);
+	if (pendingIter != m_pendingShaders[stage].end()) pendingIter->second.wait();
+
 	return index < m_reflectors[stage].size() ? m_reflectors[stage][index] : nullptr;
 }
 
+shared_future<Blob> ShaderPool::CreateShaderAsync(Shader::Stage stage, uint32_t index, const wstring &fileName)
+{
+	// The reflector is owned by the pool from the start, so that the storage may
+	// grow while the worker fills it
+	const auto reflector = make_shared<Reflector>();
+	checkReflectorStorage(stage, index) = reflector;
+	checkShaderStorage(stage, index) = nullptr;
+
+	auto shader = async(launch::async, loadShader, fileName, reflector).share();
+	m_pendingShaders[stage][index] = shader;
+
+	return shader;
+}
+
+bool ShaderPool::WaitForShaders()
+{
+	auto success = true;
+	for (uint8_t stage = 0; stage < NUM_STAGE; ++stage)
+	{
+		for (auto &pending : m_pendingShaders[stage])
+		{
+			const auto shader = pending.second.get();
+			success = success && shader;
+			checkShaderStorage(static_cast<Stage>(stage), pending.first) = shader;
+		}
+
+		m_pendingShaders[stage].clear();
+	}
+
+	return success;
+}
+
 Blob &ShaderPool::checkShaderStorage(Shader::Stage stage, uint32_t index)
 {
 	if (index >= m_shaders[stage].size())
@@ -72,3 +115,21 @@ ReflectorPtr &ShaderPool::checkReflectorStorage(Shader::Stage stage, uint32_t in
 
 	return m_reflectors[stage][index];
 }
+
+Blob ShaderPool::loadShader(const wstring &fileName, const ReflectorPtr &reflector)
+{
+	Blob shader;
+	V_RETURN(D3DReadFileToBlob(fileName.c_str(), &shader), cerr, nullptr);
+	N_RETURN(reflector->SetShader(shader), nullptr);
+
+	return shader;
+}
+
+//--------------------------------------------------------------------------------------
+
+uint64_t XUSG::GetShaderHash(const Blob &shader)
+{
+	C_RETURN(!shader, 0);
+
+	return PipelineLibrary::Hash(shader->GetBufferPointer(), shader->GetBufferSize());
+}
@@ -42,11 +42,26 @@ namespace XUSG
 		Blob		GetShader(Shader::Stage stage, uint32_t index) const;
 		ReflectorPtr GetReflector(Shader::Stage stage, uint32_t index) const;
 
+		// Reads and reflects the shader on a worker thread; GetShader() and
+		// GetReflector() wait for it, and the future yields nullptr on failure
+		std::shared_future<Blob> CreateShaderAsync(Shader::Stage stage, uint32_t index, const std::wstring &fileName);
+
+		// Waits for all the asynchronous loads; false if any of them failed
+		bool WaitForShaders();
+
 	protected:
 		Blob &checkShaderStorage(Shader::Stage stage, uint32_t index);
 		ReflectorPtr &checkReflectorStorage(Shader::Stage stage, uint32_t index);
 
+		static Blob loadShader(const std::wstring &fileName, const ReflectorPtr &reflector);
+
 		std::vector<Blob> m_shaders[Shader::NUM_STAGE];
 		std::vector<ReflectorPtr> m_reflectors[Shader::NUM_STAGE];
+
+		// Asynchronous loads, by index, until waited for
+		std::map<uint32_t, std::shared_future<Blob>> m_pendingShaders[Shader::NUM_STAGE];
 	};
+
+	// Hash of the shader bytecode; 0 for no shader
+	uint64_t GetShaderHash(const Blob &shader);
 }
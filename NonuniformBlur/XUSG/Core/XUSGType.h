@@ -107,6 +107,24 @@ namespace XUSG
 
 	using Pipeline = com_ptr<ID3D12PipelineState>;
 
+	// Pipeline state keys are made of 64-bit content hashes, so folding their
+	// words is enough
+	struct PipelineKeyHasher
+	{
+		size_t operator()(const std::string &key) const
+		{
+			uint64_t hash = 0;
+			for (size_t i = 0; i + sizeof(uint64_t) <= key.size(); i += sizeof(uint64_t))
+			{
+				uint64_t word;
+				memcpy(&word, &key[i], sizeof(uint64_t));
+				hash = (hash ^ word) * 0x9e3779b185ebca87ull;
+			}
+
+			return static_cast<size_t>(hash ^ (hash >> 32));
+		}
+	};
+
 	// Shaders related
 	namespace Shader
 	{
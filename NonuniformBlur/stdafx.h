@@ -39,6 +39,7 @@
 #include <unordered_map>
 #include <map>
 #include <functional>
+#include <future>
 #include <wrl.h>
 #include <shellapi.h>
 